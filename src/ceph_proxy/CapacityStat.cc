@@ -0,0 +1,231 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "CapacityStat.h"
+#include "CephProxy.h"
+#include "RadosWrapper.h"
+#include "ConfigRead.h"
+#include "CephProxyLog.h"
+
+#include <errno.h>
+
+#include <string>
+#include <utility>
+
+CapacityStat::CapacityStat(CephProxy *_proxy): proxy(_proxy),
+    refreshInterval(ProxyGetCapacityRefreshMs()), maxStale(ProxyGetCapacityMaxStaleMs()),
+    requested(0), completed(0), version(0), lastRet(0), stop(false)
+{
+}
+
+int CapacityStat::Load(CapacitySnapshot &snap)
+{
+    snap.time = std::chrono::steady_clock::now();
+    int ret = RadosGetClusterStat(proxy->radosClient, &snap.cluster);
+    if (ret < 0) {
+        return ret;
+    }
+
+    std::vector<std::pair<int64_t, std::string>> pools;
+    proxy->poolDir.GetPools(pools);
+    return RadosGetAllPoolsStat(proxy->radosClient, pools, snap.pools);
+}
+
+void CapacityStat::Refresher()
+{
+    std::unique_lock<std::mutex> l(lock);
+    auto next = std::chrono::steady_clock::now() + refreshInterval;
+    while (!stop) {
+        refreshCond.wait_until(l, next, [this]() { return stop || requested > completed; });
+        if (stop) {
+            break;
+        }
+
+        uint64_t target = requested;
+        l.unlock();
+        std::shared_ptr<CapacitySnapshot> snap = std::make_shared<CapacitySnapshot>();
+        int ret = Load(*snap);
+        l.lock();
+
+        if (ret == 0) {
+            snap->version = ++version;
+            std::atomic_store(&snapshot, std::shared_ptr<const CapacitySnapshot>(snap));
+        } else {
+            ProxyDbgLogWarnLimit1("refresh capacity failed: %d", ret);
+        }
+        lastRet = ret;
+        completed = target;
+        next = std::chrono::steady_clock::now() + refreshInterval;
+        doneCond.notify_all();
+
+        std::vector<Waiter> done;
+        for (auto iter = waiters.begin(); iter != waiters.end();) {
+            if (iter->gen <= target) {
+                done.push_back(*iter);
+                iter = waiters.erase(iter);
+            } else {
+                iter++;
+            }
+        }
+        if (!done.empty()) {
+            uint64_t ver = version;
+            l.unlock();
+            for (auto &w : done) {
+                w.cb(ret, ver, w.arg);
+            }
+            l.lock();
+        }
+    }
+}
+
+void CapacityStat::Start()
+{
+    std::shared_ptr<CapacitySnapshot> snap = std::make_shared<CapacitySnapshot>();
+    int ret = Load(*snap);
+    if (ret == 0) {
+        snap->version = ++version;
+        std::atomic_store(&snapshot, std::shared_ptr<const CapacitySnapshot>(snap));
+    } else {
+        ProxyDbgLogErr("load capacity failed: %d", ret);
+    }
+
+    refresher = std::thread(&CapacityStat::Refresher, this);
+}
+
+void CapacityStat::Stop()
+{
+    std::vector<Waiter> cancelled;
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stop = true;
+        refreshCond.notify_all();
+        doneCond.notify_all();
+    }
+    if (refresher.joinable()) {
+        refresher.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> l(lock);
+        cancelled.swap(waiters);
+    }
+    for (auto &w : cancelled) {
+        w.cb(-ECANCELED, 0, w.arg);
+    }
+}
+
+int CapacityStat::GetSnapshot(std::shared_ptr<const CapacitySnapshot> &snap, bool fresh)
+{
+    snap = std::atomic_load(&snapshot);
+    if (!fresh && snap != nullptr && std::chrono::steady_clock::now() - snap->time <= maxStale) {
+        return 0;
+    }
+
+    std::unique_lock<std::mutex> l(lock);
+    if (stop) {
+        return -ESHUTDOWN;
+    }
+    uint64_t gen = ++requested;
+    refreshCond.notify_one();
+    doneCond.wait(l, [this, gen]() { return stop || completed >= gen; });
+    if (completed < gen) {
+        return -ESHUTDOWN;
+    }
+    if (lastRet < 0) {
+        return lastRet;
+    }
+
+    snap = std::atomic_load(&snapshot);
+    return 0;
+}
+
+int CapacityStat::GetClusterStat(CephClusterStat *stat)
+{
+    std::shared_ptr<const CapacitySnapshot> snap;
+    int ret = GetSnapshot(snap, false);
+    if (ret != 0) {
+        return ret;
+    }
+
+    *stat = snap->cluster;
+    return 0;
+}
+
+int CapacityStat::GetPoolStat(int64_t poolId, CephPoolStat *stat)
+{
+    std::shared_ptr<const CapacitySnapshot> snap;
+    int ret = GetSnapshot(snap, false);
+    if (ret != 0) {
+        return ret;
+    }
+
+    auto iter = snap->pools.find(poolId);
+    if (iter == snap->pools.end()) {
+        /* a pool created after the snapshot is worth a refresh once the directory knows it */
+        std::string poolName;
+        if (proxy->poolDir.GetPoolName(poolId, poolName) != 0) {
+            return -ENOENT;
+        }
+        ret = GetSnapshot(snap, true);
+        if (ret != 0) {
+            return ret;
+        }
+        iter = snap->pools.find(poolId);
+        if (iter == snap->pools.end()) {
+            return -ENOENT;
+        }
+    }
+
+    *stat = iter->second;
+    return 0;
+}
+
+int CapacityStat::GetPoolsStat(CephPoolStat *stat, uint64_t *poolId, uint32_t poolNum)
+{
+    std::shared_ptr<const CapacitySnapshot> snap;
+    int ret = GetSnapshot(snap, false);
+    if (ret != 0) {
+        return ret;
+    }
+
+    for (uint32_t i = 0; i < poolNum; i++) {
+        std::string poolName;
+        if (snap->pools.find(poolId[i]) == snap->pools.end() &&
+            proxy->poolDir.GetPoolName(poolId[i], poolName) == 0) {
+            ret = GetSnapshot(snap, true);
+            if (ret != 0) {
+                return ret;
+            }
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < poolNum; i++) {
+        auto iter = snap->pools.find(poolId[i]);
+        if (iter == snap->pools.end()) {
+            ProxyDbgLogErr("lookup pool stat poolId: %lu failed", poolId[i]);
+            stat[i].numBytes = -1;
+            continue;
+        }
+        stat[i] = iter->second;
+    }
+    return 0;
+}
+
+int CapacityStat::Refresh(CapacityCallBack_t cb, void *arg)
+{
+    if (cb == nullptr) {
+        return -EINVAL;
+    }
+
+    std::lock_guard<std::mutex> l(lock);
+    if (stop) {
+        return -ESHUTDOWN;
+    }
+    waiters.push_back({ ++requested, cb, arg });
+    refreshCond.notify_one();
+    return 0;
+}
@@ -0,0 +1,81 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_CAPACITY_STAT_H_
+#define _CEPH_PROXY_CAPACITY_STAT_H_
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CephProxyInterface.h"
+
+class CephProxy;
+
+struct CapacitySnapshot {
+    uint64_t version;
+    /* when the refresh that produced it started */
+    std::chrono::steady_clock::time_point time;
+    CephClusterStat cluster;
+    std::map<int64_t, CephPoolStat> pools;
+};
+
+/*
+ * Cluster and per-pool usage kept by a refresher thread: one cluster_stat
+ * and one get_pool_stats over the pools of the pool directory per refresh,
+ * every refreshInterval. Readers take the latest snapshot without a lock;
+ * one older than maxStale, or missing a pool the directory knows, makes the
+ * reader wait for a refresh that starts after it, and concurrent readers
+ * share that refresh.
+ */
+class CapacityStat {
+private:
+    struct Waiter {
+        uint64_t gen;
+        CapacityCallBack_t cb;
+        void *arg;
+    };
+
+    CephProxy *proxy;
+    std::shared_ptr<const CapacitySnapshot> snapshot;
+    std::chrono::milliseconds refreshInterval;
+    std::chrono::milliseconds maxStale;
+
+    std::mutex lock;
+    std::condition_variable refreshCond;
+    std::condition_variable doneCond;
+    /* a reader asks for refresh requested and waits until completed reaches it */
+    uint64_t requested;
+    uint64_t completed;
+    uint64_t version;
+    int lastRet;
+    bool stop;
+    std::vector<Waiter> waiters;
+    std::thread refresher;
+
+    int Load(CapacitySnapshot &snap);
+    void Refresher();
+    int GetSnapshot(std::shared_ptr<const CapacitySnapshot> &snap, bool fresh);
+
+public:
+    CapacityStat(CephProxy *_proxy);
+    ~CapacityStat() { }
+
+    void Start();
+    void Stop();
+    int GetClusterStat(CephClusterStat *stat);
+    int GetPoolStat(int64_t poolId, CephPoolStat *stat);
+    int GetPoolsStat(CephPoolStat *stat, uint64_t *poolId, uint32_t poolNum);
+    int Refresh(CapacityCallBack_t cb, void *arg);
+};
+
+#endif
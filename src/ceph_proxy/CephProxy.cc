@@ -67,6 +67,15 @@ int CephProxy::Init(const std::string &cephConf,
 	return ret;
     } 
 
+    ret = poolDir.Init(radosClient);
+    if (ret != 0) {
+	ProxyDbgLogErr("PoolDirectory Init failed: %d.", ret);
+	ptable.Clear();
+	RadosClientShutdown(radosClient);
+	return ret;
+    }
+    minAlloc.Init(radosClient);
+
     std::string coreNumber = ProxyGetCoreNumber();
     std::vector<uint32_t> vecCoreId;
     vecCoreId.resize(0);
@@ -93,6 +102,13 @@ int CephProxy::Init(const std::string &cephConf,
     }
     worker->Start(vecCoreId);
 
+    capacityStat = new(std::nothrow) CapacityStat(this);
+    if (capacityStat == nullptr) {
+        ProxyDbgLogErr("Allocate memory failed.");
+        return -1;
+    }
+    capacityStat->Start();
+
     poolStatManager = new(std::nothrow) PoolUsageStat(this);
     if (poolStatManager == nullptr) {
         ProxyDbgLogErr("Allocate memory failed.");
@@ -111,6 +127,12 @@ void CephProxy::Shutdown() {
 	poolStatManager = nullptr;
     }
 
+    if (capacityStat) {
+	capacityStat->Stop();
+	delete capacityStat;
+	capacityStat = nullptr;
+    }
+
     if (worker) {
 	worker->Stop();
 	delete worker;
@@ -118,6 +140,8 @@ void CephProxy::Shutdown() {
     }
 
     ptable.Clear();
+    poolDir.Clear();
+    minAlloc.Clear();
     RadosClientShutdown(radosClient);
     state = PROXY_DOWN;
 }
@@ -132,6 +156,16 @@ int32_t CephProxy::Enqueue(ceph_proxy_op_t op, completion_t c)
     return ret;
 }
 
+int32_t CephProxy::EnqueueBatch(ceph_proxy_op_t *ops, completion_t *comps, uint32_t num)
+{
+    uint64_t ts = 0;
+    int32_t ret = 0;
+    PROXY_FTDS_START_HIGH(PROXY_FTDS_OPS_QUEUE, ts);
+    ret = worker->QueueBatch(ops, comps, num);
+    PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_QUEUE, ts, ret == (int32_t)num ? 0 : -1);
+    return ret;
+}
+
 rados_ioctx_t CephProxy::GetIoCtx(const std::string &pool)
 {
     uint64_t ts = 0;
@@ -160,6 +194,9 @@ rados_ioctx_t CephProxy::GetIoCtx2(const int64_t poolId)
         int ret = RadosCreateIoCtx2(radosClient, poolId, &ioctx);
         if (ret != 0) {
             ProxyDbgLogWarnLimit1("Create IoCtx(%ld) failed: %d", poolId, ret);
+            if (ret == -ENOENT) {
+                poolDir.Invalidate(poolId);
+            }
             PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_GETIOCTX, ts, ret);
             return nullptr;
         }
@@ -178,6 +215,9 @@ rados_ioctx_t CephProxy::GetIoCtxFromCeph(const int64_t poolId)
     int ret = RadosCreateIoCtx2(radosClient, poolId, &ioctx);
     if (ret != 0) {
         ProxyDbgLogWarnLimit1("Create IoCtx(%ld) failed: %d", poolId, ret);
+        if (ret == -ENOENT) {
+            poolDir.Invalidate(poolId);
+        }
         PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_GETIOCTX, ts, ret);
         return nullptr;
     }
@@ -188,38 +228,34 @@ rados_ioctx_t CephProxy::GetIoCtxFromCeph(const int64_t poolId)
 
 int64_t CephProxy::GetPoolIdByPoolName(const char *poolName)
 {
-    rados_ioctx_t ioctx;
-    int ret = RadosCreateIoCtx(radosClient, poolName, &ioctx);
-    if (ret != 0) {
-        ProxyDbgLogErr("Create IoCtx Failed: %d", ret);
+    if (poolName == nullptr) {
         return -1;
     }
-    
-    ret = RadosGetPoolId(ioctx);
-    if (ret < 0) {
-        ProxyDbgLogErr("Get Pool ID Failed: %d", ret);
+
+    int64_t poolId = poolDir.GetPoolId(poolName);
+    if (poolId < 0) {
+        ProxyDbgLogErr("Get Pool ID of %s Failed: %ld", poolName, poolId);
+        return -1;
     }
 
-    RadosReleaseIoCtx(ioctx);
-    return ret;
+    return poolId;
 }
 
 int CephProxy::GetPoolNameByPoolId(int64_t poolId, char *buf, unsigned maxLen)
 {
-    rados_ioctx_t ioctx;
-    int ret = RadosCreateIoCtx2(radosClient, poolId, &ioctx);
-    if (ret != 0) {
-        ProxyDbgLogErr("Create IoCtx Failed: %d", ret);
+    std::string poolName;
+    int ret = poolDir.GetPoolName(poolId, poolName);
+    if (ret < 0) {
+        ProxyDbgLogErr("Get Pool Name of %ld Failed: %d", poolId, ret);
         return -1;
     }
-    
-    ret = RadosGetPoolName(ioctx, buf, maxLen);
-    if (ret < 0) {
-        ProxyDbgLogErr("Get Pool ID Failed: %d", ret);
+
+    if (poolName.length() >= maxLen) {
+        return -ERANGE;
     }
 
-    RadosReleaseIoCtx(ioctx);
-    return ret;
+    memcpy(buf, poolName.c_str(), poolName.length() + 1);
+    return 0;
 }
 
 int64_t CephProxy::GetPoolIdByCtx(rados_ioctx_t ioctx)
@@ -232,19 +268,48 @@ int64_t CephProxy::GetPoolIdByCtx(rados_ioctx_t ioctx)
     return ret;
 }    
 
+void CephProxy::CheckPoolGone(int64_t poolId)
+{
+    /* a missing object answers -ENOENT too, only a pool gone from the osdmap is dropped */
+    std::string poolName;
+    if (RadosPoolReverseLookup(radosClient, poolId, poolName) == -ENOENT) {
+        poolDir.Invalidate(poolId);
+    }
+}
+
 int CephProxy::GetClusterStat(CephClusterStat *stat)
 {
-	return RadosGetClusterStat(radosClient, stat);
+    if (capacityStat == nullptr) {
+	ProxyDbgLogErr("proxy is not working.");
+	return -1;
+    }
+
+    return capacityStat->GetClusterStat(stat);
 }
 
 int CephProxy::GetPoolStat(rados_ioctx_t ctx, CephPoolStat *stat)
 {
-	return RadosGetPoolStat(radosClient, ctx, stat);
+    if (capacityStat == nullptr) {
+	ProxyDbgLogErr("proxy is not working.");
+	return -1;
+    }
+
+    if (ctx == nullptr) {
+	ProxyDbgLogErr("ioctx %p not valid", ctx);
+	return -EINVAL;
+    }
+
+    return capacityStat->GetPoolStat(RadosGetPoolId(ctx), stat);
 }
 
 int CephProxy::GetPoolsStat(CephPoolStat *stat, uint64_t *poolId, uint32_t poolNum)
 {
-	return RadosGetPoolsStat(radosClient, stat, poolId, poolNum);
+    if (capacityStat == nullptr) {
+	ProxyDbgLogErr("proxy is not working.");
+	return -1;
+    }
+
+    return capacityStat->GetPoolsStat(stat, poolId, poolNum);
 }
 
 int CephProxy::GetPoolUsedSizeAndMaxAvail(uint64_t &usedSize, uint64_t &maxAvail)
@@ -257,6 +322,16 @@ int CephProxy::GetPoolUsedSizeAndMaxAvail(uint64_t &usedSize, uint64_t &maxAvail
     return poolStatManager->GetPoolAllUsedAndAvail(usedSize, maxAvail);
 }
 
+int CephProxy::RefreshCapacity(CapacityCallBack_t cb, void *arg)
+{
+    if (capacityStat == nullptr) {
+	ProxyDbgLogErr("proxy is not working.");
+	return -1;
+    }
+
+    return capacityStat->Refresh(cb, arg);
+}
+
 int CephProxy::RegisterPoolNewNotifyFn(NotifyPoolEventFn fn)
 {
     if (poolStatManager == nullptr) {
@@ -281,16 +356,28 @@ int CephProxy::GetMinAllocSize(uint32_t *minAllocSize, CEPH_BDEV_TYPE_E type)
 {
      switch(type) {
 	    case CEPH_BDEV_HDD:
-     	    return RadosGetMinAllocSizeHDD(radosClient,minAllocSize);
+     	    return minAlloc.GetMinAllocSize(CEPH_BDEV_HDD, minAllocSize);
 	    case CEPH_BDEV_SSD:
-     	    return RadosGetMinAllocSizeSSD(radosClient,minAllocSize);
+     	    return minAlloc.GetMinAllocSize(CEPH_BDEV_SSD, minAllocSize);
 	    default:
-     	    return RadosGetMinAllocSizeHDD(radosClient,minAllocSize);
+     	    return minAlloc.GetMinAllocSize(CEPH_BDEV_HDD, minAllocSize);
     }
 
     return 0;
 }
 
+int CephProxy::GetPoolMinAllocSize(int64_t poolId, uint32_t *minAllocSize)
+{
+    std::string poolName;
+    int ret = poolDir.GetPoolName(poolId, poolName);
+    if (ret != 0) {
+	ProxyDbgLogErr("lookup pool %ld failed: %d", poolId, ret);
+	return ret;
+    }
+
+    return minAlloc.GetPoolMinAllocSize(poolId, minAllocSize);
+}
+
 CephProxyState CephProxy::GetState() const {
 	return state;
 }
@@ -16,6 +16,9 @@
 #include "CephProxyInterface.h"
 #include "RadosWorker.h"
 #include "PoolContext.h"
+#include "PoolDirectory.h"
+#include "MinAllocDiscovery.h"
+#include "CapacityStat.h"
 #include "RadosMonitor.h"
 
 typedef void *rados_client_t;
@@ -40,15 +43,18 @@ class CephProxy {
 public:
 	rados_client_t radosClient;
 	IOCtxTable ptable;
+	PoolDirectory poolDir;
+	MinAllocDiscovery minAlloc;
 	ProxyConfig config;
 	RadosWorker *worker;
 	PoolUsageStat *poolStatManager;
+	CapacityStat *capacityStat;
 
 	CephProxyState state;
 
 	static CephProxy *instance;
 private:
-	CephProxy(): state(PROXY_DOWN) { }
+	CephProxy(): capacityStat(nullptr), state(PROXY_DOWN) { }
 public:
 	static CephProxy* GetProxy() {
 	    if ( instance == nullptr) {
@@ -66,6 +72,7 @@ public:
 	
 	void Shutdown();
 	int32_t Enqueue(ceph_proxy_op_t op, completion_t c);
+	int32_t EnqueueBatch(ceph_proxy_op_t *ops, completion_t *comps, uint32_t num);
 
 	CephProxyState GetState() const;
 	rados_ioctx_t GetIoCtx(const std::string& pool);
@@ -74,11 +81,15 @@ public:
 	int64_t GetPoolIdByPoolName(const char *poolName);
 	int GetPoolNameByPoolId(int64_t poolId, char *buf, unsigned maxLen);
 	int64_t GetPoolIdByCtx(rados_ioctx_t ioctx);
+	/* an op got -ENOENT, drop the pool from poolDir if it is the pool that is gone */
+	void CheckPoolGone(int64_t poolId);
 	int GetClusterStat(CephClusterStat *stat);
 	int GetPoolStat(rados_ioctx_t ctx, CephPoolStat *stat);
 	int GetPoolsStat(CephPoolStat *stat, uint64_t *poolId, uint32_t poolNum);
 	int GetMinAllocSize(uint32_t *minAllocSize, CEPH_BDEV_TYPE_E type);
+	int GetPoolMinAllocSize(int64_t poolId, uint32_t *minAllocSize);
 	int GetPoolUsedSizeAndMaxAvail(uint64_t &usedSize, uint64_t &maxAvail);
+	int RefreshCapacity(CapacityCallBack_t cb, void *arg);
 	int RegisterPoolNewNotifyFn(NotifyPoolEventFn fn);
 	int GetPoolInfo(uint32_t poolId, struct PoolInfo *info);
 };
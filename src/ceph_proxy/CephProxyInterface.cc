@@ -7,6 +7,11 @@
 #include "CephProxy.h"
 #include "RadosWrapper.h"
 #include "CephProxyOp.h"
+#include "ProxyCrc32c.h"
+#include "DataIntegrity.h"
+#include "CompletionRing.h"
+#include "ClsClient.h"
+#include "OmapStream.h"
 
 #include <iostream>
 #include <string>
@@ -62,6 +67,16 @@ int32_t CephProxyQueueOp(ceph_proxy_t proxy, ceph_proxy_op_t op, completion_t c)
     return cephProxy->Enqueue(op, c);
 }
 
+int32_t CephProxyQueueOps(ceph_proxy_t proxy, ceph_proxy_op_t *ops, completion_t *comps, uint32_t num)
+{
+    CephProxy *cephProxy = reinterpret_cast<CephProxy*>(proxy);
+	if (cephProxy == nullptr || ops == nullptr || comps == nullptr) {
+		ProxyDbgLogErr("proxy %p, ops %p or comps %p is invalid", cephProxy, ops, comps);
+		return -EINVAL;
+	}
+    return cephProxy->EnqueueBatch(ops, comps, num);
+}
+
 rados_ioctx_t CephProxyGetIoCtx(ceph_proxy_t proxy, const char *poolname)
 {
 	CephProxy *cephProxy = reinterpret_cast<CephProxy *>(proxy);
@@ -117,6 +132,16 @@ int CephProxyGetMinAllocSize(ceph_proxy_t proxy, uint32_t *minAllocSize, CEPH_BD
 	return cephProxy->GetMinAllocSize(minAllocSize, type);
 }
 
+int CephProxyGetPoolMinAllocSize(ceph_proxy_t proxy, int64_t poolId, uint32_t *minAllocSize)
+{
+	CephProxy *cephProxy = reinterpret_cast<CephProxy *>(proxy);
+	if (cephProxy == nullptr || minAllocSize == nullptr) {
+		ProxyDbgLogErr("proxy %p or minAllocSize %p is invalid", cephProxy, minAllocSize);
+		return -EINVAL;
+	}
+	return cephProxy->GetPoolMinAllocSize(poolId, minAllocSize);
+}
+
 int CephProxyGetClusterStat(ceph_proxy_t proxy, CephClusterStat *result)
 {
 	CephProxy *cephProxy = reinterpret_cast<CephProxy *>(proxy);
@@ -163,6 +188,16 @@ int CephProxyGetUsedSizeAndMaxAvail(ceph_proxy_t proxy, uint64_t &usedSize, uint
 	return cephProxy->GetPoolUsedSizeAndMaxAvail(usedSize, maxAvail);
 }
 
+int CephProxyRefreshCapacity(ceph_proxy_t proxy, CapacityCallBack_t cb, void *arg)
+{
+	CephProxy *cephProxy = reinterpret_cast<CephProxy *>(proxy);
+	if (cephProxy == nullptr) {
+		ProxyDbgLogErr("proxy %p is invalid", cephProxy);
+		return -EINVAL;
+	}
+	return cephProxy->RefreshCapacity(cb, arg);
+}
+
 int CephProxyRegisterPoolNewNotifyFn(NotifyPoolEventFn fn)
 {
 	ceph_proxy_t proxy = GetCephProxyInstance();
@@ -184,6 +219,56 @@ int CephProxyGetPoolInfo(ceph_proxy_t proxy, uint32_t poolId, struct PoolInfo *i
 	return cephProxy->GetPoolInfo(poolId, info);
 }
 
+int CephProxyOmapStreamOpen(ceph_proxy_t proxy, int64_t poolId, const char *oid,
+			const char *startAfter, uint32_t pageSize, uint32_t flags, proxy_omap_stream_t *stream)
+{
+	CephProxy *cephProxy = reinterpret_cast<CephProxy *>(proxy);
+	if (cephProxy == nullptr || oid == nullptr || stream == nullptr) {
+		ProxyDbgLogErr("proxy %p, oid %p or stream %p is invalid", cephProxy, oid, stream);
+		return -EINVAL;
+	}
+	OmapStream *s = nullptr;
+	int ret = OmapStream::Open(cephProxy, poolId, oid, startAfter, pageSize, flags, &s);
+	*stream = s;
+	return ret;
+}
+
+int CephProxyOmapStreamNext(proxy_omap_stream_t stream, const char **key, size_t *keyLen,
+			const char **val, size_t *valLen)
+{
+	OmapStream *s = static_cast<OmapStream *>(stream);
+	if (s == nullptr || key == nullptr || keyLen == nullptr) {
+		ProxyDbgLogErr("stream %p, key %p or keyLen %p is invalid", s, key, keyLen);
+		return -EINVAL;
+	}
+	return s->Next(key, keyLen, val, valLen);
+}
+
+void CephProxyOmapStreamStat(proxy_omap_stream_t stream, ProxyOmapStreamStat *stat)
+{
+	static_cast<OmapStream *>(stream)->Stat(stat);
+}
+
+void CephProxyOmapStreamClose(proxy_omap_stream_t stream)
+{
+	delete static_cast<OmapStream *>(stream);
+}
+
+int CephProxyRegisterIntegrityNotifyFn(IntegrityNotifyFn fn)
+{
+	ProxyIntegritySetNotifyFn(fn);
+	return 0;
+}
+
+void CephProxyGetIntegrityStat(CephIntegrityStat *stat)
+{
+	if (stat == nullptr) {
+		ProxyDbgLogErr("integrity stat %p is invalid", stat);
+		return;
+	}
+	ProxyIntegrityGetStat(stat);
+}
+
 int CephProxyWriteOpInit2(ceph_proxy_op_t *op, const int64_t poolId, const char* oid)
 {
 	if (op == nullptr || oid == nullptr) {
@@ -262,6 +347,25 @@ void CephProxyWriteOpWriteSGL(ceph_proxy_op_t op, SGL_S *s, size_t len1, uint64_
 	RadosWriteOpWriteSGL(op, s, len1, off, alignBuffer, isRelease);
 }
 
+int CephProxyWriteOpGetDataCrc(ceph_proxy_op_t op, uint32_t *crc)
+{
+	if (op == nullptr || crc == nullptr) {
+		ProxyDbgLogErr("op %p or crc %p is invalid", op, crc);
+		return -EINVAL;
+	}
+	return RadosWriteOpGetDataCrc(op, crc);
+}
+
+uint32_t CephProxyCrc32c(uint32_t crc, const char *buf, size_t len)
+{
+	return ProxyCrc32c(crc, buf, len);
+}
+
+uint32_t CephProxySglCrc32c(uint32_t crc, const SGL_S *sgl, size_t len, int isRelease)
+{
+	return ProxyCrc32cSgl(crc, sgl, len, isRelease);
+}
+
 void CephProxyWriteOpWriteFull(ceph_proxy_op_t op, const char *buffer, size_t len)
 {
 	RadosWriteOpWriteFull(op, buffer, len);
@@ -410,6 +514,15 @@ void CephProxyReadOpReadSGL(ceph_proxy_op_t op, uint64_t offset, size_t len, SGL
 	RadosReadOpReadSGL(op, offset, len , s, prval, isRelease);
 }
 
+void CephProxyReadOpSetExpectedCrc(ceph_proxy_op_t op, uint32_t crc)
+{
+	if (op == nullptr) {
+		ProxyDbgLogErr("op %p is invalid", op);
+		return;
+	}
+	RadosReadOpSetExpectedCrc(op, crc);
+}
+
 void CephProxyReadOpCheckSum(ceph_proxy_op_t op, proxy_checksum_type_t type, 
 			const char *initValue, size_t initValueLen, 
 			uint64_t offset, size_t len, size_t chunkSize, char *pCheckSum,
@@ -426,3 +539,126 @@ void CephProxyCompletionDestroy(completion_t c) {
 	CompletionDestroy(c);
 }
 
+int CephProxyCompletionRingCreate(uint32_t entries, proxy_cq_t *cq)
+{
+	if (cq == nullptr) {
+		ProxyDbgLogErr("cq %p is invalid", cq);
+		return -EINVAL;
+	}
+	CompletionRing *ring = CompletionRing::Create(entries);
+	if (ring == nullptr) {
+		*cq = nullptr;
+		return entries == 0 ? -EINVAL : -ENOMEM;
+	}
+	*cq = ring;
+	return 0;
+}
+
+int CephProxyCompletionRingDestroy(proxy_cq_t cq)
+{
+	CompletionRing *ring = static_cast<CompletionRing *>(cq);
+	if (ring == nullptr) {
+		return -EINVAL;
+	}
+	if (ring->Attached() != 0) {
+		ProxyDbgLogErr("completion ring %p still has %u completions", ring, ring->Attached());
+		return -EBUSY;
+	}
+	delete ring;
+	return 0;
+}
+
+completion_t CephProxyCreateRingCompletion(proxy_cq_t cq, void *userData)
+{
+	CompletionRing *ring = static_cast<CompletionRing *>(cq);
+	if (ring == nullptr) {
+		ProxyDbgLogErr("cq %p is invalid", ring);
+		return nullptr;
+	}
+	return CompletionRingInit(ring, userData);
+}
+
+uint32_t CephProxyCompletionRingReap(proxy_cq_t cq, ProxyCqEntry *entries, uint32_t max)
+{
+	return static_cast<CompletionRing *>(cq)->Reap(entries, max);
+}
+
+int CephProxyCompletionRingWait(proxy_cq_t cq, ProxyCqEntry *entries, uint32_t max,
+				uint32_t minComplete, int timeoutMs)
+{
+	CompletionRing *ring = static_cast<CompletionRing *>(cq);
+	if (ring == nullptr || entries == nullptr) {
+		ProxyDbgLogErr("cq %p or entries %p is invalid", ring, entries);
+		return -EINVAL;
+	}
+	return ring->Wait(entries, max, minComplete, timeoutMs);
+}
+
+int CephProxyCompletionRingFd(proxy_cq_t cq)
+{
+	return static_cast<CompletionRing *>(cq)->Fd();
+}
+
+int CephProxyCompletionRingArm(proxy_cq_t cq)
+{
+	return static_cast<CompletionRing *>(cq)->Arm() ? 1 : 0;
+}
+
+int CephProxyClsMethodRegister(const char *cls, const char *method, uint32_t flags, proxy_cls_method_t *handle)
+{
+	if (handle == nullptr) {
+		ProxyDbgLogErr("handle %p is invalid", handle);
+		return -EINVAL;
+	}
+	ClsMethod *m = nullptr;
+	int ret = ClsMethodCreate(cls, method, flags, &m);
+	*handle = m;
+	return ret;
+}
+
+void CephProxyClsMethodRelease(proxy_cls_method_t handle)
+{
+	ClsMethodDestroy(static_cast<ClsMethod *>(handle));
+}
+
+void CephProxyReadOpExec(ceph_proxy_op_t op, proxy_cls_method_t method, const char *inBuf,
+			size_t inLen, char *outBuf, size_t outLen, size_t *usedLen, int *prval)
+{
+	ClsMethod *m = static_cast<ClsMethod *>(method);
+	if (op == nullptr || m == nullptr || m->isWrite) {
+		ProxyDbgLogErr("op %p or read method %p is invalid", op, m);
+		return;
+	}
+	ClsMethodExec(op, m, inBuf, inLen, outBuf, outLen, usedLen, prval);
+}
+
+void CephProxyWriteOpExec(ceph_proxy_op_t op, proxy_cls_method_t method, const char *inBuf,
+			size_t inLen, int *prval)
+{
+	ClsMethod *m = static_cast<ClsMethod *>(method);
+	if (op == nullptr || m == nullptr || !m->isWrite) {
+		ProxyDbgLogErr("op %p or write method %p is invalid", op, m);
+		return;
+	}
+	ClsMethodExec(op, m, inBuf, inLen, nullptr, 0, nullptr, prval);
+}
+
+int CephProxyClsExecBatch(ceph_proxy_t proxy, int64_t poolId, proxy_cls_method_t method,
+			ProxyClsCall *calls, uint32_t num, completion_t c)
+{
+	CephProxy *cephProxy = reinterpret_cast<CephProxy *>(proxy);
+	ClsMethod *m = static_cast<ClsMethod *>(method);
+	if (cephProxy == nullptr || m == nullptr || calls == nullptr || num == 0 || c == nullptr) {
+		ProxyDbgLogErr("proxy %p, method %p, calls %p(%u) or completion %p is invalid",
+			cephProxy, m, calls, num, c);
+		return -EINVAL;
+	}
+	for (uint32_t i = 0; i < num; i++) {
+		if (calls[i].oid == nullptr) {
+			ProxyDbgLogErr("call %u has no object", i);
+			return -EINVAL;
+		}
+	}
+	return ClsExecBatch(cephProxy, poolId, m, calls, num, static_cast<Completion *>(c));
+}
+
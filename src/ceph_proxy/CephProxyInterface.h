@@ -207,8 +207,61 @@ typedef struct {
 
 typedef int32_t (*NotifyPoolEventFn)(uint32_t *poolId, uint32_t length);
 
+typedef struct {
+    /* SGL reads whose data matched the crc32c they were checked against */
+    uint64_t verified;
+
+    uint64_t verifiedBytes;
+
+    /* checking was asked for but the OSD could not sum the range, as on a short read */
+    uint64_t unverified;
+
+    uint64_t mismatches;
+} CephIntegrityStat;
+
+typedef void (*IntegrityNotifyFn)(int64_t poolId, const char *oid, uint64_t offset, uint64_t len,
+				uint32_t expected, uint32_t actual);
+
+typedef struct {
+    /* omap pages fetched */
+    uint64_t pages;
+
+    /* calls of Next that had to wait for a page, the first one always does */
+    uint64_t stalls;
+
+    /* most key and value bytes held at once, the page read from and the one prefetched */
+    uint64_t peakBytes;
+} ProxyOmapStreamStat;
+
 typedef void *completion_t;
+typedef void *proxy_cq_t;
+typedef void *proxy_cls_method_t;
+typedef void *proxy_omap_stream_t;
+
+/* CephProxyOmapStreamOpen flags: keys only, values come back empty */
+#define PROXY_OMAP_STREAM_KEYS_ONLY 0x1
+
+/* the method modifies the object and goes out in a write op */
+#define PROXY_CLS_METHOD_WRITE 0x1
+
+/* one call of CephProxyClsExecBatch, ret and usedLen are filled in when it completes */
+typedef struct {
+    const char *oid;
+    const char *inBuf;
+    size_t inLen;
+    char *outBuf;
+    size_t outLen;
+    size_t usedLen;
+    int32_t ret;
+} ProxyClsCall;
+
+/* one finished op on a completion ring */
+typedef struct {
+    void *userData;
+    int32_t ret;
+} ProxyCqEntry;
 typedef void (*CallBack_t)(int ret, void *arg);
+typedef void (*CapacityCallBack_t)(int ret, uint64_t version, void *arg);
 typedef void *ceph_proxy_op_t;
 typedef void *rados_ioctx_t;
 typedef void *ceph_proxy_t;
@@ -316,6 +369,14 @@ int64_t CephProxyGetPoolIdByCtx(ceph_proxy_t proxy, rados_ioctx_t ioctx);
 
 int CephProxyGetMinAllocSize(ceph_proxy_t proxy, uint32_t *minAllocSize, CEPH_BDEV_TYPE_E type);
 
+/*
+ * bluestore_min_alloc_size of the OSDs the pool's CRUSH rule places data on,
+ * the largest when they differ. Like CephProxyGetMinAllocSize it comes from
+ * the OSDs' metadata and is kept until the osdmap changes. Return -ENOENT
+ * when the pool does not exist or maps to no known OSD.
+ */
+PROXY_API_PUBLIC int CephProxyGetPoolMinAllocSize(ceph_proxy_t proxy, int64_t poolId, uint32_t *minAllocSize);
+
 
 
 
@@ -350,6 +411,15 @@ PROXY_API_PUBLIC int CephProxyGetPoolsStat(ceph_proxy_t proxy, CephPoolStat *sta
 
 PROXY_API_PUBLIC int CephProxyGetUsedSizeAndMaxAvail(ceph_proxy_t proxy, uint64_t &usedSize, uint64_t &maxAvail);
 
+/*
+ * The cluster and pool stats above are served from a snapshot the proxy
+ * refreshes every proxy.capacity_refresh_ms; a call finding it older than
+ * proxy.capacity_max_stale_ms waits for a new one. This asks for a snapshot
+ * taken after the call and runs cb(ret, version, arg) once it is in place,
+ * on the refresher thread, ret < 0 when the refresh failed.
+ */
+PROXY_API_PUBLIC int CephProxyRefreshCapacity(ceph_proxy_t proxy, CapacityCallBack_t cb, void *arg);
+
 
 
 
@@ -359,6 +429,13 @@ PROXY_API_PUBLIC int CephProxyGetUsedSizeAndMaxAvail(ceph_proxy_t proxy, uint64_
 
 PROXY_API_PUBLIC int32_t CephProxyQueueOp(ceph_proxy_t proxy, ceph_proxy_op_t op, completion_t c);
 
+/*
+ * Queues ops[i] with comps[i] like num calls of CephProxyQueueOp, taking the
+ * worker queue lock once per run of ops on the same pool. Returns how many
+ * ops were queued, a prefix of the array; the rest are left to the caller.
+ */
+PROXY_API_PUBLIC int32_t CephProxyQueueOps(ceph_proxy_t proxy, ceph_proxy_op_t *ops, completion_t *comps, uint32_t num);
+
 
 
 
@@ -480,6 +557,17 @@ PROXY_API_PUBLIC void CephProxyWriteOpWrite(ceph_proxy_op_t op, const char *buff
 
 PROXY_API_PUBLIC void CephProxyWriteOpWriteSGL(ceph_proxy_op_t op, SGL_S *sgl, size_t len1, uint64_t off, AlignBuffer *alignBuffer, int isRelease);
 
+/*
+ * crc32c with seed -1, as ceph_crc32c and the OSD checksum op take it, of the
+ * bytes the op's write, write full or append carries, alignment padding
+ * included. Return -ENODATA when the op carries no data.
+ */
+PROXY_API_PUBLIC int CephProxyWriteOpGetDataCrc(ceph_proxy_op_t op, uint32_t *crc);
+
+PROXY_API_PUBLIC uint32_t CephProxyCrc32c(uint32_t crc, const char *buf, size_t len);
+
+PROXY_API_PUBLIC uint32_t CephProxySglCrc32c(uint32_t crc, const SGL_S *sgl, size_t len, int isRelease);
+
 
 
 
@@ -715,6 +803,15 @@ PROXY_API_PUBLIC void CephProxyReadOpRead(ceph_proxy_op_t op, uint64_t offset, s
 
 PROXY_API_PUBLIC void CephProxyReadOpReadSGL(ceph_proxy_op_t op, uint64_t offset, size_t len, SGL_S *sgl, int *prval, int isRelease);
 
+/*
+ * Check the data the SGL read of this op lands in against crc, a crc32c with
+ * seed -1 kept from CephProxyWriteOpGetDataCrc when the range was written; a
+ * range read short is checked with zeros for the missing tail. A mismatch
+ * completes the op with -EIO. With proxy.data_crc_check on, SGL reads are
+ * also checked against a crc32c the OSD takes of the same range in the same op.
+ */
+PROXY_API_PUBLIC void CephProxyReadOpSetExpectedCrc(ceph_proxy_op_t op, uint32_t crc);
+
 
 
 
@@ -752,6 +849,78 @@ PROXY_API_PUBLIC completion_t CephProxyCreateCompletion(CallBack_t fn, void *arg
 
 PROXY_API_PUBLIC void CephProxyCompletionDestroy(completion_t c);
 
+/*
+ * Completion rings: ops queued with a ring completion post (ret, userData)
+ * to the ring instead of calling back on the librados finisher, and the
+ * owner reaps them in batches from its own thread. One thread reaps a ring,
+ * any number may queue ops on it. At most entries (rounded up to a power of
+ * two) completions can be created on a ring at a time, which keeps it from
+ * ever filling.
+ */
+PROXY_API_PUBLIC int CephProxyCompletionRingCreate(uint32_t entries, proxy_cq_t *cq);
+
+/* return -EBUSY while completions created on the ring are not destroyed */
+PROXY_API_PUBLIC int CephProxyCompletionRingDestroy(proxy_cq_t cq);
+
+/* return null when the ring has as many completions as entries */
+PROXY_API_PUBLIC completion_t CephProxyCreateRingCompletion(proxy_cq_t cq, void *userData);
+
+/* up to max finished ops, never blocks */
+PROXY_API_PUBLIC uint32_t CephProxyCompletionRingReap(proxy_cq_t cq, ProxyCqEntry *entries, uint32_t max);
+
+/*
+ * Reap at least minComplete ops, sleeping on the ring's eventfd while there
+ * are fewer, unless timeoutMs passes first; -1 waits forever. Return the
+ * number reaped, which is less than minComplete on a timeout.
+ */
+PROXY_API_PUBLIC int CephProxyCompletionRingWait(proxy_cq_t cq, ProxyCqEntry *entries, uint32_t max,
+				uint32_t minComplete, int timeoutMs);
+
+/*
+ * For callers waiting in their own epoll: the eventfd turns readable after an
+ * op is posted to an armed ring. Arm returns 1 when ops are already waiting,
+ * then the ring is not armed and the caller reaps instead of sleeping. Read
+ * the fd to clear it.
+ */
+PROXY_API_PUBLIC int CephProxyCompletionRingFd(proxy_cq_t cq);
+PROXY_API_PUBLIC int CephProxyCompletionRingArm(proxy_cq_t cq);
+
+/*
+ * Register an object class method once and call it through the handle. The
+ * names are checked here, not on every call. flags is PROXY_CLS_METHOD_WRITE
+ * for methods that modify the object. Return -EINVAL on an empty name or one
+ * longer than 255 bytes.
+ */
+PROXY_API_PUBLIC int CephProxyClsMethodRegister(const char *cls, const char *method, uint32_t flags,
+				proxy_cls_method_t *handle);
+
+/* no op using the handle may be in flight */
+PROXY_API_PUBLIC void CephProxyClsMethodRelease(proxy_cls_method_t handle);
+
+/*
+ * Call a read method. Its output is copied to outBuf and its length set in
+ * usedLen. If the output is longer than outLen, the op completes with
+ * -ERANGE and usedLen holds the length needed.
+ */
+PROXY_API_PUBLIC void CephProxyReadOpExec(ceph_proxy_op_t op, proxy_cls_method_t method, const char *inBuf,
+				size_t inLen, char *outBuf, size_t outLen, size_t *usedLen, int *prval);
+
+/* call a method registered with PROXY_CLS_METHOD_WRITE */
+PROXY_API_PUBLIC void CephProxyWriteOpExec(ceph_proxy_op_t op, proxy_cls_method_t method, const char *inBuf,
+				size_t inLen, int *prval);
+
+/*
+ * Call method on num objects of a pool, one op per call, all queued
+ * together. Each call gets its own ret and usedLen, set as for a single
+ * exec. c completes once, after the last call. Its ret is the ret of the
+ * first failed call in array order, or 0 if none failed. The inputs are
+ * copied before this returns. calls and the out buffers must stay valid
+ * until c completes. Calls that find the worker queue full fail with
+ * -EBUSY. Return -EBUSY without completing c when none could be queued.
+ */
+PROXY_API_PUBLIC int CephProxyClsExecBatch(ceph_proxy_t proxy, int64_t poolId, proxy_cls_method_t method,
+				ProxyClsCall *calls, uint32_t num, completion_t c);
+
 
 
 
@@ -768,6 +937,34 @@ PROXY_API_PUBLIC int CephProxyRegisterPoolNewNotifyFn(NotifyPoolEventFn fn);
 
 PROXY_API_PUBLIC int CephProxyGetPoolInfo(ceph_proxy_t proxy, uint32_t poolId, struct PoolInfo *info);
 
+/*
+ * Walk the omap of an object in key order, pageSize entries (0 for 1024)
+ * per omap read, starting after startAfter (null or "" for the beginning).
+ * Only two pages are held at a time: while the caller reads one, the next
+ * is already being fetched. The first page is queued here, errors of the
+ * reads come back from Next.
+ */
+PROXY_API_PUBLIC int CephProxyOmapStreamOpen(ceph_proxy_t proxy, int64_t poolId, const char *oid,
+				const char *startAfter, uint32_t pageSize, uint32_t flags, proxy_omap_stream_t *stream);
+
+/*
+ * Return 1 with the next entry, 0 after the last one, or the error of the
+ * omap read, -ENOENT when the object does not exist. key and val point into
+ * the fetched page, not copied, and stay valid until the next call.
+ */
+PROXY_API_PUBLIC int CephProxyOmapStreamNext(proxy_omap_stream_t stream, const char **key, size_t *keyLen,
+				const char **val, size_t *valLen);
+
+PROXY_API_PUBLIC void CephProxyOmapStreamStat(proxy_omap_stream_t stream, ProxyOmapStreamStat *stat);
+
+/* waits for a page still being fetched */
+PROXY_API_PUBLIC void CephProxyOmapStreamClose(proxy_omap_stream_t stream);
+
+/* fn runs on the completing thread for every crc32c mismatch found on an SGL read */
+PROXY_API_PUBLIC int CephProxyRegisterIntegrityNotifyFn(IntegrityNotifyFn fn);
+
+PROXY_API_PUBLIC void CephProxyGetIntegrityStat(CephIntegrityStat *stat);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,8 @@
 #include "CephProxyInterface.h"
 #include "CephProxyOp.h"
 #include "CephProxyLog.h"
+#include "ProxyObjectPool.h"
+#include "CompletionRing.h"
 
 completion_t CompletionInit(userCallback_t fn, void *cbArg)
 {
@@ -14,18 +16,40 @@ completion_t CompletionInit(userCallback_t fn, void *cbArg)
 	    ProxyDbgLogErr("callback func is nullptr");
 	    return nullptr;
     }
-    Completion *c = new(std::nothrow) Completion(fn, cbArg);
+    Completion *c = ProxyObjectPool<Completion>::Get();
     if (c == nullptr) {
 	    ProxyDbgLogErr("Allocate Memory failed.");
 	    return nullptr;
     }
+    c->fn = fn;
+    c->cbArg = cbArg;
     completion_t rc = c;
     return rc;
 }
 
+completion_t CompletionRingInit(CompletionRing *ring, void *userData)
+{
+    if (ring->Attach() != 0) {
+	    ProxyDbgLogErr("completion ring %p has %u completions already", ring, ring->Capacity());
+	    return nullptr;
+    }
+    Completion *c = ProxyObjectPool<Completion>::Get();
+    if (c == nullptr) {
+	    ProxyDbgLogErr("Allocate Memory failed.");
+	    ring->Detach();
+	    return nullptr;
+    }
+    c->fn = CompletionRingPost;
+    c->cbArg = c;
+    c->ring = ring;
+    c->userData = userData;
+    return c;
+}
+
 void CompletionDestroy(completion_t c){
     Completion *comp = static_cast<Completion *>(c);
-    if (comp) {
-        delete comp;
+    if (comp != nullptr && comp->ring != nullptr) {
+	    comp->ring->Detach();
     }
+    ProxyObjectPool<Completion>::Put(comp);
 }
@@ -17,6 +17,7 @@
 #include <vector>
 #include <set>
 #include <cstddef>
+#include <new>
 
 #define UNKNOW_POOL_ID -1
 #define INVALID_POOL_ID -2
@@ -29,21 +30,14 @@ using namespace librados;
 
 typedef void(*userCallback_t)(int ret, void *arg);
 
+/* values are handed out from attrset itself, they live as long as the iterator */
 struct RadosXattrsIter {
-    RadosXattrsIter(): val(nullptr) {
+    RadosXattrsIter() {
         i = attrset.end();
     }
-    
-    ~RadosXattrsIter() {
-        if (val) {
-            free(val);
-        }
-        val = nullptr;
-    }
 
     std::map<std::string, bufferlist> attrset;
     std::map<std::string, bufferlist>::iterator i;
-    char *val;
 };
 
 struct RadosOmapIter {
@@ -85,6 +79,26 @@ public:
 
     }
 
+    explicit RadosObjectOperation(CephProxyOpType _type):
+        opType(_type), poolId(UNKNOW_POOL_ID), callback(nullptr), cbArg(nullptr), ts(0) {
+
+    }
+
+    /* assign keeps the capacity a pooled op already has, so reused names do not allocate */
+    void Init(int64_t _poolId, const char *oid) {
+        poolId = _poolId;
+        objectId.assign(oid);
+    }
+
+    void Reset() {
+        poolId = UNKNOW_POOL_ID;
+        poolName.clear();
+        objectId.clear();
+        callback = nullptr;
+        cbArg = nullptr;
+        ts = 0;
+    }
+
     virtual ~RadosObjectOperation() {
 
     }
@@ -104,6 +118,11 @@ public:
 	    size_t len = 0;
 	    int buildType = 0;
             SGL_S *sgl = nullptr;
+            uint64_t offset = 0;
+            // the OSD sums the same range into osdCrc, see RadosReadOpReadSGL
+            bool verify = false;
+            bool hasExpected = false;
+            uint32_t expectedCrc = 0;
         } readSgl;
 
         struct _xattr {
@@ -127,6 +146,11 @@ public:
         struct _exec {
             char **outBuf = nullptr;
             size_t *outLen = 0;
+            // RadosReadOpExecUserBuf: the output lands in userBuf, usedLen is its length
+            bool toUserBuf = false;
+            char *userBuf = nullptr;
+            size_t userLen = 0;
+            size_t *usedLen = nullptr;
         } exec;
     }reqCtx;
     
@@ -141,6 +165,10 @@ public:
     int checksumRetvals;
 
 
+    bufferlist osdCrc;
+    int osdCrcRetVal;
+
+
     bufferlist execOut;
     int execOutRetVals;
 
@@ -163,6 +191,31 @@ public:
 
     }
 
+    RadosObjectReadOp() : RadosObjectOperation(BATCH_READ_OP) {
+
+    }
+
+    /* the librados op has no clear(), it is rebuilt in place; the bufferlists and maps keep nothing */
+    void Reset() {
+        RadosObjectOperation::Reset();
+        op.~ObjectReadOperation();
+        new (&op) librados::ObjectReadOperation();
+        reqCtx = reqContext();
+        bl.clear();
+        results.clear();
+        retVals = 0;
+        checksums.clear();
+        checksumRetvals = 0;
+        osdCrc.clear();
+        osdCrcRetVal = 0;
+        execOut.clear();
+        execOutRetVals = 0;
+        omapKeys.clear();
+        omap.clear();
+        header.clear();
+        xattrs.clear();
+    }
+
     ~RadosObjectReadOp() {
 
     }
@@ -173,15 +226,32 @@ public:
     librados::ObjectWriteOperation op;
     bool isRemove;
     bufferlist bl;
+    // op holds one plain write of bl at writeOff, the IO worker may merge it with its neighbours
+    bool mergeable;
+    uint64_t writeOff;
 public:
     RadosObjectWriteOp(const string& pool, const string& oid)
-      : RadosObjectOperation(BATCH_WRITE_OP, pool, oid), isRemove(false) {
+      : RadosObjectOperation(BATCH_WRITE_OP, pool, oid), isRemove(false), mergeable(false), writeOff(0) {
 
     }
 
     RadosObjectWriteOp(const int64_t poolId, const string &oid)
-      : RadosObjectOperation(BATCH_WRITE_OP, poolId, oid), isRemove(false) {
+      : RadosObjectOperation(BATCH_WRITE_OP, poolId, oid), isRemove(false), mergeable(false), writeOff(0) {
+
+    }
+
+    RadosObjectWriteOp() : RadosObjectOperation(BATCH_WRITE_OP), isRemove(false), mergeable(false), writeOff(0) {
+
+    }
 
+    void Reset() {
+        RadosObjectOperation::Reset();
+        op.~ObjectWriteOperation();
+        new (&op) librados::ObjectWriteOperation();
+        isRemove = false;
+        bl.clear();
+        mergeable = false;
+        writeOff = 0;
     }
 
     ~RadosObjectWriteOp() {
@@ -189,12 +259,28 @@ public:
     }
 };
 
+class CompletionRing;
+
 struct Completion {
     userCallback_t fn;
     void *cbArg;
+    // set for completions posted to a ring, fn is then CompletionRingPost and cbArg this
+    CompletionRing *ring;
+    void *userData;
 public:
-    Completion(userCallback_t _fn, void *arg) : fn(_fn),cbArg(arg) {
+    Completion(userCallback_t _fn, void *arg) : fn(_fn),cbArg(arg), ring(nullptr), userData(nullptr) {
+
+    }
+
+    Completion() : fn(nullptr), cbArg(nullptr), ring(nullptr), userData(nullptr) {
+
+    }
 
+    void Reset() {
+        fn = nullptr;
+        cbArg = nullptr;
+        ring = nullptr;
+        userData = nullptr;
     }
 
     virtual ~Completion() {
@@ -203,6 +289,7 @@ public:
 };
 
 completion_t CompletionInit(userCallback_t fn, void *cbArg);
+completion_t CompletionRingInit(CompletionRing *ring, void *userData);
 void CompletionDestroy(completion_t c);
 
 #endif
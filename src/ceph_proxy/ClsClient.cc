@@ -0,0 +1,185 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "ClsClient.h"
+#include "CephProxy.h"
+#include "CephProxyOp.h"
+#include "CephProxyLog.h"
+#include "RadosWrapper.h"
+#include "ProxyObjectPool.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+#include <vector>
+
+struct ClsBatch;
+
+struct ClsCall {
+    ClsBatch *batch;
+    uint32_t index;
+    ceph_proxy_op_t op;
+    // queued with the op, its callback is ClsCallDone with this call
+    Completion comp;
+};
+
+/* one CephProxyClsExecBatch, pooled so the call arrays keep their capacity */
+struct ClsBatch {
+    bool isWrite;
+    ProxyClsCall *calls;
+    std::atomic<uint32_t> left;
+    // taken from the caller's completion when queued, as the IO worker does
+    userCallback_t fn;
+    void *cbArg;
+    std::vector<ClsCall> slots;
+    std::vector<ceph_proxy_op_t> ops;
+    std::vector<completion_t> comps;
+
+    ClsBatch() : isWrite(false), calls(nullptr), left(0), fn(nullptr), cbArg(nullptr) {
+    }
+
+    void Reset() {
+        isWrite = false;
+        calls = nullptr;
+        left = 0;
+        fn = nullptr;
+        cbArg = nullptr;
+        slots.clear();
+        ops.clear();
+        comps.clear();
+    }
+};
+
+int ClsMethodCreate(const char *cls, const char *method, uint32_t flags, ClsMethod **m)
+{
+    size_t clsLen = cls == nullptr ? 0 : strnlen(cls, CLS_NAME_MAX + 1);
+    size_t methodLen = method == nullptr ? 0 : strnlen(method, CLS_NAME_MAX + 1);
+    if (clsLen == 0 || clsLen > CLS_NAME_MAX || methodLen == 0 || methodLen > CLS_NAME_MAX) {
+        ProxyDbgLogErr("class %p or method %p name is empty or longer than %d", cls, method, CLS_NAME_MAX);
+        return -EINVAL;
+    }
+
+    ClsMethod *cm = new(std::nothrow) ClsMethod();
+    if (cm == nullptr) {
+        ProxyDbgLogErr("Allocate Memory failed.");
+        return -ENOMEM;
+    }
+    cm->cls.assign(cls, clsLen);
+    cm->method.assign(method, methodLen);
+    cm->isWrite = (flags & PROXY_CLS_METHOD_WRITE) != 0;
+    *m = cm;
+    return 0;
+}
+
+void ClsMethodDestroy(ClsMethod *m)
+{
+    delete m;
+}
+
+int ClsMethodExec(ceph_proxy_op_t op, const ClsMethod *m, const char *inBuf, size_t inLen,
+    char *outBuf, size_t outLen, size_t *usedLen, int *prval)
+{
+    RadosObjectOperation *operation = reinterpret_cast<RadosObjectOperation *>(op);
+    if (operation->opType != (m->isWrite ? BATCH_WRITE_OP : BATCH_READ_OP)) {
+        ProxyDbgLogErr("%s.%s needs a %s op", m->cls.c_str(), m->method.c_str(), m->isWrite ? "write" : "read");
+        return -EINVAL;
+    }
+
+    if (m->isWrite) {
+        RadosWriteOpExec(op, m->cls.c_str(), m->method.c_str(), inBuf, inLen, prval);
+    } else {
+        RadosReadOpExecUserBuf(op, m->cls.c_str(), m->method.c_str(), inBuf, inLen, outBuf, outLen, usedLen, prval);
+    }
+    return 0;
+}
+
+static void ClsOpRelease(bool isWrite, ceph_proxy_op_t op)
+{
+    if (isWrite) {
+        RadosWriteOpRelease(op);
+    } else {
+        RadosReadOpRelease(op);
+    }
+}
+
+/* the last call to finish completes the batch, the caller may reuse calls from its callback */
+static void ClsCallDone(int ret, void *arg)
+{
+    ClsCall *s = static_cast<ClsCall *>(arg);
+    ClsBatch *b = s->batch;
+    b->calls[s->index].ret = ret;
+    ClsOpRelease(b->isWrite, s->op);
+    s->op = nullptr;
+    if (b->left.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    int first = 0;
+    for (size_t i = 0; i < b->slots.size(); i++) {
+        if (b->calls[i].ret < 0) {
+            first = b->calls[i].ret;
+            break;
+        }
+    }
+    userCallback_t fn = b->fn;
+    void *cbArg = b->cbArg;
+    ProxyObjectPool<ClsBatch>::Put(b);
+    fn(first, cbArg);
+}
+
+int ClsExecBatch(CephProxy *proxy, int64_t poolId, const ClsMethod *m, ProxyClsCall *calls, uint32_t num,
+    Completion *c)
+{
+    ClsBatch *b = ProxyObjectPool<ClsBatch>::Get();
+    if (b == nullptr) {
+        ProxyDbgLogErr("Allocate Memory failed.");
+        return -ENOMEM;
+    }
+    b->isWrite = m->isWrite;
+    b->calls = calls;
+    b->fn = c->fn;
+    b->cbArg = c->cbArg;
+    b->slots.resize(num);
+
+    for (uint32_t i = 0; i < num; i++) {
+        ClsCall &s = b->slots[i];
+        ProxyClsCall &call = calls[i];
+        call.ret = 0;
+        call.usedLen = 0;
+        s.batch = b;
+        s.index = i;
+        s.op = m->isWrite ? RadosWriteOpInit2(poolId, call.oid) : RadosReadOpInit2(poolId, call.oid);
+        if (s.op == nullptr) {
+            for (uint32_t j = 0; j < i; j++) {
+                ClsOpRelease(m->isWrite, b->slots[j].op);
+            }
+            ProxyObjectPool<ClsBatch>::Put(b);
+            return -ENOMEM;
+        }
+        ClsMethodExec(s.op, m, call.inBuf, call.inLen, call.outBuf, call.outLen, &call.usedLen, nullptr);
+        s.comp.fn = ClsCallDone;
+        s.comp.cbArg = &s;
+        b->ops.push_back(s.op);
+        b->comps.push_back(&s.comp);
+    }
+
+    b->left = num;
+    int32_t queued = proxy->EnqueueBatch(b->ops.data(), b->comps.data(), num);
+    if (queued <= 0) {
+        for (uint32_t i = 0; i < num; i++) {
+            ClsOpRelease(m->isWrite, b->slots[i].op);
+        }
+        ProxyObjectPool<ClsBatch>::Put(b);
+        return -EBUSY;
+    }
+    // the queued calls may finish meanwhile, b is gone once the last one of all is done
+    for (uint32_t i = queued; i < num; i++) {
+        ClsCallDone(-EBUSY, &b->slots[i]);
+    }
+    return 0;
+}
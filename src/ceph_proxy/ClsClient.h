@@ -0,0 +1,46 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_CLS_CLIENT_H_
+#define _CEPH_PROXY_CLS_CLIENT_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "CephProxyInterface.h"
+
+/* the OSD op carries the class and method name lengths in a byte each */
+#define CLS_NAME_MAX 255
+
+class CephProxy;
+struct Completion;
+
+/*
+ * A class method behind a proxy_cls_method_t. The names are checked and
+ * kept once here, every call passes them to librados as they are. librados
+ * itself encodes them into the op's input on each call; only Objecter
+ * internals could reuse that, and the proxy stays on the public API.
+ */
+struct ClsMethod {
+    std::string cls;
+    std::string method;
+    bool isWrite;
+};
+
+/* -EINVAL on an empty or too long name */
+int ClsMethodCreate(const char *cls, const char *method, uint32_t flags, ClsMethod **m);
+void ClsMethodDestroy(ClsMethod *m);
+
+/* adds the call to op, a read or write op as the method needs */
+int ClsMethodExec(ceph_proxy_op_t op, const ClsMethod *m, const char *inBuf, size_t inLen,
+    char *outBuf, size_t outLen, size_t *usedLen, int *prval);
+
+/* see CephProxyClsExecBatch */
+int ClsExecBatch(CephProxy *proxy, int64_t poolId, const ClsMethod *m, ProxyClsCall *calls, uint32_t num,
+    Completion *c);
+
+#endif
@@ -0,0 +1,185 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "CompletionRing.h"
+#include "CephProxyOp.h"
+#include "CephProxyLog.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+CompletionRing::CompletionRing() : slots(nullptr), mask(0), efd(-1), attached(0), tail(0), armed(false), head(0)
+{
+}
+
+CompletionRing::~CompletionRing()
+{
+    delete[] slots;
+    if (efd >= 0) {
+        close(efd);
+    }
+}
+
+CompletionRing *CompletionRing::Create(uint32_t entries)
+{
+    if (entries == 0 || entries > (1U << 31)) {
+        ProxyDbgLogErr("completion ring of %u entries is invalid", entries);
+        return nullptr;
+    }
+    uint64_t size = 1;
+    while (size < entries) {
+        size <<= 1;
+    }
+
+    CompletionRing *ring = new(std::nothrow) CompletionRing();
+    if (ring == nullptr) {
+        ProxyDbgLogErr("Allocate completion ring failed.");
+        return nullptr;
+    }
+    ring->slots = new(std::nothrow) Slot[size];
+    if (ring->slots == nullptr) {
+        ProxyDbgLogErr("Allocate %lu completion ring slots failed.", size);
+        delete ring;
+        return nullptr;
+    }
+    for (uint64_t i = 0; i < size; i++) {
+        ring->slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    ring->mask = size - 1;
+    ring->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring->efd < 0) {
+        ProxyDbgLogErr("create completion ring eventfd failed: %d", errno);
+        delete ring;
+        return nullptr;
+    }
+    return ring;
+}
+
+int CompletionRing::Attach()
+{
+    uint32_t n = attached.load(std::memory_order_relaxed);
+    do {
+        if (n >= Capacity()) {
+            return -EBUSY;
+        }
+    } while (!attached.compare_exchange_weak(n, n + 1, std::memory_order_relaxed));
+    return 0;
+}
+
+void CompletionRing::Detach()
+{
+    attached.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CompletionRing::Post(int32_t ret, void *userData)
+{
+    uint64_t pos = tail.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    while (true) {
+        slot = &slots[pos & mask];
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        int64_t dif = static_cast<int64_t>(seq - pos);
+        if (dif == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            // cannot happen while Attach() bounds the completions, wait for the consumer anyway
+            ProxyDbgLogWarnLimit1("completion ring %p is full.", this);
+            sched_yield();
+            pos = tail.load(std::memory_order_relaxed);
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+    slot->userData = userData;
+    slot->ret = ret;
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    // pairs with the fence in Arm(): either the consumer sees this entry or this sees armed
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (armed.load(std::memory_order_relaxed) && armed.exchange(false, std::memory_order_relaxed)) {
+        uint64_t one = 1;
+        ssize_t n = write(efd, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+uint32_t CompletionRing::Reap(ProxyCqEntry *entries, uint32_t max)
+{
+    uint32_t n = 0;
+    while (n < max) {
+        Slot &slot = slots[head & mask];
+        if (slot.seq.load(std::memory_order_acquire) != head + 1) {
+            break;
+        }
+        entries[n].userData = slot.userData;
+        entries[n].ret = slot.ret;
+        slot.seq.store(head + mask + 1, std::memory_order_release);
+        head++;
+        n++;
+    }
+    return n;
+}
+
+bool CompletionRing::Arm()
+{
+    armed.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (slots[head & mask].seq.load(std::memory_order_acquire) == head + 1) {
+        armed.store(false, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+int CompletionRing::Wait(ProxyCqEntry *entries, uint32_t max, uint32_t minComplete, int timeoutMs)
+{
+    minComplete = std::min(minComplete, max);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    uint32_t n = Reap(entries, max);
+    while (n < minComplete) {
+        if (Arm()) {
+            n += Reap(entries + n, max - n);
+            continue;
+        }
+        int waitMs = -1;
+        if (timeoutMs >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) {
+                break;
+            }
+            waitMs = left;
+        }
+        struct pollfd pfd = { efd, POLLIN, 0 };
+        if (poll(&pfd, 1, waitMs) < 0 && errno != EINTR) {
+            int err = errno;
+            armed.store(false, std::memory_order_relaxed);
+            return n > 0 ? n : -err;
+        }
+        uint64_t cnt = 0;
+        ssize_t r = read(efd, &cnt, sizeof(cnt));
+        (void)r;
+        n += Reap(entries + n, max - n);
+    }
+    // a wakeup that came too late for this wait would only make the next one return early
+    armed.store(false, std::memory_order_relaxed);
+    return n;
+}
+
+void CompletionRingPost(int ret, void *arg)
+{
+    Completion *c = static_cast<Completion *>(arg);
+    c->ring->Post(ret, c->userData);
+}
@@ -0,0 +1,86 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_COMPLETION_RING_H_
+#define _CEPH_PROXY_COMPLETION_RING_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "CephProxyInterface.h"
+
+#define COMPLETION_RING_CACHELINE 64
+
+/*
+ * Finished ops of one caller, posted from the librados finisher threads and
+ * reaped by the caller instead of running its callback there. Producers claim
+ * a slot with one CAS and publish it with its sequence number, the bounded
+ * MPMC queue of D. Vyukov cut down to one consumer. A ring never fills: no
+ * more completions may be attached to it than it has slots, and each of them
+ * has at most one op in flight.
+ *
+ * The eventfd is only written when the consumer armed the ring before going
+ * to sleep, a caller that keeps polling never pays for the syscall.
+ */
+class CompletionRing {
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        void *userData;
+        int32_t ret;
+    };
+
+    Slot *slots;
+    uint64_t mask;
+    int efd;
+    std::atomic<uint32_t> attached;
+
+    alignas(COMPLETION_RING_CACHELINE) std::atomic<uint64_t> tail;
+    alignas(COMPLETION_RING_CACHELINE) std::atomic<bool> armed;
+    alignas(COMPLETION_RING_CACHELINE) uint64_t head;
+
+    CompletionRing();
+
+public:
+    ~CompletionRing();
+
+    /* entries is rounded up to a power of two, null when out of memory or fds */
+    static CompletionRing *Create(uint32_t entries);
+
+    uint32_t Capacity() const
+    {
+        return mask + 1;
+    }
+
+    int Fd() const
+    {
+        return efd;
+    }
+
+    /* -EBUSY once Capacity() completions are attached */
+    int Attach();
+    void Detach();
+    uint32_t Attached() const
+    {
+        return attached.load(std::memory_order_relaxed);
+    }
+
+    /* any thread */
+    void Post(int32_t ret, void *userData);
+
+    /* the consumer only: up to max entries, never blocks */
+    uint32_t Reap(ProxyCqEntry *entries, uint32_t max);
+    /* true when an entry was already posted, then the fd is not written and the caller must not sleep */
+    bool Arm();
+    /* at least minComplete entries unless timeoutMs (-1 waits forever) passes first */
+    int Wait(ProxyCqEntry *entries, uint32_t max, uint32_t minComplete, int timeoutMs);
+};
+
+/* the completion callback of a ring completion, arg is its Completion */
+void CompletionRingPost(int ret, void *arg);
+
+#endif
@@ -31,6 +31,16 @@
 #define DEFAULT_WORKER_NUM	1
 #define DEFAULT_MSGR_NUM	3
 #define DEFAULT_BIND_CORE	0
+#define DEFAULT_WRITE_MERGE_WINDOW_US	100
+#define MAX_WRITE_MERGE_WINDOW_US	10000
+#define DEFAULT_WRITE_MERGE_MAX_BYTES	(1024 * 1024)
+#define MIN_WRITE_MERGE_MAX_BYTES	4096
+#define MAX_WRITE_MERGE_MAX_BYTES	(16 * 1024 * 1024)
+#define DEFAULT_CAPACITY_REFRESH_MS	1000
+#define MIN_CAPACITY_REFRESH_MS	10
+#define MAX_CAPACITY_REFRESH_MS	60000
+#define DEFAULT_CAPACITY_MAX_STALE_MS	5000
+#define MAX_CAPACITY_MAX_STALE_MS	600000
 
 #define MAX_CPU_NUM (256)
 
@@ -56,6 +66,12 @@ typedef struct {
     uint64_t bindCore;
     uint64_t osdTimeout;
     uint64_t monTimeout;
+    uint64_t writeMerge;
+    uint64_t writeMergeWindowUs;
+    uint64_t writeMergeMaxBytes;
+    uint64_t capacityRefreshMs;
+    uint64_t capacityMaxStaleMs;
+    uint64_t dataCrcCheck;
 } ProxyControlCfg;
 
 ProxyControlCfg g_ProxyCfg = { 0 };
@@ -72,6 +88,15 @@ static void InitClusterCfg()
 
     g_ProxyCfg.osdTimeout = 0;
     g_ProxyCfg.monTimeout = 0;
+
+    g_ProxyCfg.writeMerge = 0;
+    g_ProxyCfg.writeMergeWindowUs = DEFAULT_WRITE_MERGE_WINDOW_US;
+    g_ProxyCfg.writeMergeMaxBytes = DEFAULT_WRITE_MERGE_MAX_BYTES;
+
+    g_ProxyCfg.capacityRefreshMs = DEFAULT_CAPACITY_REFRESH_MS;
+    g_ProxyCfg.capacityMaxStaleMs = DEFAULT_CAPACITY_MAX_STALE_MS;
+
+    g_ProxyCfg.dataCrcCheck = 0;
 }
 
 
@@ -117,12 +142,56 @@ static int32_t ReadConfig()
     return ret;
 }
 
+/* keys added after the first release, a proxy.conf without them keeps the defaults */
+static void ReadOptionalConfig()
+{
+    uint64_t val = 0;
+    if (GetCfgItemUint64(&val, "proxy", "write_merge") == RETURN_OK) {
+        g_ProxyCfg.writeMerge = (val != 0);
+    }
+    if (GetCfgItemUint64(&val, "proxy", "write_merge_window_us") == RETURN_OK) {
+        if (val > MAX_WRITE_MERGE_WINDOW_US) {
+            ProxyDbgLogErr("write_merge_window_us %lu is out of range 0~%d, use %d", val,
+                MAX_WRITE_MERGE_WINDOW_US, DEFAULT_WRITE_MERGE_WINDOW_US);
+        } else {
+            g_ProxyCfg.writeMergeWindowUs = val;
+        }
+    }
+    if (GetCfgItemUint64(&val, "proxy", "write_merge_max_bytes") == RETURN_OK) {
+        if (val < MIN_WRITE_MERGE_MAX_BYTES || val > MAX_WRITE_MERGE_MAX_BYTES) {
+            ProxyDbgLogErr("write_merge_max_bytes %lu is out of range %d~%d, use %d", val,
+                MIN_WRITE_MERGE_MAX_BYTES, MAX_WRITE_MERGE_MAX_BYTES, DEFAULT_WRITE_MERGE_MAX_BYTES);
+        } else {
+            g_ProxyCfg.writeMergeMaxBytes = val;
+        }
+    }
+    if (GetCfgItemUint64(&val, "proxy", "capacity_refresh_ms") == RETURN_OK) {
+        if (val < MIN_CAPACITY_REFRESH_MS || val > MAX_CAPACITY_REFRESH_MS) {
+            ProxyDbgLogErr("capacity_refresh_ms %lu is out of range %d~%d, use %d", val,
+                MIN_CAPACITY_REFRESH_MS, MAX_CAPACITY_REFRESH_MS, DEFAULT_CAPACITY_REFRESH_MS);
+        } else {
+            g_ProxyCfg.capacityRefreshMs = val;
+        }
+    }
+    if (GetCfgItemUint64(&val, "proxy", "capacity_max_stale_ms") == RETURN_OK) {
+        if (val > MAX_CAPACITY_MAX_STALE_MS) {
+            ProxyDbgLogErr("capacity_max_stale_ms %lu is out of range 0~%d, use %d", val,
+                MAX_CAPACITY_MAX_STALE_MS, DEFAULT_CAPACITY_MAX_STALE_MS);
+        } else {
+            g_ProxyCfg.capacityMaxStaleMs = val;
+        }
+    }
+    if (GetCfgItemUint64(&val, "proxy", "data_crc_check") == RETURN_OK) {
+        g_ProxyCfg.dataCrcCheck = (val != 0);
+    }
+}
+
 int32_t ProxyConfigInit()
 {
 	int ret;
 	memset(&g_ProxyCfg, 0, sizeof(ProxyControlCfg));
 	InitClusterCfg();
-
+	ReadOptionalConfig();
 
 	ret = ReadConfig();
 	if (ret != RETURN_OK) {
@@ -187,3 +256,33 @@ const char *ProxyGetMonTimeOutOption()
 {
 	return RADOS_MON_OP_TIMEOUT;
 }
+
+uint32_t ProxyGetWriteMerge()
+{
+	return g_ProxyCfg.writeMerge;
+}
+
+uint32_t ProxyGetWriteMergeWindowUs()
+{
+	return g_ProxyCfg.writeMergeWindowUs;
+}
+
+uint64_t ProxyGetWriteMergeMaxBytes()
+{
+	return g_ProxyCfg.writeMergeMaxBytes;
+}
+
+uint32_t ProxyGetCapacityRefreshMs()
+{
+	return g_ProxyCfg.capacityRefreshMs;
+}
+
+uint32_t ProxyGetCapacityMaxStaleMs()
+{
+	return g_ProxyCfg.capacityMaxStaleMs;
+}
+
+uint32_t ProxyGetDataCrcCheck()
+{
+	return g_ProxyCfg.dataCrcCheck;
+}
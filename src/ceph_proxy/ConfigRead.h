@@ -46,5 +46,14 @@ uint64_t ProxyGetOsdTimeOut();
 const char *ProxyGetMonTimeOutOption();
 uint64_t ProxyGetMonTimeOut();
 
+uint32_t ProxyGetWriteMerge();
+uint32_t ProxyGetWriteMergeWindowUs();
+uint64_t ProxyGetWriteMergeMaxBytes();
+
+uint32_t ProxyGetCapacityRefreshMs();
+uint32_t ProxyGetCapacityMaxStaleMs();
+
+uint32_t ProxyGetDataCrcCheck();
+
 #endif
 
@@ -0,0 +1,52 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "DataIntegrity.h"
+#include "CephProxyLog.h"
+
+#include <atomic>
+
+static std::atomic<IntegrityNotifyFn> g_notifyFn { nullptr };
+static std::atomic<uint64_t> g_verified { 0 };
+static std::atomic<uint64_t> g_verifiedBytes { 0 };
+static std::atomic<uint64_t> g_unverified { 0 };
+static std::atomic<uint64_t> g_mismatches { 0 };
+
+void ProxyIntegritySetNotifyFn(IntegrityNotifyFn fn)
+{
+    g_notifyFn = fn;
+}
+
+void ProxyIntegrityVerified(uint64_t bytes)
+{
+    g_verified.fetch_add(1, std::memory_order_relaxed);
+    g_verifiedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void ProxyIntegrityUnverified()
+{
+    g_unverified.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProxyIntegrityMismatch(int64_t poolId, const char *oid, uint64_t offset, uint64_t len,
+    uint32_t expected, uint32_t actual)
+{
+    g_mismatches.fetch_add(1, std::memory_order_relaxed);
+    ProxyDbgLogErr("crc32c mismatch pool(%ld) object(%s) %lu~%lu: expected 0x%08x, read 0x%08x",
+        poolId, oid, offset, len, expected, actual);
+    IntegrityNotifyFn fn = g_notifyFn;
+    if (fn != nullptr) {
+        fn(poolId, oid, offset, len, expected, actual);
+    }
+}
+
+void ProxyIntegrityGetStat(CephIntegrityStat *stat)
+{
+    stat->verified = g_verified.load(std::memory_order_relaxed);
+    stat->verifiedBytes = g_verifiedBytes.load(std::memory_order_relaxed);
+    stat->unverified = g_unverified.load(std::memory_order_relaxed);
+    stat->mismatches = g_mismatches.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,26 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_DATA_INTEGRITY_H_
+#define _CEPH_PROXY_DATA_INTEGRITY_H_
+
+#include <stdint.h>
+
+#include "CephProxyInterface.h"
+
+/*
+ * Outcome of the crc32c checks on SGL reads, counted process wide like the
+ * op pools. A mismatch is also handed to the registered notify function on
+ * the completing thread, before the op's callback sees -EIO.
+ */
+void ProxyIntegritySetNotifyFn(IntegrityNotifyFn fn);
+void ProxyIntegrityVerified(uint64_t bytes);
+void ProxyIntegrityUnverified();
+void ProxyIntegrityMismatch(int64_t poolId, const char *oid, uint64_t offset, uint64_t len,
+    uint32_t expected, uint32_t actual);
+void ProxyIntegrityGetStat(CephIntegrityStat *stat);
+
+#endif
@@ -0,0 +1,391 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "MinAllocDiscovery.h"
+#include "ProxyJson.h"
+#include "RadosWrapper.h"
+#include "CephProxyLog.h"
+
+#include <errno.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#define MON_CMD_OSD_DUMP "{\"prefix\": \"osd dump\", \"format\": \"json\"}"
+#define MON_CMD_OSD_METADATA "{\"prefix\": \"osd metadata\", \"format\": \"json\"}"
+#define MON_CMD_OSD_TREE "{\"prefix\": \"osd tree\", \"format\": \"json\"}"
+#define MON_CMD_CRUSH_RULE_DUMP "{\"prefix\": \"osd crush rule dump\", \"format\": \"json\"}"
+#define MON_CMD_OSD_STAT "{\"prefix\": \"osd stat\", \"format\": \"json\"}"
+
+namespace {
+
+struct TreeNode {
+    std::string deviceClass;
+    std::vector<int64_t> children;
+};
+
+void SetMax(std::map<std::string, uint32_t> &m, const std::string &key, uint32_t val)
+{
+    uint32_t &cur = m[key];
+    if (val > cur) {
+        cur = val;
+    }
+}
+
+/* the OSDs below the bucket, of the device class when cls is not empty */
+void CollectOsds(const std::map<int64_t, TreeNode> &nodes, int64_t id, const std::string &cls,
+    std::set<int64_t> &osds, int depth)
+{
+    auto iter = nodes.find(id);
+    if (id >= 0) {
+        if (cls.empty() || (iter != nodes.end() && iter->second.deviceClass == cls)) {
+            osds.insert(id);
+        }
+        return;
+    }
+    if (iter == nodes.end() || depth > 32) {
+        return;
+    }
+    for (int64_t child : iter->second.children) {
+        CollectOsds(nodes, child, cls, osds, depth + 1);
+    }
+}
+
+/* "epoch" at the top of osd stat, or in its "osdmap" section on older releases */
+int ParseEpoch(const std::string &out, int64_t &epoch)
+{
+    ProxyJson stat;
+    int ret = ProxyJsonParse(out, stat);
+    if (ret != 0) {
+        return ret;
+    }
+    if (stat.GetInt("epoch", epoch)) {
+        return 0;
+    }
+    const ProxyJson *osdmap = stat.Get("osdmap");
+    if (osdmap != nullptr && osdmap->GetInt("epoch", epoch)) {
+        return 0;
+    }
+    return -EINVAL;
+}
+
+}
+
+int MinAllocDiscovery::Build(const MinAllocReplies &replies, uint32_t hddSize, uint32_t ssdSize, MinAllocInfo &out)
+{
+    ProxyJson dump;
+    ProxyJson metadata;
+    ProxyJson tree;
+    ProxyJson rules;
+    if (ProxyJsonParse(replies.osdDump, dump) != 0 || ProxyJsonParse(replies.osdMetadata, metadata) != 0 ||
+        ProxyJsonParse(replies.osdTree, tree) != 0 || ProxyJsonParse(replies.crushRules, rules) != 0) {
+        ProxyDbgLogErr("parse osd dump, metadata, tree or crush rules failed");
+        return -EINVAL;
+    }
+    const ProxyJson *pools = dump.Get("pools");
+    const ProxyJson *treeNodes = tree.Get("nodes");
+    if (!dump.GetInt("epoch", out.epoch) || pools == nullptr || pools->type != ProxyJson::JSON_ARRAY ||
+        metadata.type != ProxyJson::JSON_ARRAY || treeNodes == nullptr ||
+        treeNodes->type != ProxyJson::JSON_ARRAY || rules.type != ProxyJson::JSON_ARRAY) {
+        ProxyDbgLogErr("unexpected osd dump, metadata, tree or crush rules layout");
+        return -EINVAL;
+    }
+
+    std::map<int64_t, TreeNode> nodes;
+    std::map<std::string, int64_t> idByName;
+    for (auto &node : treeNodes->items) {
+        int64_t id = 0;
+        std::string name;
+        if (!node.GetInt("id", id)) {
+            continue;
+        }
+        TreeNode &n = nodes[id];
+        node.GetString("device_class", n.deviceClass);
+        if (node.GetString("name", name)) {
+            idByName[name] = id;
+        }
+        const ProxyJson *children = node.Get("children");
+        if (children != nullptr) {
+            for (auto &child : children->items) {
+                int64_t childId = 0;
+                if (child.ToInt(childId)) {
+                    n.children.push_back(childId);
+                }
+            }
+        }
+    }
+
+    std::map<int64_t, uint32_t> osdSize;
+    for (auto &osd : metadata.items) {
+        int64_t id = 0;
+        std::string store;
+        if (!osd.GetInt("id", id) || (osd.GetString("osd_objectstore", store) && store != "bluestore")) {
+            continue;
+        }
+
+        std::string bdev;
+        std::string rotational;
+        if (!osd.GetString("bluestore_bdev_type", bdev) && osd.GetString("bluestore_bdev_rotational", rotational)) {
+            bdev = (rotational == "0") ? "ssd" : "hdd";
+        }
+        int64_t size = 0;
+        if (!osd.GetInt("bluestore_min_alloc_size", size) || size <= 0) {
+            size = (bdev == "ssd") ? ssdSize : hddSize;
+        }
+        if (size <= 0 || size > UINT32_MAX) {
+            continue;
+        }
+
+        osdSize[id] = size;
+        if (!bdev.empty()) {
+            SetMax(out.byBdev, bdev, size);
+        }
+        auto iter = nodes.find(id);
+        if (iter != nodes.end() && !iter->second.deviceClass.empty()) {
+            SetMax(out.byClass, iter->second.deviceClass, size);
+        }
+    }
+
+    std::map<int64_t, uint32_t> byRule;
+    for (auto &rule : rules.items) {
+        int64_t ruleId = 0;
+        const ProxyJson *steps = rule.Get("steps");
+        if (!rule.GetInt("rule_id", ruleId) || steps == nullptr) {
+            continue;
+        }
+
+        std::set<int64_t> osds;
+        for (auto &step : steps->items) {
+            std::string op;
+            std::string itemName;
+            int64_t item = 0;
+            if (!step.GetString("op", op) || op != "take") {
+                continue;
+            }
+            /* a class restricted take names its shadow bucket root~class */
+            std::string cls;
+            if (step.GetString("item_name", itemName)) {
+                size_t sep = itemName.find('~');
+                if (sep != std::string::npos) {
+                    cls = itemName.substr(sep + 1);
+                    itemName = itemName.substr(0, sep);
+                }
+                auto iter = idByName.find(itemName);
+                if (iter == idByName.end()) {
+                    continue;
+                }
+                item = iter->second;
+            } else if (!step.GetInt("item", item)) {
+                continue;
+            }
+            CollectOsds(nodes, item, cls, osds, 0);
+        }
+
+        uint32_t size = 0;
+        for (int64_t osd : osds) {
+            auto iter = osdSize.find(osd);
+            if (iter != osdSize.end() && iter->second > size) {
+                size = iter->second;
+            }
+        }
+        byRule[ruleId] = size;
+    }
+
+    for (auto &pool : pools->items) {
+        int64_t poolId = 0;
+        int64_t ruleId = 0;
+        if (!pool.GetInt("pool", poolId) || !pool.GetInt("crush_rule", ruleId)) {
+            continue;
+        }
+        auto iter = byRule.find(ruleId);
+        out.byPool[poolId] = (iter == byRule.end()) ? 0 : iter->second;
+    }
+    return 0;
+}
+
+void MinAllocDiscovery::Init(rados_client_t radosClient)
+{
+    std::lock_guard<std::mutex> l(loadLock);
+    client = radosClient;
+}
+
+void MinAllocDiscovery::Clear()
+{
+    std::lock_guard<std::mutex> l(loadLock);
+    std::atomic_store(&info, std::shared_ptr<const MinAllocInfo>());
+    client = nullptr;
+    std::lock_guard<std::mutex> ml(missLock);
+    missed.clear();
+}
+
+int MinAllocDiscovery::Load()
+{
+    if (client == nullptr) {
+        return -ENOTCONN;
+    }
+
+    /*
+     * the epoch comes from osd dump, asked first, so a map that changes while
+     * the rest is read shows as a newer epoch to the next CheckEpoch
+     */
+    MinAllocReplies replies;
+    int ret = RadosMonCommand(client, MON_CMD_OSD_DUMP, replies.osdDump);
+    if (ret == 0) {
+        ret = RadosMonCommand(client, MON_CMD_OSD_METADATA, replies.osdMetadata);
+    }
+    if (ret == 0) {
+        ret = RadosMonCommand(client, MON_CMD_OSD_TREE, replies.osdTree);
+    }
+    if (ret == 0) {
+        ret = RadosMonCommand(client, MON_CMD_CRUSH_RULE_DUMP, replies.crushRules);
+    }
+
+    std::shared_ptr<MinAllocInfo> next = std::make_shared<MinAllocInfo>();
+    if (ret == 0) {
+        uint32_t hddSize = 0;
+        uint32_t ssdSize = 0;
+        LocalMinAllocSize(CEPH_BDEV_HDD, &hddSize);
+        LocalMinAllocSize(CEPH_BDEV_SSD, &ssdSize);
+        ret = Build(replies, hddSize, ssdSize, *next);
+    }
+    if (ret != 0) {
+        /* an empty info with no epoch falls back to the local config until the next epoch check */
+        ProxyDbgLogWarnLimit1("discover min_alloc_size failed: %d", ret);
+        next = std::make_shared<MinAllocInfo>();
+        next->epoch = -1;
+    } else {
+        ProxyDbgLogDebug("min_alloc_size discovered, epoch=%ld, classes=%lu, pools=%lu",
+            next->epoch, next->byClass.size(), next->byPool.size());
+    }
+
+    std::atomic_store(&info, std::shared_ptr<const MinAllocInfo>(next));
+    loads++;
+    return ret;
+}
+
+int MinAllocDiscovery::LoadOnMiss(uint64_t seen)
+{
+    std::lock_guard<std::mutex> l(loadLock);
+    /* a load finished after the miss already covers it */
+    if (loads > seen) {
+        return 0;
+    }
+    return Load();
+}
+
+int64_t MinAllocDiscovery::MissedAt(int64_t poolId)
+{
+    std::lock_guard<std::mutex> l(missLock);
+    auto iter = missed.find(poolId);
+    return (iter == missed.end()) ? 0 : iter->second;
+}
+
+int MinAllocDiscovery::LocalMinAllocSize(CEPH_BDEV_TYPE_E type, uint32_t *minAllocSize)
+{
+    if (type == CEPH_BDEV_SSD) {
+        return RadosGetMinAllocSizeSSD(client, minAllocSize);
+    }
+    return RadosGetMinAllocSizeHDD(client, minAllocSize);
+}
+
+int MinAllocDiscovery::CheckEpoch()
+{
+    std::shared_ptr<const MinAllocInfo> cur = std::atomic_load(&info);
+    if (cur == nullptr || client == nullptr) {
+        return 0;
+    }
+
+    std::string out;
+    int64_t epoch = 0;
+    int ret = RadosMonCommand(client, MON_CMD_OSD_STAT, out);
+    if (ret == 0) {
+        ret = ParseEpoch(out, epoch);
+    }
+    if (ret != 0) {
+        ProxyDbgLogErr("get osdmap epoch failed: %d", ret);
+        return ret;
+    }
+    if (epoch == cur->epoch) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> l(loadLock);
+    cur = std::atomic_load(&info);
+    if (cur == nullptr || cur->epoch >= epoch) {
+        return 0;
+    }
+    return Load();
+}
+
+int MinAllocDiscovery::GetMinAllocSize(CEPH_BDEV_TYPE_E type, uint32_t *minAllocSize)
+{
+    uint64_t seen = loads;
+    std::shared_ptr<const MinAllocInfo> cur = std::atomic_load(&info);
+    if (cur == nullptr) {
+        LoadOnMiss(seen);
+        cur = std::atomic_load(&info);
+    }
+
+    if (cur != nullptr) {
+        /* nvme OSDs are solid state too, the largest of them wins */
+        std::vector<std::string> names;
+        if (type == CEPH_BDEV_SSD) {
+            names = { "ssd", "nvme" };
+        } else {
+            names = { "hdd" };
+        }
+        for (auto *m : { &cur->byClass, &cur->byBdev }) {
+            uint32_t size = 0;
+            for (auto &name : names) {
+                auto iter = m->find(name);
+                if (iter != m->end() && iter->second > size) {
+                    size = iter->second;
+                }
+            }
+            if (size != 0) {
+                *minAllocSize = size;
+                return 0;
+            }
+        }
+    }
+    return LocalMinAllocSize(type, minAllocSize);
+}
+
+int MinAllocDiscovery::GetPoolMinAllocSize(int64_t poolId, uint32_t *minAllocSize)
+{
+    uint64_t seen = loads;
+    std::shared_ptr<const MinAllocInfo> cur = std::atomic_load(&info);
+    if (cur == nullptr || cur->byPool.find(poolId) == cur->byPool.end()) {
+        if (cur != nullptr && MissedAt(poolId) == cur->epoch) {
+            return -ENOENT;
+        }
+        /* a pool created after the last load moved the epoch, the timer may not have seen it yet */
+        int ret = LoadOnMiss(seen);
+        if (ret != 0) {
+            return ret;
+        }
+        cur = std::atomic_load(&info);
+    }
+
+    if (cur == nullptr) {
+        return -ENOTCONN;
+    }
+    auto iter = cur->byPool.find(poolId);
+    if (iter == cur->byPool.end()) {
+        /* unknown or deleted, not asked again before the epoch moves */
+        if (cur->epoch > 0) {
+            std::lock_guard<std::mutex> l(missLock);
+            missed[poolId] = cur->epoch;
+        }
+        return -ENOENT;
+    }
+    if (iter->second == 0) {
+        return -ENOENT;
+    }
+    *minAllocSize = iter->second;
+    return 0;
+}
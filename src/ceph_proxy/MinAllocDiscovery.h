@@ -0,0 +1,80 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_MIN_ALLOC_DISCOVERY_H_
+#define _CEPH_PROXY_MIN_ALLOC_DISCOVERY_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "CephProxyInterface.h"
+
+/* the JSON replies discovery reads, one of each per reload */
+struct MinAllocReplies {
+    std::string osdDump;
+    std::string osdMetadata;
+    std::string osdTree;
+    std::string crushRules;
+};
+
+struct MinAllocInfo {
+    /* osdmap epoch of the osd dump the info was built from */
+    int64_t epoch = 0;
+    /* largest min_alloc_size of the bluestore OSDs per CRUSH device class */
+    std::map<std::string, uint32_t> byClass;
+    /* the same keyed by bluestore_bdev_type, for OSDs without a class */
+    std::map<std::string, uint32_t> byBdev;
+    /* largest min_alloc_size of the OSDs the pool's CRUSH rule takes from */
+    std::map<int64_t, uint32_t> byPool;
+};
+
+/*
+ * bluestore_min_alloc_size as the OSDs use it, which is fixed when an OSD is
+ * created and may differ from the client's config. Built from osd metadata,
+ * osd tree, the pools of osd dump and the CRUSH rules, and kept until the
+ * PoolUsageStat timer sees a new osdmap epoch in osd stat. OSDs whose
+ * metadata has no bluestore_min_alloc_size (before it was reported) count with
+ * the client's bluestore_min_alloc_size_hdd/ssd for their rotational flag.
+ */
+class MinAllocDiscovery {
+private:
+    rados_client_t client;
+    std::shared_ptr<const MinAllocInfo> info;
+    /* reloads are serialized, loads counts the ones that finished */
+    std::mutex loadLock;
+    std::atomic<uint64_t> loads;
+    /* pools a load on miss did not find, with the epoch of that load */
+    std::mutex missLock;
+    std::map<int64_t, int64_t> missed;
+
+    int Load();
+    int LoadOnMiss(uint64_t seen);
+    /* epoch the pool was last found missing at, 0 when it never was */
+    int64_t MissedAt(int64_t poolId);
+    int LocalMinAllocSize(CEPH_BDEV_TYPE_E type, uint32_t *minAllocSize);
+
+public:
+    MinAllocDiscovery(): client(nullptr), loads(0) { }
+    ~MinAllocDiscovery() { }
+
+    void Init(rados_client_t radosClient);
+    void Clear();
+    /* reload when the osdmap epoch moved since the last load, nothing before the first lookup */
+    int CheckEpoch();
+    int GetMinAllocSize(CEPH_BDEV_TYPE_E type, uint32_t *minAllocSize);
+    /* return -ENOENT when no OSD the pool maps to is known */
+    int GetPoolMinAllocSize(int64_t poolId, uint32_t *minAllocSize);
+
+    /* hddSize/ssdSize stand in for OSDs that do not report theirs */
+    static int Build(const MinAllocReplies &replies, uint32_t hddSize, uint32_t ssdSize, MinAllocInfo &out);
+};
+
+#endif
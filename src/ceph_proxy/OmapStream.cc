@@ -0,0 +1,190 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "OmapStream.h"
+#include "CephProxy.h"
+#include "CephProxyLog.h"
+#include "ProxyObjectPool.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+OmapStream::OmapStream(CephProxy *_proxy, int64_t _poolId, const char *_oid, uint32_t _pageSize, bool _keysOnly)
+    : proxy(_proxy), poolId(_poolId), oid(_oid), pageSize(_pageSize), keysOnly(_keysOnly), cur(0),
+      fetching(false), err(0), op(nullptr)
+{
+    memset(&stat, 0, sizeof(stat));
+    // nothing is read yet, the first page is on its way into pages[1]
+    pages[0].more = true;
+    vi = pages[0].vals.end();
+    ki = pages[0].keys.end();
+}
+
+OmapStream::~OmapStream()
+{
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [this]() { return !fetching; });
+}
+
+int OmapStream::Open(CephProxy *proxy, int64_t poolId, const char *oid, const char *startAfter,
+    uint32_t pageSize, uint32_t flags, OmapStream **stream)
+{
+    OmapStream *s = new(std::nothrow) OmapStream(proxy, poolId, oid,
+        pageSize == 0 ? OMAP_STREAM_PAGE_DEFAULT : pageSize, (flags & PROXY_OMAP_STREAM_KEYS_ONLY) != 0);
+    if (s == nullptr) {
+        ProxyDbgLogErr("Allocate Memory failed.");
+        return -ENOMEM;
+    }
+    if (startAfter != nullptr) {
+        s->after = startAfter;
+    }
+
+    std::unique_lock<std::mutex> l(s->lock);
+    int ret = s->Fetch();
+    l.unlock();
+    if (ret != 0) {
+        delete s;
+        return ret;
+    }
+    *stream = s;
+    return 0;
+}
+
+/* under lock: reads the page after `after` into the page the caller is not on */
+int OmapStream::Fetch()
+{
+    OmapPage &p = pages[1 - cur];
+    p.Clear();
+    p.done = false;
+    RadosObjectReadOp *readOp = ProxyObjectPool<RadosObjectReadOp>::Get();
+    if (readOp == nullptr) {
+        ProxyDbgLogErr("Allocate ReadOp Failed.");
+        p.ret = -ENOMEM;
+        p.done = true;
+        return -ENOMEM;
+    }
+    readOp->Init(poolId, oid.c_str());
+    if (keysOnly) {
+        readOp->op.omap_get_keys2(after, pageSize, &p.keys, &p.more, &p.ret);
+    } else {
+        readOp->op.omap_get_vals2(after, pageSize, &p.vals, &p.more, &p.ret);
+    }
+    comp.fn = PageDone;
+    comp.cbArg = this;
+    op = readOp;
+    fetching = true;
+    stat.pages++;
+
+    int ret = proxy->Enqueue(readOp, &comp);
+    if (ret != 0) {
+        ProxyDbgLogErr("queue omap read of %s failed: %d", oid.c_str(), ret);
+        ProxyObjectPool<RadosObjectReadOp>::Put(readOp);
+        op = nullptr;
+        fetching = false;
+        p.ret = -EBUSY;
+        p.done = true;
+        return -EBUSY;
+    }
+    return 0;
+}
+
+void OmapStream::PageDone(int ret, void *arg)
+{
+    OmapStream *s = static_cast<OmapStream *>(arg);
+    std::lock_guard<std::mutex> l(s->lock);
+    OmapPage &p = s->pages[1 - s->cur];
+    if (ret < 0) {
+        p.ret = ret;
+    }
+    for (auto &k : p.keys) {
+        p.bytes += k.size();
+    }
+    for (auto &v : p.vals) {
+        p.bytes += v.first.size() + v.second.length();
+    }
+    p.done = true;
+    s->stat.peakBytes = std::max(s->stat.peakBytes, s->pages[0].bytes + s->pages[1].bytes);
+    ProxyObjectPool<RadosObjectReadOp>::Put(s->op);
+    s->op = nullptr;
+    s->fetching = false;
+    s->cond.notify_all();
+}
+
+bool OmapStream::AtEnd()
+{
+    return keysOnly ? ki == pages[cur].keys.end() : vi == pages[cur].vals.end();
+}
+
+int OmapStream::Next(const char **key, size_t *keyLen, const char **val, size_t *valLen)
+{
+    std::unique_lock<std::mutex> l(lock);
+    while (AtEnd()) {
+        if (err != 0) {
+            return err;
+        }
+        if (!pages[cur].more) {
+            return 0;
+        }
+        OmapPage &next = pages[1 - cur];
+        if (!next.done) {
+            stat.stalls++;
+            cond.wait(l, [&next]() { return next.done; });
+        }
+        if (next.ret < 0) {
+            err = next.ret;
+            return err;
+        }
+
+        // the entry handed out last goes with the old page
+        pages[cur].Clear();
+        cur = 1 - cur;
+        OmapPage &p = pages[cur];
+        vi = p.vals.begin();
+        ki = p.keys.begin();
+        bool empty = keysOnly ? p.keys.empty() : p.vals.empty();
+        if (empty) {
+            // no key to continue after, asking again would return the same page
+            p.more = false;
+        } else if (p.more) {
+            after = keysOnly ? *p.keys.rbegin() : p.vals.rbegin()->first;
+            // a failed fetch shows up once this page is read
+            Fetch();
+        }
+    }
+
+    if (keysOnly) {
+        *key = ki->c_str();
+        *keyLen = ki->size();
+        ++ki;
+        if (val != nullptr) {
+            *val = nullptr;
+        }
+        if (valLen != nullptr) {
+            *valLen = 0;
+        }
+        return 1;
+    }
+
+    *key = vi->first.c_str();
+    *keyLen = vi->first.size();
+    size_t len = vi->second.length();
+    if (val != nullptr) {
+        *val = len > 0 ? vi->second.c_str() : nullptr;
+    }
+    if (valLen != nullptr) {
+        *valLen = len;
+    }
+    ++vi;
+    return 1;
+}
+
+void OmapStream::Stat(ProxyOmapStreamStat *st)
+{
+    std::lock_guard<std::mutex> l(lock);
+    *st = stat;
+}
@@ -0,0 +1,88 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_OMAP_STREAM_H_
+#define _CEPH_PROXY_OMAP_STREAM_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "CephProxyOp.h"
+
+#define OMAP_STREAM_PAGE_DEFAULT 1024
+
+class CephProxy;
+
+struct OmapPage {
+    std::map<std::string, bufferlist> vals;
+    std::set<std::string> keys;
+    bool more;
+    int ret;
+    bool done;
+    uint64_t bytes;
+
+    OmapPage() : more(false), ret(0), done(true), bytes(0) {
+    }
+
+    void Clear() {
+        vals.clear();
+        keys.clear();
+        more = false;
+        ret = 0;
+        bytes = 0;
+    }
+};
+
+/*
+ * An omap walk as omap_get_vals2 pages chained by start_after. Two pages
+ * take turns: the caller reads one while the proxy worker fetches the next
+ * into the other, queued as soon as the last key of the current page is
+ * known. Entries are handed out as pointers into the page maps, librados
+ * has decoded each value into its own bufferlist already.
+ */
+class OmapStream {
+private:
+    CephProxy *proxy;
+    int64_t poolId;
+    std::string oid;
+    uint32_t pageSize;
+    bool keysOnly;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    OmapPage pages[2];
+    // cur is read by the caller, the other one is being fetched while fetching
+    int cur;
+    bool fetching;
+    std::string after;
+    std::map<std::string, bufferlist>::iterator vi;
+    std::set<std::string>::iterator ki;
+    int err;
+    // queued with the fetch, its callback is PageDone with this stream
+    RadosObjectReadOp *op;
+    Completion comp;
+    ProxyOmapStreamStat stat;
+
+    OmapStream(CephProxy *_proxy, int64_t _poolId, const char *_oid, uint32_t _pageSize, bool _keysOnly);
+    int Fetch();
+    bool AtEnd();
+    static void PageDone(int ret, void *arg);
+
+public:
+    ~OmapStream();
+
+    static int Open(CephProxy *proxy, int64_t poolId, const char *oid, const char *startAfter,
+        uint32_t pageSize, uint32_t flags, OmapStream **stream);
+    int Next(const char **key, size_t *keyLen, const char **val, size_t *valLen);
+    void Stat(ProxyOmapStreamStat *st);
+};
+
+#endif
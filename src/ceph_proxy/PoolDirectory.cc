@@ -0,0 +1,164 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "PoolDirectory.h"
+#include "RadosWrapper.h"
+#include "CephProxyLog.h"
+
+#include <errno.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+int PoolDirectory::Init(rados_client_t radosClient)
+{
+    client = radosClient;
+    return Refresh(true);
+}
+
+void PoolDirectory::Clear()
+{
+    std::lock_guard<std::mutex> rl(refreshLock);
+    std::unique_lock<std::shared_mutex> l(mutex);
+    idByName.clear();
+    nameById.clear();
+    client = nullptr;
+}
+
+int PoolDirectory::Load(bool latest)
+{
+    if (client == nullptr) {
+        return -ENOTCONN;
+    }
+
+    uint64_t seq = ++started;
+    int ret = 0;
+    if (latest) {
+        ret = RadosWaitForLatestOsdmap(client);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    std::vector<std::pair<int64_t, std::string>> pools;
+    ret = RadosPoolList(client, pools);
+    if (ret < 0) {
+        return ret;
+    }
+
+    std::unordered_map<std::string, int64_t> names;
+    std::unordered_map<int64_t, std::string> ids;
+    for (auto &pool : pools) {
+        names[pool.second] = pool.first;
+        ids[pool.first] = pool.second;
+    }
+
+    std::unique_lock<std::shared_mutex> l(mutex);
+    if (ids != nameById) {
+        idByName.swap(names);
+        nameById.swap(ids);
+        version++;
+        ProxyDbgLogDebug("pool directory updated, pools=%lu, version=%lu", pools.size(), version.load());
+    }
+    done = seq;
+    return 0;
+}
+
+int PoolDirectory::Refresh(bool latest)
+{
+    std::lock_guard<std::mutex> rl(refreshLock);
+    return Load(latest);
+}
+
+int PoolDirectory::RefreshOnMiss(uint64_t seen)
+{
+    std::lock_guard<std::mutex> rl(refreshLock);
+    /* a reload started after the miss already covers it */
+    if (done > seen) {
+        return 0;
+    }
+    return Load(true);
+}
+
+bool PoolDirectory::FindId(const std::string &name, int64_t &poolId)
+{
+    std::shared_lock<std::shared_mutex> l(mutex);
+    auto iter = idByName.find(name);
+    if (iter == idByName.end()) {
+        return false;
+    }
+    poolId = iter->second;
+    return true;
+}
+
+bool PoolDirectory::FindName(int64_t poolId, std::string &name)
+{
+    std::shared_lock<std::shared_mutex> l(mutex);
+    auto iter = nameById.find(poolId);
+    if (iter == nameById.end()) {
+        return false;
+    }
+    name = iter->second;
+    return true;
+}
+
+int64_t PoolDirectory::GetPoolId(const std::string &name)
+{
+    int64_t poolId = 0;
+    uint64_t seen = started;
+    if (FindId(name, poolId)) {
+        return poolId;
+    }
+
+    int ret = RefreshOnMiss(seen);
+    if (ret < 0) {
+        return ret;
+    }
+    return FindId(name, poolId) ? poolId : -ENOENT;
+}
+
+int PoolDirectory::GetPoolName(int64_t poolId, std::string &name)
+{
+    uint64_t seen = started;
+    if (FindName(poolId, name)) {
+        return 0;
+    }
+
+    int ret = RefreshOnMiss(seen);
+    if (ret < 0) {
+        return ret;
+    }
+    return FindName(poolId, name) ? 0 : -ENOENT;
+}
+
+void PoolDirectory::Invalidate(int64_t poolId)
+{
+    std::unique_lock<std::shared_mutex> l(mutex);
+    auto iter = nameById.find(poolId);
+    if (iter == nameById.end()) {
+        return;
+    }
+    /* the name may already belong to a newer pool */
+    auto name = idByName.find(iter->second);
+    if (name != idByName.end() && name->second == poolId) {
+        idByName.erase(name);
+    }
+    ProxyDbgLogInfo("pool directory dropped pool %ld(%s)", poolId, iter->second.c_str());
+    nameById.erase(iter);
+    version++;
+}
+
+void PoolDirectory::GetPools(std::vector<std::pair<int64_t, std::string>> &pools)
+{
+    std::shared_lock<std::shared_mutex> l(mutex);
+    pools.assign(nameById.begin(), nameById.end());
+}
+
+uint64_t PoolDirectory::GetVersion() const
+{
+    return version;
+}
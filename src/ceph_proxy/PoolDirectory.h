@@ -0,0 +1,68 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_POOL_DIRECTORY_H_
+#define _CEPH_PROXY_POOL_DIRECTORY_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "CephProxyInterface.h"
+
+/*
+ * Pool name <-> id translation from a copy of the pools in the client's
+ * osdmap. librados has no public osdmap epoch, so the copy is reloaded by the
+ * PoolUsageStat timer and by any lookup that misses; a miss first waits for
+ * the latest osdmap, and concurrent misses share one reload. A pool an op or
+ * an IoCtx finds deleted is dropped at once, so its name misses and reloads;
+ * a rename alone keeps the old entry until the next timer reload, which is no
+ * longer than the PoolUsageStat interval.
+ */
+class PoolDirectory {
+private:
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, int64_t> idByName;
+    std::unordered_map<int64_t, std::string> nameById;
+    rados_client_t client;
+
+    /* reloads are serialized, started/done number them */
+    std::mutex refreshLock;
+    std::atomic<uint64_t> started;
+    std::atomic<uint64_t> done;
+    /* bumped whenever a reload changes the maps */
+    std::atomic<uint64_t> version;
+
+    int Load(bool latest);
+    int RefreshOnMiss(uint64_t seen);
+    bool FindId(const std::string &name, int64_t &poolId);
+    bool FindName(int64_t poolId, std::string &name);
+
+public:
+    PoolDirectory(): client(nullptr), started(0), done(0), version(0) { }
+    ~PoolDirectory() { }
+
+    int Init(rados_client_t radosClient);
+    void Clear();
+    /* latest waits for the newest osdmap from the monitors first */
+    int Refresh(bool latest);
+    /* return -ENOENT when the pool is not in the latest osdmap */
+    int64_t GetPoolId(const std::string &name);
+    int GetPoolName(int64_t poolId, std::string &name);
+    /* drop a pool librados no longer knows, the next lookup of it reloads */
+    void Invalidate(int64_t poolId);
+    /* every pool as of the last reload */
+    void GetPools(std::vector<std::pair<int64_t, std::string>> &pools);
+    uint64_t GetVersion() const;
+};
+
+#endif
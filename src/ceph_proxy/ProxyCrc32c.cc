@@ -0,0 +1,233 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "ProxyCrc32c.h"
+#include "ProxySgl.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/* reflected Castagnoli polynomial */
+#define CRC32C_POLY 0x82f63b78U
+/* bytes each of the three interleaved streams covers before they are combined */
+#define CRC32C_BLOCK 1024
+#define CRC32C_ZEROS 4096
+
+static uint32_t g_table[8][256];
+/* g_shift[k][b] is the crc of (b << 8k) followed by CRC32C_BLOCK zero bytes */
+static uint32_t g_shift[4][256];
+static ProxyCrc32cFn g_crc32c = ProxyCrc32cTable;
+static const char *g_crc32cName = "table";
+static const unsigned char g_zeros[CRC32C_ZEROS] = { 0 };
+
+static inline uint64_t Load64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * A raw crc is linear in the seed and the data, so crc(s, A B) is the crc of
+ * crc(s, A) over |B| zero bytes xor crc(0, B): three streams of CRC32C_BLOCK
+ * bytes are summed independently and shifted together here.
+ */
+static inline uint32_t ShiftBlock(uint32_t crc)
+{
+    return g_shift[0][crc & 0xff] ^ g_shift[1][(crc >> 8) & 0xff] ^
+        g_shift[2][(crc >> 16) & 0xff] ^ g_shift[3][crc >> 24];
+}
+
+uint32_t ProxyCrc32cTable(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+        crc = g_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v = Load64(p);
+        uint32_t lo = static_cast<uint32_t>(v) ^ crc;
+        uint32_t hi = static_cast<uint32_t>(v >> 32);
+        crc = g_table[7][lo & 0xff] ^ g_table[6][(lo >> 8) & 0xff] ^
+            g_table[5][(lo >> 16) & 0xff] ^ g_table[4][lo >> 24] ^
+            g_table[3][hi & 0xff] ^ g_table[2][(hi >> 8) & 0xff] ^
+            g_table[1][(hi >> 16) & 0xff] ^ g_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = g_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t Crc32cSse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+    while (len >= 3 * CRC32C_BLOCK) {
+        uint64_t c0 = crc;
+        uint64_t c1 = 0;
+        uint64_t c2 = 0;
+        for (size_t i = 0; i < CRC32C_BLOCK; i += 8) {
+            c0 = _mm_crc32_u64(c0, Load64(p + i));
+            c1 = _mm_crc32_u64(c1, Load64(p + CRC32C_BLOCK + i));
+            c2 = _mm_crc32_u64(c2, Load64(p + 2 * CRC32C_BLOCK + i));
+        }
+        crc = ShiftBlock(ShiftBlock(c0) ^ c1) ^ c2;
+        p += 3 * CRC32C_BLOCK;
+        len -= 3 * CRC32C_BLOCK;
+    }
+    uint64_t c = crc;
+    while (len >= 8) {
+        c = _mm_crc32_u64(c, Load64(p));
+        p += 8;
+        len -= 8;
+    }
+    crc = c;
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+    return crc;
+}
+
+static bool HwSupported()
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+
+static ProxyCrc32cFn g_hw = Crc32cSse42;
+static const char *g_hwName = "sse4.2";
+#elif defined(__aarch64__)
+__attribute__((target("arch=armv8-a+crc")))
+static uint32_t Crc32cArmv8(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+    while (len >= 3 * CRC32C_BLOCK) {
+        uint32_t c0 = crc;
+        uint32_t c1 = 0;
+        uint32_t c2 = 0;
+        for (size_t i = 0; i < CRC32C_BLOCK; i += 8) {
+            c0 = __crc32cd(c0, Load64(p + i));
+            c1 = __crc32cd(c1, Load64(p + CRC32C_BLOCK + i));
+            c2 = __crc32cd(c2, Load64(p + 2 * CRC32C_BLOCK + i));
+        }
+        crc = ShiftBlock(ShiftBlock(c0) ^ c1) ^ c2;
+        p += 3 * CRC32C_BLOCK;
+        len -= 3 * CRC32C_BLOCK;
+    }
+    while (len >= 8) {
+        crc = __crc32cd(crc, Load64(p));
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+    return crc;
+}
+
+static bool HwSupported()
+{
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+static ProxyCrc32cFn g_hw = Crc32cArmv8;
+static const char *g_hwName = "armv8";
+#else
+static bool HwSupported()
+{
+    return false;
+}
+
+static ProxyCrc32cFn g_hw = nullptr;
+static const char *g_hwName = "table";
+#endif
+
+namespace {
+
+struct Crc32cInit {
+    Crc32cInit()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; k++) {
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+            }
+            g_table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                g_table[k][i] = (g_table[k - 1][i] >> 8) ^ g_table[0][g_table[k - 1][i] & 0xff];
+            }
+        }
+        for (uint32_t k = 0; k < 4; k++) {
+            for (uint32_t b = 0; b < 256; b++) {
+                g_shift[k][b] = ProxyCrc32cTable(b << (8 * k), g_zeros, CRC32C_BLOCK);
+            }
+        }
+        if (g_hw != nullptr && HwSupported()) {
+            g_crc32c = g_hw;
+            g_crc32cName = g_hwName;
+        }
+    }
+};
+
+Crc32cInit g_crc32cInit;
+
+}
+
+uint32_t ProxyCrc32c(uint32_t crc, const void *data, size_t len)
+{
+    return g_crc32c(crc, static_cast<const unsigned char *>(data), len);
+}
+
+uint32_t ProxyCrc32cSgl(uint32_t crc, const SGL_S *sgl, size_t len, int isRelease)
+{
+    SglForEach(sgl, 0, len, isRelease, [&crc](char *buf, size_t n) {
+        crc = g_crc32c(crc, reinterpret_cast<const unsigned char *>(buf), n);
+    });
+    return crc;
+}
+
+uint32_t ProxyCrc32cZeros(uint32_t crc, size_t len)
+{
+    while (len > 0) {
+        size_t size = std::min<size_t>(sizeof(g_zeros), len);
+        crc = g_crc32c(crc, g_zeros, size);
+        len -= size;
+    }
+    return crc;
+}
+
+const char *ProxyCrc32cName()
+{
+    return g_crc32cName;
+}
+
+ProxyCrc32cFn ProxyCrc32cHw()
+{
+    return (g_hw != nullptr && HwSupported()) ? g_hw : nullptr;
+}
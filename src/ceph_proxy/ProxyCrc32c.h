@@ -0,0 +1,37 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_CRC32C_H_
+#define _CEPH_PROXY_CRC32C_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sgl.h"
+
+/*
+ * crc32c (Castagnoli) the way ceph_crc32c computes it: the seed goes in as
+ * it is and the result is not inverted, so crc32c(-1, ...) matches what an
+ * OSD returns for a LIBRADOS_CHECKSUM_TYPE_CRC32C checksum with init -1.
+ * ceph_crc32c itself lives in libceph-common, which the proxy does not link;
+ * this picks SSE4.2 or the ARMv8 CRC instructions when the CPU has them and
+ * a slicing-by-8 table otherwise.
+ */
+typedef uint32_t (*ProxyCrc32cFn)(uint32_t crc, const unsigned char *data, size_t len);
+
+uint32_t ProxyCrc32c(uint32_t crc, const void *data, size_t len);
+/* len bytes of the chained SGL, isRelease entries hold one 4K page each as in the SGL read/write ops */
+uint32_t ProxyCrc32cSgl(uint32_t crc, const SGL_S *sgl, size_t len, int isRelease);
+/* crc of len zero bytes, for the zero-filled tail of a short read */
+uint32_t ProxyCrc32cZeros(uint32_t crc, size_t len);
+
+/* the implementation ProxyCrc32c uses: "sse4.2", "armv8" or "table" */
+const char *ProxyCrc32cName();
+uint32_t ProxyCrc32cTable(uint32_t crc, const unsigned char *data, size_t len);
+/* null when the CPU has no crc32c instructions */
+ProxyCrc32cFn ProxyCrc32cHw();
+
+#endif
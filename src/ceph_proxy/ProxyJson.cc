@@ -0,0 +1,240 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "ProxyJson.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#define JSON_MAX_DEPTH 64
+
+namespace {
+
+class JsonReader {
+private:
+    const std::string &in;
+    size_t pos;
+
+    void SkipSpace()
+    {
+        while (pos < in.size() && (in[pos] == ' ' || in[pos] == '\t' || in[pos] == '\n' || in[pos] == '\r')) {
+            pos++;
+        }
+    }
+
+    bool Literal(const char *word)
+    {
+        size_t len = strlen(word);
+        if (in.compare(pos, len, word) != 0) {
+            return false;
+        }
+        pos += len;
+        return true;
+    }
+
+    static void AppendUtf8(std::string &out, uint32_t cp)
+    {
+        if (cp < 0x80) {
+            out.push_back(cp);
+        } else if (cp < 0x800) {
+            out.push_back(0xc0 | (cp >> 6));
+            out.push_back(0x80 | (cp & 0x3f));
+        } else {
+            out.push_back(0xe0 | (cp >> 12));
+            out.push_back(0x80 | ((cp >> 6) & 0x3f));
+            out.push_back(0x80 | (cp & 0x3f));
+        }
+    }
+
+    bool String(std::string &out)
+    {
+        pos++;
+        while (pos < in.size()) {
+            char c = in[pos++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (pos >= in.size()) {
+                return false;
+            }
+            c = in[pos++];
+            switch (c) {
+                case '"': case '\\': case '/': out.push_back(c); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    if (pos + 4 > in.size()) {
+                        return false;
+                    }
+                    char hex[5] = { 0 };
+                    in.copy(hex, 4, pos);
+                    char *end = nullptr;
+                    uint32_t cp = strtoul(hex, &end, 16);
+                    if (end != hex + 4) {
+                        return false;
+                    }
+                    pos += 4;
+                    AppendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool Number(std::string &out)
+    {
+        size_t start = pos;
+        if (in[pos] == '-') {
+            pos++;
+        }
+        while (pos < in.size() && strchr("0123456789.eE+-", in[pos]) != nullptr) {
+            pos++;
+        }
+        out = in.substr(start, pos - start);
+        return out != "-" && !out.empty();
+    }
+
+public:
+    JsonReader(const std::string &_in): in(_in), pos(0) { }
+
+    bool Value(ProxyJson &val, int depth)
+    {
+        SkipSpace();
+        if (pos >= in.size() || depth > JSON_MAX_DEPTH) {
+            return false;
+        }
+
+        char c = in[pos];
+        if (c == '{' || c == '[') {
+            bool isObject = (c == '{');
+            char close = isObject ? '}' : ']';
+            val.type = isObject ? ProxyJson::JSON_OBJECT : ProxyJson::JSON_ARRAY;
+            pos++;
+            SkipSpace();
+            if (pos < in.size() && in[pos] == close) {
+                pos++;
+                return true;
+            }
+            while (true) {
+                if (isObject) {
+                    SkipSpace();
+                    std::string key;
+                    if (pos >= in.size() || in[pos] != '"' || !String(key)) {
+                        return false;
+                    }
+                    SkipSpace();
+                    if (pos >= in.size() || in[pos] != ':') {
+                        return false;
+                    }
+                    pos++;
+                    val.keys.push_back(key);
+                }
+                val.items.emplace_back();
+                if (!Value(val.items.back(), depth + 1)) {
+                    return false;
+                }
+                SkipSpace();
+                if (pos < in.size() && in[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                if (pos < in.size() && in[pos] == close) {
+                    pos++;
+                    return true;
+                }
+                return false;
+            }
+        } else if (c == '"') {
+            val.type = ProxyJson::JSON_STRING;
+            return String(val.str);
+        } else if (c == 't' || c == 'f') {
+            val.type = ProxyJson::JSON_BOOL;
+            val.str = (c == 't') ? "true" : "false";
+            return Literal(val.str.c_str());
+        } else if (c == 'n') {
+            val.type = ProxyJson::JSON_NULL;
+            return Literal("null");
+        }
+        val.type = ProxyJson::JSON_NUMBER;
+        return Number(val.str);
+    }
+
+    bool End()
+    {
+        SkipSpace();
+        return pos == in.size();
+    }
+};
+
+}
+
+const ProxyJson *ProxyJson::Get(const std::string &key) const
+{
+    if (type != JSON_OBJECT) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == key) {
+            return &items[i];
+        }
+    }
+    return nullptr;
+}
+
+bool ProxyJson::ToInt(int64_t &val) const
+{
+    if ((type != JSON_NUMBER && type != JSON_STRING) || str.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    long long n = strtoll(str.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+    val = n;
+    return true;
+}
+
+bool ProxyJson::GetInt(const std::string &key, int64_t &val) const
+{
+    const ProxyJson *member = Get(key);
+    return member != nullptr && member->ToInt(val);
+}
+
+bool ProxyJson::GetString(const std::string &key, std::string &val) const
+{
+    const ProxyJson *member = Get(key);
+    if (member == nullptr || member->type != JSON_STRING) {
+        return false;
+    }
+    val = member->str;
+    return true;
+}
+
+int ProxyJsonParse(const std::string &in, ProxyJson &out)
+{
+    JsonReader reader(in);
+    out = ProxyJson();
+    if (!reader.Value(out, 0) || !reader.End()) {
+        out = ProxyJson();
+        return -EINVAL;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_JSON_H_
+#define _CEPH_PROXY_JSON_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Just enough JSON to read the formatted output of mon commands. Numbers are
+ * kept as their text, object members in the order they came.
+ */
+struct ProxyJson {
+    enum Type {
+        JSON_NULL = 0,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT,
+    };
+
+    Type type = JSON_NULL;
+    /* the string, the number's text, or "true"/"false" */
+    std::string str;
+    /* array items, or object members with their keys in keys */
+    std::vector<ProxyJson> items;
+    std::vector<std::string> keys;
+
+    /* a number, or a string holding one as osd metadata has them */
+    bool ToInt(int64_t &val) const;
+    /* null when not an object or no such member */
+    const ProxyJson *Get(const std::string &key) const;
+    bool GetInt(const std::string &key, int64_t &val) const;
+    bool GetString(const std::string &key, std::string &val) const;
+};
+
+/* return -EINVAL on malformed input or trailing garbage */
+int ProxyJsonParse(const std::string &in, ProxyJson &out);
+
+#endif
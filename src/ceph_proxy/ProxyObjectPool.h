@@ -0,0 +1,145 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _PROXY_OBJECT_POOL_H_
+#define _PROXY_OBJECT_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+struct ProxyObjectPoolStat {
+    uint64_t hits;
+    uint64_t misses;
+    size_t cached;
+};
+
+/*
+ * Free lists of op objects, one per thread plus a shared depot. An op is
+ * usually taken on the caller's thread and put back from a librados
+ * callback, so a thread holding more than LOCAL_MAX hands a batch to the
+ * depot and an empty one refills from it, touching the lock once per batch.
+ * T provides a default constructor and Reset(), which must leave the object
+ * as a fresh one while keeping its buffers.
+ */
+template <typename T>
+class ProxyObjectPool {
+    static constexpr size_t LOCAL_MAX = 256;
+    static constexpr size_t BATCH = LOCAL_MAX / 2;
+    static constexpr size_t DEPOT_MAX = 8192;
+
+    struct Depot {
+        std::mutex lock;
+        std::vector<T *> objs;
+        std::atomic<size_t> size { 0 };
+        std::atomic<uint64_t> hits { 0 };
+        std::atomic<uint64_t> misses { 0 };
+        std::atomic<bool> enable { true };
+    };
+
+    struct Local {
+        std::vector<T *> objs;
+
+        Local() {
+            objs.reserve(LOCAL_MAX + 1);
+        }
+
+        ~Local() {
+            Spill(*this, objs.size());
+        }
+    };
+
+    /* never freed: threads may exit after static destructors have run */
+    static Depot &GetDepot() {
+        static Depot *depot = new Depot();
+        return *depot;
+    }
+
+    static Local &GetLocal() {
+        static thread_local Local local;
+        return local;
+    }
+
+    static void Spill(Local &l, size_t n) {
+        Depot &d = GetDepot();
+        std::lock_guard<std::mutex> lg(d.lock);
+        while (n-- > 0) {
+            T *obj = l.objs.back();
+            l.objs.pop_back();
+            if (d.objs.size() < DEPOT_MAX) {
+                d.objs.push_back(obj);
+            } else {
+                delete obj;
+            }
+        }
+        d.size = d.objs.size();
+    }
+
+    static void Refill(Local &l) {
+        Depot &d = GetDepot();
+        if (d.size == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lg(d.lock);
+        size_t n = std::min(BATCH, d.objs.size());
+        l.objs.insert(l.objs.end(), d.objs.end() - n, d.objs.end());
+        d.objs.resize(d.objs.size() - n);
+        d.size = d.objs.size();
+    }
+
+public:
+    /* returns nullptr when out of memory */
+    static T *Get() {
+        Depot &d = GetDepot();
+        if (d.enable) {
+            Local &l = GetLocal();
+            if (l.objs.empty()) {
+                Refill(l);
+            }
+            if (!l.objs.empty()) {
+                T *obj = l.objs.back();
+                l.objs.pop_back();
+                d.hits.fetch_add(1, std::memory_order_relaxed);
+                return obj;
+            }
+        }
+        d.misses.fetch_add(1, std::memory_order_relaxed);
+        return new(std::nothrow) T();
+    }
+
+    static void Put(T *obj) {
+        if (obj == nullptr) {
+            return;
+        }
+        if (!GetDepot().enable) {
+            delete obj;
+            return;
+        }
+        obj->Reset();
+        Local &l = GetLocal();
+        l.objs.push_back(obj);
+        if (l.objs.size() > LOCAL_MAX) {
+            Spill(l, BATCH);
+        }
+    }
+
+    /* turning the pool off frees objects as they are put back, cached ones stay until reused */
+    static void SetEnable(bool enable) {
+        GetDepot().enable = enable;
+    }
+
+    static ProxyObjectPoolStat Stat() {
+        Depot &d = GetDepot();
+        return { d.hits.load(), d.misses.load(), d.size.load() };
+    }
+};
+
+#endif
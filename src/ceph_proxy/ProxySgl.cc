@@ -0,0 +1,228 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "ProxySgl.h"
+#include "ProxyCrc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+#define STREAM_ALIGN 16
+#define STREAM_LINE 64
+
+#if defined(__x86_64__)
+/* unaligned loads, aligned streaming stores a cache line at a time; the caller fences */
+static void StreamCopy(char *dst, const char *src, size_t len)
+{
+    size_t head = (STREAM_ALIGN - (reinterpret_cast<uintptr_t>(dst) & (STREAM_ALIGN - 1))) & (STREAM_ALIGN - 1);
+    head = std::min(head, len);
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+    while (len >= STREAM_LINE) {
+        const __m128i *s = reinterpret_cast<const __m128i *>(src);
+        __m128i *d = reinterpret_cast<__m128i *>(dst);
+        __m128i a = _mm_loadu_si128(s);
+        __m128i b = _mm_loadu_si128(s + 1);
+        __m128i c = _mm_loadu_si128(s + 2);
+        __m128i e = _mm_loadu_si128(s + 3);
+        _mm_stream_si128(d, a);
+        _mm_stream_si128(d + 1, b);
+        _mm_stream_si128(d + 2, c);
+        _mm_stream_si128(d + 3, e);
+        dst += STREAM_LINE;
+        src += STREAM_LINE;
+        len -= STREAM_LINE;
+    }
+    memcpy(dst, src, len);
+}
+
+static inline void StreamFence()
+{
+    _mm_sfence();
+}
+#else
+static void StreamCopy(char *dst, const char *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+
+static inline void StreamFence()
+{
+}
+#endif
+
+static inline void Copy(char *dst, const char *src, size_t len, bool stream)
+{
+    if (stream) {
+        StreamCopy(dst, src, len);
+    } else {
+        memcpy(dst, src, len);
+    }
+}
+
+static inline bool Streamed(size_t len)
+{
+    return len >= PROXY_SGL_STREAM_BYTES;
+}
+
+size_t SglLength(const SGL_S *sgl, int isRelease)
+{
+    size_t len = 0;
+    for (; sgl != nullptr; sgl = sgl->nextSgl) {
+        for (uint32_t i = 0; i < sgl->entrySumInSgl; i++) {
+            len += SglEntryLen(sgl, i, isRelease);
+        }
+    }
+    return len;
+}
+
+void SglMemcpy(void *dst, const void *src, size_t len, bool stream)
+{
+    Copy(static_cast<char *>(dst), static_cast<const char *>(src), len, stream);
+    if (stream) {
+        StreamFence();
+    }
+}
+
+size_t SglCopyIn(SGL_S *sgl, uint64_t off, const void *src, size_t len, int isRelease)
+{
+    const char *p = static_cast<const char *>(src);
+    bool stream = Streamed(len);
+    size_t done = SglForEach(sgl, off, len, isRelease, [&p, stream](char *buf, size_t n) {
+        Copy(buf, p, n, stream);
+        p += n;
+    });
+    if (stream) {
+        StreamFence();
+    }
+    return done;
+}
+
+/* the data goes to the caller's buffer, which it is about to use, so never streamed */
+size_t SglCopyOut(const SGL_S *sgl, uint64_t off, void *dst, size_t len, int isRelease)
+{
+    char *p = static_cast<char *>(dst);
+    return SglForEach(sgl, off, len, isRelease, [&p](char *buf, size_t n) {
+        memcpy(p, buf, n);
+        p += n;
+    });
+}
+
+size_t SglZero(SGL_S *sgl, uint64_t off, size_t len, int isRelease)
+{
+    return SglForEach(sgl, off, len, isRelease, [](char *buf, size_t n) {
+        memset(buf, 0, n);
+    });
+}
+
+size_t SglCopyFromBufferlist(SGL_S *sgl, uint64_t off, const ceph::bufferlist &bl, int isRelease, uint32_t *crc)
+{
+    SglIter it(sgl, isRelease);
+    if (!it.Seek(off)) {
+        return 0;
+    }
+    bool stream = Streamed(bl.length());
+    size_t done = 0;
+    for (auto &p : bl.buffers()) {
+        const char *src = p.c_str();
+        size_t left = p.length();
+        /* summed as it is read for the copy, the copy then finds it in cache */
+        if (crc != nullptr) {
+            *crc = ProxyCrc32c(*crc, src, left);
+        }
+        while (left > 0 && !it.End()) {
+            size_t n = std::min(it.Left(), left);
+            Copy(it.Ptr(), src, n, stream);
+            it.Next(n);
+            src += n;
+            left -= n;
+            done += n;
+        }
+        if (it.End()) {
+            break;
+        }
+    }
+    if (stream) {
+        StreamFence();
+    }
+    return done;
+}
+
+/* the messenger reads the buffer as soon as the op is sent, so it is not streamed either */
+size_t SglAppendToBufferlist(ceph::bufferlist &bl, const SGL_S *sgl, size_t len, const AlignBuffer *align,
+    int isRelease)
+{
+    size_t prevLen = 0;
+    size_t backLen = 0;
+    if (align != nullptr && align->prevAlignBuffer != nullptr) {
+        prevLen = align->prevAlignLen;
+    }
+    if (align != nullptr && align->backAlignBuffer != nullptr) {
+        backLen = align->backAlignLen;
+    }
+    if (prevLen + len + backLen == 0) {
+        return 0;
+    }
+
+    ceph::bufferptr bp(prevLen + len + backLen);
+    char *p = bp.c_str();
+    if (prevLen != 0) {
+        memcpy(p, align->prevAlignBuffer, prevLen);
+        p += prevLen;
+    }
+    size_t done = SglForEach(sgl, 0, len, isRelease, [&p](char *buf, size_t n) {
+        memcpy(p, buf, n);
+        p += n;
+    });
+    if (backLen != 0) {
+        memcpy(p, align->backAlignBuffer, backLen);
+    }
+    bp.set_length(prevLen + done + backLen);
+    bl.append(std::move(bp));
+    return done;
+}
+
+size_t SglToIovec(const SGL_S *sgl, uint64_t off, size_t len, int isRelease, std::vector<struct iovec> &iov)
+{
+    return SglForEach(sgl, off, len, isRelease, [&iov](char *buf, size_t n) {
+        iov.push_back({ buf, n });
+    });
+}
+
+size_t SglCopyFromIovec(SGL_S *sgl, uint64_t off, const struct iovec *iov, int iovcnt, int isRelease)
+{
+    SglIter it(sgl, isRelease);
+    if (!it.Seek(off)) {
+        return 0;
+    }
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    bool stream = Streamed(total);
+    size_t done = 0;
+    for (int i = 0; i < iovcnt && !it.End(); i++) {
+        const char *src = static_cast<const char *>(iov[i].iov_base);
+        size_t left = iov[i].iov_len;
+        while (left > 0 && !it.End()) {
+            size_t n = std::min(it.Left(), left);
+            Copy(it.Ptr(), src, n, stream);
+            it.Next(n);
+            src += n;
+            left -= n;
+            done += n;
+        }
+    }
+    if (stream) {
+        StreamFence();
+    }
+    return done;
+}
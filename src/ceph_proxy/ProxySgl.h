@@ -0,0 +1,140 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_SGL_H_
+#define _CEPH_PROXY_SGL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "CephProxyInterface.h"
+#include "rados/librados.hpp"
+
+/*
+ * Byte ranges of a chain of SGL_S, the chain ends at a null nextSgl. Entries
+ * of an isRelease chain hold one 4K page each whatever their len says, as
+ * the SGL ops have always taken them; otherwise an entry holds len bytes.
+ */
+
+#define PROXY_SGL_PAGE 4096
+/* a transfer into an SGL from this size on is copied with non-temporal stores, see SglMemcpy */
+#define PROXY_SGL_STREAM_BYTES (256 * 1024)
+
+static inline size_t SglEntryLen(const SGL_S *sgl, uint32_t entry, int isRelease)
+{
+    return isRelease ? PROXY_SGL_PAGE : sgl->entrys[entry].len;
+}
+
+/* a position in the chain, never left on a used up or empty entry */
+class SglIter {
+private:
+    const SGL_S *sgl;
+    uint32_t entry;
+    size_t off;
+    int isRelease;
+
+    void Settle()
+    {
+        while (sgl != nullptr && (entry >= sgl->entrySumInSgl || off >= SglEntryLen(sgl, entry, isRelease))) {
+            if (entry < sgl->entrySumInSgl) {
+                entry++;
+            } else {
+                sgl = sgl->nextSgl;
+                entry = 0;
+            }
+            off = 0;
+        }
+    }
+
+public:
+    SglIter(const SGL_S *_sgl, int _isRelease) : sgl(_sgl), entry(0), off(0), isRelease(_isRelease)
+    {
+        Settle();
+    }
+
+    bool End() const
+    {
+        return sgl == nullptr;
+    }
+
+    char *Ptr() const
+    {
+        return sgl->entrys[entry].buf + off;
+    }
+
+    /* bytes left in the current entry */
+    size_t Left() const
+    {
+        return SglEntryLen(sgl, entry, isRelease) - off;
+    }
+
+    /* n is at most Left() */
+    void Next(size_t n)
+    {
+        off += n;
+        Settle();
+    }
+
+    /* false when the chain ends within the n bytes */
+    bool Seek(uint64_t n)
+    {
+        while (n > 0 && sgl != nullptr) {
+            size_t step = std::min<uint64_t>(Left(), n);
+            Next(step);
+            n -= step;
+        }
+        return n == 0;
+    }
+};
+
+/* fn(char *buf, size_t len) on each piece of [off, off + len) in order, return the bytes the chain had */
+template <typename Fn>
+size_t SglForEach(const SGL_S *sgl, uint64_t off, size_t len, int isRelease, Fn &&fn)
+{
+    SglIter it(sgl, isRelease);
+    if (!it.Seek(off)) {
+        return 0;
+    }
+    size_t done = 0;
+    while (done < len && !it.End()) {
+        size_t n = std::min(it.Left(), len - done);
+        fn(it.Ptr(), n);
+        it.Next(n);
+        done += n;
+    }
+    return done;
+}
+
+size_t SglLength(const SGL_S *sgl, int isRelease);
+
+/*
+ * With stream set the stores bypass the cache, for data nobody reads soon
+ * that would only push out what others need, as the pages of a read that
+ * go back to the cache layer. x86 only, elsewhere a memcpy.
+ */
+void SglMemcpy(void *dst, const void *src, size_t len, bool stream);
+
+/* the copies stop where the chain ends and return the bytes copied */
+size_t SglCopyIn(SGL_S *sgl, uint64_t off, const void *src, size_t len, int isRelease);
+size_t SglCopyOut(const SGL_S *sgl, uint64_t off, void *dst, size_t len, int isRelease);
+size_t SglZero(SGL_S *sgl, uint64_t off, size_t len, int isRelease);
+
+/* bl into the chain from off, crc when not null is summed over the data on the way */
+size_t SglCopyFromBufferlist(SGL_S *sgl, uint64_t off, const ceph::bufferlist &bl, int isRelease,
+    uint32_t *crc = nullptr);
+/* len bytes of the chain, inside the align buffers when given, appended to bl as one buffer */
+size_t SglAppendToBufferlist(ceph::bufferlist &bl, const SGL_S *sgl, size_t len, const AlignBuffer *align,
+    int isRelease);
+
+/* the pieces of [off, off + len) appended to iov, no data is copied */
+size_t SglToIovec(const SGL_S *sgl, uint64_t off, size_t len, int isRelease, std::vector<struct iovec> &iov);
+size_t SglCopyFromIovec(SGL_S *sgl, uint64_t off, const struct iovec *iov, int iovcnt, int isRelease);
+
+#endif
@@ -524,6 +524,22 @@ int PoolUsageStat::UpdatePoolUsage(void)
     return 0;
 }
 
+int32_t PoolUsageStat::UpdatePoolDirectory(void)
+{
+    int32_t ret = proxy->poolDir.Refresh(true);
+    if (ret != 0) {
+        ProxyDbgLogErr("refresh pool directory failed: %d", ret);
+        return ret;
+    }
+
+    return 0;
+}
+
+int32_t PoolUsageStat::UpdateMinAllocSize(void)
+{
+    return proxy->minAlloc.CheckEpoch();
+}
+
 int PoolUsageStat::RegisterPoolNewNotifyFn(NotifyPoolEventFn fn)
 {
     if (ccm_adaptor == NULL) {
@@ -557,11 +573,21 @@ static void PoolUsageTimer(PoolUsageStat *poolUsageManager)
 	    break;
 	}
 
-	int32_t ret = poolUsageManager->UpdatePoolUsage();
+	int32_t ret = poolUsageManager->UpdatePoolDirectory();
+        if (ret != 0) {
+            ProxyDbgLogErr("update pool directory failed.");
+	}
+
+	ret = poolUsageManager->UpdatePoolUsage();
         if (ret != 0) {
             ProxyDbgLogErr("update pool usage failed.");
 	}
 
+	ret = poolUsageManager->UpdateMinAllocSize();
+        if (ret != 0) {
+            ProxyDbgLogErr("update min alloc size failed.");
+	}
+
 	sleep(poolUsageManager->GetTimeInterval());
     }
 }
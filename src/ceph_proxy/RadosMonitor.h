@@ -86,6 +86,8 @@ public:
 	uint32_t GetDefaultECStripeUnit();
 	int32_t UpdatePoolUsage(void);
 	int32_t UpdatePoolList(void);
+	int32_t UpdatePoolDirectory(void);
+	int32_t UpdateMinAllocSize(void);
 	int32_t RegisterPoolNewNotifyFn(NotifyPoolEventFn fn);
 
 	uint32_t GetTimeInterval();
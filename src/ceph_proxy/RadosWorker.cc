@@ -8,11 +8,13 @@
 #include "CephProxyOp.h"
 #include "RadosWrapper.h"
 #include "CephProxyFtds.h"
+#include "ProxyObjectPool.h"
 
 #include <pthread.h>
 #include <string>
 #include <vector>
 #include <utility>
+#include <algorithm>
 
 #ifdef HAVE_SCHED
 #include <sched.h>
@@ -23,6 +25,8 @@
 #endif
 
 #define IO_WORKER_QUEUE_MAX_COUNT 65535
+// a queue this deep is submitted at once, no write merge window is waited for
+#define WRITE_MERGE_WAIT_MAX_OPS 64
 
 pid_t proxy_gettid(void)
 {
@@ -50,6 +54,167 @@ int _set_affnitify(int id)
     return 0;
 }
 
+struct MergedWrite {
+    RadosObjectWriteOp *op = nullptr;
+    Completion *comp = nullptr;
+    std::vector<std::pair<userCallback_t, void *>> callbacks;
+
+    void Reset() {
+	op = nullptr;
+	comp = nullptr;
+	callbacks.clear();
+    }
+};
+
+/* each merged op completes with the result of the write that carried it, in submission order */
+static void MergedWriteDone(int ret, void *arg)
+{
+    MergedWrite *m = static_cast<MergedWrite *>(arg);
+    for (auto &cb : m->callbacks) {
+	cb.first(ret, cb.second);
+    }
+    ProxyObjectPool<RadosObjectWriteOp>::Put(m->op);
+    ProxyObjectPool<Completion>::Put(m->comp);
+    ProxyObjectPool<MergedWrite>::Put(m);
+}
+
+static RadosObjectWriteOp *MergeCandidate(ceph_proxy_op_t op)
+{
+    RadosObjectOperation *operation = reinterpret_cast<RadosObjectOperation *>(op);
+    if (operation->opType != BATCH_WRITE_OP) {
+	return nullptr;
+    }
+    RadosObjectWriteOp *writeOp = static_cast<RadosObjectWriteOp *>(operation);
+    if (!writeOp->mergeable || writeOp->op.size() != 1 || writeOp->bl.length() == 0) {
+	return nullptr;
+    }
+    return writeOp;
+}
+
+/* lays bl at off over the group's data, the later write wins where they overlap */
+static void Overlay(uint64_t &start, uint64_t &end, bufferlist &data, uint64_t off, const bufferlist &bl)
+{
+    uint64_t blEnd = off + bl.length();
+    bufferlist out;
+    if (off > start) {
+	bufferlist head;
+	head.substr_of(data, 0, off - start);
+	out.claim_append(head);
+    }
+    out.append(bl);
+    if (end > blEnd) {
+	bufferlist tail;
+	tail.substr_of(data, blEnd - start, end - blEnd);
+	out.claim_append(tail);
+    }
+    data.swap(out);
+    start = std::min(start, off);
+    end = std::max(end, blEnd);
+}
+
+/*
+ * Folds runs of plain writes to one object whose ranges touch or overlap
+ * into a single write, sent where the first of them was queued. Any other op
+ * on the object ends the run, so it still sees the writes before it and none
+ * after it.
+ */
+void RadosIOWorker::MergeWrites(std::vector<RequestCtx> &ls)
+{
+    bool merged = false;
+    groups.clear();
+    openGroups.clear();
+    groupOf.assign(ls.size(), -1);
+    for (size_t i = 0; i < ls.size(); i++) {
+	RadosObjectOperation *operation = reinterpret_cast<RadosObjectOperation *>(ls[i].op);
+	std::string_view oid(operation->objectId);
+	auto it = openGroups.find(oid);
+	RadosObjectWriteOp *writeOp = MergeCandidate(ls[i].op);
+	if (writeOp == nullptr) {
+	    if (it != openGroups.end()) {
+		openGroups.erase(it);
+	    }
+	    continue;
+	}
+
+	uint64_t off = writeOp->writeOff;
+	uint64_t end = off + writeOp->bl.length();
+	if (it != openGroups.end()) {
+	    WriteGroup &g = groups[it->second];
+	    if (g.poolId == operation->poolId && off <= g.end && end >= g.start &&
+		std::max(g.end, end) - std::min(g.start, off) <= mergePolicy.maxBytes) {
+		Overlay(g.start, g.end, g.bl, off, writeOp->bl);
+		g.members++;
+		groupOf[i] = it->second;
+		merged = true;
+		continue;
+	    }
+	}
+	groups.push_back({ i, operation->poolId, off, end, 1, writeOp->bl, nullptr });
+	groupOf[i] = groups.size() - 1;
+	openGroups[oid] = groups.size() - 1;
+    }
+    if (!merged) {
+	return;
+    }
+
+    mergedOps.clear();
+    for (size_t i = 0; i < ls.size(); i++) {
+	if (groupOf[i] < 0 || groups[groupOf[i]].members == 1) {
+	    mergedOps.push_back(ls[i]);
+	    continue;
+	}
+	WriteGroup &g = groups[groupOf[i]];
+	Completion *c = static_cast<Completion *>(ls[i].comp);
+	if (g.first != i) {
+	    static_cast<MergedWrite *>(g.merged)->callbacks.emplace_back(c->fn, c->cbArg);
+	    continue;
+	}
+
+	MergedWrite *m = ProxyObjectPool<MergedWrite>::Get();
+	RadosObjectWriteOp *op = ProxyObjectPool<RadosObjectWriteOp>::Get();
+	Completion *mc = ProxyObjectPool<Completion>::Get();
+	if (m == nullptr || op == nullptr || mc == nullptr) {
+	    // the writes go out one by one, in their own places
+	    ProxyDbgLogWarnLimit1("Allocate merged write failed, %u writes are sent alone.", g.members);
+	    ProxyObjectPool<MergedWrite>::Put(m);
+	    ProxyObjectPool<RadosObjectWriteOp>::Put(op);
+	    ProxyObjectPool<Completion>::Put(mc);
+	    g.members = 1;
+	    mergedOps.push_back(ls[i]);
+	    continue;
+	}
+	RadosObjectOperation *operation = reinterpret_cast<RadosObjectOperation *>(ls[i].op);
+	op->Init(g.poolId, operation->objectId.c_str());
+	op->bl.claim(g.bl);
+	op->op.write(g.start, op->bl);
+	mc->fn = MergedWriteDone;
+	mc->cbArg = m;
+	m->op = op;
+	m->comp = mc;
+	m->callbacks.emplace_back(c->fn, c->cbArg);
+	g.merged = m;
+	mergedOps.push_back(RequestCtx(nullptr, op, mc));
+    }
+    ls.swap(mergedOps);
+}
+
+/* called with ioworkerLock held before op is queued, wakes the handler once the neighbour it waits for is there */
+void RadosIOWorker::EndMergeWait(ceph_proxy_op_t op)
+{
+    if (!mergeWaiting || Ops.empty()) {
+	return;
+    }
+    RadosObjectWriteOp *tail = MergeCandidate(Ops.back().op);
+    RadosObjectWriteOp *w = MergeCandidate(op);
+    bool adjacent = tail != nullptr && w != nullptr && tail->poolId == w->poolId &&
+	tail->objectId == w->objectId && w->writeOff <= tail->writeOff + tail->bl.length() &&
+	w->writeOff + w->bl.length() >= tail->writeOff;
+    if (adjacent || Ops.size() + 1 >= WRITE_MERGE_WAIT_MAX_OPS) {
+	mergeReady = true;
+	ioworkerCond.notify_all();
+    }
+}
+
 int32_t RadosIOWorker::Queue(ceph_proxy_op_t op, completion_t c)
 {
     std::unique_lock ul(ioworkerLock);
@@ -68,28 +233,79 @@ int32_t RadosIOWorker::Queue(ceph_proxy_op_t op, completion_t c)
     if (Ops.empty()) {
 	ioworkerCond.notify_all();
     }
+    EndMergeWait(op);
 
     Ops.push_back(reqCtx);
     return 0;
 }
 
+/* one lock and one wakeup for the whole run, ops past the returned count were not queued */
+int32_t RadosIOWorker::QueueBatch(ceph_proxy_op_t *ops, completion_t *comps, uint32_t num)
+{
+    std::unique_lock ul(ioworkerLock);
+
+    uint32_t room = 0;
+    if (Ops.size() <= IO_WORKER_QUEUE_MAX_COUNT) {
+	room = IO_WORKER_QUEUE_MAX_COUNT + 1 - Ops.size();
+    }
+    uint32_t n = std::min(num, room);
+    if (n < num) {
+	RadosObjectOperation *operation = reinterpret_cast<RadosObjectOperation *>(ops[n]);
+	ProxyDbgLogErr("Too many requests are stacked in the IOWorker Queue, ops.size = %d, poolId: %d.",
+			Ops.size(), operation->poolId);
+    }
+    if (n == 0) {
+	return 0;
+    }
+
+    if (Ops.empty()) {
+	ioworkerCond.notify_all();
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+	EndMergeWait(ops[i]);
+	Ops.push_back(RequestCtx(nullptr, ops[i], comps[i]));
+    }
+    return n;
+}
+
 void* RadosIOWorker::OpHandler() {
     std::unique_lock ul(ioworkerLock);
+    // swapped with Ops every round, both keep their capacity
+    std::vector<RequestCtx> ls;
 
     while(!ioworkerStop) {
 	while(!Ops.empty()) {
 		uint64_t ts = 0;
 	    int32_t ret = 0;
 		PROXY_FTDS_START_HIGH(PROXY_FTDS_OPS_WAITQ, ts);
-	    std::vector<RequestCtx> ls;
+	    // a write at the tail may be followed by its neighbours, give them a moment to arrive
+	    if (mergePolicy.enable && mergePolicy.windowUs != 0 && Ops.size() < WRITE_MERGE_WAIT_MAX_OPS &&
+		MergeCandidate(Ops.back().op) != nullptr) {
+		mergeWaiting = true;
+		mergeReady = false;
+		ioworkerCond.wait_for(ul, std::chrono::microseconds(mergePolicy.windowUs),
+		    [this] { return mergeReady || ioworkerStop; });
+		mergeWaiting = false;
+	    }
 	    ls.swap(Ops);
 	    ioworkerRunning = true;
     	    ul.unlock();
 
-	    for (auto opair : ls) {
+	    if (mergePolicy.enable) {
+		MergeWrites(ls);
+	    }
+
+	    // resolved once per pool for the round, not per op
+	    int64_t poolId = INVALID_POOL_ID;
+	    rados_ioctx_t ioctx = NULL;
+	    for (auto &opair : ls) {
   		Completion *c = static_cast<Completion *>(opair.comp);
     		RadosObjectOperation *operation = reinterpret_cast<RadosObjectOperation *>(opair.op);
-		rados_ioctx_t ioctx = proxy->GetIoCtx2(operation->poolId);
+		if (operation->poolId != poolId || ioctx == NULL) {
+		    poolId = operation->poolId;
+		    ioctx = proxy->GetIoCtx2(poolId);
+		}
 		if (ioctx == NULL) {
 		    ProxyDbgLogWarnLimit1("Get IOCtx(%u) Failed.", operation->poolId);
 		    c->fn(-ENOENT, c->cbArg);
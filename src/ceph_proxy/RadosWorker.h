@@ -11,6 +11,7 @@
 #include "CephProxy.h"
 #include "CephProxyLog.h"
 #include "CephProxyOp.h"
+#include "ConfigRead.h"
 
 #include <unistd.h>
 #include <pthread.h>
@@ -21,6 +22,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <string_view>
 #include <mutex>
 #include <shared_mutex>
 #include <condition_variable>
@@ -186,7 +189,36 @@ public:
     }
 };
 
+/* proxy.write_merge, off unless set */
+struct WriteMergePolicy {
+    bool enable { false };
+    uint32_t windowUs { 0 };
+    uint64_t maxBytes { 0 };
+};
+
 class RadosIOWorker {
+    /* plain writes of one object whose ranges touch, sent as the write at index first */
+    struct WriteGroup {
+	size_t first;
+	int64_t poolId;
+	uint64_t start;
+	uint64_t end;
+	uint32_t members;
+	bufferlist bl;
+	void *merged;
+    };
+
+    WriteMergePolicy mergePolicy;
+    std::vector<WriteGroup> groups;
+    std::vector<int32_t> groupOf;
+    std::unordered_map<std::string_view, size_t> openGroups;
+    std::vector<RequestCtx> mergedOps;
+    // the handler sits in the merge window, mergeReady ends it before the timeout
+    bool mergeWaiting { false };
+    bool mergeReady { false };
+
+    void MergeWrites(std::vector<RequestCtx> &ls);
+    void EndMergeWait(ceph_proxy_op_t op);
 public:
     std::mutex ioworkerLock;
     std::condition_variable ioworkerCond;
@@ -221,6 +253,9 @@ public:
 	ioworkerStop(false),ioworkerRunning(false),
 	ioworkerEmptyWait(false), proxy(_proxy),
 	workerName("ioworker"), ioThread(this){
+	mergePolicy.enable = ProxyGetWriteMerge() != 0;
+	mergePolicy.windowUs = ProxyGetWriteMergeWindowUs();
+	mergePolicy.maxBytes = ProxyGetWriteMergeMaxBytes();
     }
 
     ~RadosIOWorker() {
@@ -253,6 +288,7 @@ public:
     }
 
     int32_t Queue(ceph_proxy_op_t op, completion_t c);
+    int32_t QueueBatch(ceph_proxy_op_t *ops, completion_t *comps, uint32_t num);
     void *OpHandler();
 };
 
@@ -333,6 +369,47 @@ public:
 
 		return radosIOWorker->Queue(op, c);
     }
+
+    /*
+     * Queues runs of ops for the same pool with one lock each and returns
+     * how many were queued, in order; it stops at the first op that fails.
+     */
+    int32_t QueueBatch(ceph_proxy_op_t *ops, completion_t *comps, uint32_t num) {
+		uint32_t queued = 0;
+		while (queued < num) {
+			RadosObjectOperation *operation = reinterpret_cast<RadosObjectOperation *>(ops[queued]);
+			if (operation == nullptr || comps[queued] == nullptr) {
+				ProxyDbgLogErr("operation %p or c %p is invalid", operation, comps[queued]);
+				break;
+			}
+			if (operation->poolId < 0) {
+				ProxyDbgLogErr("invalid poolId: %ld", operation->poolId);
+				break;
+			}
+
+			uint32_t end = queued + 1;
+			while (end < num && ops[end] != nullptr && comps[end] != nullptr &&
+				reinterpret_cast<RadosObjectOperation *>(ops[end])->poolId == operation->poolId) {
+				end++;
+			}
+
+			RadosIOWorker *radosIOWorker = GetIOWorker(operation->poolId);
+			if (radosIOWorker == nullptr) {
+				radosIOWorker = CreateIOWorker(operation->poolId);
+				if (radosIOWorker == nullptr) {
+					ProxyDbgLogErr("CreateIOWorker Failed.");
+					break;
+				}
+			}
+
+			int32_t n = radosIOWorker->QueueBatch(ops + queued, comps + queued, end - queued);
+			queued += n;
+			if (queued < end) {
+				break;
+			}
+		}
+		return queued;
+    }
 };
 
 #endif
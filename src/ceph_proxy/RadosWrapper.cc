@@ -12,6 +12,10 @@
 #include "CephProxyLog.h"
 #include "ConfigRead.h"
 #include "CephProxy.h"
+#include "ProxyObjectPool.h"
+#include "ProxyCrc32c.h"
+#include "ProxySgl.h"
+#include "DataIntegrity.h"
 
 #include <unistd.h>
 #include <stdio.h>
@@ -32,7 +36,6 @@
 using namespace std;
 using namespace librados;
 
-#define DEFAULT_SGL_PAGE 4096
 #define RADOS_CONNECT_RETRY 5
 #define CONNECT_WAIT_TIME 5
 #define PATH_MAX_LEN		128
@@ -315,6 +318,53 @@ int RadosGetPoolName(rados_ioctx_t ctx, char *buf, unsigned maxLen)
 	return 0;
 }
 
+int RadosPoolList(rados_client_t client, std::vector<std::pair<int64_t, std::string>> &pools)
+{
+	librados::Rados *rados = reinterpret_cast<librados::Rados *>(client);
+	std::list<std::pair<int64_t, std::string>> ls;
+	int ret = rados->pool_list2(ls);
+	if (ret < 0) {
+		ProxyDbgLogErr("list pools failed: %d", ret);
+		return ret;
+	}
+
+	pools.assign(ls.begin(), ls.end());
+	return 0;
+}
+
+int RadosWaitForLatestOsdmap(rados_client_t client)
+{
+	librados::Rados *rados = reinterpret_cast<librados::Rados *>(client);
+	int ret = rados->wait_for_latest_osdmap();
+	if (ret < 0) {
+		ProxyDbgLogErr("wait for latest osdmap failed: %d", ret);
+	}
+	return ret;
+}
+
+/* answered from the client's osdmap, no round trip */
+int RadosPoolReverseLookup(rados_client_t client, int64_t poolId, std::string &name)
+{
+	librados::Rados *rados = reinterpret_cast<librados::Rados *>(client);
+	return rados->pool_reverse_lookup(poolId, &name);
+}
+
+int RadosMonCommand(rados_client_t client, const std::string &cmd, std::string &out)
+{
+	librados::Rados *rados = reinterpret_cast<librados::Rados *>(client);
+	bufferlist inbl;
+	bufferlist outbl;
+	std::string outs;
+	int ret = rados->mon_command(cmd, inbl, &outbl, &outs);
+	if (ret < 0) {
+		ProxyDbgLogErr("mon command %s failed: %d, %s", cmd.c_str(), ret, outs.c_str());
+		return ret;
+	}
+
+	out = outbl.to_str();
+	return 0;
+}
+
 void RadosClientShutdown(rados_client_t client)
 {
 	if(client != nullptr) {
@@ -389,6 +439,26 @@ int RadosGetClusterStat(rados_client_t client, CephClusterStat *stat)
 	return 0;
 }
 
+static void PoolStatToCephPoolStat(const pool_stat_t &stats, CephPoolStat *stat)
+{
+	stat->numKb = stats.num_kb;
+	stat->numBytes = stats.num_bytes;
+	stat->numObjects = stats.num_objects;
+	stat->numObjectClones = stats.num_object_clones;
+	stat->numObjectCopies = stats.num_object_copies;
+	stat->numObjectsMissingOnPrimary = stats.num_objects_missing_on_primary;
+	stat->numObjectsUnfound = stats.num_objects_unfound;
+	stat->numObjectsDegraded = stats.num_objects_degraded;
+	stat->numRd = stats.num_rd;
+	stat->numRdKb = stats.num_rd_kb;
+	stat->numWr = stats.num_wr;
+	stat->numWrKb = stats.num_wr_kb;
+	stat->numUserBytes = stats.num_user_bytes;
+	stat->compressedBytesOrig = stats.compressed_bytes_orig;
+	stat->compressedBytes = stats.compressed_bytes;
+	stat->compressedBytesAlloc = stats.compressed_bytes_alloc;
+}
+
 int RadosGetPoolStat(rados_client_t client, rados_ioctx_t ctx, CephPoolStat *stat)
 {
 	uint64_t ts = 0;
@@ -413,24 +483,7 @@ int RadosGetPoolStat(rados_client_t client, rados_ioctx_t ctx, CephPoolStat *sta
 		return ret;
 	}
 
-	pool_stat_t &stats = rawresult[pool_name];
-		
-	stat->numKb = stats.num_kb;
-	stat->numBytes = stats.num_bytes;
-	stat->numObjects = stats.num_objects;
-	stat->numObjectClones = stats.num_object_clones;
-	stat->numObjectCopies = stats.num_object_copies;
-	stat->numObjectsMissingOnPrimary = stats.num_objects_missing_on_primary;
-	stat->numObjectsUnfound = stats.num_objects_unfound;
-	stat->numObjectsDegraded = stats.num_objects_degraded;
-	stat->numRd = stats.num_rd;
-	stat->numRdKb = stats.num_rd_kb;
-	stat->numWr = stats.num_wr;
-	stat->numWrKb = stats.num_wr_kb;
-	stat->numUserBytes = stats.num_user_bytes;
-	stat->compressedBytesOrig = stats.compressed_bytes_orig;
-	stat->compressedBytes = stats.compressed_bytes;
-	stat->compressedBytesAlloc = stats.compressed_bytes_alloc;
+	PoolStatToCephPoolStat(rawresult[pool_name], stat);
 
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_GETPOOL_STAT, ts, ret);
 	return 0;
@@ -471,6 +524,42 @@ int RadosGetPoolsStat(rados_client_t client, CephPoolStat *stat, uint64_t *poolI
 	return 0;
 }
 
+/* one get_pool_stats for the given pools, a pool deleted meanwhile is left out of stats */
+int RadosGetAllPoolsStat(rados_client_t client, const std::vector<std::pair<int64_t, std::string>> &pools,
+			std::map<int64_t, CephPoolStat> &stats)
+{
+	uint64_t ts = 0;
+	PROXY_FTDS_START_HIGH(PROXY_FTDS_OPS_GETPOOL_STAT, ts);
+	librados::Rados *rados = reinterpret_cast<librados::Rados *>(client);
+	std::list<std::string> ls;
+	for (auto &pool : pools) {
+		ls.push_back(pool.second);
+	}
+
+	stats.clear();
+	if (ls.empty()) {
+		PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_GETPOOL_STAT, ts, 0);
+		return 0;
+	}
+
+	std::map<std::string, pool_stat_t> rawresult;
+	int ret = rados->get_pool_stats(ls, rawresult);
+	if (ret != 0) {
+		ProxyDbgLogErr("get pool stat failed: %d", ret);
+		PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_GETPOOL_STAT, ts, ret);
+		return ret;
+	}
+
+	for (auto &pool : pools) {
+		auto iter = rawresult.find(pool.second);
+		if (iter != rawresult.end()) {
+			PoolStatToCephPoolStat(iter->second, &stats[pool.first]);
+		}
+	}
+	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_GETPOOL_STAT, ts, ret);
+	return 0;
+}
+
 /* WriteOp */
 rados_op_t RadosWriteOpInit(const string& pool, const string &oid)
 {
@@ -487,15 +576,16 @@ rados_op_t RadosWriteOpInit(const string& pool, const string &oid)
 	return op;
 }	
 
-rados_op_t RadosWriteOpInit2(const int64_t poolId, const string &oid)
+rados_op_t RadosWriteOpInit2(const int64_t poolId, const char *oid)
 {
 	uint64_t ts = 0;
 	PROXY_FTDS_START_HIGH(PROXY_FTDS_OPS_WRITEOP_INIT, ts);
-	RadosObjectOperation *writeOp = new(std::nothrow) RadosObjectWriteOp(poolId,oid);	
+	RadosObjectWriteOp *writeOp = ProxyObjectPool<RadosObjectWriteOp>::Get();
 	if (writeOp == nullptr) {
 		ProxyDbgLogErr("Allocate WriteOp Failed.");
 		return nullptr;
 	}
+	writeOp->Init(poolId, oid);
 	rados_op_t op = reinterpret_cast<void *>(writeOp);
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_WRITEOP_INIT, ts, 0);
 	return op;
@@ -505,7 +595,7 @@ void RadosWriteOpRelease(rados_op_t op)
 {
 	if (op != nullptr) {
 		RadosObjectWriteOp *writeOp = reinterpret_cast<RadosObjectWriteOp *>(op);
-		delete writeOp;
+		ProxyObjectPool<RadosObjectWriteOp>::Put(writeOp);
 		op = nullptr;
 	}
 }
@@ -518,6 +608,7 @@ void RadosWriteOpSetFlags(rados_op_t op, int flags)
 		return;
 	}
 	writeOp->op.set_op_flags2(flags);
+	writeOp->mergeable = false;
 }
 
 void RadosWriteOpAssertExists(rados_op_t op)
@@ -593,6 +684,8 @@ void RadosWriteOpWrite(rados_op_t op, const char *buffer, size_t len, uint64_t o
 		return;
 	}
 	writeOp->bl.append(buffer, len);	
+	writeOp->mergeable = writeOp->op.size() == 0;
+	writeOp->writeOff = off;
 	writeOp->op.write(off, writeOp->bl);
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_WRITE, ts, ret);
 }
@@ -608,40 +701,10 @@ void RadosWriteOpWriteSGL(rados_op_t op, SGL_S *sgl, size_t len1, uint64_t off,
 		PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_WRITESGL, ts, ret);
 		return;
 	}
-	uint32_t leftLen = len1;
-	uint32_t curSrcEntryIndex = 0;
-
-	//
-	if (alignBuffer != NULL &&
-		alignBuffer->prevAlignBuffer != NULL &&
-		alignBuffer->prevAlignLen != 0) {
-		writeOp->bl.append(alignBuffer->prevAlignBuffer, alignBuffer->prevAlignLen);
-	}
-
-	//
-	while(leftLen > 0){
-		size_t size = 0;
-		if (isRelease) {
-			size = std::min((uint32_t)DEFAULT_SGL_PAGE, leftLen);
-		} else {
-			size = std::min(sgl->entrys[curSrcEntryIndex].len, leftLen);
-		}
-		writeOp->bl.append(sgl->entrys[curSrcEntryIndex].buf, size);
-		leftLen -= size;
-		curSrcEntryIndex++;
-		if (curSrcEntryIndex >= sgl->entrySumInSgl) {
-			curSrcEntryIndex = 0;
-			sgl = sgl->nextSgl;
-		}
-	}
-
-	//
-	if (alignBuffer != NULL &&
-		alignBuffer->backAlignBuffer != NULL &&
-		alignBuffer->backAlignLen != 0) {
-		writeOp->bl.append(alignBuffer->backAlignBuffer, alignBuffer->backAlignLen);
-	}
+	SglAppendToBufferlist(writeOp->bl, sgl, len1, alignBuffer, isRelease);
 
+	writeOp->mergeable = writeOp->op.size() == 0;
+	writeOp->writeOff = off;
 	writeOp->op.write(off, writeOp->bl);
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_WRITESGL, ts, ret);
 }	
@@ -657,30 +720,27 @@ void RadosWriteOpWriteFull(rados_op_t op, const char *buffer, size_t len)
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_WRITE, ts, ret);
 }
 
+int RadosWriteOpGetDataCrc(rados_op_t op, uint32_t *crc)
+{
+    RadosObjectWriteOp *writeOp = reinterpret_cast<RadosObjectWriteOp *>(op);
+    if (writeOp->bl.length() == 0) {
+	return -ENODATA;
+    }
+    uint32_t sum = -1;
+    for (auto &p : writeOp->bl.buffers()) {
+	sum = ProxyCrc32c(sum, p.c_str(), p.length());
+    }
+    *crc = sum;
+    return 0;
+}
+
 void RadosWriteOpWriteFullSGL(rados_op_t op, const SGL_S *sgl, size_t len, int isRelease)
 {
 	uint64_t ts = 0;
 	int32_t ret = 0;
 	PROXY_FTDS_START_HIGH(PROXY_FTDS_OPS_OPINIT_WRITESGL, ts);
 	RadosObjectWriteOp *writeOp = reinterpret_cast<RadosObjectWriteOp *>(op);
-	uint32_t leftLen = len;
-	uint32_t curSrcEtnryIndex = 0;
-	while (leftLen > 0) {
-		size_t size =0;
-		if (isRelease) {
-			size = std::min((uint32_t)DEFAULT_SGL_PAGE, leftLen);
-		} else {
-			size = std::min(sgl->entrys[curSrcEtnryIndex].len, leftLen);
-		}
-
-		writeOp->bl.append(sgl->entrys[curSrcEtnryIndex].buf, size);
-		leftLen -= size;
-		curSrcEtnryIndex++;
-		if (curSrcEtnryIndex >= sgl->entrySumInSgl) {
-			curSrcEtnryIndex = 0;
-			sgl = sgl->nextSgl;
-		}
-	}
+	SglAppendToBufferlist(writeOp->bl, sgl, len, nullptr, isRelease);
 
 	writeOp->op.write_full(writeOp->bl);
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_WRITESGL, ts, ret);
@@ -705,23 +765,7 @@ void RadosWriteOpWriteSameSGL(rados_op_t op, const SGL_S *s, size_t dataLen,
 	int32_t ret = 0;
 	PROXY_FTDS_START_HIGH(PROXY_FTDS_OPS_OPINIT_WRITESGL, ts);
 	RadosObjectWriteOp *writeOp = reinterpret_cast<RadosObjectWriteOp *>(op);
-	uint32_t leftLen = dataLen;
-	uint32_t curSrcEntryIndex = 0;
-	while (leftLen > 0) {
-		size_t size =0;
-		if (isRelease) {
-			size = std::min((uint32_t)DEFAULT_SGL_PAGE, leftLen);
-		} else {
-			size = std::min(s->entrys[curSrcEntryIndex].len, leftLen);
-		}
-		writeOp->bl.append(s->entrys[curSrcEntryIndex].buf, size);
-		leftLen -= size;
-		curSrcEntryIndex++;
-		if (curSrcEntryIndex >= s->entrySumInSgl) {
-			curSrcEntryIndex = 0;
-			s = s->nextSgl;		
-		}
-    	}
+	SglAppendToBufferlist(writeOp->bl, s, dataLen, nullptr, isRelease);
 
 	writeOp->op.writesame(off,writeLen,  writeOp->bl);
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_WRITESGL, ts, ret);
@@ -744,24 +788,7 @@ void RadosWriteOpAppendSGL(rados_op_t op, const SGL_S *s, size_t len, int isRele
 	int32_t ret = 0;
 	PROXY_FTDS_START_HIGH(PROXY_FTDS_OPS_OPINIT_APPENDSGL, ts);
 	RadosObjectWriteOp *writeOp = reinterpret_cast<RadosObjectWriteOp *>(op);
-	uint32_t leftLen = len;
-	uint32_t curSrcEntryIndex = 0;
-	while (leftLen > 0) {
-		size_t size =0;
-		if (isRelease) {
-			size = std::min((uint32_t)DEFAULT_SGL_PAGE, leftLen);
-		} else {
-			size = std::min(s->entrys[curSrcEntryIndex].len, leftLen);
-		}
-
-		writeOp->bl.append(s->entrys[curSrcEntryIndex].buf, size);
-		leftLen -= size;
-		curSrcEntryIndex++;
-		if (curSrcEntryIndex >= s->entrySumInSgl) {
-			curSrcEntryIndex = 0;
-			s = s->nextSgl;
-		}	
-	}
+	SglAppendToBufferlist(writeOp->bl, s, len, nullptr, isRelease);
 
 	writeOp->op.append(writeOp->bl);
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_APPENDSGL, ts, ret);
@@ -803,6 +830,16 @@ void RadosWriteOpZero(rados_op_t op, uint64_t off, uint64_t len)
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_ZERO, ts, ret);
 }
 
+void RadosWriteOpExec(rados_op_t op, const char *cls, const char *method,
+		const char *inBuf, size_t inLen, int *prval)
+{
+	RadosObjectWriteOp *writeOp = reinterpret_cast<RadosObjectWriteOp *>(op);
+	bufferlist inbl;
+	inbl.append(inBuf, inLen);
+	// a write op brings no output back, the method's return is all there is
+	writeOp->op.exec(cls, method, inbl, nullptr, prval);
+}
+
 void RadosWriteOpOmapSet(rados_op_t op, const char *const *keys,
 		const char *const *vals, const size_t *lens, size_t num)
 {
@@ -848,13 +885,14 @@ rados_op_t RadosReadOpInit(const string& pool, const string &oid)
 	return op;
 }
 
-rados_op_t RadosReadOpInit2(const int64_t poolId,const string &oid)
+rados_op_t RadosReadOpInit2(const int64_t poolId, const char *oid)
 {
-	RadosObjectReadOp *readOp = new(std::nothrow) RadosObjectReadOp(poolId, oid);
+	RadosObjectReadOp *readOp = ProxyObjectPool<RadosObjectReadOp>::Get();
 	if (readOp == nullptr) {
 		ProxyDbgLogErr("Allocate ReadOp Failed.");
 		return nullptr;
 	}
+	readOp->Init(poolId, oid);
 	rados_op_t op = reinterpret_cast<void *>(readOp);
 	return op;
 }
@@ -863,7 +901,7 @@ void RadosReadOpRelease(rados_op_t op)
 {
 	if (op != nullptr) {
 		RadosObjectReadOp *readOp= reinterpret_cast<RadosObjectReadOp *>(op);
-		delete readOp;
+		ProxyObjectPool<RadosObjectReadOp>::Put(readOp);
 		op = nullptr;
 	}
 }
@@ -929,11 +967,6 @@ void RadosReadOpGetXattrs(rados_op_t op, proxy_xattrs_iter_t *iter, int *prval)
 int RadosGetXattrsNext(proxy_xattrs_iter_t iter, const char **name, const char **val, size_t *len)
 {
 	RadosXattrsIter *it = static_cast<RadosXattrsIter*>(iter);
-	if (it->val) {
-		free(it->val);
-		it->val = nullptr;
-	}
-	
 	if (it->i == it->attrset.end()){
 		*name = nullptr;
 		*val = nullptr;
@@ -945,16 +978,8 @@ int RadosGetXattrsNext(proxy_xattrs_iter_t iter, const char **name, const char *
 	*name = s.c_str();
 	bufferlist &bl(it->i->second);
 	size_t blLen = bl.length();
-	if (!blLen) {
-		*val = (char *)NULL;
-	}else{
-		it->val = (char *)malloc(blLen);
-		if (!it->val) {
-			return -ENOMEM;
-		}
-		memcpy(it->val, bl.c_str(), blLen);
-		*val = it->val;
-	}
+	// c_str() only copies when the value is not contiguous yet
+	*val = blLen ? bl.c_str() : nullptr;
 	*len = blLen;
 	++it->i;
 	return 0;	
@@ -1113,11 +1138,34 @@ void RadosReadOpReadSGL(rados_op_t op, uint64_t offset,size_t len, SGL_S *sgl, i
     readOp->reqCtx.readSgl.sgl = sgl;
     readOp->reqCtx.readSgl.len = len;
     readOp->reqCtx.readSgl.buildType = isRelease;
+    readOp->reqCtx.readSgl.offset = offset;
 
     readOp->op.read(offset, len, &(readOp->results), prval);
+    /*
+     * The OSD sums the range it read in the same op, so the copy into the SGL can be
+     * checked against it. A range past the object's end fails the checksum with
+     * -EINVAL; FAILOK keeps that from failing the read, which is then left unverified.
+     */
+    if (ProxyGetDataCrcCheck() && len > 0) {
+	// the init value and the sums come back as le32, as the hosts the proxy runs on are
+	bufferlist init;
+	uint32_t seed = -1;
+	init.append(reinterpret_cast<const char *>(&seed), sizeof(seed));
+	readOp->op.checksum(LIBRADOS_CHECKSUM_TYPE_CRC32C, init, offset, len, 0,
+		&(readOp->osdCrc), &(readOp->osdCrcRetVal));
+	readOp->op.set_op_flags2(LIBRADOS_OP_FLAG_FAILOK);
+	readOp->reqCtx.readSgl.verify = true;
+    }
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_OPINIT_READSGL, ts, ret);
 }
 
+void RadosReadOpSetExpectedCrc(rados_op_t op, uint32_t crc)
+{
+    RadosObjectReadOp *readOp = reinterpret_cast<RadosObjectReadOp *>(op);
+    readOp->reqCtx.readSgl.hasExpected = true;
+    readOp->reqCtx.readSgl.expectedCrc = crc;
+}
+
 void RadosReadOpCheckSum(rados_op_t op, proxy_checksum_type_t type,
 			const char *initValue, size_t initValueLen,
 			uint64_t offset, size_t len, size_t chunkSize,
@@ -1145,6 +1193,21 @@ void RadosReadOpExec(rados_op_t op, const char *cls, const char *method,
     readOp->op.exec(cls, method, inbl, &(readOp->execOut),prval);
 }
 
+void RadosReadOpExecUserBuf(rados_op_t op, const char *cls, const char *method,
+			const char *inBuf, size_t inLen, char *outBuf,
+			size_t outLen, size_t *usedLen, int *prval)
+{
+    RadosObjectReadOp *readOp = reinterpret_cast<RadosObjectReadOp *>(op);
+    bufferlist inbl;
+    inbl.append(inBuf, inLen);
+
+    readOp->reqCtx.exec.toUserBuf = true;
+    readOp->reqCtx.exec.userBuf = outBuf;
+    readOp->reqCtx.exec.userLen = outLen;
+    readOp->reqCtx.exec.usedLen = usedLen;
+    readOp->op.exec(cls, method, inbl, &(readOp->execOut), prval);
+}
+
 int RadosOperationOperate(rados_op_t op, rados_ioctx_t io)
 {
     RadosObjectOperation *rop = reinterpret_cast<RadosObjectOperation *>(op);
@@ -1169,6 +1232,48 @@ int RadosOperationOperate(rados_op_t op, rados_ioctx_t io)
     return ret;
 }
 
+/*
+ * crc is the sum of the results as copied into the SGL. Against the OSD's sum only
+ * a full read can be checked, a short one ends where the checksum op failed. A
+ * stored crc covers the whole range, so the zero-filled tail is summed in.
+ */
+static int VerifyReadSgl(RadosObjectReadOp *readOp, uint32_t crc)
+{
+    size_t readLen = readOp->results.length();
+    size_t len = readOp->reqCtx.readSgl.len;
+    uint64_t offset = readOp->reqCtx.readSgl.offset;
+    bool verified = false;
+
+    if (readOp->reqCtx.readSgl.verify && readOp->osdCrcRetVal == 0 &&
+        readLen == len && readOp->osdCrc.length() >= 2 * sizeof(uint32_t)) {
+	// a count of one chunk, then its sum
+	uint32_t osdCrc = 0;
+	readOp->osdCrc.copy(sizeof(uint32_t), sizeof(uint32_t), reinterpret_cast<char *>(&osdCrc));
+	if (osdCrc != crc) {
+	    ProxyIntegrityMismatch(readOp->poolId, readOp->objectId.c_str(), offset, len, osdCrc, crc);
+	    return -EIO;
+	}
+	verified = true;
+    }
+
+    if (readOp->reqCtx.readSgl.hasExpected) {
+	crc = ProxyCrc32cZeros(crc, len - readLen);
+	if (crc != readOp->reqCtx.readSgl.expectedCrc) {
+	    ProxyIntegrityMismatch(readOp->poolId, readOp->objectId.c_str(), offset, len,
+		    readOp->reqCtx.readSgl.expectedCrc, crc);
+	    return -EIO;
+	}
+	verified = true;
+    }
+
+    if (verified) {
+	ProxyIntegrityVerified(len);
+    } else {
+	ProxyIntegrityUnverified();
+    }
+    return 0;
+}
+
 void ReadCallback(rados_completion_t c, void *arg)
 {
     RadosObjectReadOp *readOp = (RadosObjectReadOp *)arg;
@@ -1178,50 +1283,26 @@ void ReadCallback(rados_completion_t c, void *arg)
 			// std::cerr << "readOp->results.length = " << readOp->results.length() << std::endl;
 			memcpy(readOp->reqCtx.read.buffer, readOp->results.c_str(), readOp->results.length());
 	    } else if (readOp->reqCtx.readSgl.sgl != nullptr) {
-		    if (readOp->results.length() != readOp->reqCtx.readSgl.len) {
-			    uint16_t current_entry = 0;
-			    SGL_S * sgl = readOp->reqCtx.readSgl.sgl;
-			    while (sgl != NULL) {
-				    while (current_entry < sgl->entrySumInSgl) {
-					    memset((sgl->entrys[current_entry].buf), 0, sgl->entrys[current_entry].len);
-					    current_entry++;
-				    }
-				    sgl = sgl->nextSgl;
-				    current_entry = 0;
-			    }
-		    }
-
-	        size_t len = readOp->results.length();
-	        uint32_t leftLen = len;
-	        int curEntryIndex = 0;
-	        uint64_t offset = 0;
 	        SGL_S *sgl = readOp->reqCtx.readSgl.sgl;
 	        int buildType = readOp->reqCtx.readSgl.buildType;
-  
- 	        while (leftLen > 0) {
-		        size_t size = 0;
-		        if (buildType) {
-			        size = std::min((uint32_t)DEFAULT_SGL_PAGE, leftLen);
-		        } else {
-			        size = std::min(sgl->entrys[curEntryIndex].len, leftLen);
-		        }
-
-		        bufferlist bl;
-		        bl.substr_of(readOp->results, offset, size);
-		        memcpy(sgl->entrys[curEntryIndex].buf, bl.c_str(), size);
-		        leftLen -= size;
-		        curEntryIndex++;
-		        if (curEntryIndex >= ENTRY_PER_SGL) {
-		            curEntryIndex = 0;
-		            sgl = sgl->nextSgl;
-		        }
-
-		        offset += size;
+	        size_t len = readOp->results.length();
+	        bool check = readOp->reqCtx.readSgl.verify || readOp->reqCtx.readSgl.hasExpected;
+	        uint32_t crc = -1;
+
+	        SglCopyFromBufferlist(sgl, 0, readOp->results, buildType, check ? &crc : nullptr);
+	        // a short read leaves the rest of the range as zeros
+	        if (len < readOp->reqCtx.readSgl.len) {
+		        SglZero(sgl, len, readOp->reqCtx.readSgl.len - len, buildType);
+	        }
+
+	        if (check) {
+		        ret = VerifyReadSgl(readOp, crc);
 	        }
 	    }
 	} else {
 		if (ret == -2) {
 			ProxyDbgLogWarn("pool(%ld) or objects(%s) is not exists: %d", readOp->poolId, readOp->objectId.c_str(), ret);
+			CephProxy::instance->CheckPoolGone(readOp->poolId);
 		} else {
 			ProxyDbgLogErr("read pool(%ld) or objects(%s) failed: %d", readOp->poolId, readOp->objectId.c_str(), ret);
 		}
@@ -1253,6 +1334,21 @@ void ReadCallback(rados_completion_t c, void *arg)
 		readOp->checksums.c_str(),
 		readOp->reqCtx.checksum.chunkSumLen);
     }
+
+    // usedLen is set on -ERANGE too, so the caller knows how much room the output needs
+    if (ret == 0 && readOp->reqCtx.exec.toUserBuf) {
+	size_t len = readOp->execOut.length();
+	if (readOp->reqCtx.exec.usedLen != nullptr) {
+	    *(readOp->reqCtx.exec.usedLen) = len;
+	}
+	if (len > readOp->reqCtx.exec.userLen) {
+	    ProxyDbgLogWarnLimit1("exec output of %s is %lu bytes, the buffer only %lu",
+		    readOp->objectId.c_str(), len, readOp->reqCtx.exec.userLen);
+	    ret = -ERANGE;
+	} else if (len > 0) {
+	    readOp->execOut.copy(0, len, readOp->reqCtx.exec.userBuf);
+	}
+    }
     
 	// TODO: other reqCtx;
 	PROXY_FTDS_END_HIGH(PROXY_FTDS_OPS_READ, readOp->ts, ret);
@@ -1276,6 +1372,7 @@ void WriteCallback(rados_completion_t c, void *arg)
 		ProxyDbgLogDebug("write ret is %d", ret);
 	} else if (ret == -2) {
 		ProxyDbgLogWarnLimit1("pool(object) is not exists");
+		CephProxy::instance->CheckPoolGone(writeOp->poolId);
 	} else {
 		ProxyDbgLogErr("write ret is %d", ret);
 	}
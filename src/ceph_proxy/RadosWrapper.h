@@ -23,17 +23,23 @@ int RadosCreateIoCtx2(rados_client_t client, const int64_t poolId, rados_ioctx_t
 void RadosReleaseIoCtx(rados_ioctx_t ctx);
 int64_t RadosGetPoolId(rados_ioctx_t ctx);
 int RadosGetPoolName(rados_ioctx_t ctx, char *buf, unsigned maxLen);
+int RadosPoolList(rados_client_t client, std::vector<std::pair<int64_t, std::string>> &pools);
+int RadosWaitForLatestOsdmap(rados_client_t client);
+int RadosPoolReverseLookup(rados_client_t client, int64_t poolId, std::string &name);
+int RadosMonCommand(rados_client_t client, const std::string &cmd, std::string &out);
 
 int RadosGetMinAllocSizeHDD(rados_client_t client, uint32_t *minAllocSize);
 int RadosGetMinAllocSizeSSD(rados_client_t client, uint32_t *minAllocSize);
 int RadosGetClusterStat(rados_client_t client, CephClusterStat *stat);
 int RadosGetPoolStat(rados_client_t client, rados_ioctx_t ctx, CephPoolStat *stat);
 int RadosGetPoolsStat(rados_client_t client, CephPoolStat *stat, uint64_t *poolId, uint32_t poolNum);
+int RadosGetAllPoolsStat(rados_client_t client, const std::vector<std::pair<int64_t, std::string>> &pools,
+			std::map<int64_t, CephPoolStat> &stats);
 
 
 rados_op_t RadosWriteOpInit(const string& pool, const string &oid);
 
-rados_op_t RadosWriteOpInit2(const int64_t poolId, const string &oid);
+rados_op_t RadosWriteOpInit2(const int64_t poolId, const char *oid);
 
 void RadosWriteOpRelease(rados_op_t op);
 
@@ -61,6 +67,7 @@ void RadosWriteOpCreateObject(rados_op_t op, int exclusive, const char *category
 void RadosWriteOpWrite(rados_op_t op, const char *buffer, size_t len, uint64_t off);
 
 void RadosWriteOpWriteSGL(rados_op_t op, SGL_S *s, size_t len1, uint64_t off, AlignBuffer *alignBuffer, int isRelease);
+int RadosWriteOpGetDataCrc(rados_op_t op, uint32_t *crc);
 
 void RadosWriteOpWriteFull(rados_op_t op, const char *buffer, size_t len);
 
@@ -101,7 +108,7 @@ void RadosWriteOpSetAllocHint(rados_op_t op,
 
 rados_op_t RadosReadOpInit(const string& pool, const string &oid);
 
-rados_op_t RadosReadOpInit2(const int64_t poolId, const string &oid);
+rados_op_t RadosReadOpInit2(const int64_t poolId, const char *oid);
 
 void RadosReadOpRelease(rados_op_t op);
 
@@ -140,6 +147,7 @@ void RadosReadOpRead(rados_op_t op, uint64_t offset, size_t len, char *buffer,
 			size_t *bytesRead, int *prval);
 
 void RadosReadOpReadSGL(rados_op_t op, uint64_t offset, size_t len, SGL_S *s, int *prval, int isRelease);
+void RadosReadOpSetExpectedCrc(rados_op_t op, uint32_t crc);
 
 void RadosReadOpCheckSum(rados_op_t op, proxy_checksum_type_t type,
 		const char *initValue, size_t initValueLen,
@@ -0,0 +1,698 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "FakeCluster.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <regex>
+
+#define FAKE_GIB (1024ULL * 1024ULL * 1024ULL)
+#define FAKE_DEFAULT_CAPACITY (300 * FAKE_GIB)
+
+static std::string CmdArg(const std::string &cmd, const std::string &key)
+{
+	std::regex expression("\"" + key + "\"\\s*:\\s*\"([^\"]*)\"");
+	std::smatch result;
+	if (std::regex_search(cmd, result, expression)) {
+		return result[1].str();
+	}
+	return "";
+}
+
+/* same shape as "ceph df" plain output, byte_u_t for sizes */
+static std::string ByteStr(uint64_t bytes)
+{
+	static const char *units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+	double val = bytes;
+	uint32_t u = 0;
+	while (val >= 1024 && u < sizeof(units) / sizeof(units[0]) - 1) {
+		val /= 1024;
+		u++;
+	}
+	char buf[64] = { 0 };
+	if (val == static_cast<uint64_t>(val)) {
+		snprintf(buf, sizeof(buf), "%lu %s", static_cast<uint64_t>(val), units[u]);
+	} else {
+		snprintf(buf, sizeof(buf), "%.1f %s", val, units[u]);
+	}
+	return buf;
+}
+
+static std::string CountStr(uint64_t count)
+{
+	char buf[64] = { 0 };
+	if (count >= 1024 * 1024) {
+		snprintf(buf, sizeof(buf), "%.2fM", count / (1024.0 * 1024.0));
+	} else if (count >= 1024) {
+		snprintf(buf, sizeof(buf), "%.2fk", count / 1024.0);
+	} else {
+		snprintf(buf, sizeof(buf), "%lu", count);
+	}
+	return buf;
+}
+
+FakeCluster &FakeCluster::Instance()
+{
+	static FakeCluster cluster;
+	return cluster;
+}
+
+FakeCluster::FakeCluster()
+{
+	InitConf();
+	finisher = std::thread([this]() {
+		pthread_setname_np(pthread_self(), "fake_finisher");
+		Finisher();
+	});
+}
+
+FakeCluster::~FakeCluster()
+{
+	{
+		std::lock_guard<std::mutex> l(finisherLock);
+		finisherStop = true;
+		finisherCond.notify_all();
+	}
+	if (finisher.joinable()) {
+		finisher.join();
+	}
+}
+
+void FakeCluster::InitConf()
+{
+	capacity = FAKE_DEFAULT_CAPACITY;
+	conf.clear();
+	conf["auth_cluster_required"] = "none";
+	conf["bluestore_min_alloc_size"] = "0";
+	conf["bluestore_min_alloc_size_hdd"] = "65536";
+	conf["bluestore_min_alloc_size_ssd"] = "16384";
+	conf["osd_pool_erasure_code_stripe_unit"] = "4096";
+	ecProfiles.clear();
+	ecProfiles["default"] = FakeEcProfile();
+}
+
+void FakeCluster::Reset()
+{
+	{
+		std::lock_guard<std::mutex> l(lock);
+		pools.clear();
+		methods.clear();
+		monReplies.clear();
+		InitConf();
+	}
+	std::lock_guard<std::mutex> l(faultLock);
+	faults.clear();
+	corruptions.clear();
+	for (auto &lat : latency) {
+		lat = Latency();
+	}
+	for (auto &count : opCount) {
+		count = 0;
+	}
+	monCount.clear();
+}
+
+int64_t FakeCluster::CreatePool(const std::string &name, uint32_t size)
+{
+	std::lock_guard<std::mutex> l(lock);
+	if (LookupPool(name) != nullptr) {
+		return -EEXIST;
+	}
+	int64_t id = ++lastPoolId;
+	FakePool &pool = pools[id];
+	pool.id = id;
+	pool.name = name;
+	pool.size = size;
+	return id;
+}
+
+int64_t FakeCluster::CreateEcPool(const std::string &name, const std::string &profile)
+{
+	std::lock_guard<std::mutex> l(lock);
+	if (LookupPool(name) != nullptr) {
+		return -EEXIST;
+	}
+	if (ecProfiles.find(profile) == ecProfiles.end()) {
+		return -ENOENT;
+	}
+	int64_t id = ++lastPoolId;
+	FakePool &pool = pools[id];
+	pool.id = id;
+	pool.name = name;
+	pool.ecProfile = profile;
+	pool.size = ecProfiles[profile].k + ecProfiles[profile].m;
+	return id;
+}
+
+int FakeCluster::DeletePool(const std::string &name)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *pool = LookupPool(name);
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	pools.erase(pool->id);
+	return 0;
+}
+
+int FakeCluster::RenamePool(const std::string &name, const std::string &newName)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *pool = LookupPool(name);
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	if (LookupPool(newName) != nullptr) {
+		return -EEXIST;
+	}
+	pool->name = newName;
+	return 0;
+}
+
+void FakeCluster::SetEcProfile(const std::string &name, uint32_t k, uint32_t m, uint32_t stripeUnit)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakeEcProfile &profile = ecProfiles[name];
+	profile.k = k;
+	profile.m = m;
+	profile.stripeUnit = stripeUnit;
+}
+
+int FakeCluster::CreateNamespace(const std::string &pool, const std::string &nspace)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *p = LookupPool(pool);
+	if (p == nullptr) {
+		return -ENOENT;
+	}
+	p->namespaces.insert(nspace);
+	return 0;
+}
+
+int FakeCluster::SetPoolStored(const std::string &pool, uint64_t bytes)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *p = LookupPool(pool);
+	if (p == nullptr) {
+		return -ENOENT;
+	}
+	p->storedOverride = bytes;
+	return 0;
+}
+
+void FakeCluster::SetCapacity(uint64_t bytes)
+{
+	std::lock_guard<std::mutex> l(lock);
+	capacity = bytes;
+}
+
+void FakeCluster::SetConf(const std::string &key, const std::string &val)
+{
+	std::lock_guard<std::mutex> l(lock);
+	conf[key] = val;
+}
+
+void FakeCluster::SetMonReply(const std::string &prefix, const std::string &out)
+{
+	std::lock_guard<std::mutex> l(lock);
+	if (out.empty()) {
+		monReplies.erase(prefix);
+	} else {
+		monReplies[prefix] = out;
+	}
+}
+
+void FakeCluster::RegisterMethod(const std::string &cls, const std::string &method, FakeClassMethod fn)
+{
+	std::lock_guard<std::mutex> l(lock);
+	methods[cls + "." + method] = fn;
+}
+
+int FakeCluster::CreateImage(const std::string &pool, const std::string &name, uint64_t size, uint8_t order)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *p = LookupPool(pool);
+	if (p == nullptr) {
+		return -ENOENT;
+	}
+	if (p->images.find(name) != p->images.end()) {
+		return -EEXIST;
+	}
+	char id[32] = { 0 };
+	snprintf(id, sizeof(id), "%lx", 0x1000 + (++lastImageId));
+	FakeImage &image = p->images[name];
+	image.id = id;
+	image.name = name;
+	image.size = size;
+	image.order = order;
+	return 0;
+}
+
+int FakeCluster::WriteImage(const std::string &pool, const std::string &name, uint64_t off, uint64_t len)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *p = LookupPool(pool);
+	if (p == nullptr) {
+		return -ENOENT;
+	}
+	auto it = p->images.find(name);
+	if (it == p->images.end()) {
+		return -ENOENT;
+	}
+	FakeImage &image = it->second;
+	if (off + len > image.size) {
+		return -EINVAL;
+	}
+	for (uint64_t objNo = off >> image.order; len != 0 && objNo <= (off + len - 1) >> image.order; objNo++) {
+		image.written.insert(objNo);
+	}
+	return 0;
+}
+
+int FakeCluster::CreateImageSnap(const std::string &pool, const std::string &name, const std::string &snap)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *p = LookupPool(pool);
+	if (p == nullptr) {
+		return -ENOENT;
+	}
+	auto it = p->images.find(name);
+	if (it == p->images.end()) {
+		return -ENOENT;
+	}
+	FakeImage &image = it->second;
+	for (auto &s : image.snaps) {
+		if (s.name == snap) {
+			return -EEXIST;
+		}
+	}
+	FakeImageSnap s;
+	s.id = ++lastSnapId;
+	s.name = snap;
+	s.size = image.size;
+	s.written.swap(image.written);
+	image.snaps.push_back(s);
+	return 0;
+}
+
+void FakeCluster::SetLatency(FakeOpKind kind, uint32_t us, uint32_t jitterUs)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	latency[kind].us = us;
+	latency[kind].jitterUs = jitterUs;
+}
+
+void FakeCluster::InjectError(FakeOpKind kind, int err, uint32_t count, const std::string &match)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	faults.push_back({ kind, err, count, match });
+}
+
+void FakeCluster::InjectCorruption(uint32_t count, const std::string &match)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	corruptions.push_back({ FAKE_OP_READ, 0, count, match });
+}
+
+void FakeCluster::ClearFaults()
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	faults.clear();
+	corruptions.clear();
+	for (auto &lat : latency) {
+		lat = Latency();
+	}
+}
+
+uint64_t FakeCluster::GetOpCount(FakeOpKind kind)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	return opCount[kind];
+}
+
+uint64_t FakeCluster::GetMonCommandCount(const std::string &prefix)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	auto it = monCount.find(prefix);
+	return it == monCount.end() ? 0 : it->second;
+}
+
+FakeObjectRef FakeCluster::GetObject(int64_t poolId, const std::string &nspace, const std::string &oid)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *pool = LookupPool(poolId);
+	if (pool == nullptr) {
+		return nullptr;
+	}
+	auto it = pool->objects.find(ObjectKey(nspace, oid));
+	return it == pool->objects.end() ? nullptr : it->second;
+}
+
+int FakeCluster::PutObject(int64_t poolId, const std::string &nspace, const std::string &oid, const FakeObject &obj)
+{
+	std::lock_guard<std::mutex> l(lock);
+	FakePool *pool = LookupPool(poolId);
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	pool->objects[ObjectKey(nspace, oid)] = std::make_shared<FakeObject>(obj);
+	return 0;
+}
+
+FakePool *FakeCluster::LookupPool(const std::string &name)
+{
+	for (auto &p : pools) {
+		if (p.second.name == name) {
+			return &p.second;
+		}
+	}
+	return nullptr;
+}
+
+FakePool *FakeCluster::LookupPool(int64_t id)
+{
+	auto it = pools.find(id);
+	return it == pools.end() ? nullptr : &it->second;
+}
+
+void FakeCluster::PoolList(std::list<std::pair<int64_t, std::string> > &v)
+{
+	v.clear();
+	for (auto &it : pools) {
+		v.push_back(std::make_pair(it.first, it.second.name));
+	}
+}
+
+FakeImage *FakeCluster::LookupImage(int64_t poolId, const std::string &name)
+{
+	FakePool *pool = LookupPool(poolId);
+	if (pool == nullptr) {
+		return nullptr;
+	}
+	auto it = pool->images.find(name);
+	return it == pool->images.end() ? nullptr : &it->second;
+}
+
+FakeImage *FakeCluster::LookupImageById(int64_t poolId, const std::string &id)
+{
+	FakePool *pool = LookupPool(poolId);
+	if (pool == nullptr) {
+		return nullptr;
+	}
+	for (auto &image : pool->images) {
+		if (image.second.id == id) {
+			return &image.second;
+		}
+	}
+	return nullptr;
+}
+
+bool FakeCluster::LookupMethod(const std::string &cls, const std::string &method, FakeClassMethod *fn)
+{
+	auto it = methods.find(cls + "." + method);
+	if (it == methods.end()) {
+		return false;
+	}
+	*fn = it->second;
+	return true;
+}
+
+int FakeCluster::GetConf(const std::string &key, std::string &val)
+{
+	std::lock_guard<std::mutex> l(lock);
+	auto it = conf.find(key);
+	if (it == conf.end()) {
+		return -ENOENT;
+	}
+	val = it->second;
+	return 0;
+}
+
+int FakeCluster::CheckFault(FakeOpKind kind, const std::string &what)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	opCount[kind]++;
+	for (auto it = faults.begin(); it != faults.end(); it++) {
+		if (it->kind != kind || (!it->match.empty() && what.find(it->match) == std::string::npos)) {
+			continue;
+		}
+		int err = it->err;
+		if (it->count != 0 && --it->count == 0) {
+			faults.erase(it);
+		}
+		return err;
+	}
+	return 0;
+}
+
+bool FakeCluster::CheckCorruption(const std::string &oid)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	for (auto it = corruptions.begin(); it != corruptions.end(); it++) {
+		if (!it->match.empty() && oid.find(it->match) == std::string::npos) {
+			continue;
+		}
+		if (it->count != 0 && --it->count == 0) {
+			corruptions.erase(it);
+		}
+		return true;
+	}
+	return false;
+}
+
+uint64_t FakeCluster::PickLatency(FakeOpKind kind)
+{
+	std::lock_guard<std::mutex> l(faultLock);
+	uint64_t us = latency[kind].us;
+	if (latency[kind].jitterUs != 0) {
+		thread_local std::mt19937 rng(std::random_device{}());
+		us += std::uniform_int_distribution<uint32_t>(0, latency[kind].jitterUs)(rng);
+	}
+	return us;
+}
+
+void FakeCluster::Defer(uint64_t us, std::function<void()> fn)
+{
+	std::lock_guard<std::mutex> l(finisherLock);
+	auto it = deferred.emplace(std::chrono::steady_clock::now() + std::chrono::microseconds(us), std::move(fn));
+	if (it == deferred.begin()) {
+		finisherCond.notify_one();
+	}
+}
+
+/* one thread, like the librados finisher, so callbacks never run in the submitter's context */
+void FakeCluster::Finisher()
+{
+	std::unique_lock<std::mutex> l(finisherLock);
+	while (true) {
+		if (deferred.empty()) {
+			if (finisherStop) {
+				break;
+			}
+			finisherCond.wait(l);
+			continue;
+		}
+		auto it = deferred.begin();
+		if (!finisherStop && it->first > std::chrono::steady_clock::now()) {
+			finisherCond.wait_until(l, it->first);
+			continue;
+		}
+		std::function<void()> fn = std::move(it->second);
+		deferred.erase(it);
+		l.unlock();
+		fn();
+		l.lock();
+	}
+}
+
+std::string FakeCluster::ObjectKey(const std::string &nspace, const std::string &oid)
+{
+	std::string key(nspace);
+	key.push_back('\0');
+	key.append(oid);
+	return key;
+}
+
+uint64_t FakeCluster::PoolStored(FakePool &pool)
+{
+	if (pool.storedOverride != 0) {
+		return pool.storedOverride;
+	}
+	uint64_t stored = 0;
+	for (auto &obj : pool.objects) {
+		stored += obj.second->data.length();
+	}
+	return stored;
+}
+
+double FakeCluster::PoolRawRatio(FakePool &pool)
+{
+	if (pool.ecProfile.empty()) {
+		return pool.size;
+	}
+	FakeEcProfile &profile = ecProfiles[pool.ecProfile];
+	return (profile.k + profile.m) * 1.0 / profile.k;
+}
+
+void FakeCluster::ClusterStat(uint64_t &cap, uint64_t &used, uint64_t &objects)
+{
+	cap = capacity;
+	used = 0;
+	objects = 0;
+	for (auto &p : pools) {
+		used += PoolStored(p.second) * PoolRawRatio(p.second);
+		objects += p.second.objects.size();
+	}
+}
+
+int FakeCluster::MonCommand(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs)
+{
+	std::string prefix = CmdArg(cmd, "prefix");
+	{
+		std::lock_guard<std::mutex> l(faultLock);
+		monCount[prefix]++;
+	}
+	int ret = CheckFault(FAKE_OP_MON, prefix);
+	if (ret != 0) {
+		return ret;
+	}
+
+	std::lock_guard<std::mutex> l(lock);
+	auto canned = monReplies.find(prefix);
+	if (canned != monReplies.end()) {
+		outbl->append(canned->second);
+		return 0;
+	}
+	if (prefix == "df") {
+		return MonDf(outbl);
+	} else if (prefix == "osd lspools") {
+		return MonLsPools(outbl);
+	} else if (prefix == "osd pool get") {
+		return MonPoolGet(cmd, outbl, outs);
+	} else if (prefix == "osd erasure-code-profile get") {
+		return MonEcProfileGet(cmd, outbl, outs);
+	} else if (prefix == "config get") {
+		return MonConfigGet(cmd, outbl, outs);
+	}
+	if (outs != nullptr) {
+		*outs = "command not known";
+	}
+	return -EINVAL;
+}
+
+int FakeCluster::MonDf(ceph::bufferlist *outbl)
+{
+	uint64_t cap = 0;
+	uint64_t used = 0;
+	uint64_t objects = 0;
+	ClusterStat(cap, used, objects);
+	uint64_t avail = cap > used ? cap - used : 0;
+	char line[256] = { 0 };
+	std::string out("RAW STORAGE:\n");
+	snprintf(line, sizeof(line), "    %-9s %-10s %-10s %-10s %-12s %s\n", "CLASS", "SIZE", "AVAIL", "USED",
+		"RAW USED", "%RAW USED");
+	out.append(line);
+	for (const char *cls : { "hdd", "TOTAL" }) {
+		snprintf(line, sizeof(line), "    %-9s %-10s %-10s %-10s %-12s %.2f\n", cls, ByteStr(cap).c_str(),
+			ByteStr(avail).c_str(), ByteStr(used).c_str(), ByteStr(used).c_str(), cap ? used * 100.0 / cap : 0);
+		out.append(line);
+	}
+	out.append(" \nPOOLS:\n");
+	snprintf(line, sizeof(line), "    %-12s %4s %12s %10s %12s %8s %12s\n", "POOL", "ID", "STORED", "OBJECTS",
+		"USED", "%USED", "MAX AVAIL");
+	out.append(line);
+	for (auto &p : pools) {
+		FakePool &pool = p.second;
+		double ratio = PoolRawRatio(pool);
+		uint64_t stored = PoolStored(pool);
+		uint64_t poolUsed = stored * ratio;
+		uint64_t maxAvail = avail / ratio;
+		double usedRatio = (poolUsed + avail) ? poolUsed * 100.0 / (poolUsed + avail) : 0;
+		snprintf(line, sizeof(line), "    %-12s %4ld %12s %10s %12s %8.2f %12s\n", pool.name.c_str(), pool.id,
+			ByteStr(stored).c_str(), CountStr(pool.objects.size()).c_str(), ByteStr(poolUsed).c_str(), usedRatio,
+			ByteStr(maxAvail).c_str());
+		out.append(line);
+	}
+	outbl->append(out);
+	return 0;
+}
+
+int FakeCluster::MonLsPools(ceph::bufferlist *outbl)
+{
+	std::string out;
+	for (auto &p : pools) {
+		out.append(std::to_string(p.first) + " " + p.second.name + "\n");
+	}
+	outbl->append(out);
+	return 0;
+}
+
+int FakeCluster::MonPoolGet(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs)
+{
+	std::string name = CmdArg(cmd, "pool");
+	std::string var = CmdArg(cmd, "var");
+	FakePool *pool = LookupPool(name);
+	if (pool == nullptr) {
+		if (outs != nullptr) {
+			*outs = "unrecognized pool '" + name + "'";
+		}
+		return -ENOENT;
+	}
+	if (var == "erasure_code_profile") {
+		if (pool->ecProfile.empty()) {
+			if (outs != nullptr) {
+				*outs = "pool '" + name + "' is not a erasure pool";
+			}
+			return -EACCES;
+		}
+		outbl->append("erasure_code_profile: " + pool->ecProfile + "\n");
+		return 0;
+	} else if (var == "size") {
+		outbl->append("size: " + std::to_string(pool->size) + "\n");
+		return 0;
+	}
+	if (outs != nullptr) {
+		*outs = "unrecognized variable '" + var + "'";
+	}
+	return -EINVAL;
+}
+
+int FakeCluster::MonEcProfileGet(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs)
+{
+	std::string name = CmdArg(cmd, "name");
+	auto it = ecProfiles.find(name);
+	if (it == ecProfiles.end()) {
+		if (outs != nullptr) {
+			*outs = "unknown erasure code profile '" + name + "'";
+		}
+		return -ENOENT;
+	}
+	std::string out = "k=" + std::to_string(it->second.k) + "\nm=" + std::to_string(it->second.m) +
+		"\nplugin=jerasure\ntechnique=reed_sol_van\n";
+	if (it->second.stripeUnit != 0) {
+		out.append("stripe_unit=" + std::to_string(it->second.stripeUnit) + "\n");
+	}
+	outbl->append(out);
+	return 0;
+}
+
+int FakeCluster::MonConfigGet(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs)
+{
+	std::string key = CmdArg(cmd, "key");
+	auto it = conf.find(key);
+	if (it == conf.end()) {
+		if (outs != nullptr) {
+			*outs = "unrecognized key '" + key + "'";
+		}
+		return -ENOENT;
+	}
+	outbl->append(it->second + "\n");
+	return 0;
+}
@@ -0,0 +1,204 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _CEPH_PROXY_FAKE_CLUSTER_H_
+#define _CEPH_PROXY_FAKE_CLUSTER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rados/librados.hpp"
+
+/*
+ * In-memory cluster behind the fake librados and librbd. The proxy links
+ * against libfakerados instead of librados.so/librbd.so, tests build the
+ * cluster and inject faults through FakeCluster::Instance().
+ */
+
+typedef enum {
+	FAKE_OP_READ = 0,
+	FAKE_OP_WRITE,
+	FAKE_OP_MON,
+	FAKE_OP_CONNECT,
+	FAKE_OP_IOCTX,
+	FAKE_OP_RBD,
+	FAKE_OP_OSDMAP,
+	FAKE_OP_STAT,
+	FAKE_OP_KIND_NUM,
+} FakeOpKind;
+
+struct FakeObject {
+	ceph::bufferlist data;
+	std::map<std::string, ceph::bufferlist> omap;
+	ceph::bufferlist omapHeader;
+	std::map<std::string, ceph::bufferlist> xattrs;
+	uint64_t version = 0;
+	time_t mtime = 0;
+};
+typedef std::shared_ptr<FakeObject> FakeObjectRef;
+
+/* obj is null when the object does not exist, an exec method may create or remove it */
+typedef std::function<int(FakeObjectRef &obj, ceph::bufferlist &in, ceph::bufferlist *out)> FakeClassMethod;
+
+struct FakeEcProfile {
+	uint32_t k = 2;
+	uint32_t m = 1;
+	uint32_t stripeUnit = 0;
+};
+
+struct FakeImageSnap {
+	uint64_t id = 0;
+	std::string name;
+	uint64_t size = 0;
+	std::set<uint64_t> written;
+};
+
+struct FakeImage {
+	std::string id;
+	std::string name;
+	uint64_t size = 0;
+	uint8_t order = 22;
+	std::vector<FakeImageSnap> snaps;
+	std::set<uint64_t> written;
+};
+
+struct FakePool {
+	int64_t id = 0;
+	std::string name;
+	std::string ecProfile;
+	uint32_t size = 3;
+	uint64_t storedOverride = 0;
+	std::map<std::string, FakeObjectRef> objects;
+	std::set<std::string> namespaces;
+	std::map<std::string, FakeImage> images;
+	uint64_t numRd = 0;
+	uint64_t numRdKb = 0;
+	uint64_t numWr = 0;
+	uint64_t numWrKb = 0;
+};
+
+class FakeCluster {
+public:
+	static FakeCluster &Instance();
+
+	/* drops pools, images, conf and faults, keeps the finisher running */
+	void Reset();
+
+	int64_t CreatePool(const std::string &name, uint32_t size = 3);
+	int64_t CreateEcPool(const std::string &name, const std::string &profile);
+	int DeletePool(const std::string &name);
+	int RenamePool(const std::string &name, const std::string &newName);
+	void SetEcProfile(const std::string &name, uint32_t k, uint32_t m, uint32_t stripeUnit = 0);
+	int CreateNamespace(const std::string &pool, const std::string &nspace);
+	/* report a fixed STORED size in df instead of the sum of the object sizes */
+	int SetPoolStored(const std::string &pool, uint64_t bytes);
+	void SetCapacity(uint64_t bytes);
+	/* cluster side config, answers conf_get and "config get" */
+	void SetConf(const std::string &key, const std::string &val);
+	/* answer mon commands with the prefix by the canned output, empty removes it */
+	void SetMonReply(const std::string &prefix, const std::string &out);
+	void RegisterMethod(const std::string &cls, const std::string &method, FakeClassMethod fn);
+
+	int CreateImage(const std::string &pool, const std::string &name, uint64_t size, uint8_t order = 22);
+	int WriteImage(const std::string &pool, const std::string &name, uint64_t off, uint64_t len);
+	int CreateImageSnap(const std::string &pool, const std::string &name, const std::string &snap);
+
+	/* every op of the kind waits us + rand(0, jitterUs) before it completes */
+	void SetLatency(FakeOpKind kind, uint32_t us, uint32_t jitterUs = 0);
+	/* the next count ops of the kind whose oid, mon prefix or image name contains match fail with err, 0 is forever */
+	void InjectError(FakeOpKind kind, int err, uint32_t count = 1, const std::string &match = "");
+	/* the next count reads of objects whose oid contains match return data with one byte flipped, the object is left intact */
+	void InjectCorruption(uint32_t count = 1, const std::string &match = "");
+	void ClearFaults();
+	uint64_t GetOpCount(FakeOpKind kind);
+	uint64_t GetMonCommandCount(const std::string &prefix);
+
+	FakeObjectRef GetObject(int64_t poolId, const std::string &nspace, const std::string &oid);
+	int PutObject(int64_t poolId, const std::string &nspace, const std::string &oid, const FakeObject &obj);
+
+	/* used by the fake librados and librbd */
+	std::mutex lock;
+	FakePool *LookupPool(const std::string &name);
+	FakePool *LookupPool(int64_t id);
+	void PoolList(std::list<std::pair<int64_t, std::string> > &v);
+	FakeImage *LookupImage(int64_t poolId, const std::string &name);
+	FakeImage *LookupImageById(int64_t poolId, const std::string &id);
+	bool LookupMethod(const std::string &cls, const std::string &method, FakeClassMethod *fn);
+	int GetConf(const std::string &key, std::string &val);
+	int CheckFault(FakeOpKind kind, const std::string &what);
+	bool CheckCorruption(const std::string &oid);
+	uint64_t PickLatency(FakeOpKind kind);
+	void Defer(uint64_t us, std::function<void()> fn);
+	int MonCommand(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs);
+	void ClusterStat(uint64_t &capacity, uint64_t &used, uint64_t &objects);
+	uint64_t PoolStored(FakePool &pool);
+	double PoolRawRatio(FakePool &pool);
+
+	static std::string ObjectKey(const std::string &nspace, const std::string &oid);
+
+private:
+	struct Fault {
+		FakeOpKind kind;
+		int err;
+		uint32_t count;
+		std::string match;
+	};
+	struct Latency {
+		uint32_t us = 0;
+		uint32_t jitterUs = 0;
+	};
+
+	FakeCluster();
+	~FakeCluster();
+	void Finisher();
+	void InitConf();
+	int MonDf(ceph::bufferlist *outbl);
+	int MonLsPools(ceph::bufferlist *outbl);
+	int MonPoolGet(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs);
+	int MonEcProfileGet(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs);
+	int MonConfigGet(const std::string &cmd, ceph::bufferlist *outbl, std::string *outs);
+
+	int64_t lastPoolId = 0;
+	uint64_t lastImageId = 0;
+	uint64_t lastSnapId = 0;
+	uint64_t capacity = 0;
+	std::map<int64_t, FakePool> pools;
+	std::map<std::string, FakeEcProfile> ecProfiles;
+	std::map<std::string, std::string> conf;
+	std::map<std::string, std::string> monReplies;
+	std::map<std::string, FakeClassMethod> methods;
+
+	std::mutex faultLock;
+	std::vector<Fault> faults;
+	std::vector<Fault> corruptions;
+	Latency latency[FAKE_OP_KIND_NUM];
+	uint64_t opCount[FAKE_OP_KIND_NUM] = { 0 };
+	std::map<std::string, uint64_t> monCount;
+
+	std::mutex finisherLock;
+	std::condition_variable finisherCond;
+	std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> deferred;
+	std::thread finisher;
+	bool finisherStop = false;
+};
+
+/* replaces the global cache conf parser, unit/key pairs answer GetCfgItem* */
+void FakeConfSet(const std::string &unit, const std::string &key, const std::string &val);
+void FakeConfReset();
+
+#endif
@@ -0,0 +1,107 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "FakeCluster.h"
+
+/* stands in for libconfparser, the proxy reads its settings through GetCfgItem* */
+
+static std::mutex gConfLock;
+static std::map<std::string, std::string> gConf;
+static bool gConfInit = false;
+
+static void ConfDefaults()
+{
+	gConf.clear();
+	gConf["proxy.ceph_conf_path"] = "";
+	gConf["proxy.ceph_keyring_path"] = "";
+	gConf["proxy.core_number"] = "0";
+	gConf["proxy.bind_core"] = "0";
+	gConf["proxy.rados_mon_op_timeout"] = "5";
+	gConf["proxy.rados_osd_op_timeout"] = "5";
+	gConfInit = true;
+}
+
+static int ConfLookup(const char *unit, const char *key, std::string &val)
+{
+	std::lock_guard<std::mutex> l(gConfLock);
+	if (!gConfInit) {
+		ConfDefaults();
+	}
+	auto it = gConf.find(std::string(unit) + "." + key);
+	if (it == gConf.end()) {
+		return -1;
+	}
+	val = it->second;
+	return 0;
+}
+
+void FakeConfSet(const std::string &unit, const std::string &key, const std::string &val)
+{
+	std::lock_guard<std::mutex> l(gConfLock);
+	if (!gConfInit) {
+		ConfDefaults();
+	}
+	gConf[unit + "." + key] = val;
+}
+
+void FakeConfReset()
+{
+	std::lock_guard<std::mutex> l(gConfLock);
+	ConfDefaults();
+}
+
+extern "C" {
+
+int GetCfgItemCstr(char *dest, size_t destSize, const char *unit, const char *key)
+{
+	std::string val;
+	if (ConfLookup(unit, key, val) != 0 || val.length() >= destSize) {
+		return -1;
+	}
+	strcpy(dest, val.c_str());
+	return 0;
+}
+
+int GetCfgItemInt32(int32_t *dest, const char *unit, const char *key)
+{
+	std::string val;
+	if (ConfLookup(unit, key, val) != 0) {
+		return -1;
+	}
+	*dest = strtol(val.c_str(), nullptr, 10);
+	return 0;
+}
+
+int GetCfgItemUint32(uint32_t *dest, const char *unit, const char *key)
+{
+	std::string val;
+	if (ConfLookup(unit, key, val) != 0) {
+		return -1;
+	}
+	*dest = strtoul(val.c_str(), nullptr, 10);
+	return 0;
+}
+
+int GetCfgItemUint64(uint64_t *dest, const char *unit, const char *key)
+{
+	std::string val;
+	if (ConfLookup(unit, key, val) != 0) {
+		return -1;
+	}
+	*dest = strtoull(val.c_str(), nullptr, 10);
+	return 0;
+}
+
+}
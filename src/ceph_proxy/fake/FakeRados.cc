@@ -0,0 +1,1105 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
+#include "rados/librados.h"
+#include "rados/librados.hpp"
+#include "crc32c.h"
+#include "FakeCluster.h"
+
+/*
+ * librados entry points used by the proxy, the opaque impl pointers of the
+ * public classes point to the structures below.
+ */
+
+#define FAKE_MAX_ERRNO 4095
+
+struct FakeRadosClient {
+	std::map<std::string, std::string> conf;
+	bool connected = false;
+};
+
+struct FakeIoCtx {
+	int64_t poolId = -1;
+	std::string poolName;
+	std::string nspace;
+};
+
+struct FakeOpCtx {
+	std::string oid;
+	FakeObjectRef obj;
+	bool dirty = false;
+	uint64_t readBytes = 0;
+	uint64_t writeBytes = 0;
+};
+
+typedef std::function<int(FakeOpCtx &ctx)> FakeOpStep;
+
+struct FakeObjectOperation {
+	std::atomic<int> ref { 1 };
+	bool hasExec = false;
+	std::vector<FakeOpStep> steps;
+
+	void Get()
+	{
+		ref++;
+	}
+	void Put()
+	{
+		if (--ref == 0) {
+			delete this;
+		}
+	}
+};
+
+struct FakeCompletion {
+	std::atomic<int> ref { 1 };
+	void *arg = nullptr;
+	librados::callback_t cb = nullptr;
+	int rval = 0;
+
+	void Get()
+	{
+		ref++;
+	}
+	void Put()
+	{
+		if (--ref == 0) {
+			delete this;
+		}
+	}
+};
+
+static FakeRadosClient *Client(librados::RadosClient *client)
+{
+	return reinterpret_cast<FakeRadosClient *>(client);
+}
+
+static FakeIoCtx *Io(librados::IoCtxImpl *io)
+{
+	return reinterpret_cast<FakeIoCtx *>(io);
+}
+
+static FakeObjectOperation *Op(librados::ObjectOperationImpl *impl)
+{
+	return reinterpret_cast<FakeObjectOperation *>(impl);
+}
+
+static void AddStep(librados::ObjectOperationImpl *impl, int *prval, FakeOpStep step)
+{
+	Op(impl)->steps.push_back([prval, step](FakeOpCtx &ctx) {
+		int r = step(ctx);
+		if (prval != nullptr) {
+			*prval = r;
+		}
+		return r;
+	});
+}
+
+static void EnsureObject(FakeOpCtx &ctx)
+{
+	if (ctx.obj == nullptr) {
+		ctx.obj = std::make_shared<FakeObject>();
+	}
+	ctx.dirty = true;
+}
+
+static void WriteData(FakeObject &obj, uint64_t off, const ceph::bufferlist &bl)
+{
+	ceph::bufferlist out;
+	uint64_t size = obj.data.length();
+	if (off <= size) {
+		if (off != 0) {
+			out.substr_of(obj.data, 0, off);
+		}
+	} else {
+		out.append(obj.data);
+		out.append_zero(off - size);
+	}
+	out.append(bl);
+	uint64_t end = off + bl.length();
+	if (end < size) {
+		ceph::bufferlist tail;
+		tail.substr_of(obj.data, end, size - end);
+		out.append(tail);
+	}
+	obj.data.swap(out);
+}
+
+static void TruncateData(FakeObject &obj, uint64_t off)
+{
+	uint64_t size = obj.data.length();
+	if (off < size) {
+		ceph::bufferlist out;
+		if (off != 0) {
+			out.substr_of(obj.data, 0, off);
+		}
+		obj.data.swap(out);
+	} else if (off > size) {
+		obj.data.append_zero(off - size);
+	}
+}
+
+static bool CmpMatch(int cmp, int op)
+{
+	switch (op) {
+		case LIBRADOS_CMPXATTR_OP_EQ:
+			return cmp == 0;
+		case LIBRADOS_CMPXATTR_OP_NE:
+			return cmp != 0;
+		case LIBRADOS_CMPXATTR_OP_GT:
+			return cmp > 0;
+		case LIBRADOS_CMPXATTR_OP_GTE:
+			return cmp >= 0;
+		case LIBRADOS_CMPXATTR_OP_LT:
+			return cmp < 0;
+		case LIBRADOS_CMPXATTR_OP_LTE:
+			return cmp <= 0;
+		default:
+			return false;
+	}
+}
+
+static int ConfGet(FakeRadosClient *client, const std::string &key, std::string &val)
+{
+	if (client == nullptr) {
+		return -EINVAL;
+	}
+	auto it = client->conf.find(key);
+	if (it != client->conf.end()) {
+		val = it->second;
+		return 0;
+	}
+	return FakeCluster::Instance().GetConf(key, val);
+}
+
+/* "key = value" lines, section headers and comments are skipped */
+static int ConfReadFile(FakeRadosClient *client, const char *path)
+{
+	if (client == nullptr) {
+		return -EINVAL;
+	}
+	if (path == nullptr || path[0] == '\0') {
+		return 0;
+	}
+	std::ifstream in(path);
+	if (!in.is_open()) {
+		return -ENOENT;
+	}
+	std::string line;
+	while (std::getline(in, line)) {
+		size_t pos = line.find('=');
+		if (line.empty() || line[0] == '#' || line[0] == ';' || line[0] == '[' || pos == std::string::npos) {
+			continue;
+		}
+		std::string key = line.substr(0, pos);
+		std::string val = line.substr(pos + 1);
+		key.erase(0, key.find_first_not_of(" \t"));
+		key.erase(key.find_last_not_of(" \t") + 1);
+		val.erase(0, val.find_first_not_of(" \t"));
+		val.erase(val.find_last_not_of(" \t") + 1);
+		std::replace(key.begin(), key.end(), ' ', '_');
+		client->conf[key] = val;
+	}
+	return 0;
+}
+
+static int Connect(FakeRadosClient *client)
+{
+	if (client == nullptr) {
+		return -EINVAL;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	usleep(cluster.PickLatency(FAKE_OP_CONNECT));
+	int ret = cluster.CheckFault(FAKE_OP_CONNECT, "");
+	if (ret != 0) {
+		return ret;
+	}
+	client->connected = true;
+	return 0;
+}
+
+static int ClusterStat(FakeRadosClient *client, uint64_t &kb, uint64_t &kbUsed, uint64_t &kbAvail, uint64_t &objects)
+{
+	if (client == nullptr || !client->connected) {
+		return -ENOTCONN;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	usleep(cluster.PickLatency(FAKE_OP_STAT));
+	int ret = cluster.CheckFault(FAKE_OP_STAT, "cluster_stat");
+	if (ret != 0) {
+		return ret;
+	}
+	uint64_t capacity = 0;
+	uint64_t used = 0;
+	std::lock_guard<std::mutex> l(cluster.lock);
+	cluster.ClusterStat(capacity, used, objects);
+	kb = capacity >> 10;
+	kbUsed = used >> 10;
+	kbAvail = capacity > used ? (capacity - used) >> 10 : 0;
+	return 0;
+}
+
+static int Execute(const FakeIoCtx &io, const std::string &oid, FakeObjectOperation *op, bool write)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	int ret = cluster.CheckFault(write ? FAKE_OP_WRITE : FAKE_OP_READ, oid);
+	if (ret != 0) {
+		return ret;
+	}
+
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakePool *pool = cluster.LookupPool(io.poolId);
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	std::string key = FakeCluster::ObjectKey(io.nspace, oid);
+	auto it = pool->objects.find(key);
+	FakeOpCtx ctx;
+	ctx.oid = oid;
+	if (it != pool->objects.end()) {
+		/* copy on write, a failed op leaves the stored object untouched */
+		ctx.obj = (write || op->hasExec) ? std::make_shared<FakeObject>(*it->second) : it->second;
+	}
+	for (auto &step : op->steps) {
+		ret = step(ctx);
+		if (ret < 0) {
+			break;
+		}
+	}
+	if (ret > 0) {
+		ret = 0;
+	}
+
+	if (write) {
+		pool->numWr++;
+		pool->numWrKb += ctx.writeBytes >> 10;
+	} else {
+		pool->numRd++;
+		pool->numRdKb += ctx.readBytes >> 10;
+	}
+	if (ret == 0 && write && ctx.dirty) {
+		if (ctx.obj == nullptr) {
+			pool->objects.erase(key);
+		} else {
+			ctx.obj->version++;
+			ctx.obj->mtime = time(nullptr);
+			pool->objects[key] = ctx.obj;
+		}
+	}
+	return ret;
+}
+
+static int AioOperate(librados::IoCtxImpl *impl, const std::string &oid, librados::AioCompletion *c,
+	librados::ObjectOperationImpl *opImpl, bool write)
+{
+	if (impl == nullptr || c == nullptr) {
+		return -EINVAL;
+	}
+	FakeIoCtx io = *Io(impl);
+	FakeObjectOperation *op = Op(opImpl);
+	FakeCompletion *comp = reinterpret_cast<FakeCompletion *>(c->pc);
+	op->Get();
+	comp->Get();
+	FakeCluster &cluster = FakeCluster::Instance();
+	cluster.Defer(cluster.PickLatency(write ? FAKE_OP_WRITE : FAKE_OP_READ), [io, oid, op, comp, write]() {
+		comp->rval = Execute(io, oid, op, write);
+		if (comp->cb != nullptr) {
+			comp->cb(comp, comp->arg);
+		}
+		op->Put();
+		comp->Put();
+	});
+	return 0;
+}
+
+namespace librados {
+
+Rados::Rados() : client(nullptr)
+{
+}
+
+Rados::~Rados()
+{
+	shutdown();
+}
+
+int Rados::init(const char * const id)
+{
+	if (client == nullptr) {
+		client = reinterpret_cast<RadosClient *>(new FakeRadosClient());
+	}
+	return 0;
+}
+
+int Rados::conf_read_file(const char * const path) const
+{
+	return ConfReadFile(Client(client), path);
+}
+
+int Rados::conf_set(const char *option, const char *value)
+{
+	if (client == nullptr) {
+		return -EINVAL;
+	}
+	Client(client)->conf[option] = value;
+	return 0;
+}
+
+int Rados::conf_get(const char *option, std::string &val)
+{
+	return ConfGet(Client(client), option, val);
+}
+
+int Rados::connect()
+{
+	return Connect(Client(client));
+}
+
+void Rados::shutdown()
+{
+	delete Client(client);
+	client = nullptr;
+}
+
+int Rados::ioctx_create(const char *name, IoCtx &io)
+{
+	FakeRadosClient *c = Client(client);
+	if (c == nullptr || !c->connected) {
+		return -ENOTCONN;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	int ret = cluster.CheckFault(FAKE_OP_IOCTX, name);
+	if (ret != 0) {
+		return ret;
+	}
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakePool *pool = cluster.LookupPool(std::string(name));
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	FakeIoCtx *impl = new FakeIoCtx();
+	impl->poolId = pool->id;
+	impl->poolName = pool->name;
+	io.close();
+	io.io_ctx_impl = reinterpret_cast<IoCtxImpl *>(impl);
+	return 0;
+}
+
+int Rados::ioctx_create2(int64_t pool_id, IoCtx &io)
+{
+	FakeRadosClient *c = Client(client);
+	if (c == nullptr || !c->connected) {
+		return -ENOTCONN;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	int ret = cluster.CheckFault(FAKE_OP_IOCTX, std::to_string(pool_id));
+	if (ret != 0) {
+		return ret;
+	}
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakePool *pool = cluster.LookupPool(pool_id);
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	FakeIoCtx *impl = new FakeIoCtx();
+	impl->poolId = pool->id;
+	impl->poolName = pool->name;
+	io.close();
+	io.io_ctx_impl = reinterpret_cast<IoCtxImpl *>(impl);
+	return 0;
+}
+
+int Rados::cluster_stat(cluster_stat_t &result)
+{
+	return ClusterStat(Client(client), result.kb, result.kb_used, result.kb_avail, result.num_objects);
+}
+
+int Rados::get_pool_stats(std::list<std::string> &v, stats_map &result)
+{
+	FakeRadosClient *c = Client(client);
+	if (c == nullptr || !c->connected) {
+		return -ENOTCONN;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	usleep(cluster.PickLatency(FAKE_OP_STAT));
+	int ret = cluster.CheckFault(FAKE_OP_STAT, "get_pool_stats");
+	if (ret != 0) {
+		return ret;
+	}
+	std::lock_guard<std::mutex> l(cluster.lock);
+	for (auto &name : v) {
+		FakePool *pool = cluster.LookupPool(name);
+		if (pool == nullptr) {
+			continue;
+		}
+		pool_stat_t stat {};
+		stat.num_bytes = cluster.PoolStored(*pool);
+		stat.num_kb = stat.num_bytes >> 10;
+		stat.num_objects = pool->objects.size();
+		stat.num_object_copies = stat.num_objects * pool->size;
+		stat.num_rd = pool->numRd;
+		stat.num_rd_kb = pool->numRdKb;
+		stat.num_wr = pool->numWr;
+		stat.num_wr_kb = pool->numWrKb;
+		stat.num_user_bytes = stat.num_bytes;
+		result[name] = stat;
+	}
+	return 0;
+}
+
+int Rados::pool_list2(std::list<std::pair<int64_t, std::string> > &v)
+{
+	FakeRadosClient *c = Client(client);
+	if (c == nullptr || !c->connected) {
+		return -ENOTCONN;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	int ret = cluster.CheckFault(FAKE_OP_OSDMAP, "pool_list2");
+	if (ret != 0) {
+		return ret;
+	}
+	std::lock_guard<std::mutex> l(cluster.lock);
+	cluster.PoolList(v);
+	return 0;
+}
+
+/* the cluster state is shared, only the monitor round trip is left to fake */
+int Rados::wait_for_latest_osdmap()
+{
+	FakeRadosClient *c = Client(client);
+	if (c == nullptr || !c->connected) {
+		return -ENOTCONN;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	usleep(cluster.PickLatency(FAKE_OP_OSDMAP));
+	return cluster.CheckFault(FAKE_OP_OSDMAP, "wait_for_latest_osdmap");
+}
+
+int Rados::pool_reverse_lookup(int64_t id, std::string *name)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakePool *pool = cluster.LookupPool(id);
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	*name = pool->name;
+	return 0;
+}
+
+AioCompletion *Rados::aio_create_completion(void *cb_arg, callback_t cb_complete, callback_t cb_safe)
+{
+	FakeCompletion *c = new FakeCompletion();
+	c->arg = cb_arg;
+	c->cb = cb_complete;
+	return new AioCompletion(reinterpret_cast<AioCompletionImpl *>(c));
+}
+
+int Rados::mon_command(std::string cmd, const bufferlist &inbl, bufferlist *outbl, std::string *outs)
+{
+	FakeRadosClient *c = Client(client);
+	if (c == nullptr || !c->connected) {
+		return -ENOTCONN;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	usleep(cluster.PickLatency(FAKE_OP_MON));
+	bufferlist out;
+	int ret = cluster.MonCommand(cmd, &out, outs);
+	if (outbl != nullptr) {
+		outbl->claim(out);
+	}
+	return ret;
+}
+
+AioCompletion::~AioCompletion()
+{
+}
+
+void AioCompletion::release()
+{
+	reinterpret_cast<FakeCompletion *>(pc)->Put();
+	delete this;
+}
+
+IoCtx::IoCtx() : io_ctx_impl(nullptr)
+{
+}
+
+IoCtx::~IoCtx()
+{
+	close();
+}
+
+void IoCtx::close()
+{
+	delete Io(io_ctx_impl);
+	io_ctx_impl = nullptr;
+}
+
+int64_t IoCtx::get_id()
+{
+	return io_ctx_impl == nullptr ? -1 : Io(io_ctx_impl)->poolId;
+}
+
+std::string IoCtx::get_pool_name()
+{
+	return io_ctx_impl == nullptr ? "" : Io(io_ctx_impl)->poolName;
+}
+
+void IoCtx::set_namespace(const std::string &nspace)
+{
+	Io(io_ctx_impl)->nspace = nspace;
+}
+
+void IoCtx::set_osdmap_full_try()
+{
+}
+
+int IoCtx::operate(const std::string &oid, ObjectWriteOperation *op)
+{
+	if (io_ctx_impl == nullptr) {
+		return -EINVAL;
+	}
+	usleep(FakeCluster::Instance().PickLatency(FAKE_OP_WRITE));
+	return Execute(*Io(io_ctx_impl), oid, Op(op->impl), true);
+}
+
+int IoCtx::operate(const std::string &oid, ObjectReadOperation *op, bufferlist *pbl)
+{
+	if (io_ctx_impl == nullptr) {
+		return -EINVAL;
+	}
+	usleep(FakeCluster::Instance().PickLatency(FAKE_OP_READ));
+	return Execute(*Io(io_ctx_impl), oid, Op(op->impl), false);
+}
+
+int IoCtx::aio_operate(const std::string &oid, AioCompletion *c, ObjectWriteOperation *op)
+{
+	return AioOperate(io_ctx_impl, oid, c, op->impl, true);
+}
+
+int IoCtx::aio_operate(const std::string &oid, AioCompletion *c, ObjectReadOperation *op, bufferlist *pbl)
+{
+	return AioOperate(io_ctx_impl, oid, c, op->impl, false);
+}
+
+ObjectOperation::ObjectOperation() : impl(reinterpret_cast<ObjectOperationImpl *>(new FakeObjectOperation()))
+{
+}
+
+ObjectOperation::~ObjectOperation()
+{
+	Op(impl)->Put();
+}
+
+size_t ObjectOperation::size()
+{
+	return Op(impl)->steps.size();
+}
+
+/* only FAILOK does anything here: the last op's error goes to its prval and the rest still run */
+void ObjectOperation::set_op_flags2(int flags)
+{
+	std::vector<FakeOpStep> &steps = Op(impl)->steps;
+	if ((flags & LIBRADOS_OP_FLAG_FAILOK) == 0 || steps.empty()) {
+		return;
+	}
+	FakeOpStep step = steps.back();
+	steps.back() = [step](FakeOpCtx &ctx) {
+		step(ctx);
+		return 0;
+	};
+}
+
+void ObjectOperation::assert_exists()
+{
+	AddStep(impl, nullptr, [](FakeOpCtx &ctx) {
+		return ctx.obj == nullptr ? -ENOENT : 0;
+	});
+}
+
+void ObjectOperation::assert_version(uint64_t ver)
+{
+	AddStep(impl, nullptr, [ver](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		if (ver < ctx.obj->version) {
+			return -ERANGE;
+		}
+		return ver > ctx.obj->version ? -EOVERFLOW : 0;
+	});
+}
+
+void ObjectOperation::cmpext(uint64_t off, const bufferlist &cmp_bl, int *prval)
+{
+	bufferlist bl(cmp_bl);
+	AddStep(impl, prval, [off, bl](FakeOpCtx &ctx) {
+		std::string data;
+		if (ctx.obj != nullptr && off < ctx.obj->data.length()) {
+			ctx.obj->data.copy(off, std::min<uint64_t>(bl.length(), ctx.obj->data.length() - off), data);
+		}
+		data.resize(bl.length(), '\0');
+		std::string expect;
+		bl.copy(0, bl.length(), expect);
+		for (size_t i = 0; i < expect.size(); i++) {
+			if (expect[i] != data[i]) {
+				return -FAKE_MAX_ERRNO - static_cast<int>(i);
+			}
+		}
+		return 0;
+	});
+}
+
+void ObjectOperation::cmpxattr(const char *name, uint8_t op, const bufferlist &val)
+{
+	std::string key(name);
+	std::string expect = val.to_str();
+	AddStep(impl, nullptr, [key, op, expect](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		std::string cur;
+		auto it = ctx.obj->xattrs.find(key);
+		if (it != ctx.obj->xattrs.end()) {
+			cur = it->second.to_str();
+		}
+		return CmpMatch(expect.compare(cur), op) ? 0 : -ECANCELED;
+	});
+}
+
+void ObjectOperation::omap_cmp(const std::map<std::string, std::pair<bufferlist, int>> &assertions, int *prval)
+{
+	std::map<std::string, std::pair<bufferlist, int>> expect(assertions);
+	AddStep(impl, prval, [expect](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		for (auto &a : expect) {
+			auto it = ctx.obj->omap.find(a.first);
+			if (it == ctx.obj->omap.end()) {
+				return -ECANCELED;
+			}
+			int cmp = it->second.to_str().compare(a.second.first.to_str());
+			if (a.second.second != LIBRADOS_CMPXATTR_OP_EQ && a.second.second != LIBRADOS_CMPXATTR_OP_GT &&
+				a.second.second != LIBRADOS_CMPXATTR_OP_LT) {
+				return -EINVAL;
+			}
+			if (!CmpMatch(cmp, a.second.second)) {
+				return -ECANCELED;
+			}
+		}
+		return 0;
+	});
+}
+
+void ObjectOperation::exec(const char *cls, const char *method, bufferlist &inbl, bufferlist *obl, int *prval)
+{
+	std::string c(cls);
+	std::string m(method);
+	bufferlist in(inbl);
+	Op(impl)->hasExec = true;
+	AddStep(impl, prval, [c, m, in, obl](FakeOpCtx &ctx) mutable {
+		FakeClassMethod fn;
+		if (!FakeCluster::Instance().LookupMethod(c, m, &fn)) {
+			return -EOPNOTSUPP;
+		}
+		bufferlist out;
+		int r = fn(ctx.obj, in, &out);
+		if (obl != nullptr) {
+			obl->claim(out);
+		}
+		ctx.dirty = true;
+		return r;
+	});
+}
+
+void ObjectWriteOperation::create(bool exclusive)
+{
+	AddStep(impl, nullptr, [exclusive](FakeOpCtx &ctx) {
+		if (ctx.obj != nullptr) {
+			return exclusive ? -EEXIST : 0;
+		}
+		EnsureObject(ctx);
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::write(uint64_t off, const bufferlist &bl)
+{
+	bufferlist data(bl);
+	AddStep(impl, nullptr, [off, data](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		WriteData(*ctx.obj, off, data);
+		ctx.writeBytes += data.length();
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::write_full(const bufferlist &bl)
+{
+	bufferlist data(bl);
+	AddStep(impl, nullptr, [data](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		ctx.obj->data = data;
+		ctx.writeBytes += data.length();
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::writesame(uint64_t off, uint64_t write_len, const bufferlist &bl)
+{
+	bufferlist data(bl);
+	AddStep(impl, nullptr, [off, write_len, data](FakeOpCtx &ctx) {
+		if (data.length() == 0 || write_len % data.length() != 0) {
+			return -EINVAL;
+		}
+		bufferlist same;
+		for (uint64_t done = 0; done < write_len; done += data.length()) {
+			same.append(data);
+		}
+		EnsureObject(ctx);
+		WriteData(*ctx.obj, off, same);
+		ctx.writeBytes += write_len;
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::append(const bufferlist &bl)
+{
+	bufferlist data(bl);
+	AddStep(impl, nullptr, [data](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		WriteData(*ctx.obj, ctx.obj->data.length(), data);
+		ctx.writeBytes += data.length();
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::remove()
+{
+	AddStep(impl, nullptr, [](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		ctx.obj = nullptr;
+		ctx.dirty = true;
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::truncate(uint64_t off)
+{
+	AddStep(impl, nullptr, [off](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		TruncateData(*ctx.obj, off);
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::zero(uint64_t off, uint64_t len)
+{
+	AddStep(impl, nullptr, [off, len](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		uint64_t size = ctx.obj->data.length();
+		if (off < size) {
+			bufferlist zeros;
+			zeros.append_zero(std::min(len, size - off));
+			WriteData(*ctx.obj, off, zeros);
+		}
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::rmxattr(const char *name)
+{
+	std::string key(name);
+	AddStep(impl, nullptr, [key](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		if (ctx.obj->xattrs.erase(key) == 0) {
+			return -ENODATA;
+		}
+		ctx.dirty = true;
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::setxattr(const char *name, const bufferlist &bl)
+{
+	std::string key(name);
+	bufferlist val(bl);
+	AddStep(impl, nullptr, [key, val](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		ctx.obj->xattrs[key] = val;
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::omap_set(const std::map<std::string, bufferlist> &map)
+{
+	std::map<std::string, bufferlist> kvs(map);
+	AddStep(impl, nullptr, [kvs](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		for (auto &kv : kvs) {
+			ctx.obj->omap[kv.first] = kv.second;
+		}
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::omap_rm_keys(const std::set<std::string> &to_rm)
+{
+	std::set<std::string> keys(to_rm);
+	AddStep(impl, nullptr, [keys](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		for (auto &key : keys) {
+			ctx.obj->omap.erase(key);
+		}
+		ctx.dirty = true;
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::omap_clear()
+{
+	AddStep(impl, nullptr, [](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		ctx.obj->omap.clear();
+		ctx.obj->omapHeader.clear();
+		ctx.dirty = true;
+		return 0;
+	});
+}
+
+void ObjectWriteOperation::set_alloc_hint2(uint64_t expected_object_size, uint64_t expected_write_size,
+	uint32_t flags)
+{
+	AddStep(impl, nullptr, [](FakeOpCtx &ctx) {
+		EnsureObject(ctx);
+		return 0;
+	});
+}
+
+void ObjectReadOperation::stat(uint64_t *psize, time_t *pmtime, int *prval)
+{
+	AddStep(impl, prval, [psize, pmtime](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		if (psize != nullptr) {
+			*psize = ctx.obj->data.length();
+		}
+		if (pmtime != nullptr) {
+			*pmtime = ctx.obj->mtime;
+		}
+		return 0;
+	});
+}
+
+void ObjectReadOperation::getxattr(const char *name, bufferlist *pbl, int *prval)
+{
+	std::string key(name);
+	AddStep(impl, prval, [key, pbl](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		auto it = ctx.obj->xattrs.find(key);
+		if (it == ctx.obj->xattrs.end()) {
+			return -ENODATA;
+		}
+		*pbl = it->second;
+		return 0;
+	});
+}
+
+void ObjectReadOperation::getxattrs(std::map<std::string, bufferlist> *pattrs, int *prval)
+{
+	AddStep(impl, prval, [pattrs](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		*pattrs = ctx.obj->xattrs;
+		return 0;
+	});
+}
+
+void ObjectReadOperation::read(size_t off, uint64_t len, bufferlist *pbl, int *prval)
+{
+	AddStep(impl, prval, [off, len, pbl](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		uint64_t size = ctx.obj->data.length();
+		bufferlist out;
+		if (off < size) {
+			uint64_t readLen = (len == 0) ? size - off : std::min<uint64_t>(len, size - off);
+			out.substr_of(ctx.obj->data, off, readLen);
+		}
+		if (out.length() > 0 && FakeCluster::Instance().CheckCorruption(ctx.oid)) {
+			std::string data;
+			out.copy(0, out.length(), data);
+			data[data.size() / 2] ^= 0x5a;
+			out.clear();
+			out.append(data);
+		}
+		ctx.readBytes += out.length();
+		if (pbl != nullptr) {
+			pbl->claim(out);
+		}
+		return 0;
+	});
+}
+
+void ObjectReadOperation::checksum(rados_checksum_type_t type, const bufferlist &init_value_bl, uint64_t off,
+	size_t len, size_t chunk_size, bufferlist *pbl, int *prval)
+{
+	bufferlist init(init_value_bl);
+	AddStep(impl, prval, [type, init, off, len, chunk_size, pbl](FakeOpCtx &ctx) {
+		if (type != LIBRADOS_CHECKSUM_TYPE_CRC32C) {
+			return -EOPNOTSUPP;
+		}
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		uint64_t size = ctx.obj->data.length();
+		uint64_t sumLen = (len == 0) ? size : len;
+		uint64_t chunk = (chunk_size == 0) ? sumLen : chunk_size;
+		if (init.length() != sizeof(uint32_t) || off + sumLen > size || chunk == 0 || sumLen % chunk != 0) {
+			return -EINVAL;
+		}
+		uint32_t seed = 0;
+		init.copy(0, sizeof(seed), reinterpret_cast<char *>(&seed));
+		bufferlist out;
+		uint32_t count = sumLen / chunk;
+		out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+		for (uint64_t pos = off; pos < off + sumLen; pos += chunk) {
+			std::string data;
+			ctx.obj->data.copy(pos, chunk, data);
+			uint32_t crc = ceph_crc32c(seed, reinterpret_cast<const unsigned char *>(data.data()), data.size());
+			out.append(reinterpret_cast<const char *>(&crc), sizeof(crc));
+		}
+		ctx.readBytes += sumLen;
+		if (pbl != nullptr) {
+			pbl->claim(out);
+		}
+		return 0;
+	});
+}
+
+void ObjectReadOperation::omap_get_vals2(const std::string &start_after, uint64_t max_return,
+	std::map<std::string, bufferlist> *out_vals, bool *pmore, int *prval)
+{
+	std::string start(start_after);
+	AddStep(impl, prval, [start, max_return, out_vals, pmore](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		out_vals->clear();
+		auto it = ctx.obj->omap.upper_bound(start);
+		for (; it != ctx.obj->omap.end() && out_vals->size() < max_return; it++) {
+			(*out_vals)[it->first] = it->second;
+		}
+		if (pmore != nullptr) {
+			*pmore = (it != ctx.obj->omap.end());
+		}
+		return 0;
+	});
+}
+
+void ObjectReadOperation::omap_get_keys2(const std::string &start_after, uint64_t max_return,
+	std::set<std::string> *out_keys, bool *pmore, int *prval)
+{
+	std::string start(start_after);
+	AddStep(impl, prval, [start, max_return, out_keys, pmore](FakeOpCtx &ctx) {
+		if (ctx.obj == nullptr) {
+			return -ENOENT;
+		}
+		out_keys->clear();
+		auto it = ctx.obj->omap.upper_bound(start);
+		for (; it != ctx.obj->omap.end() && out_keys->size() < max_return; it++) {
+			out_keys->insert(it->first);
+		}
+		if (pmore != nullptr) {
+			*pmore = (it != ctx.obj->omap.end());
+		}
+		return 0;
+	});
+}
+
+}
+
+extern "C" {
+
+int rados_create(rados_t *cluster, const char * const id)
+{
+	*cluster = new FakeRadosClient();
+	return 0;
+}
+
+int rados_conf_read_file(rados_t cluster, const char *path)
+{
+	return ConfReadFile(reinterpret_cast<FakeRadosClient *>(cluster), path);
+}
+
+int rados_conf_set(rados_t cluster, const char *option, const char *value)
+{
+	if (cluster == nullptr) {
+		return -EINVAL;
+	}
+	reinterpret_cast<FakeRadosClient *>(cluster)->conf[option] = value;
+	return 0;
+}
+
+int rados_conf_get(rados_t cluster, const char *option, char *buf, size_t len)
+{
+	std::string val;
+	int ret = ConfGet(reinterpret_cast<FakeRadosClient *>(cluster), option, val);
+	if (ret != 0) {
+		return ret;
+	}
+	if (val.length() >= len) {
+		return -ENAMETOOLONG;
+	}
+	strcpy(buf, val.c_str());
+	return 0;
+}
+
+int rados_connect(rados_t cluster)
+{
+	return Connect(reinterpret_cast<FakeRadosClient *>(cluster));
+}
+
+int rados_cluster_stat(rados_t cluster, struct rados_cluster_stat_t *result)
+{
+	return ClusterStat(reinterpret_cast<FakeRadosClient *>(cluster), result->kb, result->kb_used,
+		result->kb_avail, result->num_objects);
+}
+
+void rados_shutdown(rados_t cluster)
+{
+	delete reinterpret_cast<FakeRadosClient *>(cluster);
+}
+
+int rados_aio_get_return_value(rados_completion_t c)
+{
+	return reinterpret_cast<FakeCompletion *>(c)->rval;
+}
+
+}
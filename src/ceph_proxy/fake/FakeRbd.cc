@@ -0,0 +1,319 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "rbd/librbd.hpp"
+#include "FakeCluster.h"
+
+/*
+ * librbd entry points used by RbdWrapper. Images only track which objects
+ * were written in each snapshot epoch, so diffs are object granular and the
+ * namespace of the IoCtx is ignored.
+ */
+
+#define FAKE_HEAD_SNAP UINT64_MAX
+
+struct FakeImageCtx {
+	int64_t poolId = -1;
+	std::string imageId;
+	uint64_t snapId = FAKE_HEAD_SNAP;
+};
+
+static FakeImageCtx *ImageCtx(librbd::image_ctx_t ctx)
+{
+	return reinterpret_cast<FakeImageCtx *>(ctx);
+}
+
+/* index of the snapshot in image->snaps, image->snaps.size() is the head */
+static int SnapIndex(FakeImage *image, uint64_t snapId, size_t *idx)
+{
+	if (snapId == FAKE_HEAD_SNAP) {
+		*idx = image->snaps.size();
+		return 0;
+	}
+	for (size_t i = 0; i < image->snaps.size(); i++) {
+		if (image->snaps[i].id == snapId) {
+			*idx = i;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+static int OpenImage(librados::IoCtx &io, librbd::Image &image, const char *name, const char *id,
+	const char *snapName)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	int ret = cluster.CheckFault(FAKE_OP_RBD, name != nullptr ? name : id);
+	if (ret != 0) {
+		return ret;
+	}
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakeImage *img = (name != nullptr) ? cluster.LookupImage(io.get_id(), name) :
+		cluster.LookupImageById(io.get_id(), id);
+	if (img == nullptr) {
+		return -ENOENT;
+	}
+	FakeImageCtx *ctx = new FakeImageCtx();
+	ctx->poolId = io.get_id();
+	ctx->imageId = img->id;
+	if (snapName != nullptr) {
+		auto it = std::find_if(img->snaps.begin(), img->snaps.end(),
+			[snapName](const FakeImageSnap &s) { return s.name == snapName; });
+		if (it == img->snaps.end()) {
+			delete ctx;
+			return -ENOENT;
+		}
+		ctx->snapId = it->id;
+	}
+	image.close();
+	image.ctx = reinterpret_cast<librbd::image_ctx_t>(ctx);
+	return 0;
+}
+
+static int RemoveSnap(FakeImageCtx *ctx, const char *snapName, uint64_t snapId)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakeImage *image = cluster.LookupImageById(ctx->poolId, ctx->imageId);
+	if (image == nullptr) {
+		return -ENOENT;
+	}
+	for (size_t i = 0; i < image->snaps.size(); i++) {
+		if ((snapName != nullptr && image->snaps[i].name == snapName) ||
+			(snapName == nullptr && image->snaps[i].id == snapId)) {
+			/* the objects written before the snap now belong to the next epoch */
+			std::set<uint64_t> &next = (i + 1 < image->snaps.size()) ? image->snaps[i + 1].written : image->written;
+			next.insert(image->snaps[i].written.begin(), image->snaps[i].written.end());
+			image->snaps.erase(image->snaps.begin() + i);
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+namespace librbd {
+
+ProgressContext::~ProgressContext()
+{
+}
+
+RBD::RBD()
+{
+}
+
+RBD::~RBD()
+{
+}
+
+int RBD::open(librados::IoCtx &io_ctx, Image &image, const char *name)
+{
+	return OpenImage(io_ctx, image, name, nullptr, nullptr);
+}
+
+int RBD::open_by_id(librados::IoCtx &io_ctx, Image &image, const char *id)
+{
+	return OpenImage(io_ctx, image, nullptr, id, nullptr);
+}
+
+int RBD::open_read_only(librados::IoCtx &io_ctx, Image &image, const char *name, const char *snapname)
+{
+	return OpenImage(io_ctx, image, name, nullptr, snapname);
+}
+
+int RBD::list2(librados::IoCtx &io_ctx, std::vector<image_spec_t> *images)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	int ret = cluster.CheckFault(FAKE_OP_RBD, io_ctx.get_pool_name());
+	if (ret != 0) {
+		return ret;
+	}
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakePool *pool = cluster.LookupPool(io_ctx.get_id());
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	images->clear();
+	for (auto &image : pool->images) {
+		images->push_back({ image.second.id, image.second.name });
+	}
+	return 0;
+}
+
+int RBD::namespace_exists(librados::IoCtx &io_ctx, const char *namespace_name, bool *exists)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakePool *pool = cluster.LookupPool(io_ctx.get_id());
+	if (pool == nullptr) {
+		return -ENOENT;
+	}
+	*exists = pool->namespaces.count(namespace_name) != 0;
+	return 0;
+}
+
+Image::Image() : ctx(nullptr)
+{
+}
+
+Image::~Image()
+{
+	close();
+}
+
+int Image::close()
+{
+	delete ImageCtx(ctx);
+	ctx = nullptr;
+	return 0;
+}
+
+int Image::stat(image_info_t &info, size_t infosize)
+{
+	FakeImageCtx *c = ImageCtx(ctx);
+	if (c == nullptr) {
+		return -EINVAL;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakeImage *image = cluster.LookupImageById(c->poolId, c->imageId);
+	size_t idx = 0;
+	if (image == nullptr || SnapIndex(image, c->snapId, &idx) != 0) {
+		return -ENOENT;
+	}
+	memset(&info, 0, sizeof(info));
+	info.size = (idx == image->snaps.size()) ? image->size : image->snaps[idx].size;
+	info.obj_size = 1ULL << image->order;
+	info.num_objs = (info.size + info.obj_size - 1) / info.obj_size;
+	info.order = image->order;
+	snprintf(info.block_name_prefix, sizeof(info.block_name_prefix), "rbd_data.%s", image->id.c_str());
+	info.parent_pool = -1;
+	return 0;
+}
+
+int Image::get_name(std::string *name)
+{
+	FakeImageCtx *c = ImageCtx(ctx);
+	if (c == nullptr) {
+		return -EINVAL;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakeImage *image = cluster.LookupImageById(c->poolId, c->imageId);
+	if (image == nullptr) {
+		return -ENOENT;
+	}
+	*name = image->name;
+	return 0;
+}
+
+int Image::get_id(std::string *id)
+{
+	FakeImageCtx *c = ImageCtx(ctx);
+	if (c == nullptr) {
+		return -EINVAL;
+	}
+	*id = c->imageId;
+	return 0;
+}
+
+int Image::snap_list(std::vector<snap_info_t> &snaps)
+{
+	FakeImageCtx *c = ImageCtx(ctx);
+	if (c == nullptr) {
+		return -EINVAL;
+	}
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::lock_guard<std::mutex> l(cluster.lock);
+	FakeImage *image = cluster.LookupImageById(c->poolId, c->imageId);
+	if (image == nullptr) {
+		return -ENOENT;
+	}
+	snaps.clear();
+	for (auto &s : image->snaps) {
+		snaps.push_back({ s.id, s.size, s.name });
+	}
+	return 0;
+}
+
+int Image::snap_remove2(const char *snap_name, uint32_t flags, ProgressContext &pctx)
+{
+	FakeImageCtx *c = ImageCtx(ctx);
+	if (c == nullptr || snap_name == nullptr) {
+		return -EINVAL;
+	}
+	return RemoveSnap(c, snap_name, 0);
+}
+
+int Image::snap_remove_by_id(uint64_t snap_id)
+{
+	FakeImageCtx *c = ImageCtx(ctx);
+	if (c == nullptr) {
+		return -EINVAL;
+	}
+	return RemoveSnap(c, nullptr, snap_id);
+}
+
+int Image::diff_iterate2(const char *fromsnapname, uint64_t ofs, uint64_t len, bool include_parent,
+	bool whole_object, int (*cb)(uint64_t, size_t, int, void *), void *arg)
+{
+	FakeImageCtx *c = ImageCtx(ctx);
+	if (c == nullptr) {
+		return -EINVAL;
+	}
+	std::set<uint64_t> changed;
+	uint64_t objSize = 0;
+	uint64_t size = 0;
+	{
+		FakeCluster &cluster = FakeCluster::Instance();
+		std::lock_guard<std::mutex> l(cluster.lock);
+		FakeImage *image = cluster.LookupImageById(c->poolId, c->imageId);
+		size_t view = 0;
+		if (image == nullptr || SnapIndex(image, c->snapId, &view) != 0) {
+			return -ENOENT;
+		}
+		size_t from = 0;
+		if (fromsnapname != nullptr) {
+			auto it = std::find_if(image->snaps.begin(), image->snaps.end(),
+				[fromsnapname](const FakeImageSnap &s) { return s.name == fromsnapname; });
+			if (it == image->snaps.end()) {
+				return -ENOENT;
+			}
+			from = it - image->snaps.begin() + 1;
+			if (from > view) {
+				return -EINVAL;
+			}
+		}
+		for (size_t i = from; i <= view; i++) {
+			std::set<uint64_t> &written = (i == image->snaps.size()) ? image->written : image->snaps[i].written;
+			changed.insert(written.begin(), written.end());
+		}
+		objSize = 1ULL << image->order;
+		size = (view == image->snaps.size()) ? image->size : image->snaps[view].size;
+	}
+
+	/* callbacks run without the cluster lock */
+	uint64_t end = std::min(ofs + len, size);
+	for (uint64_t objNo : changed) {
+		uint64_t objOff = std::max(objNo * objSize, ofs);
+		uint64_t objEnd = std::min((objNo + 1) * objSize, end);
+		if (objOff >= objEnd) {
+			continue;
+		}
+		int ret = cb(objOff, objEnd - objOff, 1, arg);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+}
@@ -0,0 +1,279 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef _PROXY_BENCH_H_
+#define _PROXY_BENCH_H_
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CephProxyInterface.h"
+
+/*
+ * 4KB random reads and writes through the proxy against the in-memory
+ * cluster with a fixed number of ops in flight, shared by the proxy benches.
+ */
+
+#define PAGE_SIZE_4K 4096
+
+struct BenchConf {
+	uint32_t ops = 200000;
+	uint32_t depth = 32;
+	uint32_t objects = 1024;
+	/* the fake keeps whole objects in memory */
+	uint64_t objectSize = 64ULL << 10;
+	uint32_t readPct = 50;
+	int cpu = 0;
+	/* nonzero turns writes into this many sequential streams, one object each */
+	uint32_t streams = 0;
+};
+
+/* set before any thread starts, the proxy worker and the fake finisher inherit it */
+static inline int BenchPinCpu(int cpu)
+{
+	if (cpu < 0) {
+		return 0;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		fprintf(stderr, "pin to cpu %d failed: %d\n", cpu, errno);
+		return -errno;
+	}
+	return 0;
+}
+
+struct BenchSlot {
+	struct Bench *bench;
+	ceph_proxy_op_t op;
+	completion_t comp;
+	bool isRead;
+	int prval;
+	SGL_S sgl;
+};
+
+struct Bench {
+	ceph_proxy_t proxy;
+	int64_t poolId;
+	BenchConf conf;
+	std::mt19937_64 rng { 42 };
+	std::vector<BenchSlot> slots;
+	std::vector<std::string> names;
+	/* writes the last page of each object in turn, so every read lands in data */
+	bool filling = false;
+	uint32_t fillNext = 0;
+	uint32_t streamNext = 0;
+	std::vector<uint64_t> streamOff;
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::vector<BenchSlot *> idle;
+	uint32_t errors = 0;
+	std::vector<ceph_proxy_op_t> batchOps;
+	std::vector<completion_t> batchComps;
+	/* set during RunRing, each slot then keeps one ring completion */
+	proxy_cq_t cq = nullptr;
+
+	Bench(ceph_proxy_t p, int64_t pool, const BenchConf &c) : proxy(p), poolId(pool), conf(c),
+		streamOff(c.streams, 0)
+	{
+		slots.resize(conf.depth);
+		for (auto &s : slots) {
+			memset(&s.sgl, 0, sizeof(s.sgl));
+			s.bench = this;
+			s.sgl.entrys[0].buf = static_cast<char *>(malloc(PAGE_SIZE_4K));
+			s.sgl.entrys[0].len = PAGE_SIZE_4K;
+			s.sgl.entrySumInSgl = 1;
+			memset(s.sgl.entrys[0].buf, 'w', PAGE_SIZE_4K);
+			idle.push_back(&s);
+		}
+		/* rbd data object names, longer than the inline string buffer */
+		for (uint32_t i = 0; i < conf.objects; i++) {
+			char name[64];
+			snprintf(name, sizeof(name), "rbd_data.1f2e3d4c5b6a.%016x", i);
+			names.push_back(name);
+		}
+	}
+
+	~Bench()
+	{
+		for (auto &s : slots) {
+			free(s.sgl.entrys[0].buf);
+		}
+	}
+
+	static void Done(int ret, void *arg)
+	{
+		BenchSlot *s = static_cast<BenchSlot *>(arg);
+		Bench *b = s->bench;
+		if (s->isRead) {
+			CephProxyReadOpRelease(s->op);
+		} else {
+			CephProxyWriteOpRelease(s->op);
+		}
+		CephProxyCompletionDestroy(s->comp);
+		std::lock_guard<std::mutex> l(b->lock);
+		if (ret != 0) {
+			b->errors++;
+		}
+		b->idle.push_back(s);
+		if (b->idle.size() == 1 || b->idle.size() == b->slots.size()) {
+			b->cond.notify_one();
+		}
+	}
+
+	/* builds the op and its completion, not queued yet */
+	int Prepare(BenchSlot *s)
+	{
+		const std::string *oid = &names[filling ? fillNext++ % names.size() : rng() % names.size()];
+		uint64_t off = (rng() % (conf.objectSize / PAGE_SIZE_4K)) * PAGE_SIZE_4K;
+		s->isRead = !filling && rng() % 100 < conf.readPct;
+		if (filling) {
+			off = conf.objectSize - PAGE_SIZE_4K;
+		} else if (conf.streams != 0 && !s->isRead) {
+			uint32_t stream = streamNext++ % conf.streams;
+			oid = &names[stream % names.size()];
+			off = streamOff[stream];
+			streamOff[stream] = (off + PAGE_SIZE_4K) % conf.objectSize;
+		}
+		if (s->isRead) {
+			if (CephProxyReadOpInit2(&s->op, poolId, oid->c_str()) != 0) {
+				return -ENOMEM;
+			}
+			CephProxyReadOpReadSGL(s->op, off, PAGE_SIZE_4K, &s->sgl, &s->prval, 0);
+		} else {
+			if (CephProxyWriteOpInit2(&s->op, poolId, oid->c_str()) != 0) {
+				return -ENOMEM;
+			}
+			CephProxyWriteOpWriteSGL(s->op, &s->sgl, PAGE_SIZE_4K, off, nullptr, 0);
+		}
+		if (cq != nullptr) {
+			return 0;
+		}
+		s->comp = CephProxyCreateCompletion(Done, s);
+		return s->comp == nullptr ? -ENOMEM : 0;
+	}
+
+	int Submit(BenchSlot *s)
+	{
+		int ret = Prepare(s);
+		return ret != 0 ? ret : CephProxyQueueOp(proxy, s->op, s->comp);
+	}
+
+	/* every slot that is free goes out in one CephProxyQueueOps call */
+	int SubmitBatch(std::vector<BenchSlot *> &batch)
+	{
+		std::vector<ceph_proxy_op_t> &ops = batchOps;
+		std::vector<completion_t> &comps = batchComps;
+		ops.clear();
+		comps.clear();
+		for (auto s : batch) {
+			int ret = Prepare(s);
+			if (ret != 0) {
+				return ret;
+			}
+			ops.push_back(s->op);
+			comps.push_back(s->comp);
+		}
+		int32_t queued = CephProxyQueueOps(proxy, ops.data(), comps.data(), ops.size());
+		return queued == (int32_t)ops.size() ? 0 : -EBUSY;
+	}
+
+	/* keeps depth ops in flight until count have been submitted, then drains */
+	int Run(uint32_t count, bool batched = false)
+	{
+		std::unique_lock<std::mutex> l(lock);
+		std::vector<BenchSlot *> batch;
+		for (uint32_t n = 0; n < count; n += batch.size()) {
+			cond.wait(l, [this]() { return !idle.empty(); });
+			size_t take = batched ? std::min<size_t>(idle.size(), count - n) : 1;
+			batch.assign(idle.end() - take, idle.end());
+			idle.resize(idle.size() - take);
+			l.unlock();
+			int ret = batched ? SubmitBatch(batch) : Submit(batch[0]);
+			l.lock();
+			if (ret != 0) {
+				fprintf(stderr, "submit failed: %d\n", ret);
+				return ret;
+			}
+		}
+		cond.wait(l, [this]() { return idle.size() == slots.size(); });
+		return errors == 0 ? 0 : -EIO;
+	}
+
+	/* as Run batched, but the ops are reaped from ring on this thread instead of calling back */
+	int RunRing(uint32_t count, proxy_cq_t ring)
+	{
+		cq = ring;
+		for (auto &s : slots) {
+			s.comp = CephProxyCreateRingCompletion(cq, &s);
+			if (s.comp == nullptr) {
+				return -ENOMEM;
+			}
+		}
+		std::vector<ProxyCqEntry> entries(slots.size());
+		std::vector<BenchSlot *> batch;
+		idle.swap(batch);
+		uint32_t submitted = 0;
+		uint32_t inflight = 0;
+		while (true) {
+			size_t take = std::min<size_t>(batch.size(), count - submitted);
+			idle.insert(idle.end(), batch.begin() + take, batch.end());
+			batch.resize(take);
+			if (take > 0) {
+				int ret = SubmitBatch(batch);
+				if (ret != 0) {
+					fprintf(stderr, "submit failed: %d\n", ret);
+					return ret;
+				}
+				submitted += take;
+				inflight += take;
+			}
+			batch.clear();
+			if (inflight == 0) {
+				break;
+			}
+			int n = CephProxyCompletionRingWait(cq, entries.data(), entries.size(), 1, -1);
+			if (n < 0) {
+				fprintf(stderr, "ring wait failed: %d\n", n);
+				return n;
+			}
+			for (int i = 0; i < n; i++) {
+				BenchSlot *s = static_cast<BenchSlot *>(entries[i].userData);
+				if (s->isRead) {
+					CephProxyReadOpRelease(s->op);
+				} else {
+					CephProxyWriteOpRelease(s->op);
+				}
+				if (entries[i].ret != 0) {
+					errors++;
+				}
+				batch.push_back(s);
+			}
+			inflight -= n;
+		}
+		idle.insert(idle.end(), batch.begin(), batch.end());
+		for (auto &s : slots) {
+			CephProxyCompletionDestroy(s.comp);
+			s.comp = nullptr;
+		}
+		cq = nullptr;
+		return errors == 0 ? 0 : -EIO;
+	}
+};
+
+#endif
@@ -0,0 +1,245 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FakeCluster.h"
+#include "ProxyBench.h"
+
+/*
+ * Rounds of calls to a stub class method on different objects, each call
+ * queued as its own exec op with its own completion against all of a round
+ * in one CephProxyClsExecBatch.
+ */
+
+struct ClsRound {
+	std::mutex lock;
+	std::condition_variable cond;
+	uint32_t left = 0;
+	uint32_t errors = 0;
+};
+
+static void ClsDone(int ret, void *arg)
+{
+	ClsRound *r = static_cast<ClsRound *>(arg);
+	std::lock_guard<std::mutex> l(r->lock);
+	if (ret != 0) {
+		r->errors++;
+	}
+	if (--r->left == 0) {
+		r->cond.notify_all();
+	}
+}
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_cls_bench [options]\n"
+		"  --calls n           calls timed per mode (200000)\n"
+		"  --batch n           calls per round (64)\n"
+		"  --objects n         objects the calls spread over (1024)\n"
+		"  --write             call the write method instead of the read one\n"
+		"  --latency-us n      fake osd latency of each op (0)\n"
+		"  --cpu n             core every thread is pinned to, -1 leaves them free (-1)\n");
+}
+
+static void RegisterBenchClass()
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	cluster.RegisterMethod("bench", "get", [](FakeObjectRef &obj, ceph::bufferlist &in, ceph::bufferlist *out) {
+		if (obj != nullptr) {
+			out->append(obj->data);
+		}
+		return 0;
+	});
+	cluster.RegisterMethod("bench", "set", [](FakeObjectRef &obj, ceph::bufferlist &in, ceph::bufferlist *out) {
+		if (obj == nullptr) {
+			obj = std::make_shared<FakeObject>();
+		}
+		obj->data = in;
+		return 0;
+	});
+}
+
+struct ClsBench {
+	ceph_proxy_t proxy;
+	int64_t poolId;
+	proxy_cls_method_t method;
+	uint32_t batch;
+	std::vector<std::string> names;
+	std::vector<ProxyClsCall> calls;
+	std::vector<uint64_t> outs;
+	std::vector<ceph_proxy_op_t> ops;
+	std::vector<completion_t> comps;
+	ClsRound round;
+	completion_t batchComp = nullptr;
+	uint32_t next = 0;
+
+	ClsBench(ceph_proxy_t p, int64_t pool, proxy_cls_method_t m, uint32_t b, uint32_t objects)
+		: proxy(p), poolId(pool), method(m), batch(b), calls(b), outs(b), ops(b), comps(b)
+	{
+		for (uint32_t i = 0; i < objects; i++) {
+			names.push_back("cls_bench_" + std::to_string(i));
+		}
+		for (uint32_t i = 0; i < batch; i++) {
+			comps[i] = CephProxyCreateCompletion(ClsDone, &round);
+		}
+		batchComp = CephProxyCreateCompletion(ClsDone, &round);
+	}
+
+	~ClsBench()
+	{
+		for (auto c : comps) {
+			CephProxyCompletionDestroy(c);
+		}
+		CephProxyCompletionDestroy(batchComp);
+	}
+
+	void Fill(bool isWrite)
+	{
+		for (uint32_t i = 0; i < batch; i++) {
+			ProxyClsCall &call = calls[i];
+			call.oid = names[next++ % names.size()].c_str();
+			call.inBuf = isWrite ? reinterpret_cast<const char *>(&next) : nullptr;
+			call.inLen = isWrite ? sizeof(next) : 0;
+			call.outBuf = isWrite ? nullptr : reinterpret_cast<char *>(&outs[i]);
+			call.outLen = isWrite ? 0 : sizeof(outs[i]);
+		}
+	}
+
+	int Wait()
+	{
+		std::unique_lock<std::mutex> l(round.lock);
+		round.cond.wait(l, [this]() { return round.left == 0; });
+		return round.errors == 0 ? 0 : -EIO;
+	}
+
+	/* one exec op and completion per call, the round is queued op by op */
+	int RunSingle(bool isWrite)
+	{
+		Fill(isWrite);
+		round.left = batch;
+		for (uint32_t i = 0; i < batch; i++) {
+			ProxyClsCall &call = calls[i];
+			int ret = isWrite ? CephProxyWriteOpInit2(&ops[i], poolId, call.oid) :
+				CephProxyReadOpInit2(&ops[i], poolId, call.oid);
+			if (ret != 0) {
+				return ret;
+			}
+			if (isWrite) {
+				CephProxyWriteOpExec(ops[i], method, call.inBuf, call.inLen, nullptr);
+			} else {
+				CephProxyReadOpExec(ops[i], method, nullptr, 0, call.outBuf, call.outLen, &call.usedLen, nullptr);
+			}
+			ret = CephProxyQueueOp(proxy, ops[i], comps[i]);
+			if (ret != 0) {
+				return ret;
+			}
+		}
+		int ret = Wait();
+		for (uint32_t i = 0; i < batch; i++) {
+			if (isWrite) {
+				CephProxyWriteOpRelease(ops[i]);
+			} else {
+				CephProxyReadOpRelease(ops[i]);
+			}
+		}
+		return ret;
+	}
+
+	int RunBatch(bool isWrite)
+	{
+		Fill(isWrite);
+		round.left = 1;
+		int ret = CephProxyClsExecBatch(proxy, poolId, method, calls.data(), batch, batchComp);
+		return ret != 0 ? ret : Wait();
+	}
+};
+
+int main(int argc, char **argv)
+{
+	uint32_t total = 200000;
+	uint32_t batch = 64;
+	uint32_t objects = 1024;
+	uint32_t latencyUs = 0;
+	bool isWrite = false;
+	int cpu = -1;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (arg == "--write") {
+			isWrite = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long n = strtol(argv[++i], nullptr, 10);
+		if (arg == "--calls" && n > 0) {
+			total = n;
+		} else if (arg == "--batch" && n > 0) {
+			batch = n;
+		} else if (arg == "--objects" && n > 0) {
+			objects = n;
+		} else if (arg == "--latency-us" && n >= 0) {
+			latencyUs = n;
+		} else if (arg == "--cpu") {
+			cpu = n;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+
+	if (BenchPinCpu(cpu) != 0) {
+		return 1;
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t poolId = cluster.CreatePool("rbd");
+	ceph_proxy_t proxy = nullptr;
+	if (poolId <= 0 || CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+		fprintf(stderr, "proxy init failed\n");
+		return 1;
+	}
+	RegisterBenchClass();
+	cluster.SetLatency(FAKE_OP_READ, latencyUs);
+	cluster.SetLatency(FAKE_OP_WRITE, latencyUs);
+
+	proxy_cls_method_t method = nullptr;
+	int ret = CephProxyClsMethodRegister("bench", isWrite ? "set" : "get",
+		isWrite ? PROXY_CLS_METHOD_WRITE : 0, &method);
+	if (ret == 0) {
+		ClsBench bench(proxy, poolId, method, batch, objects);
+		printf("%-7s %10s %12s\n", "mode", "calls", "calls/s");
+		for (int batched = 0; batched <= 1 && ret == 0; batched++) {
+			uint32_t rounds = (total + batch - 1) / batch;
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t r = 0; r < rounds && ret == 0; r++) {
+				ret = batched ? bench.RunBatch(isWrite) : bench.RunSingle(isWrite);
+			}
+			double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("%-7s %10u %12.0f\n", batched ? "batch" : "single", rounds * batch, rounds * batch / sec);
+		}
+		CephProxyClsMethodRelease(method);
+	}
+	if (ret != 0) {
+		fprintf(stderr, "bench failed: %d\n", ret);
+	}
+
+	CephProxyShutdown(proxy);
+	return ret == 0 ? 0 : 1;
+}
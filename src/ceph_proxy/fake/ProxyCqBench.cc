@@ -0,0 +1,126 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <chrono>
+#include <string>
+
+#include "FakeCluster.h"
+#include "ProxyBench.h"
+
+/*
+ * 4KB IO through the proxy at a high queue depth, completed by callbacks on
+ * the finisher against reaped from a completion ring by the submitting
+ * thread. Both submit every free slot in one CephProxyQueueOps call. The
+ * context switches of the process show the cross-thread wakeups each costs.
+ */
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_cq_bench [options]\n"
+		"  --ops n             ops timed per mode (200000)\n"
+		"  --depth n           ops in flight (256)\n"
+		"  --read-pct n        share of reads (50)\n"
+		"  --latency-us n      fake osd latency of each op (0)\n"
+		"  --cpu n             core every thread is pinned to, -1 leaves them free (-1)\n");
+}
+
+static long ContextSwitches()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+int main(int argc, char **argv)
+{
+	BenchConf conf;
+	conf.depth = 256;
+	conf.cpu = -1;
+	uint32_t latencyUs = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long n = strtol(argv[++i], nullptr, 10);
+		if (arg == "--ops" && n > 0) {
+			conf.ops = n;
+		} else if (arg == "--depth" && n > 0) {
+			conf.depth = n;
+		} else if (arg == "--read-pct" && n >= 0 && n <= 100) {
+			conf.readPct = n;
+		} else if (arg == "--latency-us" && n >= 0) {
+			latencyUs = n;
+		} else if (arg == "--cpu") {
+			conf.cpu = n;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+
+	if (BenchPinCpu(conf.cpu) != 0) {
+		return 1;
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t poolId = cluster.CreatePool("rbd");
+	if (poolId <= 0) {
+		fprintf(stderr, "create pool failed\n");
+		return 1;
+	}
+	cluster.SetLatency(FAKE_OP_READ, latencyUs);
+	cluster.SetLatency(FAKE_OP_WRITE, latencyUs);
+
+	ceph_proxy_t proxy = nullptr;
+	if (CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+		fprintf(stderr, "proxy init failed\n");
+		return 1;
+	}
+	proxy_cq_t cq = nullptr;
+	if (CephProxyCompletionRingCreate(conf.depth, &cq) != 0) {
+		fprintf(stderr, "create completion ring failed\n");
+		CephProxyShutdown(proxy);
+		return 1;
+	}
+
+	int ret = 0;
+	{
+		Bench bench(proxy, poolId, conf);
+		bench.filling = true;
+		ret = bench.Run(conf.objects);
+		bench.filling = false;
+
+		printf("%-9s %10s %12s %10s %12s\n", "mode", "ops", "iops", "MB/s", "ctxsw/op");
+		for (int ring = 0; ring <= 1 && ret == 0; ring++) {
+			ret = ring ? bench.RunRing(conf.depth * 16, cq) : bench.Run(conf.depth * 16, true);
+			long csw = ContextSwitches();
+			auto start = std::chrono::steady_clock::now();
+			if (ret == 0) {
+				ret = ring ? bench.RunRing(conf.ops, cq) : bench.Run(conf.ops, true);
+			}
+			double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			csw = ContextSwitches() - csw;
+			printf("%-9s %10u %12.0f %10.1f %12.3f\n", ring ? "ring" : "callback", conf.ops, conf.ops / sec,
+				conf.ops / sec * PAGE_SIZE_4K / (1024 * 1024), static_cast<double>(csw) / conf.ops);
+		}
+	}
+	if (ret != 0) {
+		fprintf(stderr, "bench failed: %d\n", ret);
+	}
+	CephProxyCompletionRingDestroy(cq);
+	CephProxyShutdown(proxy);
+	return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FakeCluster.h"
+#include "ProxyBench.h"
+#include "ProxyCrc32c.h"
+
+/*
+ * crc32c throughput of the table and the instruction paths from 4KB to 4MB
+ * buffers, then SGL reads of one object through the proxy with
+ * proxy.data_crc_check off and on, which adds the OSD side sum and the
+ * proxy side sum fused with the copy into the SGL.
+ */
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_crc_bench [options]\n"
+		"  --bytes-mb n        bytes summed per buffer size and path (1024)\n"
+		"  --read-kb n         size of each SGL read, a multiple of 4 (1024)\n"
+		"  --reads n           SGL reads timed per mode (2000)\n"
+		"  --cpu n             core every thread is pinned to, -1 leaves them free (0)\n");
+}
+
+static double SumSec(ProxyCrc32cFn fn, const std::vector<unsigned char> &buf, size_t len, uint64_t total)
+{
+	uint32_t crc = -1;
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t done = 0; done < total; done += len) {
+		crc = fn(crc, buf.data(), len);
+	}
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	/* keeps the loop from being dropped */
+	if (crc == 0x12345678) {
+		printf(" ");
+	}
+	return sec;
+}
+
+struct ReadWaiter {
+	std::mutex lock;
+	std::condition_variable cond;
+	bool done = false;
+	int ret = 0;
+};
+
+static void ReadDone(int ret, void *arg)
+{
+	ReadWaiter *w = static_cast<ReadWaiter *>(arg);
+	std::lock_guard<std::mutex> l(w->lock);
+	w->ret = ret;
+	w->done = true;
+	w->cond.notify_all();
+}
+
+static int ReadSgl(ceph_proxy_t proxy, int64_t poolId, uint64_t off, size_t len, SGL_S *sgl)
+{
+	ceph_proxy_op_t op = nullptr;
+	int ret = CephProxyReadOpInit2(&op, poolId, "crc_bench");
+	if (ret != 0) {
+		return ret;
+	}
+	int prval = 0;
+	CephProxyReadOpReadSGL(op, off, len, sgl, &prval, 1);
+	ReadWaiter w;
+	completion_t c = CephProxyCreateCompletion(ReadDone, &w);
+	ret = CephProxyQueueOp(proxy, op, c);
+	if (ret == 0) {
+		std::unique_lock<std::mutex> l(w.lock);
+		w.cond.wait(l, [&w]() { return w.done; });
+		ret = w.ret;
+	}
+	CephProxyCompletionDestroy(c);
+	CephProxyReadOpRelease(op);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t bytesMb = 1024;
+	uint32_t readKb = 1024;
+	uint32_t reads = 2000;
+	int cpu = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long n = strtol(argv[++i], nullptr, 10);
+		if (arg == "--bytes-mb" && n > 0) {
+			bytesMb = n;
+		} else if (arg == "--read-kb" && n > 0 && n % 4 == 0) {
+			readKb = n;
+		} else if (arg == "--reads" && n > 0) {
+			reads = n;
+		} else if (arg == "--cpu") {
+			cpu = n;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+
+	if (BenchPinCpu(cpu) != 0) {
+		return 1;
+	}
+
+	const size_t sizes[] = { 4096, 65536, 1 << 20, 4 << 20 };
+	std::vector<unsigned char> buf(sizes[3]);
+	std::mt19937 rng(42);
+	for (auto &c : buf) {
+		c = rng();
+	}
+	uint64_t total = bytesMb << 20;
+	ProxyCrc32cFn hw = ProxyCrc32cHw();
+	printf("%-8s %12s %12s   (%s)\n", "size", "table GB/s", "hw GB/s", ProxyCrc32cName());
+	for (size_t len : sizes) {
+		double table = SumSec(ProxyCrc32cTable, buf, len, total);
+		printf("%-8zu %12.2f", len, total / table / (1 << 30));
+		if (hw != nullptr) {
+			double sec = SumSec(hw, buf, len, total);
+			printf(" %12.2f\n", total / sec / (1 << 30));
+		} else {
+			printf(" %12s\n", "-");
+		}
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t poolId = cluster.CreatePool("rbd");
+	if (poolId <= 0) {
+		fprintf(stderr, "create pool failed\n");
+		return 1;
+	}
+	const uint32_t chunks = 16;
+	size_t readLen = static_cast<size_t>(readKb) << 10;
+	FakeObject obj;
+	for (uint32_t i = 0; i < chunks; i++) {
+		obj.data.append(reinterpret_cast<const char *>(buf.data()), std::min(readLen, buf.size()));
+		if (readLen > buf.size()) {
+			obj.data.append_zero(readLen - buf.size());
+		}
+	}
+	cluster.PutObject(poolId, "", "crc_bench", obj);
+
+	uint32_t pages = readLen / PAGE_SIZE_4K;
+	std::vector<SGL_S> sgls((pages + ENTRY_PER_SGL - 1) / ENTRY_PER_SGL);
+	std::vector<std::vector<char>> data(pages, std::vector<char>(PAGE_SIZE_4K));
+	for (uint32_t i = 0; i < pages; i++) {
+		SGL_S &sgl = sgls[i / ENTRY_PER_SGL];
+		sgl.entrys[i % ENTRY_PER_SGL].buf = data[i].data();
+		sgl.entrys[i % ENTRY_PER_SGL].len = PAGE_SIZE_4K;
+		sgl.entrySumInSgl = i % ENTRY_PER_SGL + 1;
+		sgl.nextSgl = (i / ENTRY_PER_SGL + 1 < sgls.size()) ? &sgls[i / ENTRY_PER_SGL + 1] : nullptr;
+	}
+
+	int ret = 0;
+	printf("\n%-6s %10s %12s %10s\n", "check", "reads", "reads/s", "MB/s");
+	for (int check = 0; check <= 1 && ret == 0; check++) {
+		FakeConfSet("proxy", "data_crc_check", std::to_string(check));
+		ceph_proxy_t proxy = nullptr;
+		if (CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+			fprintf(stderr, "proxy init failed\n");
+			return 1;
+		}
+		for (uint32_t i = 0; i < 64 && ret == 0; i++) {
+			ret = ReadSgl(proxy, poolId, (i % chunks) * readLen, readLen, &sgls[0]);
+		}
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < reads && ret == 0; i++) {
+			ret = ReadSgl(proxy, poolId, (i % chunks) * readLen, readLen, &sgls[0]);
+		}
+		double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (ret == 0) {
+			printf("%-6s %10u %12.0f %10.1f\n", check ? "on" : "off", reads, reads / sec,
+				reads / sec * readLen / (1024 * 1024));
+		}
+		CephProxyShutdown(proxy);
+	}
+	if (ret != 0) {
+		fprintf(stderr, "bench failed: %d\n", ret);
+	}
+	FakeConfReset();
+	return ret == 0 ? 0 : 1;
+}
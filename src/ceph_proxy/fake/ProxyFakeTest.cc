@@ -0,0 +1,1783 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CephProxyInterface.h"
+#include "CephExport.h"
+#include "RadosWrapper.h"
+#include "MinAllocDiscovery.h"
+#include "ProxyJson.h"
+#include "ProxyCrc32c.h"
+#include "ProxySgl.h"
+#include "FakeCluster.h"
+#include "crc32c.h"
+
+/*
+ * Drives the proxy end to end against the in-memory cluster, no monitor or
+ * OSD is needed. Exits 1 on the first failed check.
+ */
+
+#define PAGE_SIZE_4K 4096
+#define GIB (1024ULL * 1024ULL * 1024ULL)
+#define MON_UPDATE_WAIT_SEC 15
+
+#define CHECK(cond) do {                                                        \
+	if (!(cond)) {                                                          \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		exit(1);                                                        \
+	}                                                                       \
+} while (0)
+
+#define CHECK_EQ(a, b) do {                                                     \
+	long long _a = (long long)(a);                                          \
+	long long _b = (long long)(b);                                          \
+	if (_a != _b) {                                                         \
+		fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+			__FILE__, __LINE__, #a, #b, _a, _b);                    \
+		exit(1);                                                        \
+	}                                                                       \
+} while (0)
+
+struct OpWaiter {
+	std::mutex lock;
+	std::condition_variable cond;
+	bool done = false;
+	int ret = 0;
+};
+
+static void OpDone(int ret, void *arg)
+{
+	OpWaiter *w = static_cast<OpWaiter *>(arg);
+	std::lock_guard<std::mutex> l(w->lock);
+	w->ret = ret;
+	w->done = true;
+	w->cond.notify_all();
+}
+
+static int RunOp(ceph_proxy_t proxy, ceph_proxy_op_t op)
+{
+	OpWaiter w;
+	completion_t c = CephProxyCreateCompletion(OpDone, &w);
+	CHECK(c != nullptr);
+	int ret = CephProxyQueueOp(proxy, op, c);
+	if (ret == 0) {
+		std::unique_lock<std::mutex> l(w.lock);
+		w.cond.wait(l, [&w]() { return w.done; });
+		ret = w.ret;
+	}
+	CephProxyCompletionDestroy(c);
+	return ret;
+}
+
+static SGL_S *AllocSgl(uint32_t pages)
+{
+	SGL_S *head = nullptr;
+	SGL_S **tail = &head;
+	while (pages > 0) {
+		SGL_S *sgl = static_cast<SGL_S *>(calloc(1, sizeof(SGL_S)));
+		CHECK(sgl != nullptr);
+		uint32_t num = std::min<uint32_t>(pages, ENTRY_PER_SGL);
+		for (uint32_t i = 0; i < num; i++) {
+			sgl->entrys[i].buf = static_cast<char *>(malloc(PAGE_SIZE_4K));
+			CHECK(sgl->entrys[i].buf != nullptr);
+			sgl->entrys[i].len = PAGE_SIZE_4K;
+		}
+		sgl->entrySumInSgl = num;
+		pages -= num;
+		*tail = sgl;
+		tail = &sgl->nextSgl;
+	}
+	return head;
+}
+
+static void FreeSgl(SGL_S *sgl)
+{
+	while (sgl != nullptr) {
+		SGL_S *next = sgl->nextSgl;
+		for (uint32_t i = 0; i < sgl->entrySumInSgl; i++) {
+			free(sgl->entrys[i].buf);
+		}
+		free(sgl);
+		sgl = next;
+	}
+}
+
+static void FillSgl(SGL_S *sgl, char seed)
+{
+	uint32_t n = 0;
+	for (; sgl != nullptr; sgl = sgl->nextSgl) {
+		for (uint32_t i = 0; i < sgl->entrySumInSgl; i++, n++) {
+			memset(sgl->entrys[i].buf, seed + n % 26, PAGE_SIZE_4K);
+		}
+	}
+}
+
+static std::string SglToString(SGL_S *sgl)
+{
+	std::string out;
+	for (; sgl != nullptr; sgl = sgl->nextSgl) {
+		for (uint32_t i = 0; i < sgl->entrySumInSgl; i++) {
+			out.append(sgl->entrys[i].buf, sgl->entrys[i].len);
+		}
+	}
+	return out;
+}
+
+static int StatObject(ceph_proxy_t proxy, int64_t poolId, const char *oid, uint64_t *size)
+{
+	ceph_proxy_op_t op = nullptr;
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, oid), 0);
+	int prval = 0;
+	time_t mtime = 0;
+	CephProxyReadOpStat(op, size, &mtime, &prval);
+	int ret = RunOp(proxy, op);
+	CephProxyReadOpRelease(op);
+	return ret;
+}
+
+/* 66 pages spill into a second SGL on both the write and the read path */
+static void TestSglWriteRead(ceph_proxy_t proxy, int64_t poolId)
+{
+	const uint32_t pages = ENTRY_PER_SGL + 2;
+	char prev[512];
+	char back[512];
+	memset(prev, 'P', sizeof(prev));
+	memset(back, 'Q', sizeof(back));
+	AlignBuffer align = { prev, sizeof(prev), back, sizeof(back) };
+
+	SGL_S *wsgl = AllocSgl(pages);
+	FillSgl(wsgl, 'a');
+	ceph_proxy_op_t op = nullptr;
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "sgl_obj"), 0);
+	CephProxyWriteOpWriteSGL(op, wsgl, pages * PAGE_SIZE_4K, 0, &align, 0);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CephProxyWriteOpRelease(op);
+
+	uint64_t size = 0;
+	CHECK_EQ(StatObject(proxy, poolId, "sgl_obj", &size), 0);
+	CHECK_EQ(size, pages * PAGE_SIZE_4K + sizeof(prev) + sizeof(back));
+
+	SGL_S *rsgl = AllocSgl(pages);
+	int prval = 0;
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, "sgl_obj"), 0);
+	CephProxyReadOpReadSGL(op, sizeof(prev), pages * PAGE_SIZE_4K, rsgl, &prval, 1);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CephProxyReadOpRelease(op);
+	CHECK_EQ(prval, 0);
+	CHECK(SglToString(rsgl) == SglToString(wsgl));
+
+	/* only the back align buffer is left past the last page, the rest must read as zero */
+	SGL_S *shortSgl = AllocSgl(2);
+	FillSgl(shortSgl, 'x');
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, "sgl_obj"), 0);
+	CephProxyReadOpReadSGL(op, sizeof(prev) + pages * PAGE_SIZE_4K, 2 * PAGE_SIZE_4K, shortSgl, &prval, 1);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CephProxyReadOpRelease(op);
+	std::string expect(back, sizeof(back));
+	expect.resize(2 * PAGE_SIZE_4K, '\0');
+	CHECK(SglToString(shortSgl) == expect);
+
+	FreeSgl(wsgl);
+	FreeSgl(rsgl);
+	FreeSgl(shortSgl);
+}
+
+/*
+ * Every ProxySgl helper against a flat copy of the chain, with entries of 4K
+ * (isRelease) and of an odd len, at offsets on and off entry and SGL borders
+ * and with transfers big enough to be streamed.
+ */
+static void TestSglUtil()
+{
+	std::mt19937 rng(11);
+	for (int isRelease = 0; isRelease <= 1; isRelease++) {
+		const uint32_t entries = 2 * ENTRY_PER_SGL + 2;
+		SGL_S *sgl = AllocSgl(entries);
+		size_t entryLen = PAGE_SIZE_4K;
+		if (!isRelease) {
+			entryLen = 3000;
+			for (SGL_S *s = sgl; s != nullptr; s = s->nextSgl) {
+				for (uint32_t i = 0; i < s->entrySumInSgl; i++) {
+					s->entrys[i].len = entryLen;
+				}
+			}
+		}
+		CHECK_EQ(SglLength(sgl, isRelease), entries * entryLen);
+
+		std::string flat(entries * entryLen, '\0');
+		for (auto &c : flat) {
+			c = rng();
+		}
+		CHECK_EQ(SglCopyIn(sgl, 0, flat.data(), flat.size(), isRelease), flat.size());
+		std::string out(flat.size(), '\0');
+		CHECK_EQ(SglCopyOut(sgl, 0, &out[0], out.size(), isRelease), out.size());
+		CHECK(out == flat);
+
+		const size_t offs[] = { 0, 1, entryLen - 1, entryLen, ENTRY_PER_SGL * entryLen - 3, flat.size() - 5 };
+		const size_t lens[] = { 1, 5000, PROXY_SGL_STREAM_BYTES + 77 };
+		for (size_t off : offs) {
+			for (size_t len : lens) {
+				std::string piece(len, '\0');
+				for (auto &c : piece) {
+					c = rng();
+				}
+				size_t expect = std::min(len, flat.size() - off);
+				CHECK_EQ(SglCopyIn(sgl, off, piece.data(), len, isRelease), expect);
+				flat.replace(off, expect, piece, 0, expect);
+				std::string got(expect, '\0');
+				CHECK_EQ(SglCopyOut(sgl, off, &got[0], expect, isRelease), expect);
+				CHECK(got == flat.substr(off, expect));
+			}
+		}
+		CHECK_EQ(SglCopyIn(sgl, flat.size(), "x", 1, isRelease), 0);
+		CHECK_EQ(SglCopyOut(sgl, flat.size() + 1, &out[0], 1, isRelease), 0);
+
+		CHECK_EQ(SglZero(sgl, 10, 9000, isRelease), 9000);
+		memset(&flat[10], 0, 9000);
+		CHECK_EQ(SglCopyOut(sgl, 0, &out[0], out.size(), isRelease), out.size());
+		CHECK(out == flat);
+
+		char prev[3] = { 'p', 'p', 'p' };
+		char back[2] = { 'b', 'b' };
+		AlignBuffer align = { prev, sizeof(prev), back, sizeof(back) };
+		bufferlist bl;
+		CHECK_EQ(SglAppendToBufferlist(bl, sgl, flat.size(), &align, isRelease), flat.size());
+		CHECK(bl.to_str() == std::string(prev, sizeof(prev)) + flat + std::string(back, sizeof(back)));
+		bufferlist small;
+		CHECK_EQ(SglAppendToBufferlist(small, sgl, 100, nullptr, isRelease), 100);
+		CHECK(small.to_str() == flat.substr(0, 100));
+
+		/* several buffers, one of them streamed, summed on the way in */
+		bufferlist in;
+		in.append("abc", 3);
+		in.append(flat.data() + 1000, PROXY_SGL_STREAM_BYTES);
+		uint32_t crc = -1;
+		CHECK_EQ(SglCopyFromBufferlist(sgl, 7, in, isRelease, &crc), in.length());
+		std::string inStr = in.to_str();
+		CHECK_EQ(crc, ProxyCrc32c(-1, inStr.data(), inStr.size()));
+		flat.replace(7, inStr.size(), inStr);
+		CHECK_EQ(SglCopyOut(sgl, 0, &out[0], out.size(), isRelease), out.size());
+		CHECK(out == flat);
+		CHECK_EQ(ProxyCrc32cSgl(-1, sgl, 7777, isRelease), ProxyCrc32c(-1, flat.data(), 7777));
+
+		std::vector<struct iovec> iov;
+		CHECK_EQ(SglToIovec(sgl, entryLen - 5, 3 * entryLen, isRelease, iov), 3 * entryLen);
+		CHECK_EQ(iov.size(), 4);
+		std::string joined;
+		for (auto &v : iov) {
+			joined.append(static_cast<char *>(v.iov_base), v.iov_len);
+		}
+		CHECK(joined == flat.substr(entryLen - 5, 3 * entryLen));
+		CHECK_EQ(SglCopyFromIovec(sgl, 50000, iov.data(), iov.size(), isRelease), joined.size());
+		flat.replace(50000, joined.size(), joined);
+		CHECK_EQ(SglCopyOut(sgl, 0, &out[0], out.size(), isRelease), out.size());
+		CHECK(out == flat);
+		FreeSgl(sgl);
+	}
+
+	std::vector<char> src(PROXY_SGL_STREAM_BYTES * 2);
+	std::vector<char> dst(src.size());
+	for (auto &c : src) {
+		c = rng();
+	}
+	SglMemcpy(dst.data() + 3, src.data() + 1, src.size() - 8, true);
+	CHECK(memcmp(dst.data() + 3, src.data() + 1, src.size() - 8) == 0);
+}
+
+static void TestFaults(ceph_proxy_t proxy, int64_t poolId)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	char data[PAGE_SIZE_4K];
+	memset(data, 'e', sizeof(data));
+
+	cluster.InjectError(FAKE_OP_WRITE, -EIO, 1, "fault_obj");
+	ceph_proxy_op_t op = nullptr;
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "fault_obj"), 0);
+	CephProxyWriteOpWrite(op, data, sizeof(data), 0);
+	CHECK_EQ(RunOp(proxy, op), -EIO);
+	CephProxyWriteOpRelease(op);
+
+	uint64_t size = 0;
+	CHECK_EQ(StatObject(proxy, poolId, "fault_obj", &size), -ENOENT);
+
+	/* a failed op in the middle of a write op leaves the object untouched */
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "fault_obj"), 0);
+	CephProxyWriteOpWrite(op, data, sizeof(data), 0);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CephProxyWriteOpRelease(op);
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "fault_obj"), 0);
+	CephProxyWriteOpTruncate(op, 0);
+	CephProxyWriteOpRemoveXattr(op, "missing");
+	CHECK_EQ(RunOp(proxy, op), -ENODATA);
+	CephProxyWriteOpRelease(op);
+	CHECK_EQ(StatObject(proxy, poolId, "fault_obj", &size), 0);
+	CHECK_EQ(size, sizeof(data));
+
+	cluster.SetLatency(FAKE_OP_READ, 20000);
+	auto start = std::chrono::steady_clock::now();
+	CHECK_EQ(StatObject(proxy, poolId, "fault_obj", &size), 0);
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	CHECK(us.count() >= 20000);
+	cluster.ClearFaults();
+
+	CHECK_EQ(StatObject(proxy, poolId + 100, "fault_obj", &size), -ENOENT);
+}
+
+/* ops alternate between two pools, the slot without a completion ends the queued prefix */
+static void TestQueueOps(ceph_proxy_t proxy, int64_t poolId)
+{
+	const uint32_t num = 16;
+	const uint32_t bad = 12;
+	int64_t pools[2] = { poolId, FakeCluster::Instance().CreatePool("batch") };
+	CHECK(pools[1] > 0);
+
+	char data[num][PAGE_SIZE_4K];
+	OpWaiter waiters[num];
+	ceph_proxy_op_t ops[num];
+	completion_t comps[num];
+	for (uint32_t i = 0; i < num; i++) {
+		std::string oid = "batch_obj_" + std::to_string(i);
+		memset(data[i], 'a' + i, PAGE_SIZE_4K);
+		CHECK_EQ(CephProxyWriteOpInit2(&ops[i], pools[i / 2 % 2], oid.c_str()), 0);
+		CephProxyWriteOpWrite(ops[i], data[i], PAGE_SIZE_4K, 0);
+		comps[i] = i == bad ? nullptr : CephProxyCreateCompletion(OpDone, &waiters[i]);
+	}
+	CHECK_EQ(CephProxyQueueOps(proxy, ops, comps, 0), 0);
+	CHECK_EQ(CephProxyQueueOps(proxy, ops, comps, num), bad);
+
+	for (uint32_t i = 0; i < num; i++) {
+		if (i < bad) {
+			std::unique_lock<std::mutex> l(waiters[i].lock);
+			waiters[i].cond.wait(l, [&]() { return waiters[i].done; });
+			CHECK_EQ(waiters[i].ret, 0);
+		}
+		CephProxyWriteOpRelease(ops[i]);
+		if (comps[i] != nullptr) {
+			CephProxyCompletionDestroy(comps[i]);
+		}
+	}
+
+	for (uint32_t i = 0; i < num; i++) {
+		std::string oid = "batch_obj_" + std::to_string(i);
+		char back[PAGE_SIZE_4K];
+		size_t bytes = 0;
+		int prval = 0;
+		ceph_proxy_op_t op = nullptr;
+		CHECK_EQ(CephProxyReadOpInit2(&op, pools[i / 2 % 2], oid.c_str()), 0);
+		CephProxyReadOpRead(op, 0, sizeof(back), back, &bytes, &prval);
+		int ret = RunOp(proxy, op);
+		CephProxyReadOpRelease(op);
+		if (i < bad) {
+			CHECK_EQ(ret, 0);
+			CHECK(memcmp(back, data[i], PAGE_SIZE_4K) == 0);
+		} else {
+			CHECK_EQ(ret, -ENOENT);
+		}
+	}
+}
+
+#define RING_OPS 64
+
+/*
+ * Ops queued with ring completions are reaped in one go by the test thread,
+ * each with its own userData and result, and the eventfd only turns readable
+ * once the ring is armed.
+ */
+static void TestCompletionRing(ceph_proxy_t proxy, int64_t poolId)
+{
+	proxy_cq_t cq = nullptr;
+	CHECK_EQ(CephProxyCompletionRingCreate(0, &cq), -EINVAL);
+	CHECK_EQ(CephProxyCompletionRingCreate(RING_OPS - 4, &cq), 0);
+	CHECK(cq != nullptr);
+
+	completion_t comps[RING_OPS];
+	ceph_proxy_op_t ops[RING_OPS];
+	char data[PAGE_SIZE_4K];
+	memset(data, 'q', sizeof(data));
+	for (uint32_t i = 0; i < RING_OPS; i++) {
+		comps[i] = CephProxyCreateRingCompletion(cq, reinterpret_cast<void *>(uintptr_t(i + 1)));
+		CHECK(comps[i] != nullptr);
+	}
+	/* rounded up to 64, and no more completions than that */
+	CHECK(CephProxyCreateRingCompletion(cq, nullptr) == nullptr);
+	CHECK_EQ(CephProxyCompletionRingDestroy(cq), -EBUSY);
+
+	for (uint32_t i = 0; i < RING_OPS; i++) {
+		std::string oid = "ring_obj_" + std::to_string(i);
+		CHECK_EQ(CephProxyWriteOpInit2(&ops[i], poolId, oid.c_str()), 0);
+		CephProxyWriteOpWrite(ops[i], data, sizeof(data), 0);
+	}
+	CHECK_EQ(CephProxyQueueOps(proxy, ops, comps, RING_OPS), RING_OPS);
+
+	ProxyCqEntry entries[RING_OPS + 1];
+	CHECK_EQ(CephProxyCompletionRingWait(cq, entries, RING_OPS + 1, RING_OPS, 10000), RING_OPS);
+	std::set<uintptr_t> seen;
+	for (uint32_t i = 0; i < RING_OPS; i++) {
+		CHECK_EQ(entries[i].ret, 0);
+		seen.insert(reinterpret_cast<uintptr_t>(entries[i].userData));
+		CephProxyWriteOpRelease(ops[i]);
+	}
+	CHECK_EQ(seen.size(), RING_OPS);
+	CHECK_EQ(*seen.begin(), 1);
+	CHECK_EQ(CephProxyCompletionRingReap(cq, entries, RING_OPS), 0);
+
+	/* a completion is reused for the next op, failures carry their return code */
+	int fd = CephProxyCompletionRingFd(cq);
+	CHECK(fd >= 0);
+	CHECK_EQ(CephProxyCompletionRingArm(cq), 0);
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	CHECK_EQ(poll(&pfd, 1, 0), 0);
+
+	char back[PAGE_SIZE_4K];
+	size_t bytes = 0;
+	int prval = 0;
+	ceph_proxy_op_t op = nullptr;
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, "ring_missing"), 0);
+	CephProxyReadOpRead(op, 0, sizeof(back), back, &bytes, &prval);
+	CHECK_EQ(CephProxyQueueOps(proxy, &op, &comps[0], 1), 1);
+	CHECK_EQ(poll(&pfd, 1, 10000), 1);
+	CHECK(pfd.revents & POLLIN);
+	/* the entry is still waiting, so the ring is not armed again */
+	CHECK_EQ(CephProxyCompletionRingArm(cq), 1);
+	CHECK_EQ(CephProxyCompletionRingReap(cq, entries, RING_OPS), 1);
+	CHECK_EQ(entries[0].ret, -ENOENT);
+	CHECK(entries[0].userData == reinterpret_cast<void *>(uintptr_t(1)));
+	CephProxyReadOpRelease(op);
+
+	/* nothing pending: a wait with a timeout comes back empty */
+	CHECK_EQ(CephProxyCompletionRingWait(cq, entries, RING_OPS, 1, 10), 0);
+
+	for (uint32_t i = 0; i < RING_OPS; i++) {
+		CephProxyCompletionDestroy(comps[i]);
+	}
+	CHECK_EQ(CephProxyCompletionRingDestroy(cq), 0);
+}
+
+#define CLS_CALLS 32
+
+/* stub class: counter.add adds a u64 to the object's value and returns the sum, counter.get reads it */
+static uint64_t CounterValue(const FakeObjectRef &obj)
+{
+	uint64_t v = 0;
+	if (obj != nullptr && obj->data.length() >= sizeof(v)) {
+		obj->data.copy(0, sizeof(v), reinterpret_cast<char *>(&v));
+	}
+	return v;
+}
+
+static void RegisterCounterClass()
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	cluster.RegisterMethod("counter", "add", [](FakeObjectRef &obj, bufferlist &in, bufferlist *out) {
+		uint64_t v = 0;
+		if (in.length() != sizeof(v)) {
+			return -EINVAL;
+		}
+		in.copy(0, sizeof(v), reinterpret_cast<char *>(&v));
+		v += CounterValue(obj);
+		if (obj == nullptr) {
+			obj = std::make_shared<FakeObject>();
+		}
+		obj->data.clear();
+		obj->data.append(reinterpret_cast<const char *>(&v), sizeof(v));
+		out->append(reinterpret_cast<const char *>(&v), sizeof(v));
+		return 0;
+	});
+	cluster.RegisterMethod("counter", "get", [](FakeObjectRef &obj, bufferlist &in, bufferlist *out) {
+		if (obj == nullptr) {
+			return -ENOENT;
+		}
+		uint64_t v = CounterValue(obj);
+		out->append(reinterpret_cast<const char *>(&v), sizeof(v));
+		return 0;
+	});
+}
+
+static int RunClsBatch(ceph_proxy_t proxy, int64_t poolId, proxy_cls_method_t m, ProxyClsCall *calls, uint32_t num)
+{
+	OpWaiter w;
+	completion_t c = CephProxyCreateCompletion(OpDone, &w);
+	CHECK(c != nullptr);
+	int ret = CephProxyClsExecBatch(proxy, poolId, m, calls, num, c);
+	if (ret == 0) {
+		std::unique_lock<std::mutex> l(w.lock);
+		w.cond.wait(l, [&w]() { return w.done; });
+		ret = w.ret;
+	}
+	CephProxyCompletionDestroy(c);
+	return ret;
+}
+
+/*
+ * Class calls through registered handles, one at a time and batched over
+ * many objects. Every call of a batch gets its own result and output, the
+ * batch completes once with the first failure.
+ */
+static void TestClsExec(ceph_proxy_t proxy, int64_t poolId)
+{
+	RegisterCounterClass();
+	proxy_cls_method_t add = nullptr;
+	proxy_cls_method_t get = nullptr;
+	proxy_cls_method_t bad = nullptr;
+	CHECK_EQ(CephProxyClsMethodRegister("counter", "", 0, &bad), -EINVAL);
+	CHECK_EQ(CephProxyClsMethodRegister(nullptr, "get", 0, &bad), -EINVAL);
+	CHECK_EQ(CephProxyClsMethodRegister(std::string(256, 'c').c_str(), "get", 0, &bad), -EINVAL);
+	CHECK(bad == nullptr);
+	CHECK_EQ(CephProxyClsMethodRegister("counter", "add", PROXY_CLS_METHOD_WRITE, &add), 0);
+	CHECK_EQ(CephProxyClsMethodRegister("counter", "get", 0, &get), 0);
+
+	uint64_t delta = 5;
+	int prval = -1;
+	ceph_proxy_op_t op = nullptr;
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "cls_single"), 0);
+	CephProxyWriteOpExec(op, add, reinterpret_cast<const char *>(&delta), sizeof(delta), &prval);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CHECK_EQ(prval, 0);
+	CephProxyWriteOpRelease(op);
+
+	uint64_t v = 0;
+	size_t used = 0;
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, "cls_single"), 0);
+	CephProxyReadOpExec(op, get, nullptr, 0, reinterpret_cast<char *>(&v), sizeof(v), &used, &prval);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CHECK_EQ(v, 5);
+	CHECK_EQ(used, sizeof(v));
+	CephProxyReadOpRelease(op);
+
+	/* too small a buffer fails the op and tells how much is needed */
+	uint32_t small = 0;
+	used = 0;
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, "cls_single"), 0);
+	CephProxyReadOpExec(op, get, nullptr, 0, reinterpret_cast<char *>(&small), sizeof(small), &used, &prval);
+	CHECK_EQ(RunOp(proxy, op), -ERANGE);
+	CHECK_EQ(used, sizeof(v));
+	CephProxyReadOpRelease(op);
+
+	std::vector<std::string> oids;
+	std::vector<uint64_t> deltas(CLS_CALLS);
+	std::vector<uint64_t> sums(CLS_CALLS + 2, 0);
+	ProxyClsCall calls[CLS_CALLS + 2];
+	memset(calls, 0, sizeof(calls));
+	for (uint32_t i = 0; i < CLS_CALLS; i++) {
+		oids.push_back("cls_obj_" + std::to_string(i));
+		deltas[i] = i + 1;
+	}
+	/* run twice, the second call on each object adds to the first */
+	for (int round = 1; round <= 2; round++) {
+		for (uint32_t i = 0; i < CLS_CALLS; i++) {
+			calls[i].oid = oids[i].c_str();
+			calls[i].inBuf = reinterpret_cast<const char *>(&deltas[i]);
+			calls[i].inLen = sizeof(uint64_t);
+			calls[i].ret = -1;
+		}
+		CHECK_EQ(RunClsBatch(proxy, poolId, add, calls, CLS_CALLS), 0);
+		for (uint32_t i = 0; i < CLS_CALLS; i++) {
+			CHECK_EQ(calls[i].ret, 0);
+			CHECK_EQ(calls[i].usedLen, 0);
+		}
+	}
+
+	/* a missing object and a short buffer fail their own calls only */
+	for (uint32_t i = 0; i < CLS_CALLS + 2; i++) {
+		calls[i].oid = i < CLS_CALLS + 1 ? (i < CLS_CALLS ? oids[i].c_str() : "cls_missing") : oids[0].c_str();
+		calls[i].inBuf = nullptr;
+		calls[i].inLen = 0;
+		calls[i].outBuf = reinterpret_cast<char *>(&sums[i]);
+		calls[i].outLen = i == CLS_CALLS + 1 ? sizeof(uint32_t) : sizeof(uint64_t);
+	}
+	CHECK_EQ(RunClsBatch(proxy, poolId, get, calls, CLS_CALLS + 2), -ENOENT);
+	for (uint32_t i = 0; i < CLS_CALLS; i++) {
+		CHECK_EQ(calls[i].ret, 0);
+		CHECK_EQ(calls[i].usedLen, sizeof(uint64_t));
+		CHECK_EQ(sums[i], 2 * (i + 1));
+	}
+	CHECK_EQ(calls[CLS_CALLS].ret, -ENOENT);
+	CHECK_EQ(calls[CLS_CALLS + 1].ret, -ERANGE);
+	CHECK_EQ(calls[CLS_CALLS + 1].usedLen, sizeof(uint64_t));
+
+	/* a ring completion is posted once for the whole batch */
+	proxy_cq_t cq = nullptr;
+	CHECK_EQ(CephProxyCompletionRingCreate(1, &cq), 0);
+	completion_t c = CephProxyCreateRingCompletion(cq, calls);
+	CHECK(c != nullptr);
+	CHECK_EQ(CephProxyClsExecBatch(proxy, poolId, get, calls, CLS_CALLS, c), 0);
+	ProxyCqEntry entry;
+	CHECK_EQ(CephProxyCompletionRingWait(cq, &entry, 1, 1, 10000), 1);
+	CHECK_EQ(entry.ret, 0);
+	CHECK(entry.userData == calls);
+	CHECK_EQ(CephProxyCompletionRingWait(cq, &entry, 1, 1, 10), 0);
+	CHECK_EQ(CephProxyClsExecBatch(proxy, poolId, get, calls, 0, c), -EINVAL);
+	CephProxyCompletionDestroy(c);
+	CHECK_EQ(CephProxyCompletionRingDestroy(cq), 0);
+
+	CephProxyClsMethodRelease(add);
+	CephProxyClsMethodRelease(get);
+}
+
+#define STREAM_KEYS 10000
+#define STREAM_PAGE 256
+
+static std::string StreamKey(uint32_t i)
+{
+	char key[32];
+	snprintf(key, sizeof(key), "skey_%06u", i);
+	return key;
+}
+
+/* walks the whole stream, checking order and values; return the entries seen */
+static uint32_t DrainOmapStream(proxy_omap_stream_t stream, uint32_t first, bool keysOnly, uint32_t sleepEvery = 0)
+{
+	const char *key = nullptr;
+	const char *val = nullptr;
+	size_t keyLen = 0;
+	size_t valLen = 0;
+	uint32_t n = 0;
+	int ret = 0;
+	while ((ret = CephProxyOmapStreamNext(stream, &key, &keyLen, &val, &valLen)) == 1) {
+		CHECK(std::string(key, keyLen) == StreamKey(first + n));
+		if (keysOnly) {
+			CHECK(val == nullptr);
+		} else {
+			CHECK(std::string(val, valLen) == "val_" + std::to_string(first + n));
+		}
+		n++;
+		if (sleepEvery != 0 && n % sleepEvery == 0) {
+			usleep(10000);
+		}
+	}
+	CHECK_EQ(ret, 0);
+	CHECK_EQ(CephProxyOmapStreamNext(stream, &key, &keyLen, &val, &valLen), 0);
+	return n;
+}
+
+/*
+ * An omap larger than a page is walked in order through two pages, from the
+ * start or after a key, with values or keys only. A caller slower than the
+ * OSD waits for the first page only.
+ */
+static void TestOmapStream(ceph_proxy_t proxy, int64_t poolId)
+{
+	std::vector<std::string> keys;
+	std::vector<std::string> vals;
+	for (uint32_t i = 0; i < STREAM_KEYS; i++) {
+		keys.push_back(StreamKey(i));
+		vals.push_back("val_" + std::to_string(i));
+	}
+	for (uint32_t i = 0; i < STREAM_KEYS; i += 1000) {
+		std::vector<const char *> keyPtrs;
+		std::vector<const char *> valPtrs;
+		std::vector<size_t> lens;
+		for (uint32_t j = i; j < i + 1000; j++) {
+			keyPtrs.push_back(keys[j].c_str());
+			valPtrs.push_back(vals[j].c_str());
+			lens.push_back(vals[j].length());
+		}
+		ceph_proxy_op_t op = nullptr;
+		CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "stream_obj"), 0);
+		CephProxyWriteOpOmapSet(op, keyPtrs.data(), valPtrs.data(), lens.data(), keyPtrs.size());
+		CHECK_EQ(RunOp(proxy, op), 0);
+		CephProxyWriteOpRelease(op);
+	}
+
+	proxy_omap_stream_t stream = nullptr;
+	CHECK_EQ(CephProxyOmapStreamOpen(proxy, poolId, "stream_obj", nullptr, STREAM_PAGE, 0, &stream), 0);
+	CHECK_EQ(DrainOmapStream(stream, 0, false), STREAM_KEYS);
+	ProxyOmapStreamStat stat;
+	CephProxyOmapStreamStat(stream, &stat);
+	CHECK_EQ(stat.pages, (STREAM_KEYS + STREAM_PAGE - 1) / STREAM_PAGE);
+	/* never more than two pages of the largest entries */
+	CHECK(stat.peakBytes > 0);
+	CHECK(stat.peakBytes <= 2 * STREAM_PAGE * (keys.back().size() + vals.back().size()));
+	CephProxyOmapStreamClose(stream);
+
+	CHECK_EQ(CephProxyOmapStreamOpen(proxy, poolId, "stream_obj", keys[STREAM_KEYS - 300].c_str(), STREAM_PAGE,
+		PROXY_OMAP_STREAM_KEYS_ONLY, &stream), 0);
+	CHECK_EQ(DrainOmapStream(stream, STREAM_KEYS - 299, true), 299);
+	CephProxyOmapStreamClose(stream);
+
+	/* closed with the next page in flight */
+	CHECK_EQ(CephProxyOmapStreamOpen(proxy, poolId, "stream_obj", nullptr, 16, 0, &stream), 0);
+	const char *key = nullptr;
+	size_t keyLen = 0;
+	for (uint32_t i = 0; i < 20; i++) {
+		CHECK_EQ(CephProxyOmapStreamNext(stream, &key, &keyLen, nullptr, nullptr), 1);
+	}
+	CephProxyOmapStreamClose(stream);
+
+	CHECK_EQ(CephProxyOmapStreamOpen(proxy, poolId, "stream_missing", nullptr, 0, 0, &stream), 0);
+	CHECK_EQ(CephProxyOmapStreamNext(stream, &key, &keyLen, nullptr, nullptr), -ENOENT);
+	CHECK_EQ(CephProxyOmapStreamNext(stream, &key, &keyLen, nullptr, nullptr), -ENOENT);
+	CephProxyOmapStreamClose(stream);
+
+	/* each page takes 2ms, the caller 10ms to consume one: the next is always there */
+	FakeCluster &cluster = FakeCluster::Instance();
+	cluster.SetLatency(FAKE_OP_READ, 2000);
+	CHECK_EQ(CephProxyOmapStreamOpen(proxy, poolId, "stream_obj", nullptr, 1000, 0, &stream), 0);
+	CHECK_EQ(DrainOmapStream(stream, 0, false, 1000), STREAM_KEYS);
+	CephProxyOmapStreamStat(stream, &stat);
+	CHECK_EQ(stat.pages, STREAM_KEYS / 1000);
+	CHECK_EQ(stat.stalls, 1);
+	CephProxyOmapStreamClose(stream);
+	cluster.SetLatency(FAKE_OP_READ, 0);
+}
+
+#define MERGE_OBJ_NUM 4
+#define MERGE_OBJ_SIZE (16 * 1024)
+#define MERGE_BATCH 32
+/* the largest window proxy.conf allows */
+#define MERGE_LONG_WINDOW_US 10000
+
+struct MergeOp {
+	uint32_t obj;
+	uint32_t seq;
+	bool isRead;
+	uint64_t off;
+	std::string data;
+	std::string expect;
+	char back[MERGE_OBJ_SIZE];
+	size_t bytes;
+	int prval;
+	int ret;
+	uint32_t fired;
+	ceph_proxy_op_t op;
+};
+
+static std::mutex gMergeLock;
+static std::condition_variable gMergeCond;
+static uint32_t gMergeFired = 0;
+static uint32_t gMergeLastSeq[MERGE_OBJ_NUM];
+static uint32_t gMergeOutOfOrder = 0;
+
+static void MergeOpDone(int ret, void *arg)
+{
+	MergeOp *m = static_cast<MergeOp *>(arg);
+	std::lock_guard<std::mutex> l(gMergeLock);
+	m->ret = ret;
+	m->fired++;
+	if (m->seq < gMergeLastSeq[m->obj]) {
+		gMergeOutOfOrder++;
+	}
+	gMergeLastSeq[m->obj] = m->seq;
+	gMergeFired++;
+	gMergeCond.notify_all();
+}
+
+/*
+ * Random overlapping writes mixed with reads of the same objects, queued a
+ * batch at a time so the worker sees them together. Every read must see the
+ * writes queued before it and none after, and every op completes once.
+ */
+static void TestWriteMerge(ceph_proxy_t proxy, int64_t poolId)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::mt19937 rng(20211);
+	std::string model[MERGE_OBJ_NUM];
+	uint32_t seq = 0;
+	for (uint32_t i = 0; i < MERGE_OBJ_NUM; i++) {
+		std::string oid = "merge_obj_" + std::to_string(i);
+		model[i].assign(MERGE_OBJ_SIZE, 'A' + i);
+		ceph_proxy_op_t op = nullptr;
+		CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, oid.c_str()), 0);
+		CephProxyWriteOpWrite(op, model[i].data(), MERGE_OBJ_SIZE, 0);
+		CHECK_EQ(RunOp(proxy, op), 0);
+		CephProxyWriteOpRelease(op);
+	}
+
+	uint64_t writes = 0;
+	uint64_t sent = cluster.GetOpCount(FAKE_OP_WRITE);
+	std::vector<MergeOp> ops(MERGE_BATCH);
+	for (uint32_t round = 0; round < 200; round++) {
+		ceph_proxy_op_t batch[MERGE_BATCH];
+		completion_t comps[MERGE_BATCH];
+		for (uint32_t i = 0; i < MERGE_BATCH; i++) {
+			MergeOp &m = ops[i];
+			/* few objects and short ranges, so most writes touch another one */
+			m.obj = rng() % MERGE_OBJ_NUM;
+			m.seq = ++seq;
+			m.isRead = rng() % 8 == 0;
+			m.ret = 1;
+			m.fired = 0;
+			std::string oid = "merge_obj_" + std::to_string(m.obj);
+			if (m.isRead) {
+				m.expect = model[m.obj];
+				CHECK_EQ(CephProxyReadOpInit2(&m.op, poolId, oid.c_str()), 0);
+				CephProxyReadOpRead(m.op, 0, MERGE_OBJ_SIZE, m.back, &m.bytes, &m.prval);
+			} else {
+				uint64_t len = (rng() % 16 + 1) * 512;
+				m.off = (rng() % (MERGE_OBJ_SIZE / 512)) * 512;
+				len = std::min<uint64_t>(len, MERGE_OBJ_SIZE - m.off);
+				m.data.assign(len, 'a' + rng() % 26);
+				model[m.obj].replace(m.off, len, m.data);
+				CHECK_EQ(CephProxyWriteOpInit2(&m.op, poolId, oid.c_str()), 0);
+				CephProxyWriteOpWrite(m.op, m.data.data(), len, m.off);
+				writes++;
+			}
+			batch[i] = m.op;
+			comps[i] = CephProxyCreateCompletion(MergeOpDone, &m);
+		}
+		CHECK_EQ(CephProxyQueueOps(proxy, batch, comps, MERGE_BATCH), MERGE_BATCH);
+		{
+			std::unique_lock<std::mutex> l(gMergeLock);
+			gMergeCond.wait(l, [round]() { return gMergeFired >= (round + 1) * MERGE_BATCH; });
+		}
+		for (uint32_t i = 0; i < MERGE_BATCH; i++) {
+			MergeOp &m = ops[i];
+			CHECK_EQ(m.fired, 1);
+			CHECK_EQ(m.ret, 0);
+			if (m.isRead) {
+				CHECK_EQ(m.bytes, MERGE_OBJ_SIZE);
+				CHECK(memcmp(m.back, m.expect.data(), MERGE_OBJ_SIZE) == 0);
+				CephProxyReadOpRelease(m.op);
+			} else {
+				CephProxyWriteOpRelease(m.op);
+			}
+			CephProxyCompletionDestroy(comps[i]);
+		}
+	}
+	CHECK_EQ(gMergeOutOfOrder, 0);
+	CHECK(cluster.GetOpCount(FAKE_OP_WRITE) - sent < writes);
+
+	for (uint32_t i = 0; i < MERGE_OBJ_NUM; i++) {
+		std::string oid = "merge_obj_" + std::to_string(i);
+		std::vector<char> back(MERGE_OBJ_SIZE);
+		size_t bytes = 0;
+		int prval = 0;
+		ceph_proxy_op_t op = nullptr;
+		CHECK_EQ(CephProxyReadOpInit2(&op, poolId, oid.c_str()), 0);
+		CephProxyReadOpRead(op, 0, MERGE_OBJ_SIZE, back.data(), &bytes, &prval);
+		CHECK_EQ(RunOp(proxy, op), 0);
+		CephProxyReadOpRelease(op);
+		CHECK_EQ(bytes, MERGE_OBJ_SIZE);
+		CHECK(memcmp(back.data(), model[i].data(), MERGE_OBJ_SIZE) == 0);
+	}
+}
+
+/*
+ * With a long window the worker holds a lone write at the tail. The write
+ * next to it ends the window when it is queued, instead of at the timeout.
+ */
+static void TestMergeWindowEnd(ceph_proxy_t proxy, int64_t poolId, uint32_t windowUs)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	std::string data(4096, 'w');
+	uint64_t sent = cluster.GetOpCount(FAKE_OP_WRITE);
+	OpWaiter w[2];
+	ceph_proxy_op_t op[2];
+	completion_t c[2];
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 2; i++) {
+		CHECK_EQ(CephProxyWriteOpInit2(&op[i], poolId, "merge_window_obj"), 0);
+		CephProxyWriteOpWrite(op[i], data.data(), data.size(), i * data.size());
+		c[i] = CephProxyCreateCompletion(OpDone, &w[i]);
+		CHECK_EQ(CephProxyQueueOp(proxy, op[i], c[i]), 0);
+		if (i == 0) {
+			/* the worker is in the window by now */
+			std::this_thread::sleep_for(std::chrono::microseconds(windowUs / 10));
+		}
+	}
+	for (int i = 0; i < 2; i++) {
+		std::unique_lock<std::mutex> l(w[i].lock);
+		w[i].cond.wait(l, [&w, i]() { return w[i].done; });
+		CHECK_EQ(w[i].ret, 0);
+	}
+	auto waitedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	CHECK(waitedUs < windowUs * 3 / 4);
+	CHECK_EQ(cluster.GetOpCount(FAKE_OP_WRITE) - sent, 1);
+	for (int i = 0; i < 2; i++) {
+		CephProxyWriteOpRelease(op[i]);
+		CephProxyCompletionDestroy(c[i]);
+	}
+}
+
+static void TestOmapXattr(ceph_proxy_t proxy, int64_t poolId)
+{
+	const size_t num = 10;
+	std::vector<std::string> keys;
+	std::vector<std::string> vals;
+	std::vector<const char *> keyPtrs;
+	std::vector<const char *> valPtrs;
+	std::vector<size_t> lens;
+	for (size_t i = 0; i < num; i++) {
+		keys.push_back("key_" + std::to_string(i));
+		vals.push_back("val_" + std::to_string(i * i));
+	}
+	for (size_t i = 0; i < num; i++) {
+		keyPtrs.push_back(keys[i].c_str());
+		valPtrs.push_back(vals[i].c_str());
+		lens.push_back(vals[i].length());
+	}
+
+	ceph_proxy_op_t op = nullptr;
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "omap_obj"), 0);
+	CephProxyWriteOpCreateObject(op, CEPHPROXY_CREATE_EXCLUSIVE, nullptr);
+	CephProxyWriteOpOmapSet(op, keyPtrs.data(), valPtrs.data(), lens.data(), num);
+	CephProxyWriteOpSetXattr(op, "owner", "proxy", strlen("proxy"));
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CephProxyWriteOpRelease(op);
+
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, "omap_obj"), 0);
+	CephProxyWriteOpCreateObject(op, CEPHPROXY_CREATE_EXCLUSIVE, nullptr);
+	CHECK_EQ(RunOp(proxy, op), -EEXIST);
+	CephProxyWriteOpRelease(op);
+
+	/* page through the keys four at a time */
+	std::set<std::string> seen;
+	std::string after;
+	unsigned char more = 1;
+	while (more) {
+		proxy_omap_iter_t iter = nullptr;
+		int prval = -1;
+		CHECK_EQ(CephProxyReadOpInit2(&op, poolId, "omap_obj"), 0);
+		RadosReadOpOmapGetVals(op, after.c_str(), 4, &iter, &more, &prval);
+		CHECK_EQ(RunOp(proxy, op), 0);
+		CephProxyReadOpRelease(op);
+		CHECK_EQ(prval, 0);
+		CHECK(RadosOmapIterSize(iter) <= 4);
+		char *key = nullptr;
+		char *val = nullptr;
+		size_t keyLen = 0;
+		size_t valLen = 0;
+		while (RadosOmapGetNext(iter, &key, &val, &keyLen, &valLen) == 0 && key != nullptr) {
+			std::string k(key, keyLen);
+			size_t idx = atoi(k.c_str() + strlen("key_"));
+			CHECK(std::string(val, valLen) == vals[idx]);
+			seen.insert(k);
+			after = k;
+		}
+		RadosOmapIterEnd(iter);
+	}
+	CHECK_EQ(seen.size(), num);
+
+	proxy_xattrs_iter_t xiter = nullptr;
+	int prval = -1;
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, "omap_obj"), 0);
+	CephProxyReadOpGetXattrs(op, &xiter, &prval);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CephProxyReadOpRelease(op);
+	const char *name = nullptr;
+	const char *val = nullptr;
+	size_t len = 0;
+	CHECK_EQ(RadosGetXattrsNext(xiter, &name, &val, &len), 0);
+	CHECK(name != nullptr && strcmp(name, "owner") == 0);
+	CHECK(std::string(val, len) == "proxy");
+	CHECK_EQ(RadosGetXattrsNext(xiter, &name, &val, &len), 0);
+	CHECK(name == nullptr);
+	RadosGetXattrsEnd(xiter);
+}
+
+static std::mutex gNotifyLock;
+static std::set<uint32_t> gNotified;
+
+static int32_t PoolNewNotify(uint32_t *poolId, uint32_t length)
+{
+	std::lock_guard<std::mutex> l(gNotifyLock);
+	for (uint32_t i = 0; i < length; i++) {
+		gNotified.insert(poolId[i]);
+	}
+	return 0;
+}
+
+/* two full df rounds guarantee one ran after the cluster was changed */
+static void WaitMonitorUpdate()
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	uint64_t start = cluster.GetMonCommandCount("df");
+	for (uint32_t i = 0; i < MON_UPDATE_WAIT_SEC * 10; i++) {
+		if (cluster.GetMonCommandCount("df") >= start + 2) {
+			return;
+		}
+		usleep(100000);
+	}
+	CHECK(false);
+}
+
+static void TestPoolUsage(ceph_proxy_t proxy, int64_t rbdPool)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	CHECK_EQ(CephProxyRegisterPoolNewNotifyFn(PoolNewNotify), 0);
+	cluster.SetEcProfile("ec21", 2, 1, 8192);
+	int64_t ecPool = cluster.CreateEcPool("ecpool", "ec21");
+	CHECK(ecPool > 0);
+	CHECK_EQ(cluster.SetPoolStored("rbd", 10 * GIB), 0);
+	CHECK_EQ(cluster.SetPoolStored("ecpool", 4 * GIB), 0);
+	WaitMonitorUpdate();
+
+	struct PoolInfo info;
+	CHECK_EQ(CephProxyGetPoolInfo(proxy, ecPool, &info), 0);
+	CHECK_EQ(info.k, 2);
+	CHECK_EQ(info.m, 1);
+	CHECK_EQ(info.stripeUnit, 8192);
+	CHECK_EQ(CephProxyGetPoolInfo(proxy, rbdPool, &info), 0);
+	CHECK_EQ(info.k, 1);
+	CHECK_EQ(info.m, 2);
+	CHECK_EQ(info.stripeUnit, 4096);
+
+	/* raw used 10 * 3 + 4 * 1.5 of 300 GiB, max avail is reported in raw bytes */
+	uint64_t used = 0;
+	uint64_t maxAvail = 0;
+	CHECK_EQ(CephProxyGetUsedSizeAndMaxAvail(proxy, used, maxAvail), 0);
+	CHECK_EQ(used, 36 * GIB);
+	CHECK_EQ(maxAvail, 264 * GIB);
+	{
+		std::lock_guard<std::mutex> l(gNotifyLock);
+		CHECK(gNotified.count(ecPool) == 1);
+	}
+
+	CHECK_EQ(cluster.DeletePool("ecpool"), 0);
+	WaitMonitorUpdate();
+	CHECK_EQ(CephProxyGetPoolInfo(proxy, ecPool, &info), -ENOENT);
+
+	/* a failing df keeps the last known values */
+	cluster.InjectError(FAKE_OP_MON, -ETIMEDOUT, 0, "df");
+	WaitMonitorUpdate();
+	CHECK_EQ(CephProxyGetPoolInfo(proxy, rbdPool, &info), 0);
+	cluster.ClearFaults();
+	CHECK_EQ(cluster.SetPoolStored("rbd", 0), 0);
+}
+
+static std::string PoolName(ceph_proxy_t proxy, int64_t poolId)
+{
+	char name[64];
+	int ret = CephProxyGetPoolNameByPoolId(proxy, poolId, name, sizeof(name));
+	return ret == 0 ? std::string(name) : std::to_string(ret);
+}
+
+static void TestPoolDirectory(ceph_proxy_t proxy, int64_t rbdPool)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	char name[64];
+
+	/* a new pool is found by the reload on miss, short buffers still fail */
+	int64_t a = cluster.CreatePool("dir_a");
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_a"), a);
+	CHECK(PoolName(proxy, a) == "dir_a");
+	CHECK_EQ(CephProxyGetPoolNameByPoolId(proxy, a, name, 5), -ERANGE);
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_none"), -1);
+
+	/* rename: the new name misses and reloads, which drops the old one */
+	CHECK_EQ(cluster.RenamePool("dir_a", "dir_b"), 0);
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_b"), a);
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_a"), -1);
+	CHECK(PoolName(proxy, a) == "dir_b");
+
+	/* delete and re-create under the same name: the IoCtx of the old id fails and drops it */
+	CHECK_EQ(cluster.DeletePool("dir_b"), 0);
+	int64_t b = cluster.CreatePool("dir_b");
+	CHECK(b != a);
+	CHECK(CephProxyGetIoCtx2(proxy, a) == nullptr);
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_b"), b);
+	CHECK(PoolName(proxy, b) == "dir_b");
+	CHECK(PoolName(proxy, a) == std::to_string(-1));
+
+	/* a missing object keeps the pool, an op on a deleted pool drops it */
+	uint64_t size = 0;
+	int64_t d = cluster.CreatePool("dir_d");
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_d"), d);
+	CHECK_EQ(StatObject(proxy, d, "dir_none", &size), -ENOENT);
+	uint64_t reloads = cluster.GetOpCount(FAKE_OP_OSDMAP);
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_d"), d);
+	CHECK_EQ(cluster.GetOpCount(FAKE_OP_OSDMAP), reloads);
+	CHECK_EQ(cluster.DeletePool("dir_d"), 0);
+	int64_t e = cluster.CreatePool("dir_d");
+	CHECK_EQ(StatObject(proxy, d, "dir_none", &size), -ENOENT);
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_d"), e);
+	CHECK_EQ(cluster.DeletePool("dir_d"), 0);
+
+	/* without a miss the timer picks the rename up within one interval */
+	CHECK_EQ(cluster.RenamePool("dir_b", "dir_c"), 0);
+	WaitMonitorUpdate();
+	uint64_t maps = cluster.GetOpCount(FAKE_OP_OSDMAP);
+	uint64_t ioctxs = cluster.GetOpCount(FAKE_OP_IOCTX);
+	CHECK(PoolName(proxy, b) == "dir_c");
+	CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "dir_c"), b);
+
+	/* hits ask nothing of librados */
+	for (uint32_t i = 0; i < 1000; i++) {
+		CHECK_EQ(CephProxyGetPoolIdByPoolName(proxy, "rbd"), rbdPool);
+		CHECK_EQ(CephProxyGetPoolNameByPoolId(proxy, rbdPool, name, sizeof(name)), 0);
+	}
+	CHECK_EQ(cluster.GetOpCount(FAKE_OP_OSDMAP), maps);
+	CHECK_EQ(cluster.GetOpCount(FAKE_OP_IOCTX), ioctxs);
+
+	/* concurrent misses on the same new pool share the reload behind one osdmap wait */
+	const uint32_t threadNum = 8;
+	cluster.SetLatency(FAKE_OP_OSDMAP, 20000);
+	int64_t c = cluster.CreatePool("dir_shared");
+	std::vector<std::thread> threads;
+	std::atomic<uint32_t> found { 0 };
+	for (uint32_t i = 0; i < threadNum; i++) {
+		threads.emplace_back([&]() {
+			if (CephProxyGetPoolIdByPoolName(proxy, "dir_shared") == c) {
+				found++;
+			}
+		});
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+	cluster.SetLatency(FAKE_OP_OSDMAP, 0);
+	CHECK_EQ(found.load(), threadNum);
+	/* a thread that missed while the first reload ran may need a second one */
+	CHECK(cluster.GetOpCount(FAKE_OP_OSDMAP) - maps <= 4);
+
+	/* lookups racing rename, delete and re-create only see ids the name really had */
+	std::atomic<bool> stop { false };
+	std::atomic<uint32_t> bad { 0 };
+	int64_t first = cluster.CreatePool("dir_race");
+	CHECK(first > 0);
+	threads.clear();
+	for (uint32_t i = 0; i < threadNum; i++) {
+		threads.emplace_back([&, i]() {
+			while (!stop) {
+				const char *poolName = i % 2 == 0 ? "dir_race" : "dir_race2";
+				int64_t id = CephProxyGetPoolIdByPoolName(proxy, poolName);
+				if (id != -1 && id < first) {
+					bad++;
+				}
+				if (id == -1) {
+					continue;
+				}
+				std::string back = PoolName(proxy, id);
+				if (back != "dir_race" && back != "dir_race2" && back != std::to_string(-1)) {
+					bad++;
+				}
+			}
+		});
+	}
+	for (uint32_t round = 0; round < 50; round++) {
+		CHECK_EQ(cluster.RenamePool("dir_race", "dir_race2"), 0);
+		usleep(1000);
+		CHECK_EQ(cluster.DeletePool("dir_race2"), 0);
+		usleep(1000);
+		CHECK(cluster.CreatePool("dir_race") > 0);
+		usleep(1000);
+	}
+	stop = true;
+	for (auto &t : threads) {
+		t.join();
+	}
+	CHECK_EQ(bad.load(), 0);
+	CHECK_EQ(cluster.DeletePool("dir_race"), 0);
+	CHECK_EQ(cluster.DeletePool("dir_c"), 0);
+	CHECK_EQ(cluster.DeletePool("dir_shared"), 0);
+}
+
+static void TestDiskUsage()
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	const uint64_t objSize = 4ULL << 20;
+	cluster.SetEcProfile("ec42", 4, 2);
+	CHECK(cluster.CreatePool("images") > 0);
+	CHECK(cluster.CreateEcPool("ecimages", "ec42") > 0);
+
+	CHECK_EQ(cluster.CreateImage("images", "vol1", 64 * objSize), 0);
+	CHECK_EQ(cluster.WriteImage("images", "vol1", 0, 2 * objSize), 0);
+	CHECK_EQ(cluster.CreateImageSnap("images", "vol1", "s1"), 0);
+	/* rewriting object 1 after the snap counts it twice, once per epoch */
+	CHECK_EQ(cluster.WriteImage("images", "vol1", objSize + 100, 10), 0);
+	CHECK_EQ(cluster.WriteImage("images", "vol1", 10 * objSize, 1), 0);
+	CHECK_EQ(cluster.CreateImage("ecimages", "vol2", 16 * objSize), 0);
+	CHECK_EQ(cluster.WriteImage("ecimages", "vol2", 0, 4 * objSize), 0);
+	CHECK_EQ(cluster.WriteImage("ecimages", "vol2", 64 * objSize, 1), -EINVAL);
+
+	/* replicated pools count as k=1 m=2, the EC pool as 4+2 */
+	uint64_t usage = 0;
+	CHECK_EQ(CephLibrbdDiskUsage(&usage), 0);
+	CHECK_EQ(usage, (4 * objSize * 3 + 4 * objSize * 6 / 4) / (1024 * 1024));
+
+	cluster.InjectError(FAKE_OP_RBD, -EIO, 1, "vol2");
+	CHECK_EQ(CephLibrbdDiskUsage(&usage), -EIO);
+}
+
+/*
+ * A mixed cluster as the monitors report it: host a holds hdd osd.0 (64K,
+ * reported), hdd osd.1 (not reported, rotational) and ssd osd.2 (4K); host b
+ * ssd osd.3 (not reported, bdev_type ssd), a filestore hdd osd.4 and nvme
+ * osd.5 (4K). Rules: 0 takes default, 1 default~ssd, 2 default~hdd, 3 host b,
+ * 4 a root that does not exist. osd0Size and osd5Size replace the sizes of
+ * osd.0 and osd.5.
+ */
+static MinAllocReplies MixedClusterReplies(int64_t epoch, const std::vector<std::pair<int64_t, int>> &pools,
+	const std::string &osd0Size = "65536", const std::string &osd5Size = "4096")
+{
+	MinAllocReplies r;
+	r.osdDump = "{\"epoch\": " + std::to_string(epoch) + ", \"fsid\": \"7c1b\", \"pools\": [";
+	for (size_t i = 0; i < pools.size(); i++) {
+		r.osdDump += std::string(i ? ", " : "") + "{\"pool\": " + std::to_string(pools[i].first) +
+			", \"pool_name\": \"p" + std::to_string(i) + "\", \"size\": 3, \"crush_rule\": " +
+			std::to_string(pools[i].second) + ", \"flags_names\": \"hashpspool\"}";
+	}
+	r.osdDump += "], \"osds\": [{\"osd\": 0, \"up\": 1, \"in\": 1}]}";
+	r.osdMetadata = "[\n"
+		"  {\"id\": 0, \"osd_objectstore\": \"bluestore\", \"bluestore_bdev_type\": \"hdd\",\n"
+		"   \"bluestore_bdev_rotational\": \"1\", \"bluestore_min_alloc_size\": \"" + osd0Size + "\"},\n"
+		"  {\"id\": 1, \"osd_objectstore\": \"bluestore\", \"bluestore_bdev_rotational\": \"1\"},\n"
+		"  {\"id\": 2, \"osd_objectstore\": \"bluestore\", \"bluestore_bdev_type\": \"ssd\",\n"
+		"   \"bluestore_min_alloc_size\": \"4096\", \"hostname\": \"a\"},\n"
+		"  {\"id\": 3, \"osd_objectstore\": \"bluestore\", \"bluestore_bdev_type\": \"ssd\",\n"
+		"   \"bluestore_bdev_rotational\": \"0\", \"ceph_version\": \"ceph version 14.2.8 (\\\"nautilus\\\")\"},\n"
+		"  {\"id\": 4, \"osd_objectstore\": \"filestore\", \"backend_filestore_dev_node\": \"sdd\"},\n"
+		"  {\"id\": 5, \"osd_objectstore\": \"bluestore\", \"bluestore_bdev_type\": \"ssd\",\n"
+		"   \"bluestore_min_alloc_size\": " + osd5Size + "}\n"
+		"]";
+	r.osdTree = "{\"nodes\": ["
+		"{\"id\": -1, \"name\": \"default\", \"type\": \"root\", \"type_id\": 10, \"children\": [-5, -3]},"
+		"{\"id\": -3, \"name\": \"a\", \"type\": \"host\", \"type_id\": 1, \"pool_weights\": {}, \"children\": [2, 1, 0]},"
+		"{\"id\": 0, \"device_class\": \"hdd\", \"name\": \"osd.0\", \"type\": \"osd\", \"crush_weight\": 0.0977,"
+		" \"status\": \"up\", \"reweight\": 1.0, \"primary_affinity\": 1.0},"
+		"{\"id\": 1, \"device_class\": \"hdd\", \"name\": \"osd.1\", \"type\": \"osd\", \"status\": \"up\"},"
+		"{\"id\": 2, \"device_class\": \"ssd\", \"name\": \"osd.2\", \"type\": \"osd\", \"status\": \"up\"},"
+		"{\"id\": -5, \"name\": \"b\", \"type\": \"host\", \"type_id\": 1, \"children\": [5, 4, 3]},"
+		"{\"id\": 3, \"device_class\": \"ssd\", \"name\": \"osd.3\", \"type\": \"osd\", \"status\": \"up\"},"
+		"{\"id\": 4, \"device_class\": \"hdd\", \"name\": \"osd.4\", \"type\": \"osd\", \"status\": \"down\"},"
+		"{\"id\": 5, \"device_class\": \"nvme\", \"name\": \"osd.5\", \"type\": \"osd\", \"status\": \"up\"}"
+		"], \"stray\": []}";
+	r.crushRules = "[";
+	const char *takes[] = { "\"item\": -1, \"item_name\": \"default\"", "\"item\": -2, \"item_name\": \"default~ssd\"",
+		"\"item\": -4, \"item_name\": \"default~hdd\"", "\"item\": -5, \"item_name\": \"b\"",
+		"\"item\": -9, \"item_name\": \"gone~hdd\"" };
+	for (int i = 0; i < 5; i++) {
+		r.crushRules += std::string(i ? ", " : "") + "{\"rule_id\": " + std::to_string(i) +
+			", \"rule_name\": \"r" + std::to_string(i) + "\", \"ruleset\": " + std::to_string(i) +
+			", \"type\": 1, \"min_size\": 1, \"max_size\": 10, \"steps\": [{\"op\": \"take\", " + takes[i] +
+			"}, {\"op\": \"chooseleaf_firstn\", \"num\": 0, \"type\": \"host\"}, {\"op\": \"emit\"}]}";
+	}
+	r.crushRules += "]";
+	return r;
+}
+
+static void SetMixedClusterReplies(const MinAllocReplies &r, int64_t statEpoch)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	cluster.SetMonReply("osd dump", r.osdDump);
+	cluster.SetMonReply("osd metadata", r.osdMetadata);
+	cluster.SetMonReply("osd tree", r.osdTree);
+	cluster.SetMonReply("osd crush rule dump", r.crushRules);
+	/* nautilus nests the epoch in an osdmap section */
+	cluster.SetMonReply("osd stat", "{\"osdmap\": {\"epoch\": " + std::to_string(statEpoch) +
+		", \"num_osds\": 6, \"num_up_osds\": 5, \"num_in_osds\": 6, \"num_remapped_pgs\": 0}}");
+}
+
+static void TestProxyJson()
+{
+	ProxyJson j;
+	CHECK_EQ(ProxyJsonParse(" {\"a\": [1, -2.5e3, true, null, {}], \"b\\\"\\u00e9\": \"x\\ny\", \"c\": \"12\"} ", j), 0);
+	CHECK_EQ(j.type, ProxyJson::JSON_OBJECT);
+	const ProxyJson *a = j.Get("a");
+	CHECK(a != nullptr && a->type == ProxyJson::JSON_ARRAY && a->items.size() == 5);
+	CHECK(a->items[1].str == "-2.5e3" && a->items[2].str == "true" && a->items[3].type == ProxyJson::JSON_NULL);
+	std::string str;
+	CHECK(j.GetString("b\"\xc3\xa9", str) && str == "x\ny");
+	int64_t n = 0;
+	CHECK(j.GetInt("c", n) && n == 12);
+	CHECK(!a->items[1].ToInt(n));
+	CHECK(j.Get("d") == nullptr && a->Get("a") == nullptr);
+
+	for (const char *bad : { "", "{", "[1,]", "{\"a\" 1}", "[1] x", "\"abc", "{\"a\": tru}", "[\"\\q\"]" }) {
+		CHECK_EQ(ProxyJsonParse(bad, j), -EINVAL);
+	}
+	std::string deep(100, '[');
+	CHECK_EQ(ProxyJsonParse(deep + std::string(100, ']'), j), -EINVAL);
+}
+
+static void TestMinAllocBuild()
+{
+	MinAllocReplies r = MixedClusterReplies(42, { { 1, 0 }, { 2, 1 }, { 3, 2 }, { 4, 3 }, { 5, 4 }, { 6, 9 } });
+	MinAllocInfo info;
+	CHECK_EQ(MinAllocDiscovery::Build(r, 32768, 16384, info), 0);
+	CHECK_EQ(info.epoch, 42);
+	/* unreported OSDs take the fallback for their rotational flag, filestore is left out */
+	CHECK_EQ(info.byClass.size(), 3);
+	CHECK_EQ(info.byClass["hdd"], 65536);
+	CHECK_EQ(info.byClass["ssd"], 16384);
+	CHECK_EQ(info.byClass["nvme"], 4096);
+	CHECK_EQ(info.byBdev["hdd"], 65536);
+	CHECK_EQ(info.byBdev["ssd"], 16384);
+	CHECK_EQ(info.byPool[1], 65536);
+	CHECK_EQ(info.byPool[2], 16384);
+	CHECK_EQ(info.byPool[3], 65536);
+	CHECK_EQ(info.byPool[4], 16384);
+	/* no OSD behind the rule, or no such rule */
+	CHECK_EQ(info.byPool[5], 0);
+	CHECK_EQ(info.byPool[6], 0);
+
+	/* osd.0 redeployed with 4K leaves osd.1's fallback the largest hdd */
+	MinAllocInfo info2;
+	CHECK_EQ(MinAllocDiscovery::Build(MixedClusterReplies(43, { { 3, 2 } }, "4096"), 32768, 16384, info2), 0);
+	CHECK_EQ(info2.byClass["hdd"], 32768);
+	CHECK_EQ(info2.byPool[3], 32768);
+
+	MinAllocReplies broken = r;
+	broken.osdMetadata = "[{\"id\": 0,";
+	CHECK_EQ(MinAllocDiscovery::Build(broken, 32768, 16384, info2), -EINVAL);
+	broken = r;
+	broken.osdDump = "{\"pools\": []}";
+	CHECK_EQ(MinAllocDiscovery::Build(broken, 32768, 16384, info2), -EINVAL);
+}
+
+static void TestMinAllocSize(ceph_proxy_t proxy, int64_t rbdPool)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t ssdPool = cluster.CreatePool("alloc_ssd");
+	int64_t hddPool = cluster.CreatePool("alloc_hdd");
+	int64_t lostPool = cluster.CreatePool("alloc_lost");
+	CHECK(ssdPool > 0 && hddPool > 0 && lostPool > 0);
+
+	/* monitors without the commands: the client's bluestore_min_alloc_size_hdd/ssd */
+	uint32_t size = 0;
+	CHECK_EQ(CephProxyGetMinAllocSize(proxy, &size, CEPH_BDEV_HDD), 0);
+	CHECK_EQ(size, 65536);
+	CHECK_EQ(CephProxyGetMinAllocSize(proxy, &size, CEPH_BDEV_SSD), 0);
+	CHECK_EQ(size, 16384);
+
+	/* the timer sees an epoch and discovers */
+	std::vector<std::pair<int64_t, int>> pools = { { rbdPool, 0 }, { ssdPool, 1 }, { hddPool, 2 }, { lostPool, 4 } };
+	SetMixedClusterReplies(MixedClusterReplies(42, pools, "131072"), 42);
+	WaitMonitorUpdate();
+	uint64_t loads = cluster.GetMonCommandCount("osd metadata");
+	CHECK(loads >= 1);
+	CHECK_EQ(CephProxyGetMinAllocSize(proxy, &size, CEPH_BDEV_HDD), 0);
+	CHECK_EQ(size, 131072);
+	CHECK_EQ(CephProxyGetMinAllocSize(proxy, &size, CEPH_BDEV_SSD), 0);
+	CHECK_EQ(size, 16384);
+	CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, ssdPool, &size), 0);
+	CHECK_EQ(size, 16384);
+	CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, hddPool, &size), 0);
+	CHECK_EQ(size, 131072);
+	CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, lostPool, &size), -ENOENT);
+	CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, 9999, &size), -ENOENT);
+	CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, ssdPool, nullptr), -EINVAL);
+	/* the miss above loaded once, the pool is not asked for again before the epoch moves */
+	loads = cluster.GetMonCommandCount("osd metadata");
+	for (uint32_t i = 0; i < 100; i++) {
+		CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, 9999, &size), -ENOENT);
+	}
+	CHECK_EQ(cluster.GetMonCommandCount("osd metadata"), loads);
+
+	/* cached: neither lookups nor an unchanged epoch ask the monitors again */
+	for (uint32_t i = 0; i < 10000; i++) {
+		CHECK_EQ(CephProxyGetMinAllocSize(proxy, &size, (i & 1) ? CEPH_BDEV_SSD : CEPH_BDEV_HDD), 0);
+		CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, (i & 1) ? ssdPool : hddPool, &size), 0);
+	}
+	WaitMonitorUpdate();
+	CHECK_EQ(cluster.GetMonCommandCount("osd metadata"), loads);
+	CHECK(cluster.GetMonCommandCount("osd stat") >= 1);
+
+	/* a pool the osd dump does not have yet is discovered once, shared by concurrent callers */
+	int64_t newPool = cluster.CreatePool("alloc_new");
+	CHECK(newPool > 0);
+	std::vector<std::thread> threads;
+	std::atomic<uint32_t> missing { 0 };
+	for (uint32_t t = 0; t < 8; t++) {
+		threads.emplace_back([&]() {
+			uint32_t s = 0;
+			if (CephProxyGetPoolMinAllocSize(proxy, newPool, &s) == -ENOENT) {
+				missing++;
+			}
+		});
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+	CHECK_EQ(missing.load(), 8);
+	CHECK(cluster.GetMonCommandCount("osd metadata") - loads <= 4);
+
+	/* a new epoch reloads, a failed reload falls back until the next epoch check */
+	pools.push_back({ newPool, 1 });
+	loads = cluster.GetMonCommandCount("osd metadata");
+	cluster.InjectError(FAKE_OP_MON, -ETIMEDOUT, 1, "osd metadata");
+	SetMixedClusterReplies(MixedClusterReplies(43, pools, "262144", "65536"), 43);
+	WaitMonitorUpdate();
+	WaitMonitorUpdate();
+	CHECK(cluster.GetMonCommandCount("osd metadata") >= loads + 2);
+	CHECK_EQ(CephProxyGetMinAllocSize(proxy, &size, CEPH_BDEV_HDD), 0);
+	CHECK_EQ(size, 262144);
+	/* the nvme OSD is now the largest solid state one */
+	CHECK_EQ(CephProxyGetMinAllocSize(proxy, &size, CEPH_BDEV_SSD), 0);
+	CHECK_EQ(size, 65536);
+	CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, newPool, &size), 0);
+	CHECK_EQ(size, 16384);
+	CHECK_EQ(CephProxyGetPoolMinAllocSize(proxy, hddPool, &size), 0);
+	CHECK_EQ(size, 262144);
+
+	cluster.ClearFaults();
+	for (const char *prefix : { "osd dump", "osd metadata", "osd tree", "osd crush rule dump", "osd stat" }) {
+		cluster.SetMonReply(prefix, "");
+	}
+	for (const char *name : { "alloc_ssd", "alloc_hdd", "alloc_lost", "alloc_new" }) {
+		CHECK_EQ(cluster.DeletePool(name), 0);
+	}
+}
+
+#define CAPACITY_REFRESH_MS 100
+#define CAPACITY_MAX_STALE_MS 500
+
+struct CapacityWaiter {
+	OpWaiter w;
+	uint64_t version = 0;
+};
+
+static void CapacityDone(int ret, uint64_t version, void *arg)
+{
+	CapacityWaiter *c = static_cast<CapacityWaiter *>(arg);
+	std::lock_guard<std::mutex> l(c->w.lock);
+	c->version = version;
+	c->w.ret = ret;
+	c->w.done = true;
+	c->w.cond.notify_all();
+}
+
+static int WaitCapacity(CapacityWaiter &c)
+{
+	std::unique_lock<std::mutex> l(c.w.lock);
+	c.w.cond.wait(l, [&c]() { return c.w.done; });
+	return c.w.ret;
+}
+
+static uint64_t PoolBytes(ceph_proxy_t proxy, int64_t poolId)
+{
+	uint64_t id = poolId;
+	CephPoolStat stat;
+	CHECK_EQ(CephProxyGetPoolsStat(proxy, &stat, &id, 1), 0);
+	return stat.numBytes;
+}
+
+static void TestCapacity(ceph_proxy_t proxy, int64_t rbdPool)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	rados_ioctx_t ioctx = CephProxyGetIoCtx2(proxy, rbdPool);
+	CHECK(ioctx != nullptr);
+
+	/* a change older than the bound is always seen, also when a refresh takes longer than the bound */
+	for (uint32_t i = 1; i <= 4; i++) {
+		cluster.SetLatency(FAKE_OP_STAT, i > 2 ? 300000 : 0);
+		CHECK_EQ(cluster.SetPoolStored("rbd", i * GIB), 0);
+		usleep((CAPACITY_MAX_STALE_MS + 20) * 1000);
+		CephPoolStat stat;
+		CHECK_EQ(CephProxyGetPoolStat(proxy, ioctx, &stat), 0);
+		CHECK_EQ(stat.numBytes, i * GIB);
+	}
+	cluster.SetLatency(FAKE_OP_STAT, 0);
+
+	/* concurrent readers are served from memory, the RPCs follow the refresh interval */
+	const uint32_t threadNum = 16;
+	uint64_t rpcs = cluster.GetOpCount(FAKE_OP_STAT);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	std::atomic<uint32_t> failed { 0 };
+	for (uint32_t i = 0; i < threadNum; i++) {
+		threads.emplace_back([&]() {
+			for (uint32_t n = 0; n < 20000; n++) {
+				CephClusterStat cs;
+				CephPoolStat ps;
+				uint64_t id = rbdPool;
+				if (CephProxyGetClusterStat(proxy, &cs) != 0 || CephProxyGetPoolStat(proxy, ioctx, &ps) != 0 ||
+					CephProxyGetPoolsStat(proxy, &ps, &id, 1) != 0 || ps.numBytes != 4 * GIB) {
+					failed++;
+				}
+			}
+		});
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	CHECK_EQ(failed.load(), 0);
+	/* two RPCs per refresh */
+	CHECK(cluster.GetOpCount(FAKE_OP_STAT) - rpcs <= (uint64_t)(2 * (ms / CAPACITY_REFRESH_MS + 4)));
+
+	/* refresh requests made together share refreshes: the one running, then one for all of them */
+	CHECK_EQ(cluster.SetPoolStored("rbd", 7 * GIB), 0);
+	cluster.SetLatency(FAKE_OP_STAT, 20000);
+	CapacityWaiter waiters[threadNum];
+	rpcs = cluster.GetOpCount(FAKE_OP_STAT);
+	for (uint32_t i = 0; i < threadNum; i++) {
+		CHECK_EQ(CephProxyRefreshCapacity(proxy, CapacityDone, &waiters[i]), 0);
+	}
+	uint64_t version = 0;
+	for (uint32_t i = 0; i < threadNum; i++) {
+		CHECK_EQ(WaitCapacity(waiters[i]), 0);
+		CHECK(waiters[i].version >= version);
+		version = waiters[i].version;
+	}
+	CHECK(cluster.GetOpCount(FAKE_OP_STAT) - rpcs <= 6);
+	cluster.SetLatency(FAKE_OP_STAT, 0);
+	/* the callback runs once a snapshot taken after the request is in place */
+	CHECK_EQ(PoolBytes(proxy, rbdPool), 7 * GIB);
+
+	/* a new pool makes the reader wait for a refresh instead of failing */
+	int64_t newPool = cluster.CreatePool("capacity_new");
+	CHECK(newPool > 0);
+	CHECK_EQ(cluster.SetPoolStored("capacity_new", GIB), 0);
+	CHECK_EQ(PoolBytes(proxy, newPool), GIB);
+	CHECK_EQ(cluster.DeletePool("capacity_new"), 0);
+	usleep((CAPACITY_MAX_STALE_MS + 20) * 1000);
+	CHECK_EQ(PoolBytes(proxy, newPool), (uint64_t)-1);
+
+	/* failed refreshes reach the callback, readers get the error once the snapshot is too old */
+	cluster.InjectError(FAKE_OP_STAT, -ETIMEDOUT, 0, "cluster_stat");
+	CapacityWaiter failure;
+	CHECK_EQ(CephProxyRefreshCapacity(proxy, CapacityDone, &failure), 0);
+	CHECK_EQ(WaitCapacity(failure), -ETIMEDOUT);
+	usleep((CAPACITY_MAX_STALE_MS + 20) * 1000);
+	CephClusterStat cs;
+	CHECK_EQ(CephProxyGetClusterStat(proxy, &cs), -ETIMEDOUT);
+	cluster.ClearFaults();
+	CHECK_EQ(CephProxyGetClusterStat(proxy, &cs), 0);
+	CHECK_EQ(cluster.SetPoolStored("rbd", 0), 0);
+}
+
+/* every implementation against ceph_crc32c, at each alignment and across the 3 x 1KB blocks */
+static void TestCrc32c()
+{
+	CHECK_EQ(ProxyCrc32c(-1, "123456789", 9), 0x1cf96d7c);
+	CHECK_EQ(ProxyCrc32c(0, nullptr, 0), 0);
+
+	std::mt19937 rng(7);
+	std::vector<unsigned char> buf(3 * 3072 + 64);
+	for (auto &c : buf) {
+		c = rng();
+	}
+	ProxyCrc32cFn hw = ProxyCrc32cHw();
+	const size_t lens[] = { 1, 7, 8, 63, 1024, 3071, 3072, 3079, 6151, 9216 };
+	for (size_t off = 0; off < 8; off++) {
+		for (size_t len : lens) {
+			uint32_t seed = rng();
+			uint32_t expect = ceph_crc32c(seed, &buf[off], len);
+			CHECK_EQ(ProxyCrc32c(seed, &buf[off], len), expect);
+			CHECK_EQ(ProxyCrc32cTable(seed, &buf[off], len), expect);
+			if (hw != nullptr) {
+				CHECK_EQ(hw(seed, &buf[off], len), expect);
+			}
+		}
+	}
+	printf("crc32c uses %s\n", ProxyCrc32cName());
+
+	std::vector<unsigned char> zeros(3 * PAGE_SIZE_4K + 5, 0);
+	CHECK_EQ(ProxyCrc32cZeros(-1, zeros.size()), ceph_crc32c(-1, zeros.data(), zeros.size()));
+
+	SGL_S *sgl = AllocSgl(ENTRY_PER_SGL + 1);
+	FillSgl(sgl, 'k');
+	std::string flat = SglToString(sgl);
+	size_t len = flat.size() - 100;
+	CHECK_EQ(ProxyCrc32cSgl(-1, sgl, len, 1),
+		ceph_crc32c(-1, reinterpret_cast<const unsigned char *>(flat.data()), len));
+	FreeSgl(sgl);
+}
+
+struct IntegrityEvent {
+	int64_t poolId;
+	std::string oid;
+	uint64_t offset;
+	uint64_t len;
+	uint32_t expected;
+	uint32_t actual;
+};
+
+static std::mutex g_integrityLock;
+static std::vector<IntegrityEvent> g_integrityEvents;
+
+static void IntegrityNotify(int64_t poolId, const char *oid, uint64_t offset, uint64_t len,
+	uint32_t expected, uint32_t actual)
+{
+	std::lock_guard<std::mutex> l(g_integrityLock);
+	g_integrityEvents.push_back({ poolId, oid, offset, len, expected, actual });
+}
+
+static int ReadSglCrc(ceph_proxy_t proxy, int64_t poolId, const char *oid, uint64_t off, uint32_t pages,
+	SGL_S *sgl, const uint32_t *expected)
+{
+	ceph_proxy_op_t op = nullptr;
+	int prval = 0;
+	CHECK_EQ(CephProxyReadOpInit2(&op, poolId, oid), 0);
+	CephProxyReadOpReadSGL(op, off, pages * PAGE_SIZE_4K, sgl, &prval, 1);
+	if (expected != nullptr) {
+		CephProxyReadOpSetExpectedCrc(op, *expected);
+	}
+	int ret = RunOp(proxy, op);
+	CephProxyReadOpRelease(op);
+	return ret;
+}
+
+/* runs with proxy.data_crc_check on, every SGL read also asks the OSD for the sum of its range */
+static void TestDataIntegrity(ceph_proxy_t proxy, int64_t poolId)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	const uint32_t pages = ENTRY_PER_SGL + 4;
+	const char *oid = "crc_obj";
+	CHECK_EQ(CephProxyRegisterIntegrityNotifyFn(IntegrityNotify), 0);
+
+	SGL_S *wsgl = AllocSgl(pages);
+	FillSgl(wsgl, 'c');
+	ceph_proxy_op_t op = nullptr;
+	uint32_t stored = 0;
+	CHECK_EQ(CephProxyWriteOpInit2(&op, poolId, oid), 0);
+	CHECK_EQ(CephProxyWriteOpGetDataCrc(op, &stored), -ENODATA);
+	CephProxyWriteOpWriteSGL(op, wsgl, pages * PAGE_SIZE_4K, 0, nullptr, 1);
+	CHECK_EQ(CephProxyWriteOpGetDataCrc(op, &stored), 0);
+	CHECK_EQ(RunOp(proxy, op), 0);
+	CephProxyWriteOpRelease(op);
+	CHECK_EQ(stored, CephProxySglCrc32c(-1, wsgl, pages * PAGE_SIZE_4K, 1));
+
+	CephIntegrityStat before;
+	CephIntegrityStat after;
+	CephProxyGetIntegrityStat(&before);
+	SGL_S *rsgl = AllocSgl(pages);
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, 0, pages, rsgl, nullptr), 0);
+	CHECK(SglToString(rsgl) == SglToString(wsgl));
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, 0, pages, rsgl, &stored), 0);
+	CephProxyGetIntegrityStat(&after);
+	CHECK_EQ(after.verified - before.verified, 2);
+	CHECK_EQ(after.verifiedBytes - before.verifiedBytes, 2ULL * pages * PAGE_SIZE_4K);
+	CHECK_EQ(after.mismatches, before.mismatches);
+
+	/* flipped on the way back, the object itself and so the OSD's sum are intact */
+	cluster.InjectCorruption(1, oid);
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, PAGE_SIZE_4K, 8, rsgl, nullptr), -EIO);
+	CephProxyGetIntegrityStat(&after);
+	CHECK_EQ(after.mismatches - before.mismatches, 1);
+	{
+		std::lock_guard<std::mutex> l(g_integrityLock);
+		CHECK_EQ(g_integrityEvents.size(), 1);
+		IntegrityEvent &ev = g_integrityEvents.back();
+		CHECK_EQ(ev.poolId, poolId);
+		CHECK(ev.oid == oid);
+		CHECK_EQ(ev.offset, PAGE_SIZE_4K);
+		CHECK_EQ(ev.len, 8 * PAGE_SIZE_4K);
+		CHECK(ev.expected != ev.actual);
+	}
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, PAGE_SIZE_4K, 8, rsgl, nullptr), 0);
+
+	/* past the end the OSD fails the sum but the read stands, unverified */
+	SGL_S *shortSgl = AllocSgl(4);
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, (pages - 2) * PAGE_SIZE_4K, 4, shortSgl, nullptr), 0);
+	CephProxyGetIntegrityStat(&after);
+	CHECK_EQ(after.unverified - before.unverified, 1);
+
+	/* a stored sum of the full range covers the zero-filled tail too */
+	std::string tail = SglToString(wsgl).substr((pages - 2) * PAGE_SIZE_4K);
+	tail.resize(4 * PAGE_SIZE_4K, '\0');
+	uint32_t tailCrc = CephProxyCrc32c(-1, tail.data(), tail.size());
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, (pages - 2) * PAGE_SIZE_4K, 4, shortSgl, &tailCrc), 0);
+	CephProxyGetIntegrityStat(&after);
+	CHECK_EQ(after.unverified - before.unverified, 1);
+	CHECK_EQ(after.verified - before.verified, 3);
+
+	/* rotted at rest: the OSD sums what it has, only the crc kept since the write catches it */
+	FakeObjectRef obj = cluster.GetObject(poolId, "", oid);
+	CHECK(obj != nullptr);
+	FakeObject rotten = *obj;
+	std::string data;
+	rotten.data.copy(0, rotten.data.length(), data);
+	data[5 * PAGE_SIZE_4K + 17] ^= 0x01;
+	rotten.data.clear();
+	rotten.data.append(data);
+	CHECK_EQ(cluster.PutObject(poolId, "", oid, rotten), 0);
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, 0, pages, rsgl, nullptr), 0);
+	CHECK_EQ(ReadSglCrc(proxy, poolId, oid, 0, pages, rsgl, &stored), -EIO);
+	CephProxyGetIntegrityStat(&after);
+	CHECK_EQ(after.mismatches - before.mismatches, 2);
+	{
+		std::lock_guard<std::mutex> l(g_integrityLock);
+		CHECK_EQ(g_integrityEvents.back().expected, stored);
+	}
+
+	CHECK_EQ(CephProxyRegisterIntegrityNotifyFn(nullptr), 0);
+	FreeSgl(wsgl);
+	FreeSgl(rsgl);
+	FreeSgl(shortSgl);
+}
+
+int main(int argc, char **argv)
+{
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t rbdPool = cluster.CreatePool("rbd");
+	CHECK(rbdPool > 0);
+
+	ceph_proxy_t proxy = nullptr;
+	CHECK_EQ(CephProxyInit("", 1, "/tmp", &proxy), 0);
+	CHECK(proxy != nullptr);
+
+	TestSglWriteRead(proxy, rbdPool);
+	printf("sgl write/read ok\n");
+	TestSglUtil();
+	printf("sgl utils ok\n");
+	TestCrc32c();
+	printf("crc32c ok\n");
+	TestFaults(proxy, rbdPool);
+	printf("fault injection ok\n");
+	TestQueueOps(proxy, rbdPool);
+	printf("batched queueing ok\n");
+	TestCompletionRing(proxy, rbdPool);
+	printf("completion ring ok\n");
+	TestClsExec(proxy, rbdPool);
+	printf("class exec ok\n");
+	TestOmapXattr(proxy, rbdPool);
+	printf("omap/xattr ok\n");
+	TestOmapStream(proxy, rbdPool);
+	printf("omap stream ok\n");
+	TestPoolUsage(proxy, rbdPool);
+	printf("pool usage ok\n");
+	TestPoolDirectory(proxy, rbdPool);
+	printf("pool directory ok\n");
+	TestDiskUsage();
+	printf("disk usage ok\n");
+	TestProxyJson();
+	TestMinAllocBuild();
+	TestMinAllocSize(proxy, rbdPool);
+	printf("min alloc size ok\n");
+
+	CephProxyShutdown(proxy);
+
+	/* write merging is opt-in, the proxy is brought up again with it on */
+	FakeConfSet("proxy", "write_merge", "1");
+	FakeConfSet("proxy", "write_merge_window_us", "1000");
+	CHECK_EQ(CephProxyInit("", 1, "/tmp", &proxy), 0);
+	TestWriteMerge(proxy, rbdPool);
+	printf("write merge ok\n");
+	CephProxyShutdown(proxy);
+	FakeConfSet("proxy", "write_merge_window_us", std::to_string(MERGE_LONG_WINDOW_US));
+	CHECK_EQ(CephProxyInit("", 1, "/tmp", &proxy), 0);
+	TestMergeWindowEnd(proxy, rbdPool, MERGE_LONG_WINDOW_US);
+	printf("merge window end ok\n");
+	CephProxyShutdown(proxy);
+	FakeConfReset();
+
+	/* and with a short capacity refresh interval so the staleness bounds are checked quickly */
+	FakeConfSet("proxy", "capacity_refresh_ms", std::to_string(CAPACITY_REFRESH_MS));
+	FakeConfSet("proxy", "capacity_max_stale_ms", std::to_string(CAPACITY_MAX_STALE_MS));
+	CHECK_EQ(CephProxyInit("", 1, "/tmp", &proxy), 0);
+	TestCapacity(proxy, rbdPool);
+	printf("capacity ok\n");
+	CephProxyShutdown(proxy);
+	FakeConfReset();
+
+	FakeConfSet("proxy", "data_crc_check", "1");
+	CHECK_EQ(CephProxyInit("", 1, "/tmp", &proxy), 0);
+	TestDataIntegrity(proxy, rbdPool);
+	printf("data integrity ok\n");
+	CephProxyShutdown(proxy);
+	FakeConfReset();
+	return 0;
+}
@@ -0,0 +1,110 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+
+#include "FakeCluster.h"
+#include "ProxyBench.h"
+
+/*
+ * Sequential 4KB write streams through the proxy, one object each, with
+ * proxy.write_merge off and then on. The proxy is brought up again for each
+ * mode since the worker reads the setting when it starts.
+ */
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_merge_bench [options]\n"
+		"  --ops n             writes timed per mode (200000)\n"
+		"  --depth n           writes in flight (32)\n"
+		"  --streams n         sequential streams (4)\n"
+		"  --window-us n       proxy.write_merge_window_us (100)\n"
+		"  --latency-us n      fake osd latency of each write (0)\n"
+		"  --cpu n             core every thread is pinned to, -1 leaves them free (0)\n");
+}
+
+int main(int argc, char **argv)
+{
+	BenchConf conf;
+	conf.readPct = 0;
+	conf.streams = 4;
+	uint32_t windowUs = 100;
+	uint32_t latencyUs = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long n = strtol(argv[++i], nullptr, 10);
+		if (arg == "--ops" && n > 0) {
+			conf.ops = n;
+		} else if (arg == "--depth" && n > 0) {
+			conf.depth = n;
+		} else if (arg == "--streams" && n > 0) {
+			conf.streams = n;
+		} else if (arg == "--window-us" && n >= 0) {
+			windowUs = n;
+		} else if (arg == "--latency-us" && n >= 0) {
+			latencyUs = n;
+		} else if (arg == "--cpu") {
+			conf.cpu = n;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+	conf.objects = conf.streams;
+
+	if (BenchPinCpu(conf.cpu) != 0) {
+		return 1;
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t poolId = cluster.CreatePool("rbd");
+	if (poolId <= 0) {
+		fprintf(stderr, "create pool failed\n");
+		return 1;
+	}
+	cluster.SetLatency(FAKE_OP_WRITE, latencyUs);
+	FakeConfSet("proxy", "write_merge_window_us", std::to_string(windowUs));
+
+	int ret = 0;
+	printf("%-6s %10s %12s %10s %14s\n", "merge", "ops", "iops", "MB/s", "osd_writes/op");
+	for (int merge = 0; merge <= 1 && ret == 0; merge++) {
+		FakeConfSet("proxy", "write_merge", std::to_string(merge));
+		ceph_proxy_t proxy = nullptr;
+		if (CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+			fprintf(stderr, "proxy init failed\n");
+			return 1;
+		}
+		{
+			Bench bench(proxy, poolId, conf);
+			ret = bench.Run(conf.depth * 16);
+			uint64_t writes = cluster.GetOpCount(FAKE_OP_WRITE);
+			auto start = std::chrono::steady_clock::now();
+			ret = ret != 0 ? ret : bench.Run(conf.ops);
+			double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			writes = cluster.GetOpCount(FAKE_OP_WRITE) - writes;
+			printf("%-6s %10u %12.0f %10.1f %14.3f\n", merge ? "on" : "off", conf.ops, conf.ops / sec,
+				conf.ops / sec * PAGE_SIZE_4K / (1024 * 1024), static_cast<double>(writes) / conf.ops);
+		}
+		CephProxyShutdown(proxy);
+	}
+	if (ret != 0) {
+		fprintf(stderr, "bench failed: %d\n", ret);
+	}
+	FakeConfReset();
+	return ret == 0 ? 0 : 1;
+}
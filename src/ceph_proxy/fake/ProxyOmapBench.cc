@@ -0,0 +1,269 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FakeCluster.h"
+#include "ProxyBench.h"
+#include "RadosWrapper.h"
+
+/*
+ * The omap of one object with a million keys, walked by an omap stream
+ * against read as a whole into one iterator as RadosReadOpOmapGetVals
+ * does. Resident memory is sampled every page, after the object is in the
+ * fake, so it counts what the walk itself holds.
+ */
+
+struct SyncOp {
+	std::mutex lock;
+	std::condition_variable cond;
+	bool done = false;
+	int ret = 0;
+};
+
+static void SyncDone(int ret, void *arg)
+{
+	SyncOp *s = static_cast<SyncOp *>(arg);
+	std::lock_guard<std::mutex> l(s->lock);
+	s->ret = ret;
+	s->done = true;
+	s->cond.notify_all();
+}
+
+static int RunSync(ceph_proxy_t proxy, ceph_proxy_op_t op)
+{
+	SyncOp s;
+	completion_t c = CephProxyCreateCompletion(SyncDone, &s);
+	if (c == nullptr) {
+		return -ENOMEM;
+	}
+	int ret = CephProxyQueueOp(proxy, op, c);
+	if (ret == 0) {
+		std::unique_lock<std::mutex> l(s.lock);
+		s.cond.wait(l, [&s]() { return s.done; });
+		ret = s.ret;
+	}
+	CephProxyCompletionDestroy(c);
+	return ret;
+}
+
+static uint64_t RssBytes()
+{
+	long pages = 0;
+	long rss = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (f == nullptr) {
+		return 0;
+	}
+	if (fscanf(f, "%ld %ld", &pages, &rss) != 2) {
+		rss = 0;
+	}
+	fclose(f);
+	return rss * sysconf(_SC_PAGESIZE);
+}
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_omap_bench [options]\n"
+		"  --keys n            omap keys of the object (1000000)\n"
+		"  --page n            keys per omap read of the stream (1024)\n"
+		"  --val-size n        bytes per value (32)\n"
+		"  --latency-us n      fake osd latency of each read (0)\n"
+		"  --cpu n             core every thread is pinned to, -1 leaves them free (-1)\n");
+}
+
+static int Fill(ceph_proxy_t proxy, int64_t poolId, uint32_t keys, uint32_t valSize)
+{
+	const uint32_t batch = 10000;
+	std::string val(valSize, 'v');
+	std::vector<std::string> names;
+	for (uint32_t i = 0; i < keys; i += batch) {
+		uint32_t num = std::min(batch, keys - i);
+		names.clear();
+		for (uint32_t j = 0; j < num; j++) {
+			char key[32];
+			snprintf(key, sizeof(key), "key_%09u", i + j);
+			names.push_back(key);
+		}
+		std::vector<const char *> keyPtrs;
+		std::vector<const char *> valPtrs(num, val.c_str());
+		std::vector<size_t> lens(num, val.size());
+		for (auto &n : names) {
+			keyPtrs.push_back(n.c_str());
+		}
+		ceph_proxy_op_t op = nullptr;
+		int ret = CephProxyWriteOpInit2(&op, poolId, "omap_bench");
+		if (ret != 0) {
+			return ret;
+		}
+		CephProxyWriteOpOmapSet(op, keyPtrs.data(), valPtrs.data(), lens.data(), num);
+		ret = RunSync(proxy, op);
+		CephProxyWriteOpRelease(op);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+struct WalkResult {
+	uint64_t keys = 0;
+	double firstMs = 0;
+	double totalMs = 0;
+	uint64_t peakRss = 0;
+	uint64_t peakBytes = 0;
+};
+
+static uint64_t RssSince(uint64_t base)
+{
+	uint64_t rss = RssBytes();
+	return rss > base ? rss - base : 0;
+}
+
+static int WalkStream(ceph_proxy_t proxy, int64_t poolId, uint32_t page, WalkResult &r)
+{
+	uint64_t base = RssBytes();
+	auto start = std::chrono::steady_clock::now();
+	proxy_omap_stream_t stream = nullptr;
+	int ret = CephProxyOmapStreamOpen(proxy, poolId, "omap_bench", nullptr, page, 0, &stream);
+	if (ret != 0) {
+		return ret;
+	}
+	const char *key = nullptr;
+	const char *val = nullptr;
+	size_t keyLen = 0;
+	size_t valLen = 0;
+	while ((ret = CephProxyOmapStreamNext(stream, &key, &keyLen, &val, &valLen)) == 1) {
+		if (r.keys++ == 0) {
+			r.firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		if (r.keys % page == 0) {
+			r.peakRss = std::max(r.peakRss, RssSince(base));
+		}
+	}
+	r.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	ProxyOmapStreamStat stat = { 0, 0, 0 };
+	CephProxyOmapStreamStat(stream, &stat);
+	r.peakBytes = stat.peakBytes;
+	CephProxyOmapStreamClose(stream);
+	return ret;
+}
+
+static int WalkWhole(ceph_proxy_t proxy, int64_t poolId, uint32_t keys, WalkResult &r)
+{
+	uint64_t base = RssBytes();
+	auto start = std::chrono::steady_clock::now();
+	ceph_proxy_op_t op = nullptr;
+	int ret = CephProxyReadOpInit2(&op, poolId, "omap_bench");
+	if (ret != 0) {
+		return ret;
+	}
+	rados_omap_iter_t iter = nullptr;
+	unsigned char more = 0;
+	int prval = 0;
+	RadosReadOpOmapGetVals(op, "", keys, &iter, &more, &prval);
+	ret = RunSync(proxy, op);
+	CephProxyReadOpRelease(op);
+	if (ret != 0) {
+		RadosOmapIterEnd(iter);
+		return ret;
+	}
+	char *key = nullptr;
+	char *val = nullptr;
+	size_t keyLen = 0;
+	size_t valLen = 0;
+	/* every entry is held from here until RadosOmapIterEnd */
+	r.peakRss = RssSince(base);
+	while (RadosOmapGetNext(iter, &key, &val, &keyLen, &valLen) == 0 && key != nullptr) {
+		if (r.keys++ == 0) {
+			r.firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+	r.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	RadosOmapIterEnd(iter);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t keys = 1000000;
+	uint32_t page = 1024;
+	uint32_t valSize = 32;
+	uint32_t latencyUs = 0;
+	int cpu = -1;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long n = strtol(argv[++i], nullptr, 10);
+		if (arg == "--keys" && n > 0) {
+			keys = n;
+		} else if (arg == "--page" && n > 0) {
+			page = n;
+		} else if (arg == "--val-size" && n >= 0) {
+			valSize = n;
+		} else if (arg == "--latency-us" && n >= 0) {
+			latencyUs = n;
+		} else if (arg == "--cpu") {
+			cpu = n;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+
+	if (BenchPinCpu(cpu) != 0) {
+		return 1;
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t poolId = cluster.CreatePool("rbd");
+	ceph_proxy_t proxy = nullptr;
+	if (poolId <= 0 || CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+		fprintf(stderr, "proxy init failed\n");
+		return 1;
+	}
+
+	int ret = Fill(proxy, poolId, keys, valSize);
+	cluster.SetLatency(FAKE_OP_READ, latencyUs);
+	/* streamed first: the allocator keeps what the whole read frees, that would hide the stream's peak */
+	WalkResult stream;
+	WalkResult whole;
+	if (ret == 0) {
+		ret = WalkStream(proxy, poolId, page, stream);
+	}
+	if (ret == 0) {
+		ret = WalkWhole(proxy, poolId, keys, whole);
+	}
+	if (ret == 0) {
+		printf("%-7s %10s %14s %10s %12s %14s\n", "mode", "keys", "first_key_ms", "total_ms", "peak_rss_mb",
+			"peak_page_kb");
+		printf("%-7s %10lu %14.3f %10.1f %12.1f %14.1f\n", "stream", stream.keys, stream.firstMs, stream.totalMs,
+			stream.peakRss / 1048576.0, stream.peakBytes / 1024.0);
+		printf("%-7s %10lu %14.3f %10.1f %12.1f %14s\n", "whole", whole.keys, whole.firstMs, whole.totalMs,
+			whole.peakRss / 1048576.0, "-");
+	} else {
+		fprintf(stderr, "bench failed: %d\n", ret);
+	}
+
+	CephProxyShutdown(proxy);
+	return ret == 0 ? 0 : 1;
+}
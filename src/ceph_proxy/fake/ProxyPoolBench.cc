@@ -0,0 +1,156 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "CephProxyOp.h"
+#include "ProxyObjectPool.h"
+#include "FakeCluster.h"
+#include "ProxyBench.h"
+
+/*
+ * The ProxyBench.h load with the op pools off and then on. Every thread is
+ * pinned to one core, so the IOPS are the proxy's own cost per op;
+ * allocations are counted at malloc, which also sees operator new and the
+ * bufferlist memory.
+ */
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t align, size_t size);
+
+static std::atomic<uint64_t> gAllocs { 0 };
+
+void *malloc(size_t size)
+{
+	gAllocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	gAllocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	gAllocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size)
+{
+	gAllocs.fetch_add(1, std::memory_order_relaxed);
+	*ptr = __libc_memalign(align, size);
+	return *ptr == nullptr ? ENOMEM : 0;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+	gAllocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_memalign(align, size);
+}
+}
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_pool_bench [options]\n"
+		"  --ops n             ops timed per mode (200000)\n"
+		"  --depth n           ops in flight (32)\n"
+		"  --objects n         objects the offsets spread over (1024)\n"
+		"  --read-pct n        share of reads (50)\n"
+		"  --cpu n             core every thread is pinned to, -1 leaves them free (0)\n");
+}
+
+static void SetPools(bool enable)
+{
+	ProxyObjectPool<RadosObjectReadOp>::SetEnable(enable);
+	ProxyObjectPool<RadosObjectWriteOp>::SetEnable(enable);
+	ProxyObjectPool<Completion>::SetEnable(enable);
+}
+
+int main(int argc, char **argv)
+{
+	BenchConf conf;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long val = strtol(argv[++i], nullptr, 10);
+		if (arg == "--ops" && val > 0) {
+			conf.ops = val;
+		} else if (arg == "--depth" && val > 0) {
+			conf.depth = val;
+		} else if (arg == "--objects" && val > 0) {
+			conf.objects = val;
+		} else if (arg == "--read-pct" && val >= 0 && val <= 100) {
+			conf.readPct = val;
+		} else if (arg == "--cpu") {
+			conf.cpu = val;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+
+	if (BenchPinCpu(conf.cpu) != 0) {
+		return 1;
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t poolId = cluster.CreatePool("rbd");
+	ceph_proxy_t proxy = nullptr;
+	if (poolId <= 0 || CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+		fprintf(stderr, "proxy init failed\n");
+		return 1;
+	}
+
+	int ret = 0;
+	{
+		Bench bench(proxy, poolId, conf);
+		bench.filling = true;
+		ret = bench.Run(conf.objects);
+		bench.filling = false;
+
+		printf("%-8s %10s %12s %12s\n", "pool", "ops", "iops", "allocs/op");
+		for (bool enable : { false, true }) {
+			if (ret != 0) {
+				break;
+			}
+			SetPools(enable);
+			/* warms the pools and the worker queue up to the working set */
+			ret = bench.Run(conf.depth * 16);
+			uint64_t allocs = gAllocs.load();
+			auto start = std::chrono::steady_clock::now();
+			ret = ret != 0 ? ret : bench.Run(conf.ops);
+			double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			allocs = gAllocs.load() - allocs;
+			printf("%-8s %10u %12.0f %12.2f\n", enable ? "on" : "off", conf.ops, conf.ops / sec,
+				static_cast<double>(allocs) / conf.ops);
+		}
+	}
+	if (ret != 0) {
+		fprintf(stderr, "bench failed: %d\n", ret);
+	}
+
+	CephProxyShutdown(proxy);
+	return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CephProxy.h"
+#include "RadosWrapper.h"
+#include "FakeCluster.h"
+
+/*
+ * Pool name -> id and id -> name lookups over a set of pools, through the
+ * proxy's pool directory and through a temporary IoCtx per call as the proxy
+ * did before. The fake ioctx_create only takes the cluster lock, a real one
+ * also allocates the IoCtxImpl and reads the client's osdmap.
+ */
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_pool_dir_bench [options]\n"
+		"  --lookups n         lookups timed per thread, mode and direction (200000)\n"
+		"  --pools n           pools the lookups spread over (64)\n"
+		"  --threads n         threads looking up at once (1)\n");
+}
+
+static int64_t IoCtxPoolId(rados_client_t client, const std::string &name)
+{
+	rados_ioctx_t ioctx = nullptr;
+	int ret = RadosCreateIoCtx(client, name, &ioctx);
+	if (ret != 0) {
+		return ret;
+	}
+	int64_t poolId = RadosGetPoolId(ioctx);
+	RadosReleaseIoCtx(ioctx);
+	return poolId;
+}
+
+static int IoCtxPoolName(rados_client_t client, int64_t poolId, char *buf, unsigned maxLen)
+{
+	rados_ioctx_t ioctx = nullptr;
+	int ret = RadosCreateIoCtx2(client, poolId, &ioctx);
+	if (ret != 0) {
+		return ret;
+	}
+	ret = RadosGetPoolName(ioctx, buf, maxLen);
+	RadosReleaseIoCtx(ioctx);
+	return ret;
+}
+
+struct PoolSet {
+	std::vector<std::string> names;
+	std::vector<int64_t> ids;
+};
+
+/* ns per lookup, every thread walks the pools from its own start */
+static double Time(uint32_t threadNum, uint32_t lookups, const PoolSet &pools,
+	std::function<bool(uint32_t)> lookup)
+{
+	std::atomic<uint32_t> failed { 0 };
+	std::vector<std::thread> threads;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t t = 0; t < threadNum; t++) {
+		threads.emplace_back([&, t]() {
+			uint32_t n = pools.ids.size();
+			for (uint32_t i = 0; i < lookups; i++) {
+				if (!lookup((i + t * 7) % n)) {
+					failed++;
+				}
+			}
+		});
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	return failed == 0 ? ns / lookups : -1;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t lookups = 200000;
+	uint32_t poolNum = 64;
+	uint32_t threadNum = 1;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long n = strtol(argv[++i], nullptr, 10);
+		if (arg == "--lookups" && n > 0) {
+			lookups = n;
+		} else if (arg == "--pools" && n > 0) {
+			poolNum = n;
+		} else if (arg == "--threads" && n > 0) {
+			threadNum = n;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	PoolSet pools;
+	for (uint32_t i = 0; i < poolNum; i++) {
+		pools.names.push_back("pool_" + std::to_string(i));
+		pools.ids.push_back(cluster.CreatePool(pools.names.back()));
+		if (pools.ids.back() <= 0) {
+			fprintf(stderr, "create pool failed\n");
+			return 1;
+		}
+	}
+	ceph_proxy_t proxy = nullptr;
+	if (CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+		fprintf(stderr, "proxy init failed\n");
+		return 1;
+	}
+	rados_client_t client = reinterpret_cast<CephProxy *>(proxy)->radosClient;
+
+	/* [direction][ioctx, directory] */
+	double ns[2][2];
+	ns[0][0] = Time(threadNum, lookups, pools, [&](uint32_t i) {
+		return IoCtxPoolId(client, pools.names[i]) == pools.ids[i];
+	});
+	ns[0][1] = Time(threadNum, lookups, pools, [&](uint32_t i) {
+		return CephProxyGetPoolIdByPoolName(proxy, pools.names[i].c_str()) == pools.ids[i];
+	});
+	ns[1][0] = Time(threadNum, lookups, pools, [&](uint32_t i) {
+		char name[64];
+		return IoCtxPoolName(client, pools.ids[i], name, sizeof(name)) == 0 && pools.names[i] == name;
+	});
+	ns[1][1] = Time(threadNum, lookups, pools, [&](uint32_t i) {
+		char name[64];
+		return CephProxyGetPoolNameByPoolId(proxy, pools.ids[i], name, sizeof(name)) == 0 &&
+			pools.names[i] == name;
+	});
+
+	printf("%-12s %12s %12s %8s\n", "lookup", "ioctx_ns", "dir_ns", "gain");
+	const char *names[2] = { "name->id", "id->name" };
+	int ret = 0;
+	for (int dir = 0; dir <= 1; dir++) {
+		if (ns[dir][0] < 0 || ns[dir][1] < 0) {
+			fprintf(stderr, "%s lookups returned wrong results\n", names[dir]);
+			ret = 1;
+			continue;
+		}
+		printf("%-12s %12.1f %12.1f %7.1fx\n", names[dir], ns[dir][0], ns[dir][1], ns[dir][0] / ns[dir][1]);
+	}
+
+	CephProxyShutdown(proxy);
+	return ret;
+}
@@ -0,0 +1,136 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "FakeCluster.h"
+#include "ProxyBench.h"
+
+/*
+ * The ProxyBench.h load at each queue depth, queued one op per
+ * CephProxyQueueOp call and then every free slot per CephProxyQueueOps call.
+ */
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_queue_bench [options]\n"
+		"  --depths list       queue depths (1,2,4,8,16,32,64,128,256)\n"
+		"  --ops n             ops timed per depth and mode (100000)\n"
+		"  --objects n         objects the offsets spread over (1024)\n"
+		"  --read-pct n        share of reads (50)\n"
+		"  --latency-us n      fake osd latency of each read and write (0)\n"
+		"  --cpu n             core every thread is pinned to, -1 leaves them free (-1)\n");
+}
+
+static bool ParseDepths(const char *val, std::vector<uint32_t> &depths)
+{
+	depths.clear();
+	char *end = nullptr;
+	for (const char *p = val; *p != '\0'; p = end + (*end == ',' ? 1 : 0)) {
+		long d = strtol(p, &end, 10);
+		if (end == p || d <= 0 || (*end != ',' && *end != '\0')) {
+			return false;
+		}
+		depths.push_back(d);
+	}
+	return !depths.empty();
+}
+
+static double Iops(Bench &bench, uint32_t ops, bool batched, int &ret)
+{
+	/* warms the op pools and the worker queue up to the depth */
+	ret = bench.Run(bench.conf.depth * 16, batched);
+	auto start = std::chrono::steady_clock::now();
+	ret = ret != 0 ? ret : bench.Run(ops, batched);
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return ops / sec;
+}
+
+int main(int argc, char **argv)
+{
+	BenchConf conf;
+	conf.ops = 100000;
+	conf.cpu = -1;
+	uint32_t latencyUs = 0;
+	std::vector<uint32_t> depths = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		const char *val = argv[++i];
+		long n = strtol(val, nullptr, 10);
+		bool ok = true;
+		if (arg == "--depths") {
+			ok = ParseDepths(val, depths);
+		} else if (arg == "--ops" && n > 0) {
+			conf.ops = n;
+		} else if (arg == "--objects" && n > 0) {
+			conf.objects = n;
+		} else if (arg == "--read-pct" && n >= 0 && n <= 100) {
+			conf.readPct = n;
+		} else if (arg == "--latency-us" && n >= 0) {
+			latencyUs = n;
+		} else if (arg == "--cpu") {
+			conf.cpu = n;
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			Usage(stderr);
+			return 2;
+		}
+	}
+
+	if (BenchPinCpu(conf.cpu) != 0) {
+		return 1;
+	}
+
+	FakeCluster &cluster = FakeCluster::Instance();
+	int64_t poolId = cluster.CreatePool("rbd");
+	ceph_proxy_t proxy = nullptr;
+	if (poolId <= 0 || CephProxyInit("", 1, "/tmp", &proxy) != 0) {
+		fprintf(stderr, "proxy init failed\n");
+		return 1;
+	}
+
+	int ret = 0;
+	{
+		Bench fill(proxy, poolId, conf);
+		fill.filling = true;
+		ret = fill.Run(conf.objects);
+	}
+	cluster.SetLatency(FAKE_OP_READ, latencyUs);
+	cluster.SetLatency(FAKE_OP_WRITE, latencyUs);
+
+	printf("%6s %12s %12s %8s\n", "depth", "single_iops", "batch_iops", "gain");
+	for (uint32_t depth : depths) {
+		if (ret != 0) {
+			break;
+		}
+		conf.depth = depth;
+		Bench bench(proxy, poolId, conf);
+		double single = Iops(bench, conf.ops, false, ret);
+		double batched = ret != 0 ? 0 : Iops(bench, conf.ops, true, ret);
+		printf("%6u %12.0f %12.0f %7.2fx\n", depth, single, batched, batched / single);
+	}
+	if (ret != 0) {
+		fprintf(stderr, "bench failed: %d\n", ret);
+	}
+
+	CephProxyShutdown(proxy);
+	return ret == 0 ? 0 : 1;
+}
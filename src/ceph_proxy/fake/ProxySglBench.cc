@@ -0,0 +1,156 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ProxySgl.h"
+
+/*
+ * SGL transfers from 4KB to 4MB: a read result bufferlist into a 4K page
+ * SGL and an SGL into a write bufferlist, each the way RadosWrapper did it
+ * entry by entry before ProxySgl and through ProxySgl, then a flat copy
+ * with plain and streaming stores.
+ */
+
+#define PAGE_SIZE_4K 4096
+
+using ceph::bufferlist;
+
+static void Usage(FILE *out)
+{
+	fprintf(out, "usage: proxy_sgl_bench [options]\n"
+		"  --bytes-mb n        bytes moved per size and path (2048)\n");
+}
+
+struct Pages {
+	std::vector<SGL_S> sgls;
+	std::vector<char> data;
+
+	explicit Pages(size_t len) : sgls((len / PAGE_SIZE_4K + ENTRY_PER_SGL - 1) / ENTRY_PER_SGL), data(len)
+	{
+		uint32_t pages = len / PAGE_SIZE_4K;
+		for (uint32_t i = 0; i < pages; i++) {
+			SGL_S &sgl = sgls[i / ENTRY_PER_SGL];
+			sgl.entrys[i % ENTRY_PER_SGL].buf = &data[(size_t)i * PAGE_SIZE_4K];
+			sgl.entrys[i % ENTRY_PER_SGL].len = PAGE_SIZE_4K;
+			sgl.entrySumInSgl = i % ENTRY_PER_SGL + 1;
+			sgl.nextSgl = (i / ENTRY_PER_SGL + 1 < sgls.size()) ? &sgls[i / ENTRY_PER_SGL + 1] : nullptr;
+		}
+	}
+};
+
+/* the read callback's copy before ProxySgl */
+static void EntryCopyFromBufferlist(SGL_S *sgl, bufferlist &results)
+{
+	uint32_t leftLen = results.length();
+	uint64_t offset = 0;
+	int curEntryIndex = 0;
+	while (leftLen > 0) {
+		size_t size = std::min((uint32_t)PAGE_SIZE_4K, leftLen);
+		bufferlist bl;
+		bl.substr_of(results, offset, size);
+		memcpy(sgl->entrys[curEntryIndex].buf, bl.c_str(), size);
+		leftLen -= size;
+		if (++curEntryIndex >= ENTRY_PER_SGL) {
+			curEntryIndex = 0;
+			sgl = sgl->nextSgl;
+		}
+		offset += size;
+	}
+}
+
+/* the write SGL setters before ProxySgl */
+static void EntryAppendToBufferlist(bufferlist &bl, const SGL_S *sgl, size_t len)
+{
+	uint32_t leftLen = len;
+	uint32_t curSrcEntryIndex = 0;
+	while (leftLen > 0) {
+		size_t size = std::min((uint32_t)PAGE_SIZE_4K, leftLen);
+		bl.append(sgl->entrys[curSrcEntryIndex].buf, size);
+		leftLen -= size;
+		if (++curSrcEntryIndex >= sgl->entrySumInSgl) {
+			curSrcEntryIndex = 0;
+			sgl = sgl->nextSgl;
+		}
+	}
+}
+
+template <typename Fn>
+static double GBps(uint64_t total, size_t len, Fn &&fn)
+{
+	uint64_t rounds = std::max<uint64_t>(total / len, 1);
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < rounds; i++) {
+		fn();
+	}
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return rounds * len / sec / (1 << 30);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t bytesMb = 2048;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			Usage(stdout);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			Usage(stderr);
+			return 2;
+		}
+		long n = strtol(argv[++i], nullptr, 10);
+		if (arg == "--bytes-mb" && n > 0) {
+			bytesMb = n;
+		} else {
+			Usage(stderr);
+			return 2;
+		}
+	}
+	uint64_t total = bytesMb << 20;
+
+	printf("%-8s %12s %12s %12s %12s %12s %12s\n", "size", "rd entry", "rd sgl", "wr entry", "wr sgl",
+		"memcpy", "stream");
+	for (size_t len = PAGE_SIZE_4K; len <= (4 << 20); len *= 4) {
+		Pages pages(len);
+		std::string src(len, '\0');
+		std::mt19937 rng(len);
+		for (auto &c : src) {
+			c = rng();
+		}
+		bufferlist results;
+		results.append(src.data(), src.size());
+		std::vector<char> dst(len);
+
+		double rdEntry = GBps(total, len, [&]() { EntryCopyFromBufferlist(&pages.sgls[0], results); });
+		double rdSgl = GBps(total, len, [&]() { SglCopyFromBufferlist(&pages.sgls[0], 0, results, 1); });
+		if (memcmp(pages.data.data(), src.data(), len) != 0) {
+			fprintf(stderr, "sgl copy mismatch at %zu\n", len);
+			return 1;
+		}
+		double wrEntry = GBps(total, len, [&]() {
+			bufferlist bl;
+			EntryAppendToBufferlist(bl, &pages.sgls[0], len);
+		});
+		double wrSgl = GBps(total, len, [&]() {
+			bufferlist bl;
+			SglAppendToBufferlist(bl, &pages.sgls[0], len, nullptr, 1);
+		});
+		double plain = GBps(total, len, [&]() { SglMemcpy(dst.data(), src.data(), len, false); });
+		double stream = GBps(total, len, [&]() { SglMemcpy(dst.data(), src.data(), len, true); });
+		printf("%-8zu %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n", len, rdEntry, rdSgl, wrEntry, wrSgl,
+			plain, stream);
+	}
+	return 0;
+}
@@ -63,6 +63,62 @@ typedef struct {
     uint64_t reserve : 8;
 } __attribute__((packed, aligned(4))) RbdObjid;
 
+struct SaStr {
+    uint32_t len;
+    char *buf;
+};
+
+/*
+ * Typed arguments of an op, filled by the server adaptor next to the legacy
+ * keys/values. Strings point into the request message and live as long as
+ * the SaOpReq. A new field or type bumps SA_OP_ARGS_VERSION; consumers check
+ * version before reading and fall back to keys/values for types they lack.
+ */
+constexpr uint16_t SA_OP_ARGS_VERSION = 1;
+
+enum SaOpArgsType : uint16_t {
+    SA_OP_ARGS_NONE = 0,
+    SA_OP_ARGS_OMAP_LIST,  // CEPH_OSD_OP_OMAPGETVALS, CEPH_OSD_OP_OMAPGETKEYS
+    SA_OP_ARGS_CMPXATTR,   // CEPH_OSD_OP_CMPXATTR
+    SA_OP_ARGS_ROLLBACK,   // CEPH_OSD_OP_ROLLBACK
+    SA_OP_ARGS_CALL,       // CEPH_OSD_OP_CALL
+};
+
+struct SaOmapListArgs {
+    SaStr startAfter;
+    SaStr filterPrefix;  // empty for OMAPGETKEYS
+    uint64_t maxReturn;
+};
+
+struct SaCmpXattrArgs {
+    SaStr name;
+    SaStr value;         // CEPH_OSD_CMPXATTR_MODE_STRING
+    uint64_t u64Value;   // CEPH_OSD_CMPXATTR_MODE_U64
+    uint8_t cmpOp;
+    uint8_t cmpMode;
+};
+
+struct SaRollbackArgs {
+    uint64_t snapId;
+};
+
+struct SaCallArgs {
+    SaStr className;
+    SaStr methodName;
+    SaStr input;
+};
+
+struct SaOpArgs {
+    uint16_t version { SA_OP_ARGS_VERSION };
+    uint16_t type { SA_OP_ARGS_NONE };
+    union {
+        SaOmapListArgs omapList;
+        SaCmpXattrArgs cmpXattr;
+        SaRollbackArgs rollback;
+        SaCallArgs call;
+    } u {};
+};
+
 struct OpRequestOps {
     uint64_t opSubType {0};
 
@@ -91,6 +147,8 @@ struct OpRequestOps {
 
     std::vector<uint64_t> u64vals {};
     std::vector<int> cmpModes {};
+
+    SaOpArgs args {};
 };
 
 
@@ -119,8 +177,6 @@ struct SaOpReq {
 
     int exitsCopyUp { 0 };
 
-    std::atomic<int> *copyupFlag { nullptr };
-
     uint64_t ptVersion { 0 };
     SaOpReq &operator = (const struct SaOpReq &other)
     {
@@ -140,7 +196,6 @@ struct SaOpReq {
         snapSeq = other.snapSeq;
         snaps = other.snaps;
         exitsCopyUp = other.exitsCopyUp;
-        copyupFlag = other.copyupFlag;
         ptVersion = other.ptVersion;
         return *this;
     }
@@ -160,7 +215,6 @@ struct SaOpReq {
         snapSeq = other.snapSeq;
         snaps = other.snaps;
         exitsCopyUp = other.exitsCopyUp;
-        copyupFlag = other.copyupFlag;
         ptVersion = other.ptVersion;
     }
     SaOpReq() {}
@@ -173,11 +227,8 @@ struct SaOpContext {
 };
 
 using PREFETCH_FUNC = int (*)(struct SaOpReq &opReq, OpRequestOps &osdop);
-
-struct SaStr {
-    uint32_t len;
-    char *buf;
-};
+// hands cache memory lent to a reply back once the reply no longer references it
+using RELEASE_FUNC = void (*)(void *arg);
 
 struct SaBatchKv {
     SaStr *keys;
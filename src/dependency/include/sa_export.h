@@ -53,5 +53,11 @@ public :
     uint64_t GetReadBWThrottle();
 };
 
+extern "C" {
+// optional, ops in the array are handled in order as by num sa->DoOneOps calls,
+// null when the global cache library is built without it
+void SaExportDoBatchOps(SaExport *sa, SaOpReq **saOps, uint32_t num) __attribute__((weak));
+}
+
 #endif
 
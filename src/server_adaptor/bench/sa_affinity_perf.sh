@@ -0,0 +1,44 @@
+#!/bin/bash
+# Copyright © Huawei Technologies Co., Ltd. 2021-2021. All rights reserved.
+# Description: Compare hash-spread and worker-owned op queues with sa_bench under perf stat
+# Usage: sa_affinity_perf.sh <sa_bench binary> [extra sa_bench options]
+set -e
+set -o pipefail
+
+SA_BENCH=${1:?usage: $0 <sa_bench binary> [sa_bench options]}
+shift
+EVENTS="LLC-loads,LLC-load-misses,context-switches,cpu-migrations"
+OUT_DIR=$(mktemp -d /tmp/sa_affinity.XXXXXX)
+
+run()
+{
+        local name=$1
+        shift
+        perf stat -x, -e ${EVENTS} -o ${OUT_DIR}/${name}.perf \
+                ${SA_BENCH} --ports 16011 --duration 20 --warmup 2 "$@" > ${OUT_DIR}/${name}.out
+}
+
+counter()
+{
+        awk -F, -v ev="$2" '$3 == ev { print $1 }' ${OUT_DIR}/$1.perf
+}
+
+main()
+{
+        run hash "$@"
+        run affinity --queue-affinity "$@"
+        printf "%-9s %10s %8s %14s %14s %8s %10s\n" mode iops p99_us LLC-loads LLC-misses miss% migrations
+        for name in hash affinity; do
+                local total loads misses
+                total=$(awk '$1 == "total"' ${OUT_DIR}/${name}.out)
+                loads=$(counter ${name} LLC-loads)
+                misses=$(counter ${name} LLC-load-misses)
+                printf "%-9s %10s %8s %14s %14s %8s %10s\n" ${name} $(echo ${total} | awk '{ print $3, $7 }') \
+                        ${loads} ${misses} $(awk -v l=${loads} -v m=${misses} 'BEGIN { printf "%.2f", l ? m * 100 / l : 0 }') \
+                        $(counter ${name} cpu-migrations)
+        done
+        rm -rf ${OUT_DIR}
+}
+
+main "$@"
+exit 0
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Copyright © Huawei Technologies Co., Ltd. 2021-2021. All rights reserved.
+# Description: Compare op batch policies with sa_bench against a mock global cache with a fixed cost per call
+# Usage: sa_batch_sweep.sh <sa_bench binary> [extra sa_bench options]
+set -e
+set -o pipefail
+
+SA_BENCH=${1:?usage: $0 <sa_bench binary> [sa_bench options]}
+shift
+CALL_OVERHEAD_US=${CALL_OVERHEAD_US:-20}
+# name and --batch value, 1 is one DoOneOps call per op
+POLICIES="off:1 drain16:16 drain64:64 nagle16-50us:16:50 nagle64-200us:64:200"
+OUT_DIR=$(mktemp -d /tmp/sa_batch.XXXXXX)
+
+run()
+{
+        local name=$1
+        local batch=$2
+        shift 2
+        ${SA_BENCH} --ports 16021 --duration 10 --warmup 2 --sa-call-overhead-us ${CALL_OVERHEAD_US} \
+                --batch ${batch} "$@" > ${OUT_DIR}/${name}.out
+}
+
+main()
+{
+        for policy in ${POLICIES}; do
+                run ${policy%%:*} ${policy#*:} "$@"
+        done
+        printf "%-14s %10s %8s %8s %8s %10s\n" policy iops avg_us p99_us p999_us ops/call
+        for policy in ${POLICIES}; do
+                local name=${policy%%:*}
+                local total per_call
+                total=$(awk '$1 == "total"' ${OUT_DIR}/${name}.out)
+                per_call=$(awk '/ops per call/ { print $5 }' ${OUT_DIR}/${name}.out)
+                printf "%-14s %10s %8s %8s %8s %10s\n" ${name} $(echo ${total} | awk '{ print $3, $5, $7, $8 }') \
+                        ${per_call}
+        done
+        rm -rf ${OUT_DIR}
+}
+
+main "$@"
+exit 0
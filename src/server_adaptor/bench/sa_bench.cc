@@ -0,0 +1,436 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "common/ceph_argparse.h"
+#include "include/str_list.h"
+#include "global/global_init.h"
+#include "config_reload.h"
+#include "network_module.h"
+#include "salog.h"
+#include "thread_placement.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+namespace {
+const double MB = 1024.0 * 1024.0;
+
+void Usage(ostream &out)
+{
+    out << "usage: sa_bench [options]\n"
+        "server adaptor:\n"
+        "  --ports p1,p2          loopback ports to listen on (16001)\n"
+        "  --queues n             op queues and handler threads (8)\n"
+        "  --queue-capacity n     max ops per queue (256)\n"
+        "  --msgr n               ms_async_op_threads (3)\n"
+        "  --op-throttle n        sa_op_throttle, 0 is off (0)\n"
+        "  --op-trace file        record the ops served, for sa_replay\n"
+        "  --placement mode       none, legacy (bind_core order) or auto (NUMA aware) (none)\n"
+        "  --cores list           cpus the adaptor may use, e.g. 0-15,32-47 (all)\n"
+        "  --nic name             interface whose NUMA node auto placement follows\n"
+        "  --queue-affinity       messenger workers enqueue into queues of their own\n"
+        "  --lanes m:d[:ms]       metadata:data lane weights and data starvation limit (off)\n"
+        "  --batch n[:us]         ops per global cache call, Nagle wait for a short batch (1:0)\n"
+        "  --reload-conf file     write the [sa] live keys there and watch it for changes,\n"
+        "                         must be the file the conf parser reads\n"
+        "  --reload-at s:key=v,.. rewrite a key of the reload conf s seconds into the run,\n"
+        "                         e.g. 2:sa_op_throttle=2000,4:queue_max_capacity=8\n"
+        "mock global cache:\n"
+        "  --sa-latency-us n      DoOneOps completion latency (0, inline)\n"
+        "  --sa-jitter-us n       extra uniform latency (0)\n"
+        "  --sa-call-overhead-us n  busy time per DoOneOps/SaExportDoBatchOps call (0)\n"
+        "  --sa-no-batch-entry    SaExportDoBatchOps falls back to one call per op\n"
+        "  --sa-complete-threads n\n"
+        "  --sa-omap-value-len n  (64)\n"
+        "  --sa-log-level n       0~4 (2)\n"
+        "client:\n"
+        "  --conns n              connections, one messenger each (4)\n"
+        "  --depth n              in flight ops per connection (16)\n"
+        "  --duration s           (10)\n"
+        "  --warmup s             not counted (1)\n"
+        "  --objects n            objects per connection (1024)\n"
+        "  --bs n                 read/write block size (4096)\n"
+        "  --omap-keys n          keys per omap op (4)\n"
+        "  --mix read:70,write:30,omap_get:0,omap_set:0,call:0\n"
+        "regression gate, exit 1 when missed:\n"
+        "  --min-iops n\n"
+        "  --max-p99-us n\n";
+}
+
+bool ParseMix(const string &val, uint32_t *mix)
+{
+    for (int kind = 0; kind < SA_BENCH_KIND_NUM; kind++) {
+        mix[kind] = 0;
+    }
+    uint32_t total = 0;
+    vector<string> items;
+    get_str_vec(val, ",", items);
+    for (auto &item : items) {
+        size_t pos = item.find(':');
+        if (pos == string::npos) {
+            return false;
+        }
+        string name = item.substr(0, pos);
+        int kind = 0;
+        for (; kind < SA_BENCH_KIND_NUM; kind++) {
+            if (name == SaBenchKindName(kind)) {
+                break;
+            }
+        }
+        if (kind == SA_BENCH_KIND_NUM) {
+            return false;
+        }
+        mix[kind] = atoi(item.substr(pos + 1).c_str());
+        total += mix[kind];
+    }
+    return total > 0;
+}
+
+struct ReloadStep {
+    uint32_t sec;
+    string key;
+    uint64_t value;
+};
+
+bool ParseReloadAt(const string &val, vector<ReloadStep> &steps)
+{
+    vector<string> items;
+    get_str_vec(val, ",", items);
+    for (auto &item : items) {
+        size_t colon = item.find(':');
+        size_t eq = item.find('=');
+        if (colon == string::npos || eq == string::npos || eq < colon) {
+            return false;
+        }
+        steps.push_back({ static_cast<uint32_t>(atoi(item.substr(0, colon).c_str())),
+            item.substr(colon + 1, eq - colon - 1), strtoull(item.substr(eq + 1).c_str(), nullptr, 10) });
+    }
+    std::stable_sort(steps.begin(), steps.end(),
+        [](const ReloadStep &a, const ReloadStep &b) { return a.sec < b.sec; });
+    return true;
+}
+
+int WriteReloadConf(const string &path, const map<string, uint64_t> &keys)
+{
+    // written aside and renamed in, like a config management tool would
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::trunc);
+        out << "[sa]\n";
+        for (auto &k : keys) {
+            out << k.first << " = " << k.second << "\n";
+        }
+        if (!out) {
+            return -EIO;
+        }
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0 ? 0 : -errno;
+}
+
+uint64_t GetLiveValue(NetworkModule *network, const string &key)
+{
+    const QosParam &qos = network->GetQosParam();
+    if (key == "write_qos") {
+        return qos.limitWrite;
+    } else if (key == "get_quota_cyc") {
+        return qos.getQuotaCycle;
+    } else if (key == "sa_op_throttle") {
+        return qos.saOpThrottle;
+    }
+    return network->GetQueueMaxCapacity();
+}
+
+// rewrites the conf on schedule and checks every change reached the running adaptor
+int RunReloadSteps(NetworkModule *network, const string &path, map<string, uint64_t> keys,
+    const vector<ReloadStep> &steps, ceph::mono_time begin)
+{
+    const uint32_t applyWaitMs = 2000;
+    int ret = 0;
+    for (size_t i = 0; i < steps.size();) {
+        std::this_thread::sleep_until(begin + std::chrono::seconds(steps[i].sec));
+        uint32_t sec = steps[i].sec;
+        size_t first = i;
+        for (; i < steps.size() && steps[i].sec == sec; i++) {
+            keys[steps[i].key] = steps[i].value;
+        }
+        if (WriteReloadConf(path, keys) != 0) {
+            fprintf(stderr, "rewrite %s failed\n", path.c_str());
+            return 1;
+        }
+        auto start = ceph::mono_clock::now();
+        for (size_t j = first; j < i; j++) {
+            while (GetLiveValue(network, steps[j].key) != keys[steps[j].key] &&
+                ceph::mono_clock::now() < start + std::chrono::milliseconds(applyWaitMs)) {
+                usleep(10000);
+            }
+            uint64_t live = GetLiveValue(network, steps[j].key);
+            uint64_t waitedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                ceph::mono_clock::now() - start).count();
+            printf("reload at %us: %s=%lu, running %lu after %lu ms\n", sec, steps[j].key.c_str(),
+                keys[steps[j].key], live, waitedMs);
+            if (live != keys[steps[j].key]) {
+                ret = 1;
+            }
+        }
+    }
+    return ret;
+}
+
+void PrintStat(const char *name, SaBenchStat &s, double sec)
+{
+    uint64_t sum = 0;
+    uint32_t max = 0;
+    for (auto &l : s.latUs) {
+        sum += l;
+        max = std::max(max, l);
+    }
+    printf("%-9s %10lu %10.0f %9.2f %8lu %8u %8u %8u %8u %7lu\n", name, s.ops, s.ops / sec, s.bytes / MB / sec,
+        s.latUs.empty() ? 0 : sum / s.latUs.size(), s.Percentile(50), s.Percentile(99), s.Percentile(99.9), max,
+        s.errors);
+}
+}
+
+int main(int argc, const char **argv)
+{
+    vector<const char *> args;
+    argv_to_vec(argc, argv, args);
+    auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY,
+        CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+    SaBenchClientConf clientConf;
+    SaBenchExportConf exportConf;
+    SaBenchServerConf serverConf;
+    string ports = "16001";
+    uint64_t minIops = 0;
+    uint64_t maxP99 = 0;
+    string reloadConf;
+    vector<ReloadStep> reloadSteps;
+    string val;
+    for (auto i = args.begin(); i != args.end();) {
+        if (ceph_argparse_witharg(args, i, &val, "--ports", (char *)nullptr)) {
+            ports = val;
+        } else if (ceph_argparse_witharg(args, i, &val, "--queues", (char *)nullptr)) {
+            serverConf.queues = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--queue-capacity", (char *)nullptr)) {
+            serverConf.capacity = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--msgr", (char *)nullptr)) {
+            serverConf.msgrNum = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--op-throttle", (char *)nullptr)) {
+            serverConf.opThrottle = strtoull(val.c_str(), nullptr, 10);
+        } else if (ceph_argparse_witharg(args, i, &val, "--op-trace", (char *)nullptr)) {
+            serverConf.opTrace = val;
+        } else if (ceph_argparse_witharg(args, i, &val, "--placement", (char *)nullptr)) {
+            serverConf.placement = val;
+        } else if (ceph_argparse_witharg(args, i, &val, "--cores", (char *)nullptr)) {
+            if (ParseCpuList(val, serverConf.cores) != 0) {
+                cerr << "bad cpu list " << val << std::endl;
+                return 2;
+            }
+        } else if (ceph_argparse_witharg(args, i, &val, "--nic", (char *)nullptr)) {
+            serverConf.nic = val;
+        } else if (ceph_argparse_flag(args, i, "--queue-affinity", (char *)nullptr)) {
+            serverConf.queueAffinity = true;
+        } else if (ceph_argparse_witharg(args, i, &val, "--lanes", (char *)nullptr)) {
+            if (sscanf(val.c_str(), "%u:%u:%u", &serverConf.laneMetaWeight, &serverConf.laneDataWeight,
+                &serverConf.laneStarveMs) < 2 || serverConf.laneDataWeight == 0) {
+                cerr << "bad lanes " << val << std::endl;
+                Usage(cerr);
+                return 2;
+            }
+        } else if (ceph_argparse_witharg(args, i, &val, "--batch", (char *)nullptr)) {
+            if (sscanf(val.c_str(), "%u:%u", &serverConf.batchMaxOps, &serverConf.batchLingerUs) < 1 ||
+                serverConf.batchMaxOps == 0) {
+                cerr << "bad batch " << val << std::endl;
+                Usage(cerr);
+                return 2;
+            }
+        } else if (ceph_argparse_witharg(args, i, &val, "--reload-conf", (char *)nullptr)) {
+            reloadConf = val;
+        } else if (ceph_argparse_witharg(args, i, &val, "--reload-at", (char *)nullptr)) {
+            if (!ParseReloadAt(val, reloadSteps)) {
+                cerr << "bad reload step " << val << std::endl;
+                Usage(cerr);
+                return 2;
+            }
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-latency-us", (char *)nullptr)) {
+            exportConf.latencyUs = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-jitter-us", (char *)nullptr)) {
+            exportConf.jitterUs = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-call-overhead-us", (char *)nullptr)) {
+            exportConf.callOverheadUs = atoi(val.c_str());
+        } else if (ceph_argparse_flag(args, i, "--sa-no-batch-entry", (char *)nullptr)) {
+            exportConf.batchEntry = false;
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-complete-threads", (char *)nullptr)) {
+            exportConf.completeThreads = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-omap-value-len", (char *)nullptr)) {
+            exportConf.omapValueLen = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-log-level", (char *)nullptr)) {
+            exportConf.logLevel = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--conns", (char *)nullptr)) {
+            clientConf.conns = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--depth", (char *)nullptr)) {
+            clientConf.depth = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--duration", (char *)nullptr)) {
+            clientConf.duration = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--warmup", (char *)nullptr)) {
+            clientConf.warmup = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char *)nullptr)) {
+            clientConf.objects = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--bs", (char *)nullptr)) {
+            clientConf.blockSize = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--omap-keys", (char *)nullptr)) {
+            clientConf.omapKeys = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--mix", (char *)nullptr)) {
+            if (!ParseMix(val, clientConf.mix)) {
+                cerr << "bad mix " << val << std::endl;
+                Usage(cerr);
+                return 2;
+            }
+        } else if (ceph_argparse_witharg(args, i, &val, "--min-iops", (char *)nullptr)) {
+            minIops = strtoull(val.c_str(), nullptr, 10);
+        } else if (ceph_argparse_witharg(args, i, &val, "--max-p99-us", (char *)nullptr)) {
+            maxP99 = strtoull(val.c_str(), nullptr, 10);
+        } else if (ceph_argparse_flag(args, i, "-h", "--help", (char *)nullptr)) {
+            Usage(cout);
+            return 0;
+        } else {
+            cerr << "unknown option " << *i << std::endl;
+            Usage(cerr);
+            return 2;
+        }
+    }
+    get_str_vec(ports, ",", clientConf.ports);
+    serverConf.addr = clientConf.addr;
+    serverConf.ports = clientConf.ports;
+    if (clientConf.ports.empty() || serverConf.queues == 0 || clientConf.conns == 0 || clientConf.depth == 0 ||
+        clientConf.objects == 0 || clientConf.blockSize == 0 || (!reloadSteps.empty() && reloadConf.empty()) ||
+        (serverConf.placement != "none" && serverConf.placement != "legacy" && serverConf.placement != "auto")) {
+        Usage(cerr);
+        return 2;
+    }
+
+    // client and server messengers share this context, so they share the async workers too
+    g_conf().set_val("ms_async_op_threads", to_string(serverConf.msgrNum));
+    g_conf().apply_changes(nullptr);
+
+    SaExport sa;
+    InitSalog(sa);
+    SaBenchExportStart(exportConf);
+    NetworkModule *network = SaBenchServerStart(sa, serverConf);
+    if (network == nullptr) {
+        cerr << "server adaptor failed to start on " << ports << std::endl;
+        return 1;
+    }
+
+    map<string, uint64_t> reloadKeys = { { "write_qos", 0 }, { "get_quota_cyc", 200 },
+        { "sa_op_throttle", serverConf.opThrottle }, { "queue_max_capacity", serverConf.capacity } };
+    std::unique_ptr<OsaConfigReload> reload;
+    if (!reloadConf.empty()) {
+        reload.reset(new OsaConfigReload(network, reloadConf));
+        if (WriteReloadConf(reloadConf, reloadKeys) != 0 || reload->Start() != 0) {
+            cerr << "config reload failed to start on " << reloadConf << std::endl;
+            return 1;
+        }
+    }
+
+    DummyAuthClientServer dummyAuth(g_ceph_context);
+    dummyAuth.auth_registry.refresh_config();
+    vector<std::unique_ptr<SaBenchConnection>> conns;
+    for (uint32_t i = 0; i < clientConf.conns; i++) {
+        conns.emplace_back(new SaBenchConnection(g_ceph_context, clientConf, i));
+        if (conns.back()->Start(dummyAuth) != 0) {
+            return 1;
+        }
+    }
+
+    auto now = ceph::mono_clock::now();
+    auto warmupEnd = now + std::chrono::seconds(clientConf.warmup);
+    auto end = warmupEnd + std::chrono::seconds(clientConf.duration);
+    for (auto &c : conns) {
+        c->Run(warmupEnd, end);
+    }
+    int reloadRet = 0;
+    std::thread reloader;
+    if (!reloadSteps.empty()) {
+        reloader = std::thread([&]() {
+            reloadRet = RunReloadSteps(network, reloadConf, reloadKeys, reloadSteps, warmupEnd);
+        });
+    }
+    SaBenchStat total;
+    SaBenchStat kinds[SA_BENCH_KIND_NUM];
+    for (auto &c : conns) {
+        c->Join();
+        for (int kind = 0; kind < SA_BENCH_KIND_NUM; kind++) {
+            kinds[kind].Merge(c->GetStat(kind));
+        }
+    }
+    if (reloader.joinable()) {
+        reloader.join();
+    }
+    for (auto &c : conns) {
+        c->Stop();
+    }
+    conns.clear();
+    if (reload) {
+        reload->Stop();
+    }
+
+    SaBenchExportStop();
+    SaBenchServerStop(network);
+
+    double sec = std::max<uint32_t>(clientConf.duration, 1);
+    printf("%-9s %10s %10s %9s %8s %8s %8s %8s %8s %7s\n", "op", "ops", "iops", "MB/s", "avg_us", "p50_us",
+        "p99_us", "p999_us", "max_us", "errors");
+    for (int kind = 0; kind < SA_BENCH_KIND_NUM; kind++) {
+        if (clientConf.mix[kind] != 0) {
+            PrintStat(SaBenchKindName(kind), kinds[kind], sec);
+        }
+        total.Merge(kinds[kind]);
+    }
+    // metadata and bulk rows make lane runs comparable at a glance
+    SaBenchStat meta;
+    SaBenchStat data;
+    data.Merge(kinds[SA_BENCH_READ]);
+    data.Merge(kinds[SA_BENCH_WRITE]);
+    meta.Merge(kinds[SA_BENCH_OMAP_GET]);
+    meta.Merge(kinds[SA_BENCH_OMAP_SET]);
+    meta.Merge(kinds[SA_BENCH_CALL]);
+    if (meta.ops != 0 && data.ops != 0) {
+        PrintStat("metadata", meta, sec);
+        PrintStat("data", data, sec);
+    }
+    PrintStat("total", total, sec);
+    uint64_t calls = SaBenchExportCalls();
+    printf("global cache calls %lu, %.2f ops per call\n", calls,
+        calls == 0 ? 0.0 : static_cast<double>(SaBenchExportDone()) / calls);
+
+    int ret = 0;
+    if (total.errors != 0) {
+        cerr << "FAIL: " << total.errors << " ops failed" << std::endl;
+        ret = 1;
+    }
+    if (reloadRet != 0) {
+        cerr << "FAIL: config changes did not reach the running adaptor" << std::endl;
+        ret = 1;
+    }
+    if (minIops != 0 && total.ops / sec < minIops) {
+        cerr << "FAIL: iops " << static_cast<uint64_t>(total.ops / sec) << " < " << minIops << std::endl;
+        ret = 1;
+    }
+    if (maxP99 != 0 && total.Percentile(99) > maxP99) {
+        cerr << "FAIL: p99 " << total.Percentile(99) << "us > " << maxP99 << "us" << std::endl;
+        ret = 1;
+    }
+    return ret;
+}
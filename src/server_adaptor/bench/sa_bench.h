@@ -0,0 +1,186 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef SA_BENCH_H
+#define SA_BENCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_time.h"
+#include "msg/Dispatcher.h"
+#include "msg/Messenger.h"
+#include "auth/DummyAuth.h"
+
+class MOSDOp;
+
+/* --selftest of a bench tool, failed checks are printed and counted */
+class SaBenchSelfTest {
+protected:
+    int failed { 0 };
+
+    void Check(bool ok, const std::string &what)
+    {
+        if (!ok) {
+            std::cerr << "FAIL: " << what << std::endl;
+            failed++;
+        }
+    }
+
+    int Result(const char *name)
+    {
+        printf("%s selftest %s\n", name, failed == 0 ? "passed" : "failed");
+        return failed == 0 ? 0 : 1;
+    }
+};
+
+enum SaBenchOpKind {
+    SA_BENCH_READ = 0,
+    SA_BENCH_WRITE,
+    SA_BENCH_OMAP_GET,
+    SA_BENCH_OMAP_SET,
+    SA_BENCH_CALL,
+    SA_BENCH_KIND_NUM,
+};
+
+const char *SaBenchKindName(int kind);
+
+/* Mock SaExport, replaces the global cache library at link time */
+struct SaBenchExportConf {
+    uint32_t latencyUs { 0 };
+    uint32_t jitterUs { 0 };
+    uint32_t completeThreads { 2 };
+    // busy time every DoOneOps/SaExportDoBatchOps call costs the queue thread
+    uint32_t callOverheadUs { 0 };
+    // without it SaExportDoBatchOps behaves like a library lacking the batch entry
+    bool batchEntry { true };
+    uint32_t omapValueLen { 64 };
+    char fill { 'a' };
+    int logLevel { 2 };
+};
+
+void SaBenchExportStart(const SaBenchExportConf &conf);
+void SaBenchExportStop();
+uint64_t SaBenchExportDone();
+uint64_t SaBenchExportCalls();
+
+/* NetworkModule on loopback ports, serving from the mock SaExport */
+struct SaBenchServerConf {
+    std::string addr { "127.0.0.1" };
+    std::vector<std::string> ports;
+    uint32_t queues { 8 };
+    uint32_t capacity { 256 };
+    uint32_t msgrNum { 3 };
+    uint64_t opThrottle { 0 };
+    std::string opTrace;
+    // none, legacy (bind_core and bind_queue_core) or auto
+    std::string placement { "none" };
+    std::vector<int> cores;
+    std::string nic;
+    bool queueAffinity { false };
+    // metadata:data op lane weights, 0 metadata weight is a single FIFO
+    uint32_t laneMetaWeight { 0 };
+    uint32_t laneDataWeight { 1 };
+    uint32_t laneStarveMs { 50 };
+    // ops per global cache call and the Nagle wait for a short batch
+    uint32_t batchMaxOps { 1 };
+    uint32_t batchLingerUs { 0 };
+};
+
+class NetworkModule;
+class SaExport;
+NetworkModule *SaBenchServerStart(SaExport &sa, const SaBenchServerConf &conf);
+void SaBenchServerStop(NetworkModule *network);
+
+struct SaBenchClientConf {
+    std::vector<std::string> ports;
+    std::string addr { "127.0.0.1" };
+    uint32_t conns { 4 };
+    uint32_t depth { 16 };
+    uint32_t duration { 10 };
+    uint32_t warmup { 1 };
+    uint32_t objects { 1024 };
+    uint32_t blockSize { 4096 };
+    uint32_t objectSize { 4194304 };
+    uint32_t omapKeys { 4 };
+    uint64_t poolId { 1 };
+    uint32_t mix[SA_BENCH_KIND_NUM] { 70, 30, 0, 0, 0 };
+};
+
+struct SaBenchStat {
+    uint64_t ops { 0 };
+    uint64_t errors { 0 };
+    uint64_t bytes { 0 };
+    std::vector<uint32_t> latUs;
+
+    void Merge(const SaBenchStat &other);
+    uint32_t Percentile(double p);
+};
+
+class SaBenchConnection : public Dispatcher {
+    struct Inflight {
+        int kind;
+        uint64_t bytes;
+        ceph::mono_time start;
+    };
+
+    const SaBenchClientConf &conf;
+    uint32_t index;
+    Messenger *msgr { nullptr };
+    ConnectionRef conn;
+    std::thread sender;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::map<ceph_tid_t, Inflight> inflight;
+    ceph_tid_t lastTid { 0 };
+    ceph::mono_time recordFrom;
+    SaBenchStat stat[SA_BENCH_KIND_NUM];
+
+    bufferlist writeData;
+    std::vector<uint32_t> mixTable;
+
+    MOSDOp *PrepareOp(int kind, uint64_t &bytes);
+    void SendLoop(ceph::mono_time end);
+
+public:
+    SaBenchConnection(CephContext *cct, const SaBenchClientConf &c, uint32_t i);
+    ~SaBenchConnection() override;
+
+    int Start(DummyAuthClientServer &auth);
+    void Run(ceph::mono_time warmupEnd, ceph::mono_time end);
+    void Join();
+    void Stop();
+    const SaBenchStat &GetStat(int kind)
+    {
+        return stat[kind];
+    }
+
+    bool ms_can_fast_dispatch_any() const override
+    {
+        return true;
+    }
+    bool ms_can_fast_dispatch(const Message *m) const override;
+    void ms_fast_dispatch(Message *m) override;
+    bool ms_dispatch(Message *m) override;
+    void ms_handle_connect(Connection *con) override {};
+    void ms_handle_accept(Connection *con) override {};
+    bool ms_handle_reset(Connection *con) override;
+    void ms_handle_remote_reset(Connection *con) override {};
+    bool ms_handle_refused(Connection *con) override
+    {
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,249 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+
+#include "common/address_helper.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+namespace {
+const uint32_t BENCH_PT_NUM = 128;
+const uint32_t DRAIN_WAIT_SEC = 30;
+const char *KIND_NAME[SA_BENCH_KIND_NUM] = { "read", "write", "omap_get", "omap_set", "call" };
+}
+
+const char *SaBenchKindName(int kind)
+{
+    return (kind >= 0 && kind < SA_BENCH_KIND_NUM) ? KIND_NAME[kind] : "unknown";
+}
+
+void SaBenchStat::Merge(const SaBenchStat &other)
+{
+    ops += other.ops;
+    errors += other.errors;
+    bytes += other.bytes;
+    latUs.insert(latUs.end(), other.latUs.begin(), other.latUs.end());
+}
+
+uint32_t SaBenchStat::Percentile(double p)
+{
+    if (latUs.empty()) {
+        return 0;
+    }
+    size_t idx = std::min(latUs.size() - 1, static_cast<size_t>(p / 100 * latUs.size()));
+    std::nth_element(latUs.begin(), latUs.begin() + idx, latUs.end());
+    return latUs[idx];
+}
+
+SaBenchConnection::SaBenchConnection(CephContext *cct, const SaBenchClientConf &c, uint32_t i)
+    : Dispatcher(cct), conf(c), index(i)
+{
+    writeData.append(std::string(conf.blockSize, 'w'));
+    for (int kind = 0; kind < SA_BENCH_KIND_NUM; kind++) {
+        for (uint32_t n = 0; n < conf.mix[kind]; n++) {
+            mixTable.push_back(kind);
+        }
+    }
+}
+
+SaBenchConnection::~SaBenchConnection()
+{
+    if (msgr) {
+        delete msgr;
+    }
+}
+
+int SaBenchConnection::Start(DummyAuthClientServer &auth)
+{
+    msgr = Messenger::create(cct, cct->_conf.get_val<std::string>("ms_type"), entity_name_t::CLIENT(-1),
+        "sa_bench_client", getpid() + index, 0);
+    msgr->set_default_policy(Messenger::Policy::lossy_client(CEPH_FEATURE_OSDREPLYMUX));
+    msgr->set_auth_client(&auth);
+    msgr->set_magic(MSG_MAGIC_TRACE_CTR);
+    msgr->add_dispatcher_head(this);
+    msgr->start();
+
+    entity_addr_t addr;
+    string dest = "tcp://" + conf.addr + ":" + conf.ports[index % conf.ports.size()];
+    if (!entity_addr_from_url(&addr, dest.c_str())) {
+        fprintf(stderr, "bad server address %s\n", dest.c_str());
+        return -EINVAL;
+    }
+    addr.set_type(entity_addr_t::TYPE_MSGR2);
+    conn = msgr->connect_to_osd(entity_addrvec_t(addr));
+    return 0;
+}
+
+MOSDOp *SaBenchConnection::PrepareOp(int kind, uint64_t &bytes)
+{
+    uint32_t obj = rand() % conf.objects;
+    char name[64] = {0};
+    snprintf(name, sizeof(name), "rbd_data.%x.%016x", 0x1000 + index, obj);
+    uint32_t ptId = std::hash<std::string> {}(name) % BENCH_PT_NUM;
+    object_t oid(name);
+    hobject_t hobj(oid, "", CEPH_NOSNAP, ptId, conf.poolId, "");
+    spg_t pgid(pg_t(ptId, conf.poolId));
+    MOSDOp *m = new MOSDOp(0, ++lastTid, hobj, pgid, 1, CEPH_OSD_FLAG_ACK, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    m->set_mtime(ceph::real_clock::now());
+
+    uint64_t blocks = std::max<uint64_t>(conf.objectSize / conf.blockSize, 1);
+    uint64_t off = (rand() % blocks) * conf.blockSize;
+    bytes = 0;
+    switch (kind) {
+        case SA_BENCH_READ:
+            m->read(off, conf.blockSize);
+            bytes = conf.blockSize;
+            break;
+        case SA_BENCH_WRITE: {
+            bufferlist bl = writeData;
+            m->write(off, conf.blockSize, bl);
+            bytes = conf.blockSize;
+        } break;
+        case SA_BENCH_OMAP_GET:
+        case SA_BENCH_OMAP_SET: {
+            OSDOp osdop;
+            std::set<std::string> keys;
+            std::map<std::string, bufferlist> kvs;
+            for (uint32_t k = 0; k < conf.omapKeys; k++) {
+                string key = "key_" + to_string(rand() % 4096);
+                keys.insert(key);
+                kvs[key].append(key);
+            }
+            if (kind == SA_BENCH_OMAP_GET) {
+                osdop.op.op = CEPH_OSD_OP_OMAPGETVALSBYKEYS;
+                encode(keys, osdop.indata);
+            } else {
+                osdop.op.op = CEPH_OSD_OP_OMAPSETVALS;
+                encode(kvs, osdop.indata);
+            }
+            osdop.op.extent.offset = 0;
+            osdop.op.extent.length = osdop.indata.length();
+            m->ops.push_back(osdop);
+        } break;
+        case SA_BENCH_CALL: {
+            // rpc.das_prefetch goes through OSA_ExecClass without loading a class plugin
+            OSDOp osdop;
+            bufferlist in;
+            encode(off, in);
+            encode(static_cast<uint64_t>(conf.blockSize), in);
+            osdop.op.op = CEPH_OSD_OP_CALL;
+            osdop.op.cls.class_len = strlen("rpc");
+            osdop.op.cls.method_len = strlen("das_prefetch");
+            osdop.op.cls.indata_len = in.length();
+            osdop.indata.append("rpc");
+            osdop.indata.append("das_prefetch");
+            osdop.indata.claim_append(in);
+            m->ops.push_back(osdop);
+        } break;
+        default:
+            break;
+    }
+    return m;
+}
+
+void SaBenchConnection::SendLoop(ceph::mono_time end)
+{
+    std::unique_lock<std::mutex> l(lock);
+    while (ceph::mono_clock::now() < end) {
+        if (inflight.size() >= conf.depth) {
+            cond.wait_until(l, end);
+            continue;
+        }
+        int kind = mixTable[rand() % mixTable.size()];
+        uint64_t bytes = 0;
+        MOSDOp *m = PrepareOp(kind, bytes);
+        inflight[m->get_tid()] = { kind, bytes, ceph::mono_clock::now() };
+        l.unlock();
+        conn->send_message(m);
+        l.lock();
+    }
+    auto drainEnd = ceph::mono_clock::now() + std::chrono::seconds(DRAIN_WAIT_SEC);
+    while (!inflight.empty() && ceph::mono_clock::now() < drainEnd) {
+        cond.wait_until(l, drainEnd);
+    }
+    if (!inflight.empty()) {
+        fprintf(stderr, "connection %u: %lu ops never replied\n", index, inflight.size());
+        stat[SA_BENCH_READ].errors += inflight.size();
+    }
+}
+
+void SaBenchConnection::Run(ceph::mono_time warmupEnd, ceph::mono_time end)
+{
+    recordFrom = warmupEnd;
+    sender = std::thread([this, end]() {
+        pthread_setname_np(pthread_self(), "sa_bench_send");
+        SendLoop(end);
+    });
+}
+
+void SaBenchConnection::Join()
+{
+    if (sender.joinable()) {
+        sender.join();
+    }
+}
+
+void SaBenchConnection::Stop()
+{
+    if (conn) {
+        conn->mark_down();
+        conn.reset();
+    }
+    if (msgr) {
+        msgr->shutdown();
+        msgr->wait();
+    }
+}
+
+bool SaBenchConnection::ms_can_fast_dispatch(const Message *m) const
+{
+    return m->get_type() == CEPH_MSG_OSD_OPREPLY;
+}
+
+void SaBenchConnection::ms_fast_dispatch(Message *m)
+{
+    MOSDOpReply *reply = static_cast<MOSDOpReply *>(m);
+    auto now = ceph::mono_clock::now();
+    std::lock_guard<std::mutex> l(lock);
+    auto it = inflight.find(reply->get_tid());
+    if (it != inflight.end()) {
+        SaBenchStat &s = stat[it->second.kind];
+        // ops sent during the warmup are not counted
+        if (it->second.start >= recordFrom) {
+            s.ops++;
+            if (reply->get_result() < 0) {
+                s.errors++;
+            }
+            s.bytes += std::max<uint64_t>(it->second.bytes, reply->get_data().length());
+            s.latUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - it->second.start).count());
+        }
+        inflight.erase(it);
+        cond.notify_one();
+    }
+    m->put();
+}
+
+bool SaBenchConnection::ms_dispatch(Message *m)
+{
+    if (ms_can_fast_dispatch(m)) {
+        ms_fast_dispatch(m);
+        return true;
+    }
+    m->put();
+    return true;
+}
+
+bool SaBenchConnection::ms_handle_reset(Connection *con)
+{
+    fprintf(stderr, "connection %u reset by server\n", index);
+    return true;
+}
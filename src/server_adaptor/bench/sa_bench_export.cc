@@ -0,0 +1,271 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <random>
+
+#include "network_module.h"
+#include "osa.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+namespace {
+SaBenchExportConf g_conf;
+std::mutex g_doneMtx;
+std::condition_variable g_doneCond;
+std::multimap<ceph::mono_time, SaOpReq *> g_delayed;
+std::vector<std::thread> g_completers;
+bool g_stop { false };
+std::atomic<uint64_t> g_done { 0 };
+std::atomic<uint64_t> g_calls { 0 };
+
+int BenchPrefetch(SaOpReq &opReq, OpRequestOps &osdop)
+{
+    return 0;
+}
+
+void CompleteOps(SaOpReq *opReq)
+{
+    OSA_FinishCacheOps(opReq->ptrMosdop, opReq->optionType, opReq->optionLength, 0);
+    delete opReq;
+    g_done++;
+}
+
+void CompleterThread()
+{
+    std::unique_lock<std::mutex> l(g_doneMtx);
+    while (true) {
+        if (g_delayed.empty()) {
+            if (g_stop) {
+                break;
+            }
+            g_doneCond.wait(l);
+            continue;
+        }
+        auto it = g_delayed.begin();
+        if (!g_stop && it->first > ceph::mono_clock::now()) {
+            g_doneCond.wait_until(l, it->first);
+            continue;
+        }
+        SaOpReq *opReq = it->second;
+        g_delayed.erase(it);
+        l.unlock();
+        CompleteOps(opReq);
+        l.lock();
+    }
+}
+
+void ReleaseFill(void *arg)
+{
+    delete static_cast<std::shared_ptr<std::string> *>(arg);
+}
+
+// read data is lent like cache pages, each reply holds a reference to the fill block
+void EncodeReadFill(OpRequestOps &oneOp, int i, void *p)
+{
+    thread_local std::shared_ptr<std::string> buf;
+    if (!buf || buf->size() < oneOp.objLength) {
+        buf = std::make_shared<std::string>(oneOp.objLength, g_conf.fill);
+    }
+    OSA_EncodeReadZeroCopy(oneOp.opSubType, oneOp.objOffset, oneOp.objLength, &(*buf)[0], oneOp.objLength,
+        ReleaseFill, new std::shared_ptr<std::string>(buf), i, p);
+}
+
+void EncodeOmapFill(OpRequestOps &oneOp, int i, void *p)
+{
+    thread_local std::string value;
+    if (value.size() != g_conf.omapValueLen) {
+        value.assign(g_conf.omapValueLen, g_conf.fill);
+    }
+    std::vector<SaStr> keys;
+    std::vector<SaStr> values;
+    for (auto &k : oneOp.keys) {
+        keys.push_back({ static_cast<uint32_t>(k.size()), const_cast<char *>(k.data()) });
+        values.push_back({ static_cast<uint32_t>(value.size()), &value[0] });
+    }
+    SaBatchKv kv = { keys.data(), values.data(), static_cast<uint32_t>(keys.size()) };
+    OSA_EncodeOmapGetvalsbykeys(&kv, i, p);
+}
+
+// the fixed cost of crossing into the global cache, paid once per call
+void CallOverhead()
+{
+    g_calls++;
+    if (g_conf.callOverheadUs == 0) {
+        return;
+    }
+    auto end = ceph::mono_clock::now() + std::chrono::microseconds(g_conf.callOverheadUs);
+    while (ceph::mono_clock::now() < end) {
+    }
+}
+
+void HandleOp(SaOpReq &saOp)
+{
+    void *p = saOp.ptrMosdop;
+    for (uint32_t i = 0; i < saOp.vecOps.size(); i++) {
+        OpRequestOps &oneOp = saOp.vecOps[i];
+        switch (oneOp.opSubType) {
+            case CEPH_OSD_OP_SPARSE_READ:
+            case CEPH_OSD_OP_SYNC_READ:
+            case CEPH_OSD_OP_READ:
+                EncodeReadFill(oneOp, i, p);
+                break;
+            case CEPH_OSD_OP_OMAPGETVALSBYKEYS:
+                EncodeOmapFill(oneOp, i, p);
+                break;
+            case CEPH_OSD_OP_STAT:
+                OSA_EncodeGetOpstat(oneOp.objLength, time(nullptr), i, p);
+                break;
+            case CEPH_OSD_OP_CALL: {
+                SaOpContext ctx = { &saOp, static_cast<int>(i), nullptr };
+                OSA_SetOpResult(i, OSA_ExecClass(&ctx, BenchPrefetch), p);
+            } break;
+            default:
+                break;
+        }
+    }
+
+    if (g_conf.latencyUs == 0 && g_conf.jitterUs == 0) {
+        CompleteOps(&saOp);
+        return;
+    }
+    uint64_t us = g_conf.latencyUs;
+    if (g_conf.jitterUs) {
+        thread_local std::mt19937 rng(std::random_device{}());
+        us += std::uniform_int_distribution<uint32_t>(0, g_conf.jitterUs)(rng);
+    }
+    std::lock_guard<std::mutex> l(g_doneMtx);
+    auto it = g_delayed.emplace(ceph::mono_clock::now() + std::chrono::microseconds(us), &saOp);
+    if (it == g_delayed.begin()) {
+        g_doneCond.notify_one();
+    }
+}
+}
+
+void SaBenchExportStart(const SaBenchExportConf &conf)
+{
+    g_conf = conf;
+    g_stop = false;
+    if (g_conf.latencyUs == 0 && g_conf.jitterUs == 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < std::max<uint32_t>(g_conf.completeThreads, 1); i++) {
+        g_completers.push_back(std::thread(CompleterThread));
+    }
+}
+
+void SaBenchExportStop()
+{
+    {
+        std::lock_guard<std::mutex> l(g_doneMtx);
+        g_stop = true;
+        g_doneCond.notify_all();
+    }
+    for (auto &t : g_completers) {
+        t.join();
+    }
+    g_completers.clear();
+}
+
+uint64_t SaBenchExportDone()
+{
+    return g_done;
+}
+
+uint64_t SaBenchExportCalls()
+{
+    return g_calls;
+}
+
+void SaExport::Init(OphandlerModule &p) {}
+
+void SaExport::DoOneOps(SaOpReq &saOp)
+{
+    CallOverhead();
+    HandleOp(saOp);
+}
+
+extern "C" void SaExportDoBatchOps(SaExport *sa, SaOpReq **saOps, uint32_t num)
+{
+    if (!g_conf.batchEntry) {
+        for (uint32_t i = 0; i < num; i++) {
+            sa->DoOneOps(*saOps[i]);
+        }
+        return;
+    }
+    CallOverhead();
+    for (uint32_t i = 0; i < num; i++) {
+        HandleOp(*saOps[i]);
+    }
+}
+
+void SaExport::WriteLog(const int logLevel, const std::string &fileName, const int fLine,
+    const std::string &funcName, const std::string &format)
+{
+    if (logLevel <= g_conf.logLevel) {
+        fprintf(stderr, "[%d] %s:%d %s %s\n", logLevel, fileName.c_str(), fLine, funcName.c_str(), format.c_str());
+    }
+}
+
+void SaExport::WriteLogLimit(const int logLevel, const std::string &fileName, const int fLine,
+    const std::string &funcName, const std::string &format)
+{
+    WriteLog(logLevel, fileName, fLine, funcName, format);
+}
+
+void SaExport::WriteLogLimit2(const int logLevel, const std::string &fileName, const int fLine,
+    const std::string &funcName, const std::string &format)
+{
+    WriteLog(logLevel, fileName, fLine, funcName, format);
+}
+
+void SaExport::WriteDataLog(const std::string &fileName, const int fLine, const std::string &funcName,
+    const std::string &format) {}
+
+void SaExport::SetConfPath(const std::string &path)
+{
+    confPath = path;
+}
+
+std::string SaExport::GetConfPath()
+{
+    return confPath;
+}
+
+void SaExport::FtdsStartNormal(unsigned int id, const char *idName, uint64_t &ts) {}
+void SaExport::FtdsEndNormal(unsigned int id, const char *idName, uint64_t &ts, int ret) {}
+void SaExport::FtdsStartHigh(unsigned int id, const char *idName, uint64_t &ts) {}
+void SaExport::FtdsEndHigt(unsigned int id, const char *idName, uint64_t &ts, int ret) {}
+
+void SaExport::GetWriteQuota(unsigned int poolId, SaWcacheQosInfo &info)
+{
+    info.ptNum = 0;
+    info.writeRatio = UINT32_MAX;
+}
+
+uint64_t SaExport::GetWriteOpThrottle()
+{
+    return 0;
+}
+
+uint64_t SaExport::GetReadOpThrottle()
+{
+    return 0;
+}
+
+uint64_t SaExport::GetWriteBWThrottle()
+{
+    return 0;
+}
+
+uint64_t SaExport::GetReadBWThrottle()
+{
+    return 0;
+}
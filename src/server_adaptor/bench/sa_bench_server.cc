@@ -0,0 +1,64 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <unistd.h>
+#include <cstdio>
+
+#include "network_module.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+namespace {
+const uint32_t BIND_WAIT_SEC = 60;
+}
+
+NetworkModule *SaBenchServerStart(SaExport &sa, const SaBenchServerConf &conf)
+{
+    vector<int> cores = conf.cores;
+    for (long i = 0; cores.empty() && i < sysconf(_SC_NPROCESSORS_ONLN); i++) {
+        cores.push_back(i);
+    }
+    uint32_t bind = (conf.placement == "legacy") ? 1 : 0;
+    NetworkModule *network = new NetworkModule(sa, cores, conf.msgrNum, bind, bind);
+    if (conf.placement == "auto") {
+        network->SetAutoPlacement(conf.nic);
+    }
+    network->SetQueueAffinity(conf.queueAffinity);
+    OpLanePolicy lanes;
+    lanes.metaWeight = conf.laneMetaWeight;
+    lanes.dataWeight = conf.laneDataWeight;
+    lanes.starveMs = conf.laneStarveMs;
+    network->SetLanePolicy(lanes);
+    OpBatchPolicy batch;
+    batch.maxOps = conf.batchMaxOps;
+    batch.lingerUs = conf.batchLingerUs;
+    network->SetBatchPolicy(batch);
+    network->CreateWorkThread(conf.queues, conf.ports.size(), conf.capacity);
+    QosParam qos;
+    qos.saOpThrottle = conf.opThrottle;
+    network->SetQosParam(qos);
+    OpTraceParam trace;
+    trace.path = conf.opTrace;
+    network->SetTraceParam(trace);
+    int bindSuccess = -1;
+    int ret = network->InitNetworkModule(conf.addr, conf.ports, conf.addr, conf.ports[0], &bindSuccess);
+    for (uint32_t i = 0; ret == 0 && bindSuccess == -1 && i < BIND_WAIT_SEC * 10; i++) {
+        usleep(100000);
+    }
+    if (ret != 0 || bindSuccess != 1) {
+        fprintf(stderr, "server adaptor bind failed, ret %d\n", ret);
+        return nullptr;
+    }
+    return network;
+}
+
+void SaBenchServerStop(NetworkModule *network)
+{
+    network->FinishNetworkModule();
+    network->StopThread();
+    delete network;
+}
@@ -0,0 +1,351 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "messages/MOSDOp.h"
+#include "objclass/objclass.h"
+#include "copyup_executor.h"
+#include "osa.h"
+#include "salog.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+/*
+ * First writes of several clients to the same objects of a clone, each one
+ * an rbd.copyup through OSA_ExecClass against an in-memory global cache.
+ * The old stat-then-write copyup is timed next to the guarded one.
+ */
+namespace {
+const uint64_t POOL_ID = 3;
+
+void Usage(ostream &out)
+{
+    out << "usage: sa_copyup [options]\n"
+        "  --selftest          concurrent copyups write every object exactly once\n"
+        "  --threads n         clients copying up the same objects (8)\n"
+        "  --objects n         (1024)\n"
+        "  --data-len n        parent data per copyup (65536)\n"
+        "  --latency-us n      global cache time of every call (100)\n";
+}
+
+struct StoreObject {
+    string data;
+    uint32_t writes { 0 };
+};
+
+// the global cache behind cbFunc: every call takes latencyUs, the ops of one call apply as a whole
+struct Store {
+    mutex lock;
+    map<string, StoreObject> objects;
+    uint32_t latencyUs { 0 };
+    string failOid;
+    atomic<uint64_t> calls { 0 };
+
+    int Apply(SaOpReq &req)
+    {
+        calls++;
+        if (latencyUs != 0) {
+            this_thread::sleep_for(chrono::microseconds(latencyUs));
+        }
+        lock_guard<mutex> l(lock);
+        for (uint32_t i = 0; i < req.vecOps.size(); i++) {
+            OpRequestOps &op = req.vecOps[i];
+            auto it = objects.find(op.objName);
+            switch (op.opSubType) {
+                case CEPH_OSD_OP_STAT:
+                    if (it == objects.end()) {
+                        return -ENOENT;
+                    }
+                    OSA_EncodeGetOpstat(it->second.data.size(), time(nullptr), i, req.ptrMosdop);
+                    break;
+                case CEPH_OSD_OP_CREATE:
+                    if (it != objects.end() && (op.opFlags & CEPH_OSD_OP_FLAG_EXCL)) {
+                        return -EEXIST;
+                    }
+                    break;
+                case CEPH_OSD_OP_WRITE: {
+                    if (op.objName == failOid) {
+                        return -EIO;
+                    }
+                    StoreObject &obj = objects[op.objName];
+                    obj.data.assign(op.inData, op.inDataLen);
+                    obj.writes++;
+                } break;
+                default:
+                    return -EOPNOTSUPP;
+            }
+        }
+        return 0;
+    }
+};
+
+Store g_store;
+
+int StoreCall(SaOpReq &req)
+{
+    return g_store.Apply(req);
+}
+
+string ObjName(uint32_t i)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "rbd_data.clone.%016x", i);
+    return name;
+}
+
+string ParentData(const string &oid, uint32_t len)
+{
+    string data(len, 'p');
+    data.replace(0, min<size_t>(oid.size(), len), oid, 0, min<size_t>(oid.size(), len));
+    return data;
+}
+
+// one client op holding the rbd.copyup call, as librbd sends it for the first write to a clone object
+class CopyupOp {
+    MOSDOp *mosdop { nullptr };
+    SaOpReq req;
+    ceph::bufferlist data;
+
+public:
+    CopyupOp(const string &oid, const string &parent)
+    {
+        hobject_t hobj(object_t(oid), "", CEPH_NOSNAP, 0, POOL_ID, "");
+        mosdop = new MOSDOp(0, 1, hobj, spg_t(pg_t(0, POOL_ID)), 1, CEPH_OSD_FLAG_ACK,
+            CEPH_FEATURES_SUPPORTED_DEFAULT);
+        OSDOp call;
+        call.op.op = CEPH_OSD_OP_CALL;
+        call.op.cls.class_len = strlen("rbd");
+        call.op.cls.method_len = strlen("copyup");
+        call.op.cls.indata_len = parent.size();
+        call.indata.append("rbd");
+        call.indata.append("copyup");
+        call.indata.append(parent);
+        mosdop->ops.push_back(call);
+        data.append(parent);
+
+        OpRequestOps op;
+        op.opSubType = CEPH_OSD_OP_CALL;
+        op.objName = oid;
+        req.vecOps.push_back(op);
+        req.ptrMosdop = mosdop;
+        req.poolId = POOL_ID;
+        req.exitsCopyUp = 1;
+    }
+    ~CopyupOp()
+    {
+        mosdop->put();
+    }
+
+    // what the queue thread passes to Expect and FinishCacheOps to Release
+    const void *Token() const
+    {
+        return mosdop;
+    }
+
+    int Guarded()
+    {
+        SaOpContext ctx = { &req, 0, StoreCall };
+        return OSA_ExecClass(&ctx, nullptr);
+    }
+
+    // what OSA_ExecClass did before: a stat and then a write, two calls with nothing held between them
+    int TwoStep()
+    {
+        SaOpContext ctx = { &req, 0, StoreCall };
+        if (cls_cxx_stat2(&ctx, nullptr, nullptr) == 0) {
+            return 0;
+        }
+        return cls_cxx_write(&ctx, 0, data.length(), &data);
+    }
+};
+
+struct RunResult {
+    SaBenchStat stat;
+    uint64_t calls { 0 };
+    uint64_t writes { 0 };
+    uint32_t rewritten { 0 };
+    uint32_t wrongData { 0 };
+};
+
+// every thread copies up every object in the same order, so first writes of the clients meet
+RunResult RunClients(bool guarded, uint32_t threads, uint32_t objects, uint32_t dataLen)
+{
+    g_store.objects.clear();
+    g_store.calls = 0;
+    vector<SaBenchStat> stats(threads);
+    vector<thread> workers;
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (uint32_t n = 0; n < objects; n++) {
+                string oid = ObjName(n);
+                CopyupOp op(oid, ParentData(oid, dataLen));
+                auto start = ceph::mono_clock::now();
+                int ret = guarded ? op.Guarded() : op.TwoStep();
+                auto us = chrono::duration_cast<chrono::microseconds>(ceph::mono_clock::now() - start).count();
+                stats[t].ops++;
+                stats[t].errors += (ret != 0);
+                stats[t].latUs.push_back(us);
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    RunResult r;
+    for (auto &s : stats) {
+        r.stat.Merge(s);
+    }
+    r.calls = g_store.calls;
+    for (uint32_t i = 0; i < objects; i++) {
+        string oid = ObjName(i);
+        auto it = g_store.objects.find(oid);
+        uint32_t writes = it == g_store.objects.end() ? 0 : it->second.writes;
+        r.writes += writes;
+        r.rewritten += (writes > 1);
+        r.wrongData += (writes == 0 || it->second.data != ParentData(oid, dataLen));
+    }
+    return r;
+}
+
+class SelfTest : public SaBenchSelfTest {
+public:
+    int Run()
+    {
+        const uint32_t threads = 8;
+        const uint32_t objects = 64;
+        CopyupExecutor &executor = GetCopyupExecutor();
+        g_store.latencyUs = 200;
+        uint64_t issuedBefore = executor.Issued();
+        uint64_t dedupedBefore = executor.Deduped();
+        RunResult r = RunClients(true, threads, objects, 4096);
+        Check(r.stat.errors == 0, "concurrent copyups succeed");
+        Check(r.writes == objects && r.rewritten == 0, "every object written exactly once");
+        Check(r.wrongData == 0, "objects hold the parent data");
+        Check(executor.Issued() - issuedBefore + executor.Deduped() - dedupedBefore == threads * objects,
+            "every copyup issued or deduped");
+        Check(r.calls == executor.Issued() - issuedBefore, "one global cache call per issued copyup");
+        Check(!executor.AnyPending(), "nothing left pending");
+
+        // the object exists now: no write, and still 0
+        string oid = ObjName(0);
+        Check(CopyupOp(oid, "other").Guarded() == 0, "copyup of an existing object");
+        Check(g_store.objects[oid].writes == 1 && g_store.objects[oid].data == ParentData(oid, 4096),
+            "existing object left as it was");
+
+        // a failed copyup neither writes nor sticks, the next one goes out again
+        g_store.latencyUs = 0;
+        g_store.failOid = "rbd_data.clone.bad";
+        Check(CopyupOp(g_store.failOid, "bad").Guarded() == -EIO, "write error returned");
+        Check(g_store.objects.count(g_store.failOid) == 0, "failed copyup wrote nothing");
+        string bad = g_store.failOid;
+        g_store.failOid.clear();
+        Check(CopyupOp(bad, "good").Guarded() == 0 && g_store.objects[bad].data == "good", "copyup after an error");
+
+        // ops of the object queued after the copyup wait until it is answered, others do not
+        string key = CopyupKey(POOL_ID, "rbd_data.clone.gate");
+        CopyupOp gate("rbd_data.clone.gate", "gate");
+        executor.Expect(key, gate.Token());
+        Check(executor.AnyPending(), "expected copyup pending");
+        executor.WaitIdle(CopyupKey(POOL_ID, oid));
+        atomic<bool> waited { false };
+        thread waiter([&]() {
+            executor.WaitIdle(key);
+            waited = true;
+        });
+        this_thread::sleep_for(chrono::milliseconds(20));
+        Check(!waited, "op on the object waits for its copyup");
+        Check(gate.Guarded() == 0, "gated copyup");
+        this_thread::sleep_for(chrono::milliseconds(20));
+        Check(!waited, "object held until the copyup op is answered");
+        executor.Release(gate.Token());
+        waiter.join();
+        Check(waited && !executor.AnyPending(), "answered copyup releases the object");
+
+        // a copyup op answered without running, rejected or failed early, leaves nothing behind
+        CopyupOp rejected("rbd_data.clone.rejected", "rejected");
+        executor.Expect(CopyupKey(POOL_ID, "rbd_data.clone.rejected"), rejected.Token());
+        executor.Release(rejected.Token());
+        executor.Release(rejected.Token());
+        Check(!executor.AnyPending(), "unrun copyup released");
+        executor.WaitIdle(CopyupKey(POOL_ID, "rbd_data.clone.rejected"));
+
+        return Result("copyup");
+    }
+};
+
+void Bench(uint32_t threads, uint32_t objects, uint32_t dataLen, uint32_t latencyUs)
+{
+    g_store.latencyUs = latencyUs;
+    printf("%-9s %10s %8s %8s %10s %10s %10s %10s\n", "mode", "copyups", "p50_us", "p99_us", "calls", "writes",
+        "rewritten", "ops/s");
+    for (bool guarded : { false, true }) {
+        auto start = ceph::mono_clock::now();
+        RunResult r = RunClients(guarded, threads, objects, dataLen);
+        double sec = chrono::duration<double>(ceph::mono_clock::now() - start).count();
+        printf("%-9s %10lu %8u %8u %10lu %10lu %10u %10.0f\n", guarded ? "guarded" : "two_step", r.stat.ops,
+            r.stat.Percentile(50), r.stat.Percentile(99), r.calls, r.writes, r.rewritten, r.stat.ops / sec);
+    }
+}
+}
+
+int main(int argc, const char **argv)
+{
+    SaExport sa;
+    SaBenchExportConf exportConf;
+    exportConf.logLevel = 1;
+    InitSalog(sa);
+    SaBenchExportStart(exportConf);
+
+    bool selftest = false;
+    uint32_t threads = 8;
+    uint32_t objects = 1024;
+    uint32_t dataLen = 65536;
+    uint32_t latencyUs = 100;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--selftest") {
+            selftest = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--objects" && i + 1 < argc) {
+            objects = atoi(argv[++i]);
+        } else if (arg == "--data-len" && i + 1 < argc) {
+            dataLen = atoi(argv[++i]);
+        } else if (arg == "--latency-us" && i + 1 < argc) {
+            latencyUs = atoi(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            Usage(cout);
+            return 0;
+        } else {
+            Usage(cerr);
+            return 2;
+        }
+    }
+
+    int ret = 0;
+    if (selftest) {
+        ret = SelfTest().Run();
+    } else {
+        Bench(max<uint32_t>(threads, 1), max<uint32_t>(objects, 1), dataLen, latencyUs);
+    }
+    SaBenchExportStop();
+    return ret;
+}
@@ -0,0 +1,286 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "messages/MOSDOp.h"
+#include "include/str_list.h"
+#include "include/stringify.h"
+#include "network_module.h"
+#include "salog.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+namespace {
+const uint64_t BYTES_PER_CASE = 8ULL << 30;
+const uint32_t MIN_ITERATIONS = 1000;
+const uint32_t MAX_ITERATIONS = 1000000;
+
+void Usage(ostream &out)
+{
+    out << "usage: sa_encode [options]\n"
+        "  --reads list        read sizes (4096,65536,4194304)\n"
+        "  --omap list         omap listing sizes in keys (100,10000)\n"
+        "  --key-len n         (32)\n"
+        "  --value-len n       (128)\n"
+        "  --iterations n      per case, 0 sizes it by bytes (0)\n";
+}
+
+bool ParseList(const string &val, vector<uint32_t> &out)
+{
+    out.clear();
+    vector<string> items;
+    get_str_vec(val, ",", items);
+    for (auto &s : items) {
+        uint32_t v = strtoul(s.c_str(), nullptr, 10);
+        if (v == 0) {
+            return false;
+        }
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+// bytes of the reply that do not point into the cache memory [base, base + len)
+uint64_t CopiedBytes(bufferlist &bl, const char *base, uint64_t len)
+{
+    uint64_t copied = 0;
+    for (auto &p : bl.buffers()) {
+        if (p.c_str() < base || p.c_str() >= base + len) {
+            copied += p.length();
+        }
+    }
+    return copied;
+}
+
+// the reply paths before zero-copy, kept for comparison
+void LegacyEncodeKv(const SaBatchKv *kv, bufferlist &out)
+{
+    map<string, bufferlist> m;
+    for (uint32_t j = 0; j < kv->kvNum; j++) {
+        bufferlist value;
+        string key(kv->keys[j].buf, kv->keys[j].len);
+        value.append(kv->values[j].buf, kv->values[j].len);
+        m.insert(make_pair(key, value));
+    }
+    encode(m, out);
+}
+
+uint32_t Iterations(uint32_t fixed, uint64_t bytes)
+{
+    if (fixed != 0) {
+        return fixed;
+    }
+    return std::min<uint64_t>(MAX_ITERATIONS, std::max<uint64_t>(MIN_ITERATIONS, BYTES_PER_CASE / bytes));
+}
+
+template <typename F>
+double NsPerOp(uint32_t iterations, F &&f)
+{
+    auto start = ceph::mono_clock::now();
+    for (uint32_t n = 0; n < iterations; n++) {
+        f();
+    }
+    return std::chrono::duration<double, std::nano>(ceph::mono_clock::now() - start).count() / iterations;
+}
+
+void PrintRow(const string &name, uint64_t size, uint32_t iterations, double ns, uint64_t copied)
+{
+    printf("%-20s %10lu %9u %12.0f %14lu\n", name.c_str(), size, iterations, ns, copied);
+}
+
+class EncodeBench {
+    MOSDOp *op;
+    uint32_t fixedIterations;
+    int failed { 0 };
+
+    bufferlist &Out()
+    {
+        return op->ops[0].outdata;
+    }
+
+    void Check(bool ok, const string &what)
+    {
+        if (!ok) {
+            cerr << "FAIL: " << what << std::endl;
+            failed++;
+        }
+    }
+
+public:
+    explicit EncodeBench(uint32_t iterations) : fixedIterations(iterations)
+    {
+        hobject_t hobj(object_t("sa_encode"), "", CEPH_NOSNAP, 0, 1, "");
+        op = new MOSDOp(0, 1, hobj, spg_t(pg_t(0, 1)), 1, CEPH_OSD_FLAG_ACK, CEPH_FEATURES_SUPPORTED_DEFAULT);
+        op->ops.resize(1);
+    }
+    ~EncodeBench()
+    {
+        op->put();
+    }
+
+    int Failed()
+    {
+        return failed;
+    }
+
+    void Read(uint32_t size)
+    {
+        string data(size, 'r');
+        char *buf = &data[0];
+        uint32_t iterations = Iterations(fixedIterations, size);
+        bufferlist expect;
+        EncodeRead(CEPH_OSD_OP_READ, 0, size, buf, size, 0, op);
+        expect.claim_append(Out());
+
+        double ns = NsPerOp(iterations, [&]() {
+            Out().clear();
+            EncodeRead(CEPH_OSD_OP_READ, 0, size, buf, size, 0, op);
+        });
+        PrintRow("read copy", size, iterations, ns, CopiedBytes(Out(), buf, size));
+
+        uint32_t released = 0;
+        auto release = [](void *arg) {
+            (*static_cast<uint32_t *>(arg))++;
+        };
+        ns = NsPerOp(iterations, [&]() {
+            Out().clear();
+            EncodeReadZeroCopy(CEPH_OSD_OP_READ, 0, size, buf, size, release, &released, 0, op);
+        });
+        PrintRow("read zero-copy", size, iterations, ns, CopiedBytes(Out(), buf, size));
+        Check(Out().contents_equal(expect), "zero-copy read reply differs at " + stringify(size));
+        Out().clear();
+        Check(released == iterations, "zero-copy read released " + stringify(released) + " of " +
+            stringify(iterations));
+
+        // sparse reads carry the extent map in front of the data
+        EncodeRead(CEPH_OSD_OP_SPARSE_READ, 0, size, buf, size, 0, op);
+        expect.clear();
+        expect.claim_append(Out());
+        EncodeReadZeroCopy(CEPH_OSD_OP_SPARSE_READ, 0, size, buf, size, release, &released, 0, op);
+        Check(Out().contents_equal(expect), "zero-copy sparse read reply differs at " + stringify(size));
+        Out().clear();
+    }
+
+    void Omap(uint32_t keys, uint32_t keyLen, uint32_t valueLen)
+    {
+        vector<string> keyData;
+        vector<string> valueData;
+        for (uint32_t j = 0; j < keys; j++) {
+            char name[32] = {0};
+            snprintf(name, sizeof(name), "key_%010u", j);
+            string k = name;
+            k.resize(std::max<size_t>(keyLen, k.size()), '_');
+            keyData.push_back(k);
+            valueData.push_back(string(valueLen, 'v'));
+        }
+        vector<SaStr> keyStr;
+        vector<SaStr> valueStr;
+        for (uint32_t j = 0; j < keys; j++) {
+            keyStr.push_back({ static_cast<uint32_t>(keyData[j].size()), &keyData[j][0] });
+            valueStr.push_back({ static_cast<uint32_t>(valueData[j].size()), &valueData[j][0] });
+        }
+        SaBatchKv kv = { keyStr.data(), valueStr.data(), keys };
+        uint64_t payload = static_cast<uint64_t>(keys) * (keyLen + valueLen);
+        uint32_t iterations = Iterations(fixedIterations, payload);
+
+        bufferlist expect;
+        LegacyEncodeKv(&kv, expect);
+        // every key and value is copied into the map, then again into the reply
+        double ns = NsPerOp(iterations, [&]() {
+            Out().clear();
+            LegacyEncodeKv(&kv, Out());
+        });
+        PrintRow("omap map", keys, iterations, ns, payload + Out().length());
+
+        ns = NsPerOp(iterations, [&]() {
+            Out().clear();
+            EncodeOmapGetvalsbykeys(&kv, 0, op);
+        });
+        PrintRow("omap direct", keys, iterations, ns, Out().length());
+        Check(Out().contents_equal(expect), "direct omap reply differs at " + stringify(keys));
+
+        // unsorted input with a duplicate still encodes like the map did
+        if (keys > 2) {
+            std::swap(keyStr[0], keyStr[keys - 1]);
+            keyStr[1] = keyStr[2];
+            expect.clear();
+            LegacyEncodeKv(&kv, expect);
+            Out().clear();
+            EncodeXattrGetXattrs(&kv, 0, op);
+            Check(Out().contents_equal(expect), "unsorted kv reply differs at " + stringify(keys));
+        }
+        Out().clear();
+    }
+};
+}
+
+int main(int argc, const char **argv)
+{
+    SaExport sa;
+    SaBenchExportConf exportConf;
+    exportConf.logLevel = 1;
+    InitSalog(sa);
+    SaBenchExportStart(exportConf);
+
+    vector<uint32_t> reads = { 4096, 65536, 4194304 };
+    vector<uint32_t> omaps = { 100, 10000 };
+    uint32_t keyLen = 32;
+    uint32_t valueLen = 128;
+    uint32_t iterations = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            Usage(cout);
+            return 0;
+        } else if (i + 1 >= argc) {
+            Usage(cerr);
+            return 2;
+        }
+        string val = argv[++i];
+        bool ok = true;
+        if (arg == "--reads") {
+            ok = ParseList(val, reads);
+        } else if (arg == "--omap") {
+            ok = ParseList(val, omaps);
+        } else if (arg == "--key-len") {
+            keyLen = atoi(val.c_str());
+        } else if (arg == "--value-len") {
+            valueLen = atoi(val.c_str());
+        } else if (arg == "--iterations") {
+            iterations = atoi(val.c_str());
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            cerr << "bad option " << arg << " " << val << std::endl;
+            Usage(cerr);
+            return 2;
+        }
+    }
+
+    EncodeBench bench(iterations);
+    printf("%-20s %10s %9s %12s %14s\n", "case", "size/keys", "ops", "ns/op", "copied_bytes/op");
+    for (uint32_t size : reads) {
+        bench.Read(size);
+    }
+    for (uint32_t keys : omaps) {
+        bench.Omap(keys, keyLen, valueLen);
+    }
+    SaBenchExportStop();
+    if (bench.Failed() != 0) {
+        printf("encode check failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,232 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string_view>
+
+#include "msg_module.h"
+#include "salog.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+namespace {
+const uint32_t DEFAULT_ITERATIONS = 1000000;
+
+void Usage(ostream &out)
+{
+    out << "usage: sa_op_args [options]\n"
+        "  --selftest          round trip every op type with typed args\n"
+        "  --iterations n      conversions timed per op type and mode (1000000)\n";
+}
+
+string_view View(const SaStr &s)
+{
+    return string_view(s.buf, s.len);
+}
+
+// client side encodings of the ops, as librados builds them
+OSDOp OmapList(int op, const string &startAfter, uint64_t maxReturn, const string &filterPrefix)
+{
+    OSDOp osdOp;
+    osdOp.op.op = op;
+    encode(startAfter, osdOp.indata);
+    encode(maxReturn, osdOp.indata);
+    if (op == CEPH_OSD_OP_OMAPGETVALS) {
+        encode(filterPrefix, osdOp.indata);
+    }
+    return osdOp;
+}
+
+OSDOp CmpXattr(const string &name, uint8_t cmpOp, uint8_t mode, const string &value, uint64_t u64Value)
+{
+    OSDOp osdOp;
+    osdOp.op.op = CEPH_OSD_OP_CMPXATTR;
+    osdOp.op.xattr.name_len = name.size();
+    osdOp.op.xattr.cmp_op = cmpOp;
+    osdOp.op.xattr.cmp_mode = mode;
+    osdOp.indata.append(name);
+    if (mode == CEPH_OSD_CMPXATTR_MODE_STRING) {
+        osdOp.op.xattr.value_len = value.size();
+        osdOp.indata.append(value);
+    } else {
+        osdOp.op.xattr.value_len = sizeof(u64Value);
+        encode(u64Value, osdOp.indata);
+    }
+    return osdOp;
+}
+
+OSDOp Rollback(uint64_t snapId)
+{
+    OSDOp osdOp;
+    osdOp.op.op = CEPH_OSD_OP_ROLLBACK;
+    osdOp.op.snap.snapid = snapId;
+    return osdOp;
+}
+
+OSDOp Call(const string &cls, const string &method, const string &input)
+{
+    OSDOp osdOp;
+    osdOp.op.op = CEPH_OSD_OP_CALL;
+    osdOp.op.cls.class_len = cls.size();
+    osdOp.op.cls.method_len = method.size();
+    osdOp.op.cls.indata_len = input.size();
+    osdOp.indata.append(cls);
+    osdOp.indata.append(method);
+    osdOp.indata.append(input);
+    return osdOp;
+}
+
+// rebuilds the client op from the typed args alone, so a round trip compares the wire bytes
+OSDOp FromArgs(const OpRequestOps &oneOp)
+{
+    const SaOpArgs &args = oneOp.args;
+    switch (args.type) {
+        case SA_OP_ARGS_OMAP_LIST:
+            return OmapList(oneOp.opSubType, string(View(args.u.omapList.startAfter)), args.u.omapList.maxReturn,
+                string(View(args.u.omapList.filterPrefix)));
+        case SA_OP_ARGS_CMPXATTR:
+            return CmpXattr(string(View(args.u.cmpXattr.name)), args.u.cmpXattr.cmpOp, args.u.cmpXattr.cmpMode,
+                string(View(args.u.cmpXattr.value)), args.u.cmpXattr.u64Value);
+        case SA_OP_ARGS_ROLLBACK:
+            return Rollback(args.u.rollback.snapId);
+        case SA_OP_ARGS_CALL:
+            return Call(string(View(args.u.call.className)), string(View(args.u.call.methodName)),
+                string(View(args.u.call.input)));
+        default:
+            return OSDOp();
+    }
+}
+
+int Convert(MsgModule &msg, OSDOp &osdOp, OpRequestOps &oneOp)
+{
+    OptionsType type = { 0, 0 };
+    OptionsLength length = { 0, 0 };
+    return msg.ConvertClientopToOpreq(osdOp, oneOp, type, length, 1);
+}
+
+struct Case {
+    string name;
+    std::function<OSDOp()> make;
+    SaOpArgsType type;
+    // keys/values the legacy layout holds for it
+    vector<string> legacyKeys;
+    vector<string> legacyValues;
+};
+
+vector<Case> Cases()
+{
+    string input(64, 'i');
+    return {
+        { "omap_get_vals", [] { return OmapList(CEPH_OSD_OP_OMAPGETVALS, "key_0042", 512, "key_"); },
+            SA_OP_ARGS_OMAP_LIST, { "start_after", "max_return", "filter_prefix" }, { "key_0042", "512", "key_" } },
+        { "omap_get_keys", [] { return OmapList(CEPH_OSD_OP_OMAPGETKEYS, "", UINT64_MAX, ""); },
+            SA_OP_ARGS_OMAP_LIST, { "start_after", "max_return" }, { "", to_string(UINT64_MAX) } },
+        { "cmpxattr_str", [] { return CmpXattr("lock", CEPH_OSD_CMPXATTR_OP_EQ, CEPH_OSD_CMPXATTR_MODE_STRING,
+            "owner_7", 0); }, SA_OP_ARGS_CMPXATTR, { "lock" }, { "owner_7" } },
+        { "cmpxattr_u64", [] { return CmpXattr("ver", CEPH_OSD_CMPXATTR_OP_GT, CEPH_OSD_CMPXATTR_MODE_U64, "",
+            1ULL << 40); }, SA_OP_ARGS_CMPXATTR, { "ver" }, {} },
+        { "rollback", [] { return Rollback(17); }, SA_OP_ARGS_ROLLBACK, { "snapid" }, { "17" } },
+        { "call", [input] { return Call("rbd", "get_size", input); }, SA_OP_ARGS_CALL, {}, {} },
+    };
+}
+
+class SelfTest : public SaBenchSelfTest {
+public:
+    int Run()
+    {
+        for (bool legacy : { true, false }) {
+            MsgModule msg;
+            msg.SetLegacyArgs(legacy);
+            for (auto &c : Cases()) {
+                string name = c.name + (legacy ? " legacy" : " typed");
+                OSDOp osdOp = c.make();
+                OpRequestOps oneOp;
+                Convert(msg, osdOp, oneOp);
+                Check(oneOp.args.version == SA_OP_ARGS_VERSION, name + " version");
+                Check(oneOp.args.type == c.type, name + " type");
+                OSDOp back = FromArgs(oneOp);
+                Check(back.op.op == osdOp.op.op && back.indata.contents_equal(osdOp.indata), name + " round trip");
+                Check(memcmp(&back.op, &osdOp.op, sizeof(back.op)) == 0, name + " op fields");
+                if (legacy) {
+                    // the xattr name is a key of its own, not a positional arg
+                    Check(oneOp.keys == c.legacyKeys && oneOp.values == c.legacyValues, name + " keys/values");
+                } else {
+                    bool nameOnly = c.type == SA_OP_ARGS_CMPXATTR && oneOp.keys.size() == 1 &&
+                        oneOp.values.empty() && oneOp.subops.empty() && oneOp.u64vals.empty();
+                    Check(nameOnly || (oneOp.keys.empty() && oneOp.values.empty()), name + " no legacy copies");
+                }
+            }
+            // copyup is still found from the typed class and method
+            OSDOp copyup = Call("rbd", "copyup", "data");
+            OpRequestOps oneOp;
+            Check(Convert(msg, copyup, oneOp) == 1, "copyup detected");
+        }
+        return Result("op args");
+    }
+};
+
+void Bench(uint32_t iterations)
+{
+    printf("%-14s %12s %12s\n", "op", "legacy_ns", "typed_ns");
+    for (auto &c : Cases()) {
+        double ns[2] = { 0, 0 };
+        for (int legacy = 1; legacy >= 0; legacy--) {
+            MsgModule msg;
+            msg.SetLegacyArgs(legacy == 1);
+            OSDOp osdOp = c.make();
+            auto start = ceph::mono_clock::now();
+            for (uint32_t n = 0; n < iterations; n++) {
+                OpRequestOps oneOp;
+                Convert(msg, osdOp, oneOp);
+            }
+            ns[legacy] = std::chrono::duration<double, std::nano>(ceph::mono_clock::now() - start).count() /
+                iterations;
+        }
+        printf("%-14s %12.1f %12.1f\n", c.name.c_str(), ns[1], ns[0]);
+    }
+}
+}
+
+int main(int argc, const char **argv)
+{
+    SaExport sa;
+    SaBenchExportConf exportConf;
+    exportConf.logLevel = 1;
+    InitSalog(sa);
+    SaBenchExportStart(exportConf);
+
+    bool selftest = false;
+    uint32_t iterations = DEFAULT_ITERATIONS;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--selftest") {
+            selftest = true;
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            Usage(cout);
+            return 0;
+        } else {
+            Usage(cerr);
+            return 2;
+        }
+    }
+
+    int ret = 0;
+    if (selftest) {
+        ret = SelfTest().Run();
+    } else {
+        Bench(std::max<uint32_t>(iterations, 1));
+    }
+    SaBenchExportStop();
+    return ret;
+}
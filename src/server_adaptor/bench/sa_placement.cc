@@ -0,0 +1,266 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#include "salog.h"
+#include "sa_bench.h"
+#include "thread_placement.h"
+
+using namespace std;
+
+namespace {
+void Usage(ostream &out)
+{
+    out << "usage: sa_placement [options]\n"
+        "  --sysfs-root dir   (/sys)\n"
+        "  --nic name         interface the placement follows\n"
+        "  --addr ip          or the interface holding this address\n"
+        "  --cores list       cpus the adaptor may use (all)\n"
+        "  --msgr n           messenger workers (3)\n"
+        "  --queues n         op queues (8)\n"
+        "  --ports n          listening ports, one ms_dispatch each (1)\n"
+        "  --selftest         check the planner against synthetic sysfs trees\n";
+}
+
+void MakeDirs(const string &path)
+{
+    for (size_t pos = path.find('/', 1); pos != string::npos; pos = path.find('/', pos + 1)) {
+        mkdir(path.substr(0, pos).c_str(), 0755);
+    }
+    mkdir(path.c_str(), 0755);
+}
+
+void WriteSys(const string &root, const string &file, const string &content)
+{
+    string path = root + "/" + file;
+    MakeDirs(path.substr(0, path.rfind('/')));
+    ofstream(path) << content << "\n";
+}
+
+int RemoveEntry(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+/*
+ * Synthetic tree of packages x cores x threads, numbered the way x86 does it:
+ * first threads of every core, then their siblings. One NUMA node per package
+ * unless noNuma; eth0 hangs off nicNode.
+ */
+string MakeTree(const string &base, const string &name, int packages, int cores, int threads, bool noNuma,
+    int nicNode)
+{
+    string root = base + "/" + name;
+    int perThread = packages * cores;
+    int total = perThread * threads;
+    WriteSys(root, "devices/system/cpu/online", "0-" + to_string(total - 1));
+    vector<string> nodeCpus(packages);
+    for (int c = 0; c < total; c++) {
+        int package = (c % perThread) / cores;
+        int core = c % cores;
+        string dir = "devices/system/cpu/cpu" + to_string(c) + "/topology/";
+        WriteSys(root, dir + "physical_package_id", to_string(package));
+        WriteSys(root, dir + "core_id", to_string(core));
+        nodeCpus[package] += (nodeCpus[package].empty() ? "" : ",") + to_string(c);
+    }
+    if (!noNuma) {
+        WriteSys(root, "devices/system/node/online", "0-" + to_string(packages - 1));
+        for (int n = 0; n < packages; n++) {
+            WriteSys(root, "devices/system/node/node" + to_string(n) + "/cpulist", nodeCpus[n]);
+        }
+    }
+    WriteSys(root, "class/net/eth0/device/numa_node", to_string(nicNode));
+    return root;
+}
+
+class SelfTest : public SaBenchSelfTest {
+    string base;
+
+    // the package and core of a cpu in MakeTree numbering
+    pair<int, int> CoreOf(int cpu, int packages, int cores)
+    {
+        int perThread = packages * cores;
+        return { (cpu % perThread) / cores, cpu % cores };
+    }
+
+public:
+    int Run()
+    {
+        char tmpl[] = "/tmp/sa_placement.XXXXXX";
+        if (mkdtemp(tmpl) == nullptr) {
+            cerr << "mkdtemp failed" << std::endl;
+            return 1;
+        }
+        base = tmpl;
+
+        vector<int> cpus;
+        Check(ParseCpuList("0-3,8-11\n", cpus) == 0 && cpus.size() == 8 && cpus[4] == 8, "parse cpu list");
+        cpus.clear();
+        Check(ParseCpuList("5-2", cpus) != 0, "reject reversed range");
+
+        TwoSockets();
+        NicNodeTooSmall();
+        NoNuma();
+        Oversubscribed();
+
+        nftw(base.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+        return Result("placement");
+    }
+
+    // 2 sockets x 4 cores x 2 threads, NIC on node 1, enough cpus for every thread
+    void TwoSockets()
+    {
+        string root = MakeTree(base, "two_sockets", 2, 4, 2, false, 1);
+        PlacementParam param;
+        param.sysRoot = root;
+        param.ifName = "eth0";
+        param.msgrNum = 3;
+        param.queueNum = 4;
+        ThreadPlacement p;
+        Check(p.Init(param) == 0, "two sockets init");
+        Check(p.GetNicNode() == 1, "two sockets NIC node");
+        set<int> used;
+        for (uint32_t w = 0; w < param.msgrNum; w++) {
+            int wc = p.GetCpus(PLACEMENT_MSGR_WORKER, w)[0];
+            Check(CoreOf(wc, 2, 4).first == 1, "worker on NIC package");
+            used.insert(wc);
+            for (uint32_t q = w; q < param.queueNum; q += param.msgrNum) {
+                int qc = p.GetCpus(PLACEMENT_QUEUE, q)[0];
+                Check(CoreOf(qc, 2, 4).first == 1, "queue on NIC package");
+                used.insert(qc);
+            }
+        }
+        Check(used.size() == param.msgrNum + param.queueNum, "one cpu per thread");
+        // worker 0 and its first queue share a physical core through SMT
+        Check(CoreOf(p.GetCpus(PLACEMENT_MSGR_WORKER, 0)[0], 2, 4) == CoreOf(p.GetCpus(PLACEMENT_QUEUE, 0)[0], 2, 4),
+            "worker and queue on sibling threads");
+        Check(p.GetCpus(PLACEMENT_DISPATCH, 0).size() == 8, "dispatch spans the NIC node");
+    }
+
+    // the allowed cpus hold fewer NIC node cpus than workers, so placement spills over
+    void NicNodeTooSmall()
+    {
+        string root = MakeTree(base, "too_small", 2, 4, 1, false, 1);
+        PlacementParam param;
+        param.sysRoot = root;
+        param.ifName = "eth0";
+        param.allowed = { 0, 1, 2, 3, 4 };
+        param.msgrNum = 3;
+        param.queueNum = 4;
+        ThreadPlacement p;
+        Check(p.Init(param) == 0, "too small init");
+        Check(p.GetCpus(PLACEMENT_MSGR_WORKER, 0)[0] == 4, "NIC node cpu goes first");
+        for (int c : p.GetCpus(PLACEMENT_DISPATCH, 0)) {
+            Check(c <= 4, "only allowed cpus");
+        }
+    }
+
+    // no node directory at all, as in many VMs
+    void NoNuma()
+    {
+        string root = MakeTree(base, "no_numa", 1, 8, 1, true, -1);
+        PlacementParam param;
+        param.sysRoot = root;
+        param.ifName = "eth0";
+        param.msgrNum = 3;
+        param.queueNum = 4;
+        ThreadPlacement p;
+        Check(p.Init(param) == 0, "no numa init");
+        Check(p.GetNicNode() == -1, "no numa NIC node unknown");
+        Check(p.GetCpus(PLACEMENT_DISPATCH, 0).size() == 8, "no numa uses every cpu");
+    }
+
+    // more threads than cpus, queues share their worker's slice of 1 or 2 cpus
+    void Oversubscribed()
+    {
+        string root = MakeTree(base, "oversubscribed", 1, 4, 1, false, 0);
+        PlacementParam param;
+        param.sysRoot = root;
+        param.ifName = "eth0";
+        param.msgrNum = 3;
+        param.queueNum = 8;
+        ThreadPlacement p;
+        Check(p.Init(param) == 0, "oversubscribed init");
+        for (uint32_t q = 0; q < param.queueNum; q++) {
+            int qc = p.GetCpus(PLACEMENT_QUEUE, q)[0];
+            int wc = p.GetCpus(PLACEMENT_MSGR_WORKER, q % param.msgrNum)[0];
+            Check(qc == wc || qc == wc + 1, "queue stays in its worker slice");
+        }
+        Check(p.GetCpus(PLACEMENT_QUEUE, 2)[0] == 3, "every cpu gets work");
+    }
+};
+}
+
+int main(int argc, const char **argv)
+{
+    SaExport sa;
+    SaBenchExportConf exportConf;
+    exportConf.logLevel = 1;
+    InitSalog(sa);
+    SaBenchExportStart(exportConf);
+
+    PlacementParam param;
+    param.queueNum = 8;
+    bool selftest = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        string val = (i + 1 < argc) ? argv[i + 1] : "";
+        if (arg == "--selftest") {
+            selftest = true;
+            continue;
+        } else if (arg == "-h" || arg == "--help") {
+            Usage(cout);
+            return 0;
+        } else if (i + 1 >= argc) {
+            Usage(cerr);
+            return 2;
+        }
+        i++;
+        if (arg == "--sysfs-root") {
+            param.sysRoot = val;
+        } else if (arg == "--nic") {
+            param.ifName = val;
+        } else if (arg == "--addr") {
+            param.ifName = GetIfNameByAddr(val);
+        } else if (arg == "--cores") {
+            ParseCpuList(val, param.allowed);
+        } else if (arg == "--msgr") {
+            param.msgrNum = atoi(val.c_str());
+        } else if (arg == "--queues") {
+            param.queueNum = atoi(val.c_str());
+        } else if (arg == "--ports") {
+            param.dispatchNum = atoi(val.c_str());
+        } else {
+            cerr << "unknown option " << arg << std::endl;
+            Usage(cerr);
+            return 2;
+        }
+    }
+
+    int ret = 0;
+    if (selftest) {
+        ret = SelfTest().Run();
+    } else {
+        ThreadPlacement p;
+        ret = p.Init(param);
+        if (ret == 0) {
+            printf("NIC %s node %d\n%s\n", param.ifName.c_str(), p.GetNicNode(), p.Dump().c_str());
+        } else {
+            fprintf(stderr, "placement failed %d\n", ret);
+            ret = 1;
+        }
+    }
+    SaBenchExportStop();
+    return ret;
+}
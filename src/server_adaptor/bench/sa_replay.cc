@@ -0,0 +1,493 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include <unistd.h>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+
+#include "common/address_helper.h"
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+#include "include/str_list.h"
+#include "global/global_init.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "network_module.h"
+#include "op_trace.h"
+#include "salog.h"
+#include "sa_bench.h"
+
+using namespace std;
+
+/*
+ * Re-issues an op trace recorded by the server adaptor (sa op_trace_path or
+ * sa_bench --op-trace). Every traced connection gets its own client, ops keep
+ * their per-connection order and are sent at their traced offset divided by
+ * --speed. Payloads that were not traced are filled to their traced length.
+ */
+
+namespace {
+const int REPLAY_KIND_OTHER = SA_BENCH_KIND_NUM;
+const int REPLAY_KIND_NUM = SA_BENCH_KIND_NUM + 1;
+const uint32_t DRAIN_WAIT_SEC = 30;
+const uint32_t NO_LATENCY = UINT32_MAX;
+
+struct ReplayOp {
+    OpTraceOp rec;
+    int kind { REPLAY_KIND_OTHER };
+    uint32_t tracedUs { NO_LATENCY };
+    int32_t tracedResult { 0 };
+    uint32_t replayUs { NO_LATENCY };
+    int32_t replayResult { 0 };
+};
+
+struct ReplayConf {
+    string addr { "127.0.0.1" };
+    vector<string> ports;
+    double speed { 1.0 };
+    uint32_t depth { 64 };
+};
+
+const char *ReplayKindName(int kind)
+{
+    return kind == REPLAY_KIND_OTHER ? "other" : SaBenchKindName(kind);
+}
+
+int ClassifyOp(const OpTraceOp &rec)
+{
+    if (rec.ops.empty()) {
+        return REPLAY_KIND_OTHER;
+    }
+    uint16_t op = rec.ops[0].op.op;
+    switch (op) {
+        case CEPH_OSD_OP_CALL:
+            return SA_BENCH_CALL;
+        case CEPH_OSD_OP_OMAPGETKEYS:
+        case CEPH_OSD_OP_OMAPGETVALS:
+        case CEPH_OSD_OP_OMAPGETHEADER:
+        case CEPH_OSD_OP_OMAPGETVALSBYKEYS:
+            return SA_BENCH_OMAP_GET;
+        case CEPH_OSD_OP_OMAPSETVALS:
+        case CEPH_OSD_OP_OMAPSETHEADER:
+        case CEPH_OSD_OP_OMAPCLEAR:
+        case CEPH_OSD_OP_OMAPRMKEYS:
+            return SA_BENCH_OMAP_SET;
+        default:
+            break;
+    }
+    if (ceph_osd_op_type_data(op)) {
+        return ceph_osd_op_mode_modify(op) ? SA_BENCH_WRITE : SA_BENCH_READ;
+    }
+    return REPLAY_KIND_OTHER;
+}
+
+class SaReplayConnection : public Dispatcher {
+    const ReplayConf &conf;
+    uint32_t index;
+    vector<ReplayOp *> ops;
+    Messenger *msgr { nullptr };
+    ConnectionRef conn;
+    std::thread sender;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    map<ceph_tid_t, pair<ReplayOp *, ceph::mono_time>> inflight;
+    ceph_tid_t lastTid { 0 };
+    uint64_t lost { 0 };
+
+    MOSDOp *BuildOp(const OpTraceOp &rec)
+    {
+        object_t oid(rec.oid);
+        hobject_t hobj(oid, "", CEPH_NOSNAP, rec.hash, rec.pool, rec.nspace);
+        spg_t pgid(pg_t(rec.pgSeed, rec.pool));
+        MOSDOp *m = new MOSDOp(0, ++lastTid, hobj, pgid, 1, rec.flags, CEPH_FEATURES_SUPPORTED_DEFAULT);
+        m->set_mtime(ceph::real_clock::now());
+        for (auto &sub : rec.ops) {
+            OSDOp osdop;
+            osdop.op = sub.op;
+            osdop.indata = sub.indata;
+            if (!sub.hasIndata && sub.indataLen > osdop.indata.length()) {
+                osdop.indata.append_zero(sub.indataLen - osdop.indata.length());
+            }
+            m->ops.push_back(osdop);
+        }
+        return m;
+    }
+
+    void SendLoop(ceph::mono_time start)
+    {
+        std::unique_lock<std::mutex> l(lock);
+        for (auto op : ops) {
+            if (conf.speed > 0) {
+                auto due = start + std::chrono::nanoseconds(static_cast<uint64_t>(op->rec.tsNs / conf.speed));
+                while (ceph::mono_clock::now() < due) {
+                    cond.wait_until(l, due);
+                }
+            }
+            while (inflight.size() >= conf.depth) {
+                cond.wait(l);
+            }
+            MOSDOp *m = BuildOp(op->rec);
+            inflight[m->get_tid()] = { op, ceph::mono_clock::now() };
+            l.unlock();
+            conn->send_message(m);
+            l.lock();
+        }
+        auto drainEnd = ceph::mono_clock::now() + std::chrono::seconds(DRAIN_WAIT_SEC);
+        while (!inflight.empty() && ceph::mono_clock::now() < drainEnd) {
+            cond.wait_until(l, drainEnd);
+        }
+        lost = inflight.size();
+        inflight.clear();
+    }
+
+public:
+    SaReplayConnection(CephContext *cct, const ReplayConf &c, uint32_t i) : Dispatcher(cct), conf(c), index(i) {}
+    ~SaReplayConnection() override
+    {
+        if (msgr) {
+            delete msgr;
+        }
+    }
+
+    void AddOp(ReplayOp *op)
+    {
+        ops.push_back(op);
+    }
+
+    uint64_t GetLost()
+    {
+        return lost;
+    }
+
+    int Start(DummyAuthClientServer &auth)
+    {
+        msgr = Messenger::create(cct, cct->_conf.get_val<std::string>("ms_type"), entity_name_t::CLIENT(-1),
+            "sa_replay_client", getpid() + index, 0);
+        msgr->set_default_policy(Messenger::Policy::lossy_client(CEPH_FEATURE_OSDREPLYMUX));
+        msgr->set_auth_client(&auth);
+        msgr->set_magic(MSG_MAGIC_TRACE_CTR);
+        msgr->add_dispatcher_head(this);
+        msgr->start();
+
+        entity_addr_t addr;
+        string dest = "tcp://" + conf.addr + ":" + conf.ports[index % conf.ports.size()];
+        if (!entity_addr_from_url(&addr, dest.c_str())) {
+            fprintf(stderr, "bad server address %s\n", dest.c_str());
+            return -EINVAL;
+        }
+        addr.set_type(entity_addr_t::TYPE_MSGR2);
+        conn = msgr->connect_to_osd(entity_addrvec_t(addr));
+        return 0;
+    }
+
+    void Run(ceph::mono_time start)
+    {
+        sender = std::thread([this, start]() {
+            pthread_setname_np(pthread_self(), "sa_replay_send");
+            SendLoop(start);
+        });
+    }
+
+    void Join()
+    {
+        if (sender.joinable()) {
+            sender.join();
+        }
+    }
+
+    void Stop()
+    {
+        if (conn) {
+            conn->mark_down();
+            conn.reset();
+        }
+        if (msgr) {
+            msgr->shutdown();
+            msgr->wait();
+        }
+    }
+
+    bool ms_can_fast_dispatch_any() const override
+    {
+        return true;
+    }
+    bool ms_can_fast_dispatch(const Message *m) const override
+    {
+        return m->get_type() == CEPH_MSG_OSD_OPREPLY;
+    }
+    void ms_fast_dispatch(Message *m) override
+    {
+        MOSDOpReply *reply = static_cast<MOSDOpReply *>(m);
+        auto now = ceph::mono_clock::now();
+        std::lock_guard<std::mutex> l(lock);
+        auto it = inflight.find(reply->get_tid());
+        if (it != inflight.end()) {
+            ReplayOp *op = it->second.first;
+            op->replayUs = std::chrono::duration_cast<std::chrono::microseconds>(now - it->second.second).count();
+            op->replayResult = reply->get_result();
+            inflight.erase(it);
+            cond.notify_one();
+        }
+        m->put();
+    }
+    bool ms_dispatch(Message *m) override
+    {
+        if (ms_can_fast_dispatch(m)) {
+            ms_fast_dispatch(m);
+            return true;
+        }
+        m->put();
+        return true;
+    }
+    void ms_handle_connect(Connection *con) override {};
+    void ms_handle_accept(Connection *con) override {};
+    bool ms_handle_reset(Connection *con) override
+    {
+        fprintf(stderr, "replay connection %u reset by server\n", index);
+        return true;
+    }
+    void ms_handle_remote_reset(Connection *con) override {};
+    bool ms_handle_refused(Connection *con) override
+    {
+        return false;
+    }
+};
+
+void Usage(ostream &out)
+{
+    out << "usage: sa_replay --trace file [options]\n"
+        "  --speed x              1 replays at traced pace, 2 twice as fast, 0 as fast as possible (1)\n"
+        "  --depth n              max in flight ops per connection (64)\n"
+        "  --remote addr          replay against a running server adaptor instead of an in-process one\n"
+        "  --ports p1,p2          server ports, connections are spread over them (16001)\n"
+        "in-process server adaptor, same as sa_bench:\n"
+        "  --queues n --queue-capacity n --msgr n\n"
+        "  --sa-latency-us n --sa-jitter-us n --sa-complete-threads n --sa-log-level n\n"
+        "regression gate, exit 1 when missed:\n"
+        "  --max-p99-delta-us n   replay p99 minus traced p99\n";
+}
+
+int LoadTrace(const string &path, vector<std::unique_ptr<ReplayOp>> &ops, uint64_t &replies)
+{
+    OpTraceReader reader;
+    int ret = reader.Open(path);
+    if (ret < 0) {
+        return ret;
+    }
+    map<pair<uint32_t, uint64_t>, ReplayOp *> waiting;
+    uint8_t type = 0;
+    OpTraceOp rec;
+    OpTraceReply reply;
+    while ((ret = reader.Next(type, rec, reply)) > 0) {
+        if (type == OP_TRACE_RECORD_OP) {
+            ops.emplace_back(new ReplayOp());
+            ReplayOp *op = ops.back().get();
+            op->rec = rec;
+            op->kind = ClassifyOp(rec);
+            waiting[{ rec.connId, rec.tid }] = op;
+            continue;
+        }
+        auto it = waiting.find({ reply.connId, reply.tid });
+        if (it != waiting.end() && reply.tsNs >= it->second->rec.tsNs) {
+            it->second->tracedUs = (reply.tsNs - it->second->rec.tsNs) / 1000;
+            it->second->tracedResult = reply.result;
+            waiting.erase(it);
+            replies++;
+        }
+    }
+    if (ret < 0) {
+        // a trace cut by a crash ends with a partial record, replay what is whole
+        fprintf(stderr, "trace %s is damaged after %lu ops (%d), replaying them\n", path.c_str(), ops.size(), ret);
+    }
+    return 0;
+}
+
+void PrintKind(const char *name, SaBenchStat &traced, SaBenchStat &replay, uint64_t mismatch)
+{
+    long d50 = static_cast<long>(replay.Percentile(50)) - traced.Percentile(50);
+    long d99 = static_cast<long>(replay.Percentile(99)) - traced.Percentile(99);
+    printf("%-9s %10lu %7lu %8lu %10u %10u %8ld %10u %10u %8ld\n", name, replay.ops, replay.errors, mismatch,
+        traced.Percentile(50), replay.Percentile(50), d50, traced.Percentile(99), replay.Percentile(99), d99);
+}
+}
+
+int main(int argc, const char **argv)
+{
+    vector<const char *> args;
+    argv_to_vec(argc, argv, args);
+    auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY,
+        CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+    ReplayConf conf;
+    SaBenchServerConf serverConf;
+    SaBenchExportConf exportConf;
+    string tracePath;
+    string ports = "16001";
+    bool remote = false;
+    uint64_t maxP99Delta = 0;
+    string val;
+    for (auto i = args.begin(); i != args.end();) {
+        if (ceph_argparse_witharg(args, i, &val, "--trace", (char *)nullptr)) {
+            tracePath = val;
+        } else if (ceph_argparse_witharg(args, i, &val, "--speed", (char *)nullptr)) {
+            conf.speed = atof(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--depth", (char *)nullptr)) {
+            conf.depth = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--remote", (char *)nullptr)) {
+            conf.addr = val;
+            remote = true;
+        } else if (ceph_argparse_witharg(args, i, &val, "--ports", (char *)nullptr)) {
+            ports = val;
+        } else if (ceph_argparse_witharg(args, i, &val, "--queues", (char *)nullptr)) {
+            serverConf.queues = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--queue-capacity", (char *)nullptr)) {
+            serverConf.capacity = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--msgr", (char *)nullptr)) {
+            serverConf.msgrNum = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-latency-us", (char *)nullptr)) {
+            exportConf.latencyUs = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-jitter-us", (char *)nullptr)) {
+            exportConf.jitterUs = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-complete-threads", (char *)nullptr)) {
+            exportConf.completeThreads = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--sa-log-level", (char *)nullptr)) {
+            exportConf.logLevel = atoi(val.c_str());
+        } else if (ceph_argparse_witharg(args, i, &val, "--max-p99-delta-us", (char *)nullptr)) {
+            maxP99Delta = strtoull(val.c_str(), nullptr, 10);
+        } else if (ceph_argparse_flag(args, i, "-h", "--help", (char *)nullptr)) {
+            Usage(cout);
+            return 0;
+        } else {
+            cerr << "unknown option " << *i << std::endl;
+            Usage(cerr);
+            return 2;
+        }
+    }
+    get_str_vec(ports, ",", conf.ports);
+    if (tracePath.empty() || conf.ports.empty() || conf.depth == 0 || conf.speed < 0) {
+        Usage(cerr);
+        return 2;
+    }
+
+    vector<std::unique_ptr<ReplayOp>> ops;
+    uint64_t replies = 0;
+    int ret = LoadTrace(tracePath, ops, replies);
+    if (ret < 0) {
+        cerr << "can not read trace " << tracePath << ": " << cpp_strerror(ret) << std::endl;
+        return 1;
+    }
+    printf("trace %s: %lu ops, %lu with a traced reply\n", tracePath.c_str(), ops.size(), replies);
+    if (ops.empty()) {
+        return 0;
+    }
+
+    SaExport sa;
+    NetworkModule *network = nullptr;
+    if (!remote) {
+        g_conf().set_val("ms_async_op_threads", to_string(serverConf.msgrNum));
+        g_conf().apply_changes(nullptr);
+        InitSalog(sa);
+        SaBenchExportStart(exportConf);
+        serverConf.addr = conf.addr;
+        serverConf.ports = conf.ports;
+        network = SaBenchServerStart(sa, serverConf);
+        if (network == nullptr) {
+            cerr << "server adaptor failed to start on " << ports << std::endl;
+            return 1;
+        }
+    }
+
+    DummyAuthClientServer dummyAuth(g_ceph_context);
+    dummyAuth.auth_registry.refresh_config();
+    map<uint32_t, std::unique_ptr<SaReplayConnection>> conns;
+    for (auto &op : ops) {
+        auto it = conns.find(op->rec.connId);
+        if (it == conns.end()) {
+            it = conns.emplace(op->rec.connId,
+                std::make_unique<SaReplayConnection>(g_ceph_context, conf, conns.size())).first;
+        }
+        it->second->AddOp(op.get());
+    }
+    for (auto &c : conns) {
+        if (c.second->Start(dummyAuth) != 0) {
+            return 1;
+        }
+    }
+
+    auto start = ceph::mono_clock::now();
+    for (auto &c : conns) {
+        c.second->Run(start);
+    }
+    uint64_t lost = 0;
+    for (auto &c : conns) {
+        c.second->Join();
+        lost += c.second->GetLost();
+    }
+    double sec = std::chrono::duration<double>(ceph::mono_clock::now() - start).count();
+    size_t connNum = conns.size();
+    for (auto &c : conns) {
+        c.second->Stop();
+    }
+    conns.clear();
+    if (network != nullptr) {
+        SaBenchExportStop();
+        SaBenchServerStop(network);
+    }
+
+    // latency deltas only compare ops that got a reply both times
+    SaBenchStat traced[REPLAY_KIND_NUM];
+    SaBenchStat replay[REPLAY_KIND_NUM];
+    uint64_t mismatch[REPLAY_KIND_NUM] = { 0 };
+    for (auto &op : ops) {
+        if (op->replayUs == NO_LATENCY) {
+            continue;
+        }
+        SaBenchStat &r = replay[op->kind];
+        r.ops++;
+        if (op->replayResult < 0) {
+            r.errors++;
+        }
+        if (op->tracedUs == NO_LATENCY) {
+            continue;
+        }
+        if ((op->replayResult < 0) != (op->tracedResult < 0)) {
+            mismatch[op->kind]++;
+        }
+        r.latUs.push_back(op->replayUs);
+        traced[op->kind].ops++;
+        traced[op->kind].latUs.push_back(op->tracedUs);
+    }
+
+    printf("replayed %lu connections in %.2fs, speed %.2f, %lu ops never replied\n", connNum, sec, conf.speed, lost);
+    printf("%-9s %10s %7s %8s %10s %10s %8s %10s %10s %8s\n", "op", "ops", "errors", "mismatch", "trace_p50",
+        "replay_p50", "d_p50", "trace_p99", "replay_p99", "d_p99");
+    SaBenchStat tracedTotal;
+    SaBenchStat replayTotal;
+    uint64_t mismatchTotal = 0;
+    for (int kind = 0; kind < REPLAY_KIND_NUM; kind++) {
+        if (replay[kind].ops != 0) {
+            PrintKind(ReplayKindName(kind), traced[kind], replay[kind], mismatch[kind]);
+        }
+        tracedTotal.Merge(traced[kind]);
+        replayTotal.Merge(replay[kind]);
+        mismatchTotal += mismatch[kind];
+    }
+    PrintKind("total", tracedTotal, replayTotal, mismatchTotal);
+
+    ret = 0;
+    if (lost != 0) {
+        cerr << "FAIL: " << lost << " ops never replied" << std::endl;
+        ret = 1;
+    }
+    long d99 = static_cast<long>(replayTotal.Percentile(99)) - tracedTotal.Percentile(99);
+    if (maxP99Delta != 0 && d99 > static_cast<long>(maxP99Delta)) {
+        cerr << "FAIL: p99 delta " << d99 << "us > " << maxP99Delta << "us" << std::endl;
+        ret = 1;
+    }
+    return ret;
+}
@@ -9,37 +9,115 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <unordered_map>
 #include <messages/MOSDOp.h>
 
+#include "common/ceph_time.h"
+
+enum OpLaneType {
+    OP_LANE_DATA = 0,
+    OP_LANE_META,
+    OP_LANE_NUM,
+};
+
+/* metaWeight 0 keeps a single FIFO lane */
+struct OpLanePolicy {
+    uint32_t metaWeight { 0 };
+    uint32_t dataWeight { 1 };
+    uint32_t starveMs { 50 };
+};
+
 class ClientOpQueue {
+    struct LaneOp {
+        MOSDOp *op;
+        uint64_t ts;
+        uint64_t period;
+        size_t objHash;
+        ceph::coarse_mono_time enqueued;
+    };
+    struct ObjLane {
+        int lane;
+        uint32_t count;
+    };
+
+    std::queue<LaneOp> lanes[OP_LANE_NUM];
+    // lane of the objects with queued ops, later ops follow them so per-object order holds
+    std::unordered_map<size_t, ObjLane> objLanes;
+
+    void Take(int lane, size_t n, bool track, std::queue<MOSDOp *> &ops, std::queue<uint64_t> &ts,
+        std::queue<uint64_t> &period)
+    {
+        for (size_t i = 0; i < n; i++) {
+            LaneOp &e = lanes[lane].front();
+            ops.push(e.op);
+            ts.push(e.ts);
+            period.push(e.period);
+            if (track) {
+                auto it = objLanes.find(e.objHash);
+                if (it != objLanes.end() && --it->second.count == 0) {
+                    objLanes.erase(it);
+                }
+            }
+            lanes[lane].pop();
+        }
+    }
+
 public:
     ClientOpQueue() {};
     ~ClientOpQueue() {};
 
     std::mutex opQueueMutex;
     std::condition_variable cond {};
-    std::queue<MOSDOp *> reqQueue;
-    std::queue<uint64_t> tsQueue;
-    std::queue<uint64_t> period;
-    void EnQueue(MOSDOp *opReq, uint64_t ts , uint64_t p)
+    void EnQueue(MOSDOp *opReq, uint64_t ts , uint64_t p, int lane = OP_LANE_DATA, size_t objHash = 0,
+        bool track = false)
     {
-        reqQueue.push(opReq);
-	tsQueue.push(ts);
-	period.push(p);
+        if (track) {
+            auto it = objLanes.find(objHash);
+            if (it == objLanes.end()) {
+                objLanes[objHash] = { lane, 1 };
+            } else {
+                lane = it->second.lane;
+                it->second.count++;
+            }
+        }
+        lanes[lane].push({ opReq, ts, p, objHash, track ? ceph::coarse_mono_clock::now() : ceph::coarse_mono_time() });
         condOpReq.notify_all();
     }
-    void DeQueue();
+
+    /*
+     * Moves the next round of ops out, metadata lane first. A round is up to
+     * metaWeight metadata ops and dataWeight data ops; an idle lane gives its
+     * share to the other, and a data head older than starveMs takes the whole
+     * data lane so bulk IO cannot starve.
+     */
+    void DeQueueRound(const OpLanePolicy &policy, std::queue<MOSDOp *> &ops, std::queue<uint64_t> &ts,
+        std::queue<uint64_t> &period)
+    {
+        std::queue<LaneOp> &meta = lanes[OP_LANE_META];
+        std::queue<LaneOp> &data = lanes[OP_LANE_DATA];
+        bool track = policy.metaWeight != 0;
+        size_t metaTake = meta.size();
+        size_t dataTake = data.size();
+        if (track && metaTake != 0 && dataTake != 0) {
+            metaTake = std::min<size_t>(metaTake, policy.metaWeight);
+            if (ceph::coarse_mono_clock::now() - data.front().enqueued < std::chrono::milliseconds(policy.starveMs)) {
+                dataTake = std::min<size_t>(dataTake, policy.dataWeight);
+            }
+        }
+        Take(OP_LANE_META, metaTake, track, ops, ts, period);
+        Take(OP_LANE_DATA, dataTake, track, ops, ts, period);
+    }
+
     bool Empty()
     {
-        return reqQueue.empty();
+        return lanes[OP_LANE_DATA].empty() && lanes[OP_LANE_META].empty();
     }
 
     size_t GetSize()
     {
-	return reqQueue.size();
+	return lanes[OP_LANE_DATA].size() + lanes[OP_LANE_META].size();
     }
 
     std::condition_variable condOpReq;
 };
 #endif
-
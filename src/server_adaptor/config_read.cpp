@@ -29,6 +29,11 @@
 #define CPU_NUM_96 (96)
 #define CPU_NUM_128 (128)
 #define MAX_CPU_NUM (256)
+#define DEFAULT_TRACE_MAX_MB (1024)
+#define DEFAULT_LANE_DATA_WEIGHT (1)
+#define DEFAULT_LANE_STARVE_MS (50)
+#define DEFAULT_BATCH_MAX_OPS (1)
+#define DEFAULT_OP_ARGS_LEGACY (1)
 
 #ifndef RETURN_OK
 #define RETURN_OK 0
@@ -52,6 +57,18 @@ typedef struct {
 	uint64_t getQuotaCyc{0};
 	uint64_t getMessengerThrottle {0};
 	uint64_t saOpThrottle{ 0 };
+
+	char opTracePath[MAX_TRACE_PATH_LEN];
+	uint64_t opTraceMaxMb { 0 };
+	uint64_t opTracePayloadHash { 0 };
+	uint64_t autoPlacement { 0 };
+	uint64_t queueAffinity { 0 };
+	uint64_t laneMetaWeight { 0 };
+	uint64_t laneDataWeight { 0 };
+	uint64_t laneStarveMs { 0 };
+	uint64_t batchMaxOps { 0 };
+	uint64_t batchLingerUs { 0 };
+	uint64_t opArgsLegacy { 0 };
 } SA_ClusterControlCfg;
 
 SA_ClusterControlCfg g_SaClusterControlCfg = { 0 };
@@ -138,6 +155,45 @@ static int32_t ReadConfig()
 	GET_CFG_ITEM_U64(&g_SaClusterControlCfg.getMessengerThrottle, "sa", "enable_messenger_throttle");
 	GET_CFG_ITEM_U64(&g_SaClusterControlCfg.saOpThrottle, "sa", "sa_op_throttle");
 #undef GET_CFG_ITEM_U64
+	// op trace is optional, a missing key leaves it off
+	if (GetCfgItemCstr(g_SaClusterControlCfg.opTracePath, MAX_TRACE_PATH_LEN, "sa", "op_trace_path") != RETURN_OK) {
+		g_SaClusterControlCfg.opTracePath[0] = '\0';
+	}
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.opTraceMaxMb, "sa", "op_trace_max_mb") != RETURN_OK) {
+		g_SaClusterControlCfg.opTraceMaxMb = DEFAULT_TRACE_MAX_MB;
+	}
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.opTracePayloadHash, "sa", "op_trace_payload_hash") != RETURN_OK) {
+		g_SaClusterControlCfg.opTracePayloadHash = 0;
+	}
+	// 1 places threads by cpu/NUMA topology instead of the bind_core order
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.autoPlacement, "sa", "auto_placement") != RETURN_OK) {
+		g_SaClusterControlCfg.autoPlacement = 0;
+	}
+	// 1 lets each messenger worker enqueue into its own queues
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.queueAffinity, "sa", "queue_affinity") != RETURN_OK) {
+		g_SaClusterControlCfg.queueAffinity = 0;
+	}
+	// metadata lane weight 0 keeps one FIFO per queue
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.laneMetaWeight, "sa", "lane_meta_weight") != RETURN_OK) {
+		g_SaClusterControlCfg.laneMetaWeight = 0;
+	}
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.laneDataWeight, "sa", "lane_data_weight") != RETURN_OK) {
+		g_SaClusterControlCfg.laneDataWeight = DEFAULT_LANE_DATA_WEIGHT;
+	}
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.laneStarveMs, "sa", "lane_starve_ms") != RETURN_OK) {
+		g_SaClusterControlCfg.laneStarveMs = DEFAULT_LANE_STARVE_MS;
+	}
+	// one op per DoOneOps call unless batching is configured
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.batchMaxOps, "sa", "batch_max_ops") != RETURN_OK) {
+		g_SaClusterControlCfg.batchMaxOps = DEFAULT_BATCH_MAX_OPS;
+	}
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.batchLingerUs, "sa", "batch_linger_us") != RETURN_OK) {
+		g_SaClusterControlCfg.batchLingerUs = 0;
+	}
+	// global cache builds reading only the typed op args can turn the string copies off
+	if (GetCfgItemUint64(&g_SaClusterControlCfg.opArgsLegacy, "sa", "op_args_legacy") != RETURN_OK) {
+		g_SaClusterControlCfg.opArgsLegacy = DEFAULT_OP_ARGS_LEGACY;
+	}
 	return ret;
 }
 
@@ -203,4 +259,59 @@ uint32_t OsaConfigRead::GetMessengerThrottle()
 uint64_t OsaConfigRead::GetSaOpThrottle()
 {
 	return g_SaClusterControlCfg.saOpThrottle;
-}
\ No newline at end of file
+}
+
+char *OsaConfigRead::GetOpTracePath()
+{
+	return g_SaClusterControlCfg.opTracePath;
+}
+
+uint64_t OsaConfigRead::GetOpTraceMaxMb()
+{
+	return g_SaClusterControlCfg.opTraceMaxMb;
+}
+
+uint32_t OsaConfigRead::GetOpTracePayloadHash()
+{
+	return g_SaClusterControlCfg.opTracePayloadHash;
+}
+
+uint32_t OsaConfigRead::GetAutoPlacement()
+{
+	return g_SaClusterControlCfg.autoPlacement;
+}
+
+uint32_t OsaConfigRead::GetQueueAffinity()
+{
+	return g_SaClusterControlCfg.queueAffinity;
+}
+
+uint32_t OsaConfigRead::GetLaneMetaWeight()
+{
+	return g_SaClusterControlCfg.laneMetaWeight;
+}
+
+uint32_t OsaConfigRead::GetLaneDataWeight()
+{
+	return g_SaClusterControlCfg.laneDataWeight;
+}
+
+uint32_t OsaConfigRead::GetLaneStarveMs()
+{
+	return g_SaClusterControlCfg.laneStarveMs;
+}
+
+uint32_t OsaConfigRead::GetBatchMaxOps()
+{
+	return g_SaClusterControlCfg.batchMaxOps;
+}
+
+uint32_t OsaConfigRead::GetBatchLingerUs()
+{
+	return g_SaClusterControlCfg.batchLingerUs;
+}
+
+uint32_t OsaConfigRead::GetOpArgsLegacy()
+{
+	return g_SaClusterControlCfg.opArgsLegacy;
+}
@@ -27,6 +27,7 @@
 #define MAX_XNET_CORE 4
 #define MAX_DPSHM_CORE 8
 #define ZK_SERVER_LIST_STR_LEN 128
+#define MAX_TRACE_PATH_LEN 256
 
 class OsaConfigRead {
 public:
@@ -45,6 +46,21 @@ public:
     uint32_t GetQuotCyc();
     uint32_t GetMessengerThrottle();
     uint64_t GetSaOpThrottle();
+
+    char *GetOpTracePath();
+    uint64_t GetOpTraceMaxMb();
+    uint32_t GetOpTracePayloadHash();
+
+    uint32_t GetAutoPlacement();
+    uint32_t GetQueueAffinity();
+
+    uint32_t GetLaneMetaWeight();
+    uint32_t GetLaneDataWeight();
+    uint32_t GetLaneStarveMs();
+
+    uint32_t GetBatchMaxOps();
+    uint32_t GetBatchLingerUs();
+    uint32_t GetOpArgsLegacy();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,338 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "config_reload.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+#include "common/errno.h"
+#include "global/global_context.h"
+#include "network_module.h"
+#include "salog.h"
+
+using namespace std;
+
+extern "C" {
+int GetCfgItemCstr(char *dest, size_t destSize, const char *unit, const char *key);
+}
+
+namespace {
+const string LOG_TYPE = "SA_CONF";
+const string RELOAD_COMMAND = "sa config reload";
+const uint32_t SA_QUEUE_MAX_CAPACITY = 1024;
+const uint32_t SA_QUEUE_MIN_CAPACITY = 1;
+const uint64_t SA_OP_THROTTLE_MIN = 2000;
+const uint64_t SA_OP_THROTTLE_MAX = 30000;
+// editors write in several steps, wait for the file to settle before reading it
+const int RELOAD_DEBOUNCE_MS = 200;
+const size_t INOTIFY_BUF_LEN = 4096;
+const size_t CONF_VALUE_LEN = 1024;
+
+const char *LIVE_KEYS[] = {
+    "sa.write_qos",
+    "sa.get_quota_cyc",
+    "sa.sa_op_throttle",
+    "sa.queue_max_capacity",
+};
+
+const char *RESTART_KEYS[] = {
+    "communicate.public_ipv4_addr",
+    "communicate.local_port",
+    "sa.core_number_64",
+    "sa.core_number_96",
+    "sa.core_number_128",
+    "sa.core_number_256",
+    "sa.queue_amount",
+    "sa.msgr_amount",
+    "sa.bind_core",
+    "sa.bind_queue_core",
+    "sa.enable_messenger_throttle",
+    "sa.op_trace_path",
+    "sa.op_trace_max_mb",
+    "sa.op_trace_payload_hash",
+    "sa.auto_placement",
+    "sa.queue_affinity",
+    "sa.lane_meta_weight",
+    "sa.lane_data_weight",
+    "sa.lane_starve_ms",
+    "sa.batch_max_ops",
+    "sa.batch_linger_us",
+    "sa.op_args_legacy",
+};
+
+bool ParseU64(const string &s, uint64_t &v)
+{
+    if (s.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    v = strtoull(s.c_str(), &end, 10);
+    return errno == 0 && *end == '\0' && s[0] != '-';
+}
+}
+
+bool OsaCheckQosParam(const QosParam &qos)
+{
+    if (qos.getQuotaCycle < 1) {
+        Salog(LV_CRITICAL, LOG_TYPE, "error : get quota cycle is %u", qos.getQuotaCycle.load());
+        return false;
+    }
+    uint64_t opThrottle = qos.saOpThrottle;
+    if ((opThrottle != 0) && (opThrottle < SA_OP_THROTTLE_MIN || opThrottle > SA_OP_THROTTLE_MAX)) {
+        Salog(LV_CRITICAL, LOG_TYPE, "error : sa op throttle is %lu, should in {0, [%lu~%lu]}", opThrottle,
+            SA_OP_THROTTLE_MIN, SA_OP_THROTTLE_MAX);
+        return false;
+    }
+    return true;
+}
+
+bool OsaCheckQueueMaxCapacity(uint32_t queueMaxCapacity)
+{
+    if (queueMaxCapacity > SA_QUEUE_MAX_CAPACITY || queueMaxCapacity < SA_QUEUE_MIN_CAPACITY) {
+        Salog(LV_CRITICAL, LOG_TYPE, "error : queueMaxCapacity number is %u should between %u~%u", queueMaxCapacity,
+            SA_QUEUE_MIN_CAPACITY, SA_QUEUE_MAX_CAPACITY);
+        return false;
+    }
+    return true;
+}
+
+OsaConfigReload::~OsaConfigReload()
+{
+    Stop();
+}
+
+int OsaConfigReload::ReadFile(map<string, string> &items, string &err)
+{
+    if (access(path.c_str(), R_OK) != 0) {
+        int ret = -errno;
+        err = "read " + path + " failed: " + cpp_strerror(ret);
+        return ret;
+    }
+    // same parser as OsaConfigRead, so a reload accepts exactly what a restart would
+    auto readKey = [&items](const char *item) {
+        string s(item);
+        size_t dot = s.find('.');
+        char val[CONF_VALUE_LEN] = { 0 };
+        if (GetCfgItemCstr(val, sizeof(val), s.substr(0, dot).c_str(), s.substr(dot + 1).c_str()) == 0) {
+            items[s] = val;
+        }
+    };
+    for (auto k : LIVE_KEYS) {
+        readKey(k);
+    }
+    for (auto k : RESTART_KEYS) {
+        readKey(k);
+    }
+    return 0;
+}
+
+int OsaConfigReload::Start()
+{
+    size_t slash = path.rfind('/');
+    dir = (slash == string::npos) ? "." : path.substr(0, slash);
+    name = (slash == string::npos) ? path : path.substr(slash + 1);
+    string err;
+    int ret = ReadFile(current, err);
+    if (ret != 0) {
+        Salog(LV_ERROR, LOG_TYPE, "config reload disabled, %s", err.c_str());
+        return ret;
+    }
+
+    // the directory is watched so that files replaced by rename are seen as well
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        ret = -errno;
+        Salog(LV_ERROR, LOG_TYPE, "inotify_init1 failed %d", ret);
+        return ret;
+    }
+    if (inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        ret = -errno;
+        Salog(LV_ERROR, LOG_TYPE, "inotify watch %s failed %d", dir.c_str(), ret);
+        close(inotifyFd);
+        inotifyFd = -1;
+        return ret;
+    }
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0) {
+        ret = -errno;
+        Salog(LV_ERROR, LOG_TYPE, "eventfd failed %d", ret);
+        close(inotifyFd);
+        inotifyFd = -1;
+        return ret;
+    }
+    watcher = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "sa_conf_watch");
+        WatchThread();
+    });
+
+    if (g_ceph_context) {
+        ret = g_ceph_context->get_admin_socket()->register_command(RELOAD_COMMAND, RELOAD_COMMAND, this,
+            "re-read the server adaptor config and apply the keys that can change live");
+        if (ret != 0) {
+            Salog(LV_WARNING, LOG_TYPE, "register admin command failed %d", ret);
+        }
+    }
+    Salog(LV_WARNING, LOG_TYPE, "watching %s for config changes", path.c_str());
+    return 0;
+}
+
+void OsaConfigReload::Stop()
+{
+    if (stopFd < 0) {
+        return;
+    }
+    if (g_ceph_context) {
+        g_ceph_context->get_admin_socket()->unregister_command(RELOAD_COMMAND);
+    }
+    uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0) {
+        Salog(LV_ERROR, LOG_TYPE, "wake config watcher failed %d", -errno);
+    }
+    if (watcher.joinable()) {
+        watcher.join();
+    }
+    close(stopFd);
+    stopFd = -1;
+    close(inotifyFd);
+    inotifyFd = -1;
+}
+
+void OsaConfigReload::WatchThread()
+{
+    char buf[INOTIFY_BUF_LEN] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool dirty = false;
+    while (true) {
+        struct pollfd fds[2] = { { stopFd, POLLIN, 0 }, { inotifyFd, POLLIN, 0 } };
+        int n = poll(fds, 2, dirty ? RELOAD_DEBOUNCE_MS : -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Salog(LV_ERROR, LOG_TYPE, "poll config watch failed %d", -errno);
+            return;
+        }
+        if (fds[0].revents) {
+            return;
+        }
+        if (n == 0) {
+            dirty = false;
+            string report;
+            Reload(report);
+            continue;
+        }
+        ssize_t len;
+        while ((len = read(inotifyFd, buf, sizeof(buf))) > 0) {
+            for (char *p = buf; p < buf + len;) {
+                struct inotify_event *ev = reinterpret_cast<struct inotify_event *>(p);
+                if (ev->len > 0 && name == ev->name) {
+                    dirty = true;
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+    }
+}
+
+int OsaConfigReload::Reload(string &report)
+{
+    std::lock_guard<std::mutex> l(lock);
+    map<string, string> items;
+    string err;
+    int ret = ReadFile(items, err);
+    if (ret != 0) {
+        report = "rejected: " + err + "\n";
+        Salog(LV_ERROR, LOG_TYPE, "config reload %s", report.c_str());
+        return ret;
+    }
+
+    QosParam qos = network->GetQosParam();
+    uint32_t capacity = network->GetQueueMaxCapacity();
+    ostringstream applied;
+    ostringstream restart;
+    bool invalid = false;
+    for (auto k : LIVE_KEYS) {
+        auto it = items.find(k);
+        if (it == items.end()) {
+            // OsaConfigRead requires every live key, the next start would fail without it
+            if (current.count(k)) {
+                restart << "removed " << k << ", keeping " << current[k] << ", restart will fail until it is set\n";
+            }
+            continue;
+        }
+        if (current[k] == it->second) {
+            continue;
+        }
+        uint64_t v = 0;
+        if (!ParseU64(it->second, v)) {
+            restart << "invalid " << k << " = '" << it->second << "'\n";
+            invalid = true;
+            continue;
+        }
+        string key(k);
+        if (key != "sa.sa_op_throttle" && v > UINT32_MAX) {
+            restart << "invalid " << k << " = '" << it->second << "'\n";
+            invalid = true;
+            continue;
+        }
+        if (key == "sa.write_qos") {
+            qos.limitWrite = v;
+        } else if (key == "sa.get_quota_cyc") {
+            qos.getQuotaCycle = v;
+        } else if (key == "sa.sa_op_throttle") {
+            qos.saOpThrottle = v;
+        } else {
+            capacity = v;
+        }
+        applied << "applied " << k << ": " << current[k] << " -> " << it->second << "\n";
+    }
+    for (auto k : RESTART_KEYS) {
+        auto it = items.find(k);
+        if (it != items.end() && current[k] != it->second) {
+            restart << "restart required " << k << ": " << current[k] << " -> " << it->second << "\n";
+        } else if (it == items.end() && current.count(k)) {
+            restart << "restart required " << k << ": " << current[k] << " -> (removed)\n";
+        }
+    }
+
+    // live keys go in all together or not at all
+    if (invalid || !OsaCheckQosParam(qos) || !OsaCheckQueueMaxCapacity(capacity)) {
+        report = "rejected, the running values are kept\n" + restart.str();
+        Salog(LV_ERROR, LOG_TYPE, "config reload %s", report.c_str());
+        return -EINVAL;
+    }
+    network->UpdateQosParam(qos);
+    if (capacity != network->GetQueueMaxCapacity()) {
+        network->SetQueueMaxCapacity(capacity);
+    }
+    for (auto k : LIVE_KEYS) {
+        auto it = items.find(k);
+        if (it != items.end()) {
+            current[k] = it->second;
+        }
+    }
+    report = applied.str() + restart.str();
+    if (report.empty()) {
+        report = "no change\n";
+    }
+    Salog(LV_WARNING, LOG_TYPE, "config reload %s", report.c_str());
+    return 0;
+}
+
+bool OsaConfigReload::call(std::string_view command, const cmdmap_t &cmdmap, std::string_view format,
+    ceph::bufferlist &out)
+{
+    string report;
+    Reload(report);
+    out.append(report);
+    return true;
+}
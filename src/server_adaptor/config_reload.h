@@ -0,0 +1,60 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef CONFIG_RELOAD_H
+#define CONFIG_RELOAD_H
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "common/admin_socket.h"
+
+class NetworkModule;
+struct QosParam;
+
+// bounds shared by OSA_Init and the live reload
+bool OsaCheckQosParam(const QosParam &qos);
+bool OsaCheckQueueMaxCapacity(uint32_t queueMaxCapacity);
+
+/*
+ * Re-reads the server adaptor config file when it is rewritten (inotify) or on
+ * the admin socket command "sa config reload". Keys the running adaptor can
+ * take are validated and applied together; the rest are only reported as
+ * restart-required.
+ */
+class OsaConfigReload : public AdminSocketHook {
+    NetworkModule *network { nullptr };
+    std::string path;
+    std::string dir;
+    std::string name;
+    int inotifyFd { -1 };
+    int stopFd { -1 };
+    std::thread watcher;
+
+    std::mutex lock;
+    // "section.key" -> value as it was at start or at the last applied reload
+    std::map<std::string, std::string> current;
+
+    int ReadFile(std::map<std::string, std::string> &items, std::string &err);
+    void WatchThread();
+
+public:
+    OsaConfigReload(NetworkModule *n, const std::string &confPath) : network(n), path(confPath) {}
+    ~OsaConfigReload() override;
+
+    int Start();
+    void Stop();
+    // returns 0 when the live keys were applied or nothing changed, report describes what happened
+    int Reload(std::string &report);
+
+    bool call(std::string_view command, const cmdmap_t &cmdmap, std::string_view format,
+        ceph::bufferlist &out) override;
+};
+
+#endif
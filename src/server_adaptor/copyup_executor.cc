@@ -0,0 +1,140 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "copyup_executor.h"
+
+#include "include/rados.h"
+#include "salog.h"
+
+using namespace std;
+
+namespace {
+const string LOG_TYPE = "COPYUP";
+}
+
+CopyupExecutor &GetCopyupExecutor()
+{
+    static CopyupExecutor executor;
+    return executor;
+}
+
+string CopyupKey(uint64_t poolId, const string &oid)
+{
+    return to_string(poolId) + "/" + oid;
+}
+
+void CopyupExecutor::Expect(const string &key, const void *op)
+{
+    lock_guard<mutex> l(lock);
+    if (!expected.emplace(op, key).second) {
+        return;
+    }
+    expectedNum[key]++;
+    pendingNum++;
+}
+
+void CopyupExecutor::Release(const void *op)
+{
+    lock_guard<mutex> l(lock);
+    auto it = expected.find(op);
+    if (it == expected.end()) {
+        return;
+    }
+    auto num = expectedNum.find(it->second);
+    if (--num->second == 0) {
+        expectedNum.erase(num);
+    }
+    expected.erase(it);
+    pendingNum--;
+    cond.notify_all();
+}
+
+void CopyupExecutor::WaitIdle(const string &key)
+{
+    if (!AnyPending()) {
+        return;
+    }
+    unique_lock<mutex> l(lock);
+    cond.wait(l, [this, &key]() { return expectedNum.count(key) == 0 && flights.count(key) == 0; });
+}
+
+void CopyupExecutor::Submit(const string &key, const IssueFn &issue, DoneFn done)
+{
+    {
+        lock_guard<mutex> l(lock);
+        auto it = flights.find(key);
+        if (it != flights.end()) {
+            it->second.waiters.push_back(std::move(done));
+            deduped++;
+            return;
+        }
+        flights.emplace(key, Flight());
+        pendingNum++;
+    }
+
+    issued++;
+    int ret = issue();
+    vector<DoneFn> waiters;
+    {
+        lock_guard<mutex> l(lock);
+        auto it = flights.find(key);
+        waiters.swap(it->second.waiters);
+        flights.erase(it);
+        pendingNum--;
+        cond.notify_all();
+    }
+    if (waiters.size() != 0) {
+        Salog(LV_DEBUG, LOG_TYPE, "copyup of %s ret=%d taken by %zu more", key.c_str(), ret, waiters.size());
+    }
+    done(ret);
+    for (auto &w : waiters) {
+        w(ret);
+    }
+}
+
+int CopyupExecutor::Run(const string &key, const IssueFn &issue)
+{
+    mutex doneLock;
+    condition_variable doneCond;
+    bool finished = false;
+    int ret = 0;
+    Submit(key, issue, [&](int r) {
+        lock_guard<mutex> l(doneLock);
+        ret = r;
+        finished = true;
+        doneCond.notify_one();
+    });
+    unique_lock<mutex> l(doneLock);
+    doneCond.wait(l, [&finished]() { return finished; });
+    return ret;
+}
+
+int CopyupWrite(SaOpContext *pctx, ceph::bufferlist &data)
+{
+    SaOpReq *pOpReq = pctx->opReq;
+    SaOpReq opreq = *pOpReq;
+    OpRequestOps &clientOp = pOpReq->vecOps[pctx->opId];
+    OpRequestOps op;
+
+    op.opSubType = CEPH_OSD_OP_CREATE;
+    op.opFlags = CEPH_OSD_OP_FLAG_EXCL;
+    op.isRbd = clientOp.isRbd;
+    op.rbdObjId = clientOp.rbdObjId;
+    op.objName = clientOp.objName;
+    opreq.vecOps.clear();
+    opreq.vecOps.push_back(op);
+
+    op.opSubType = CEPH_OSD_OP_WRITE;
+    op.opFlags = 0;
+    op.objOffset = 0;
+    op.objLength = data.length();
+    op.inData = data.c_str();
+    op.inDataLen = data.length();
+    opreq.vecOps.push_back(op);
+
+    int ret = pctx->cbFunc(opreq);
+    return ret == -EEXIST ? 0 : ret;
+}
@@ -0,0 +1,86 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef COPYUP_EXECUTOR_H
+#define COPYUP_EXECUTOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/buffer.h"
+#include "sa_def.h"
+
+/*
+ * rbd.copyup writes the parent data into an object of a clone unless the
+ * object exists already. Copyups of one object run once: one issued while
+ * another is in flight waits for it and takes its result. Ops queued after
+ * a copyup wait only when they are for the same object.
+ */
+class CopyupExecutor {
+public:
+    using IssueFn = std::function<int()>;
+    using DoneFn = std::function<void(int)>;
+
+    // the queue thread marks the object before the copyup op goes to the global cache
+    void Expect(const std::string &key, const void *op);
+    // op is done, with its copyup run or not; drops the mark Expect set for it, if any
+    void Release(const void *op);
+    // an op on key has to wait while a copyup of it is expected or running
+    void WaitIdle(const std::string &key);
+    bool AnyPending() const
+    {
+        return pendingNum.load(std::memory_order_acquire) != 0;
+    }
+
+    // with a copyup of key running, done is kept as its continuation; otherwise issue runs
+    // here and done runs after it, with every continuation taken meanwhile
+    void Submit(const std::string &key, const IssueFn &issue, DoneFn done);
+    // Submit waiting for done
+    int Run(const std::string &key, const IssueFn &issue);
+
+    uint64_t Issued() const
+    {
+        return issued;
+    }
+    uint64_t Deduped() const
+    {
+        return deduped;
+    }
+
+private:
+    struct Flight {
+        std::vector<DoneFn> waiters;
+    };
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::unordered_map<std::string, Flight> flights;
+    // client op -> key of its copyup, and the number of those per key
+    std::unordered_map<const void *, std::string> expected;
+    std::unordered_map<std::string, uint32_t> expectedNum;
+    // expected copyups plus running ones, read without the lock on every submitted batch
+    std::atomic<uint32_t> pendingNum { 0 };
+    std::atomic<uint64_t> issued { 0 };
+    std::atomic<uint64_t> deduped { 0 };
+};
+
+CopyupExecutor &GetCopyupExecutor();
+std::string CopyupKey(uint64_t poolId, const std::string &oid);
+
+/*
+ * One op to the global cache for a copyup: an exclusive create and the
+ * write of data, so the write is applied only when the create is. An
+ * existing object fails the create with -EEXIST, which is 0 for copyup.
+ */
+int CopyupWrite(SaOpContext *pctx, ceph::bufferlist &data);
+
+#endif
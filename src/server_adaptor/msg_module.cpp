@@ -9,6 +9,7 @@
 #include "osd/ClassHandler.h"
 
 #include <cstdlib>
+#include <string_view>
 #include <time.h>
 #include "salog.h"
 
@@ -16,6 +17,21 @@ using namespace std;
 
 namespace {
 const string LOG_TYPE = "MSG";
+
+// a length prefixed string of the indata, as a view into it
+SaStr DecodeStrView(const char *base, bufferlist::const_iterator &bp)
+{
+    uint32_t len = 0;
+    decode(len, bp);
+    SaStr s = { len, const_cast<char *>(base) + bp.get_off() };
+    bp.advance(len);
+    return s;
+}
+
+string ToString(const SaStr &s)
+{
+    return string(s.buf, s.len);
+}
 }
 
 static void decode_str_str_map_to_bl(bufferlist::const_iterator &p, bufferlist *out)
@@ -123,18 +139,23 @@ int MsgModule::ConvertClientopToOpreq(OSDOp &clientop, OpRequestOps &oneOp, Opti
         case CEPH_OSD_OP_STAT:
             break;
         case CEPH_OSD_OP_CALL: {
-            string cname, mname;
-            auto bp = clientop.indata.cbegin();
-            try {
-                bp.copy(clientop.op.cls.class_len, cname);
-                bp.copy(clientop.op.cls.method_len, mname);
-            } catch (buffer::error &e) {
-                Salog(LV_ERROR, LOG_TYPE, "unable to decode class [%s] + method[%s]", cname.c_str(), mname.c_str());
+            uint32_t namesLen = clientop.op.cls.class_len + clientop.op.cls.method_len;
+            if (namesLen + clientop.op.cls.indata_len > clientop.indata.length()) {
+                Salog(LV_ERROR, LOG_TYPE, "unable to decode class + method + indata, %u bytes of %u",
+                    namesLen + clientop.op.cls.indata_len, clientop.indata.length());
+                break;
             }
-            if (cname.compare("rbd") == 0 && mname.compare("copyup") == 0) {
+            char *base = clientop.indata.c_str();
+            SaCallArgs &args = oneOp.args.u.call;
+            oneOp.args.type = SA_OP_ARGS_CALL;
+            args.className = { clientop.op.cls.class_len, base };
+            args.methodName = { clientop.op.cls.method_len, base + clientop.op.cls.class_len };
+            args.input = { clientop.op.cls.indata_len, base + namesLen };
+            if (string_view(args.className.buf, args.className.len) == "rbd" &&
+                string_view(args.methodName.buf, args.methodName.len) == "copyup") {
                 ret = 1;
                 SaDatalog("Converting COPYUP tid=%ld obj=%s", tid, oneOp.objName.c_str());
-            } 
+            }
         } break;
         case CEPH_OSD_OP_LIST_SNAPS: {
             SaDatalog("Converting COPYUP tid=%ld obj=%s", tid, oneOp.objName.c_str());
@@ -145,7 +166,7 @@ int MsgModule::ConvertClientopToOpreq(OSDOp &clientop, OpRequestOps &oneOp, Opti
             break;
         case CEPH_OSD_OP_ROLLBACK:
             ConvertRollBackOp(clientop, oneOp);
-            Salog(LV_DEBUG, LOG_TYPE, "rollback snapid: %s", oneOp.values[0]);
+            Salog(LV_DEBUG, LOG_TYPE, "rollback snapid: %lu", oneOp.args.u.rollback.snapId);
             break;
         default: {
             Salog(LV_DEBUG, LOG_TYPE, "Translate ClientOp, unknown op:0x%lX", oneOp.opSubType);
@@ -165,26 +186,39 @@ void MsgModule::ConvertObjRw(OSDOp &clientop, OpRequestOps &oneOp)
     }
 }
 
-void MsgModule::ConvertOmapOp(OSDOp &clientop, OpRequestOps &oneOp)
+void MsgModule::ConvertOmapList(OSDOp &clientop, OpRequestOps &oneOp)
 {
+    const char *base = clientop.indata.c_str();
     auto bp = clientop.indata.cbegin();
+    SaOmapListArgs &args = oneOp.args.u.omapList;
+    oneOp.args.type = SA_OP_ARGS_OMAP_LIST;
+    args.startAfter = DecodeStrView(base, bp);
+    decode(args.maxReturn, bp);
+    args.filterPrefix = { 0, nullptr };
+    if (clientop.op.op == CEPH_OSD_OP_OMAPGETVALS) {
+        args.filterPrefix = DecodeStrView(base, bp);
+    }
+    if (!legacyArgs) {
+        return;
+    }
+    oneOp.keys.push_back("start_after");
+    oneOp.values.push_back(ToString(args.startAfter));
+    oneOp.keys.push_back("max_return");
+    oneOp.values.push_back(to_string(args.maxReturn));
     if (clientop.op.op == CEPH_OSD_OP_OMAPGETVALS) {
-        string start_after;
-        uint64_t max_return;
-        string filter_prefix;
-
-        decode(start_after, bp);
-        oneOp.keys.push_back("start_after");
-        oneOp.values.push_back(start_after);
-
-        decode(max_return, bp);
-        oneOp.keys.push_back("max_return");
-        oneOp.values.push_back(to_string(max_return));
-
-        decode(filter_prefix, bp);
         oneOp.keys.push_back("filter_prefix");
-        oneOp.values.push_back(filter_prefix);
-    } else if (clientop.op.op == CEPH_OSD_OP_OMAPSETVALS) {
+        oneOp.values.push_back(ToString(args.filterPrefix));
+    }
+}
+
+void MsgModule::ConvertOmapOp(OSDOp &clientop, OpRequestOps &oneOp)
+{
+    if (clientop.op.op == CEPH_OSD_OP_OMAPGETVALS || clientop.op.op == CEPH_OSD_OP_OMAPGETKEYS) {
+        ConvertOmapList(clientop, oneOp);
+        return;
+    }
+    auto bp = clientop.indata.cbegin();
+    if (clientop.op.op == CEPH_OSD_OP_OMAPSETVALS) {
         bufferlist to_set_bl;
         map<string, bufferlist> to_set;
         decode_str_str_map_to_bl(bp, &to_set_bl);
@@ -198,17 +232,6 @@ void MsgModule::ConvertOmapOp(OSDOp &clientop, OpRequestOps &oneOp)
             oneOp.keys.push_back(key);
             oneOp.values.push_back(val);
         }
-    } else if (clientop.op.op == CEPH_OSD_OP_OMAPGETKEYS) {
-        string start_after;
-        uint64_t max_return;
-
-        decode(start_after, bp);
-        oneOp.keys.push_back("start_after");
-        oneOp.values.push_back(start_after);
-
-        decode(max_return, bp);
-        oneOp.keys.push_back("max_return");
-        oneOp.values.push_back(to_string(max_return));
     } else if (clientop.op.op == CEPH_OSD_OP_OMAPRMKEYS) {
         set<string> keys_to_rm;
         decode(keys_to_rm, bp);
@@ -245,6 +268,7 @@ void MsgModule::ConvertAttrOp(OSDOp &clientop, OpRequestOps &oneOp)
 {
     ceph_osd_op &op = clientop.op;
 
+    const char *base = (op.op == CEPH_OSD_OP_CMPXATTR) ? clientop.indata.c_str() : nullptr;
     auto bp = clientop.indata.cbegin();
     std::string xattr_name;
     bp.copy(op.xattr.name_len, xattr_name);
@@ -255,20 +279,33 @@ void MsgModule::ConvertAttrOp(OSDOp &clientop, OpRequestOps &oneOp)
         bp.copy(op.xattr.value_len, val);
         oneOp.values.push_back(val);
     } else if (op.op == CEPH_OSD_OP_CMPXATTR) {
+        SaCmpXattrArgs &args = oneOp.args.u.cmpXattr;
+        oneOp.args.type = SA_OP_ARGS_CMPXATTR;
+        args.name = { op.xattr.name_len, const_cast<char *>(base) };
+        args.value = { 0, nullptr };
+        args.u64Value = 0;
+        args.cmpOp = op.xattr.cmp_op;
+        args.cmpMode = op.xattr.cmp_mode;
+        switch (op.xattr.cmp_mode) {
+            case CEPH_OSD_CMPXATTR_MODE_STRING:
+                if (op.xattr.value_len > bp.get_remaining()) {
+                    throw buffer::end_of_buffer();
+                }
+                args.value = { op.xattr.value_len, const_cast<char *>(base) + bp.get_off() };
+                break;
+            case CEPH_OSD_CMPXATTR_MODE_U64:
+                decode(args.u64Value, bp);
+                break;
+        }
+        if (!legacyArgs) {
+            return;
+        }
         oneOp.subops.push_back((int)op.xattr.cmp_op);
         oneOp.cmpModes.push_back(op.xattr.cmp_mode);
-        switch (op.xattr.cmp_mode) {
-            case CEPH_OSD_CMPXATTR_MODE_STRING: {
-                string val;
-                bp.copy(op.xattr.value_len, val);
-                val[op.xattr.value_len] = 0;
-                oneOp.values.push_back(val);
-            } break;
-            case CEPH_OSD_CMPXATTR_MODE_U64: {
-                uint64_t u64val;
-                decode(u64val, bp);
-                oneOp.u64vals.push_back(u64val);
-            } break;
+        if (op.xattr.cmp_mode == CEPH_OSD_CMPXATTR_MODE_STRING) {
+            oneOp.values.push_back(ToString(args.value));
+        } else if (op.xattr.cmp_mode == CEPH_OSD_CMPXATTR_MODE_U64) {
+            oneOp.u64vals.push_back(args.u64Value);
         }
     }
 }
@@ -276,6 +313,10 @@ void MsgModule::ConvertAttrOp(OSDOp &clientop, OpRequestOps &oneOp)
 void MsgModule::ConvertRollBackOp(OSDOp &clientop, OpRequestOps &oneOp)
 {
     ceph_osd_op &op = clientop.op;
-    oneOp.keys.push_back("snapid");
-    oneOp.values.push_back(to_string(op.snap.snapid));
+    oneOp.args.type = SA_OP_ARGS_ROLLBACK;
+    oneOp.args.u.rollback.snapId = op.snap.snapid;
+    if (legacyArgs) {
+        oneOp.keys.push_back("snapid");
+        oneOp.values.push_back(to_string(op.snap.snapid));
+    }
 }
\ No newline at end of file
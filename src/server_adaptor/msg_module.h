@@ -18,7 +18,11 @@
 using MSG_UNIQUE_LOCK = std::unique_lock<std::mutex>;
 
 class MsgModule {
+    // also fill the positional keys/values of ops that have typed args
+    bool legacyArgs { true };
+
     void ConvertObjRw(OSDOp &clientop, OpRequestOps &oneOp);
+    void ConvertOmapList(OSDOp &clientop, OpRequestOps &oneOp);
     void ConvertOmapOp(OSDOp &clientop, OpRequestOps &oneOp);
     void ConvertAttrOp(OSDOp &clientop, OpRequestOps &oneOp);
     void ConvertRollBackOp(OSDOp &clientop, OpRequestOps &oneOp);
@@ -27,6 +31,11 @@ public:
     MsgModule() {}
     ~MsgModule() {}
 
+    void SetLegacyArgs(bool on)
+    {
+        legacyArgs = on;
+    }
+
     int ConvertClientopToOpreq(OSDOp &clientop, OpRequestOps &oneOp,
         OptionsType &optionType, OptionsLength &optionLength, long tid);
 };
@@ -11,6 +11,9 @@
 #include <string>
 #include <sys/prctl.h>
 #include <ctime>
+#include <algorithm>
+#include <numeric>
+#include <string_view>
 
 #include "common/config.h"
 #include "common/Timer.h"
@@ -23,6 +26,8 @@
 #include "messages/MPing.h"
 #include "common/common_init.h"
 #include "messages/MOSDOpReply.h"
+#include "include/buffer_raw.h"
+#include "copyup_executor.h"
 #include "salog.h"
 #include "sa_ftds_osa.h"
 
@@ -42,6 +47,85 @@ MsgPerfRecord *g_msgPerf { nullptr };
 #endif
 const uint32_t SA_THOUSAND_DEC = 1000;
 const uint32_t COMMON_SLEEP_TIME_MS = 100;
+
+// index of the calling msgr-worker thread, -1 on any other thread
+int CurrentMsgrWorker()
+{
+    thread_local int index = -2;
+    if (index == -2) {
+        char name[16] = {0};
+        uint32_t n = 0;
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        index = (sscanf(name, "msgr-worker-%u", &n) == 1) ? n : -1;
+    }
+    return index;
+}
+
+// read data lent by the cache, released when the last bufferptr on it goes away
+class CacheLentRaw : public buffer::raw {
+    RELEASE_FUNC release;
+    void *arg;
+
+public:
+    CacheLentRaw(char *buf, unsigned len, RELEASE_FUNC r, void *a) : buffer::raw(buf, len), release(r), arg(a) {}
+    ~CacheLentRaw() override
+    {
+        if (release != nullptr) {
+            release(arg);
+        }
+    }
+    buffer::raw *clone_empty() override
+    {
+        return buffer::create(len);
+    }
+};
+
+std::string_view KeyOf(const SaBatchKv *kv, uint32_t j)
+{
+    return std::string_view(kv->keys[j].buf, kv->keys[j].buf ? kv->keys[j].len : 0);
+}
+
+/*
+ * Encodes the arrays as a map<string, bufferlist> would be, with one copy of
+ * each key and value into a single preallocated buffer. Arrays from the cache
+ * come sorted; otherwise the order is sorted here and duplicate keys keep the
+ * first value, like map::insert did.
+ */
+void EncodeKvMap(const SaBatchKv *kv, bufferlist &out)
+{
+    std::vector<uint32_t> order;
+    for (uint32_t j = 1; j < kv->kvNum; j++) {
+        if (!(KeyOf(kv, j - 1) < KeyOf(kv, j))) {
+            order.resize(kv->kvNum);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [kv](uint32_t a, uint32_t b) {
+                return KeyOf(kv, a) < KeyOf(kv, b);
+            });
+            order.erase(std::unique(order.begin(), order.end(), [kv](uint32_t a, uint32_t b) {
+                return KeyOf(kv, a) == KeyOf(kv, b);
+            }), order.end());
+            break;
+        }
+    }
+    uint32_t num = order.empty() ? kv->kvNum : order.size();
+    size_t bytes = sizeof(uint32_t);
+    for (uint32_t n = 0; n < num; n++) {
+        uint32_t j = order.empty() ? n : order[n];
+        bytes += sizeof(uint32_t) * 2 + KeyOf(kv, j).size() + (kv->values[j].buf ? kv->values[j].len : 0);
+    }
+    out.reserve(bytes);
+    encode(num, out);
+    for (uint32_t n = 0; n < num; n++) {
+        uint32_t j = order.empty() ? n : order[n];
+        encode(KeyOf(kv, j), out);
+        encode(std::string_view(kv->values[j].buf, kv->values[j].buf ? kv->values[j].len : 0), out);
+    }
+}
+
+bool HasBatchOps()
+{
+    return SaExportDoBatchOps != nullptr;
+}
 }
 
 static NetworkModule * g_networkModule = nullptr;
@@ -82,6 +166,7 @@ int NetworkModule::InitNetworkModule(const std::string &rAddr, const std::vector
     int ret;
     if (ptrMsgModule == nullptr) {
         ptrMsgModule = new MsgModule();
+        ptrMsgModule->SetLegacyArgs(legacyOpArgs);
     }
     recvAddr = rAddr;
     vecPorts = rPort;
@@ -104,6 +189,14 @@ int NetworkModule::InitNetworkModule(const std::string &rAddr, const std::vector
     msgPerf->start();
     Salog(LV_WARNING, LOG_TYPE, "SA_PERF open");
 #endif
+    if (!traceParam.path.empty() && opTrace == nullptr) {
+        opTrace = new OpTraceRecorder(traceParam);
+        if (opTrace->Start() == 0) {
+            g_opTrace = opTrace;
+        } else {
+            Salog(LV_ERROR, LOG_TYPE, "op trace is off, can not open %s", traceParam.path.c_str());
+        }
+    }
     return ret;
 }
 
@@ -115,6 +208,11 @@ int NetworkModule::FinishNetworkModule()
         Salog(LV_DEBUG, LOG_TYPE, "FinishMessenger is failed ret=%d", ret);
     }
     Salog(LV_DEBUG, LOG_TYPE, "Finish network module.");
+    if (opTrace) {
+        // the recorder is freed with the module, late replies only see it stopped
+        g_opTrace = nullptr;
+        opTrace->Stop();
+    }
 #ifdef SA_PERF
     msgPerf->stop();
     g_msgPerf = nullptr;
@@ -221,7 +319,7 @@ int NetworkModule::ThreadFuncBodyServer()
     }
     common_init_finish(g_ceph_context);
 
-    if (bindMsgrCore) {
+    if (bindMsgrCore && placement == nullptr) {
 	    BindMsgrWorker(pid);
 	    Salog(LV_WARNING, LOG_TYPE, "msgr-worker and ms_dispatch bind cores.");
     }
@@ -330,11 +428,133 @@ void NetworkModule::BindCore(uint64_t ii, uint32_t n, bool isWorker)
     }
 }
 
+void NetworkModule::SetAutoPlacement(const std::string &ifName)
+{
+    autoPlacement = true;
+    placementIf = ifName;
+}
+
+void NetworkModule::PlaceMsgrThread()
+{
+    thread_local bool placed = false;
+    if (placement == nullptr || placed) {
+        return;
+    }
+    placed = true;
+    int index = CurrentMsgrWorker();
+    if (index >= 0) {
+        placement->Register(PLACEMENT_MSGR_WORKER, index, pthread_self());
+    } else {
+        placement->Register(PLACEMENT_DISPATCH, 0, pthread_self());
+    }
+}
+
+// a connection stays on one worker, which owns queues shard, shard + shardNum, ...
+// so the ops of one object from one connection keep their order; the shard is
+// kept per connection so a defer thread enqueueing for the worker picks the same
+size_t NetworkModule::ShardOf(const Connection *con)
+{
+    {
+        std::shared_lock<std::shared_mutex> l(connShardMtx);
+        auto it = connShard.find(con);
+        if (it != connShard.end()) {
+            return it->second;
+        }
+    }
+    uint32_t shardNum = std::min<uint64_t>(msgrNum, queueNum);
+    int worker = CurrentMsgrWorker();
+    size_t shard = (worker >= 0) ? worker : std::hash<const Connection *> {}(con);
+    std::unique_lock<std::shared_mutex> l(connShardMtx);
+    return connShard.emplace(con, shard % shardNum).first->second;
+}
+
+void NetworkModule::ForgetConnection(const Connection *con)
+{
+    std::unique_lock<std::shared_mutex> l(connShardMtx);
+    connShard.erase(con);
+}
+
+size_t NetworkModule::SelectQueue(const MOSDOp &op, size_t objHash)
+{
+    if (!queueAffinity) {
+        return objHash % queueNum;
+    }
+    uint32_t shardNum = std::min<uint64_t>(msgrNum, queueNum);
+    size_t shard = ShardOf(op.get_connection().get());
+    size_t inShard = (queueNum - shard + shardNum - 1) / shardNum;
+    return shard + (objHash % inShard) * shardNum;
+}
+
+/*
+ * Called on the messenger worker. Once an op of the shard is deferred the
+ * following ones queue behind it, so the ops of one object keep their order
+ * while the defer thread waits for queue room or write quota.
+ */
+bool NetworkModule::DeferFast(MOSDOp *opReq, size_t shard, size_t idx)
+{
+    DeferredOps *d = deferred[shard];
+    std::unique_lock<std::mutex> l(d->mtx);
+    if (d->ops.empty()) {
+        bool wait = qosParam.limitWrite && writeLimited && ContainWriteOp(*opReq);
+        if (!wait) {
+            std::lock_guard<std::mutex> ql(opDispatcher[idx]->opQueueMutex);
+            wait = opDispatcher[idx]->GetSize() > queueMaxCapacity;
+        }
+        if (!wait) {
+            return false;
+        }
+    }
+    SaDatalog("MOSDOp deferred tid=%ld obj=%s shard=%lu",
+        opReq->get_tid(), opReq->get_oid().name.c_str(), shard);
+    d->ops.push_back(opReq);
+    d->cond.notify_one();
+    return true;
+}
+
+void NetworkModule::DeferThread(size_t shard)
+{
+    DeferredOps *d = deferred[shard];
+    std::unique_lock<std::mutex> l(d->mtx);
+    while (true) {
+        d->cond.wait(l, [this, d] { return deferStop || !d->ops.empty(); });
+        if (deferStop) {
+            break;
+        }
+        MOSDOp *opReq = d->ops.front();
+        l.unlock();
+        EnqueueClientop(opReq, false);
+        l.lock();
+        // popped once enqueued, a worker seeing the deque empty may enqueue right away
+        d->ops.pop_front();
+    }
+    if (!d->ops.empty()) {
+        Salog(LV_WARNING, LOG_TYPE, "shard %lu drops %lu deferred ops at stop", shard, d->ops.size());
+    }
+    for (auto opReq : d->ops) {
+        opReq->put();
+    }
+    d->ops.clear();
+}
+
 void NetworkModule::CreateWorkThread(uint32_t qnum, uint32_t portAmout, uint32_t qmaxcapacity)
 {
     if (g_networkModule == nullptr) {
         g_networkModule = this;
     }
+    if (autoPlacement && placement == nullptr) {
+        PlacementParam param;
+        param.ifName = placementIf;
+        param.allowed.assign(coreId.begin(), coreId.end());
+        param.msgrNum = msgrNum;
+        param.dispatchNum = portAmout;
+        param.queueNum = qnum;
+        placement = new ThreadPlacement();
+        if (placement->Init(param) != 0) {
+            Salog(LV_ERROR, LOG_TYPE, "auto placement failed, falling back to bind_core");
+            delete placement;
+            placement = nullptr;
+        }
+    }
     finishThread.clear();
     opDispatcher.clear();
     doOpThread.clear();
@@ -371,11 +591,40 @@ void NetworkModule::CreateWorkThread(uint32_t qnum, uint32_t portAmout, uint32_t
 	    ceph_assert("Create thread catch std::exception" == nullptr);
      	}
     }
+    if (queueAffinity) {
+        deferStop = false;
+        uint32_t shardNum = std::min<uint64_t>(msgrNum, queueNum);
+        for (uint32_t i = 0; i < shardNum; i++) {
+            deferred.push_back(new DeferredOps());
+        }
+        for (uint32_t i = 0; i < shardNum; i++) {
+            deferThread.push_back(thread(&NetworkModule::DeferThread, this, i));
+        }
+    }
     Salog(LV_WARNING, LOG_TYPE, "CreateWorkThread %d %d", queueNum, qmaxcapacity);
 }
 
 void NetworkModule::StopThread()
 {
+    // a defer thread may wait for room in a queue, stopped before the queue threads
+    for (auto d : deferred) {
+        std::lock_guard<std::mutex> l(d->mtx);
+        deferStop = true;
+        d->cond.notify_all();
+    }
+    for (auto q : opDispatcher) {
+        std::lock_guard<std::mutex> l(q->opQueueMutex);
+        q->cond.notify_all();
+    }
+    for (auto &t : deferThread) {
+        t.join();
+    }
+    deferThread.clear();
+    for (auto d : deferred) {
+        delete d;
+    }
+    deferred.clear();
+
     for (uint32_t i = 0; i < finishThread.size(); i++) {
 	try {
             std::unique_lock<std::mutex> opReqLock(opDispatcher[i]->opQueueMutex);
@@ -404,7 +653,9 @@ void NetworkModule::StopThread()
 
 void NetworkModule::OpHandlerThread(int threadNum, int coreId)
 {
-    if (bindSaCore) {
+    if (placement) {
+        placement->Register(PLACEMENT_QUEUE, threadNum, pthread_self());
+    } else if (bindSaCore) {
 
 	Salog(LV_DEBUG, LOG_TYPE, "bind_gc_sa cpuId=%d", coreId);
         int cpus = sysconf(_SC_NPROCESSORS_CONF);
@@ -456,13 +707,13 @@ void NetworkModule::OpHandlerThread(int threadNum, int coreId)
         sleep(1);
         ceph_assert("Lock queue mutex catch std::exception 1" == nullptr);
     }
-    std::atomic<int> copyupFlag = 0;
+    OpBatcher batch;
+    batch.SetPolicy(batchPolicy);
     while (!finishThread[threadId]) {
         if (!opDispatch->Empty()) {
-            opDispatch->reqQueue.swap(dealQueue);
+            opDispatch->DeQueueRound(lanePolicy, dealQueue, dealTs, periodTs);
+            batch.Observe(dealQueue.size() + batch.Ops().size());
             SaDatalog("queue_size_swaped %d", dealQueue.size());
-            opDispatch->tsQueue.swap(dealTs);
-            opDispatch->period.swap(periodTs);
             opDispatch->cond.notify_all();
             try {
                 opReqLock.unlock();
@@ -496,26 +747,13 @@ void NetworkModule::OpHandlerThread(int threadNum, int coreId)
                     sa->FtdsEndHigt(SA_FTDS_OP_LIFE, "SA_FTDS_OP_LIFE", ts, 0);
                     continue;
                 }
-                GetlwtCas();
-                if (opreq->optionType == GCACHE_WRITE) {
-                    GetWritelwtCas();
-                    GetWriteBWCas(opreq->optionLength);
-                }
-                if (opreq->optionType == GCACHE_READ) {
-                    GetReadlwtCas();
-                    GetReadBWCas(opreq->optionLength);
-                }
-                while (copyupFlag.load() == 1) {
-                    usleep(20 * SA_THOUSAND_DEC);
+                batch.Add(opreq, ts);
+                if (batch.Full() || unlikely(opreq->exitsCopyUp == 1)) {
+                    SubmitBatch(batch);
                 }
-                if (unlikely(opreq->exitsCopyUp == 1)) {
-                    SaDatalog("exists copyup, set copyupFlag, tid=%ld", opreq->tid);
-                    copyupFlag = 1;
-                    opreq->copyupFlag = &copyupFlag;
-                }
-                sa->DoOneOps(*opreq);
-                //
-                sa->FtdsEndHigt(SA_FTDS_OP_LIFE, "SA_FTDS_OP_LIFE", ts, 0);
+            }
+            if (batch.Pending() && !batch.Linger()) {
+                SubmitBatch(batch);
             }
             uint64_t lockTsOne = 0;
             sa->FtdsStartHigh(SA_FTDS_LOCK_ONE, "SA_FTDS_LOCK_ONE", lockTsOne);
@@ -537,6 +775,15 @@ void NetworkModule::OpHandlerThread(int threadNum, int coreId)
                 ceph_assert("Lock queue mutex catch std::exception 2" == nullptr);
             }
             sa->FtdsEndHigt(SA_FTDS_LOCK_ONE, "SA_FTDS_OP_LIFE", lockTsOne, 0);
+            // Nagle: a short batch waits for more ops until the linger deadline
+            if (batch.Linger() && opDispatch->Empty()) {
+                opDispatch->condOpReq.wait_until(opReqLock, batch.Deadline());
+            }
+            if (batch.Pending() && (opDispatch->Empty() || !batch.Linger())) {
+                opReqLock.unlock();
+                SubmitBatch(batch);
+                opReqLock.lock();
+            }
             continue;
         }
     try {
@@ -557,6 +804,10 @@ void NetworkModule::OpHandlerThread(int threadNum, int coreId)
         ceph_assert("Wait queue mutex catch std::exception 1" == nullptr);
     }
     }
+    if (batch.Pending()) {
+        opReqLock.unlock();
+        SubmitBatch(batch);
+    }
     Salog(LV_WARNING, "OpHandler", "OpHandlerThread  Finish");
 }
 
@@ -659,8 +910,13 @@ int NetworkModule::ProcessOpReq(std::queue<MOSDOp *> &dealQueue, std::queue<uint
         return 0;
 }
 
-uint32_t NetworkModule::EnqueueClientop(MOSDOp *opReq)
+uint32_t NetworkModule::EnqueueClientop(MOSDOp *opReq, bool fast)
 {
+    size_t objHash = std::hash<std::string> {}(opReq->get_oid().name);
+    size_t idx = SelectQueue(*opReq, objHash);
+    if (fast && DeferFast(opReq, ShardOf(opReq->get_connection().get()), idx)) {
+        return 0;
+    }
     string source;
 #ifdef SA_PERF
     msgPerf->set_recv(opReq->osa_tick.SetRecvEnd(opReq, source));
@@ -671,7 +927,6 @@ uint32_t NetworkModule::EnqueueClientop(MOSDOp *opReq)
     uint64_t enqueTs = 0;
     sa->FtdsStartHigh(SA_FTDS_MOSDOP_ENQUEUE, "SA_FTDS_MOSDOP_ENQUEUE", enqueTs);
 
-    size_t idx = std::hash<std::string> {}(opReq->get_oid().name) % queueNum;
     std::unique_lock<std::mutex> opReqLock;
     try {
         opReqLock = std::unique_lock<std::mutex>(opDispatcher[idx]->opQueueMutex, std::defer_lock);
@@ -696,23 +951,121 @@ uint32_t NetworkModule::EnqueueClientop(MOSDOp *opReq)
         ceph_assert("Lock queue mutex catch std::exception 1" == nullptr);
     }
 
-    if (opDispatcher[idx]->GetSize() > queueMaxCapacity) {
+    // DeferFast checked the queue, a fast op racing the defer thread may overshoot by one
+    if (!fast && opDispatcher[idx]->GetSize() > queueMaxCapacity) {
         SalogLimit(LV_WARNING, LOG_TYPE, "%d queue_capacity_is_large. %d", idx, opDispatcher[idx]->GetSize());
         opDispatcher[idx]->cond.wait(opReqLock);
     }
     uint64_t periodTs = 0;
     sa->FtdsStartHigh(SA_FTDS_QUEUE_PERIOD, "SA_FTDS_QUEUE_PERIOD", periodTs);
-    opDispatcher[idx]->EnQueue(opReq, ts, periodTs);
+    if (lanePolicy.metaWeight != 0) {
+        opDispatcher[idx]->EnQueue(opReq, ts, periodTs, OpLaneOf(*opReq), objHash, true);
+    } else {
+        opDispatcher[idx]->EnQueue(opReq, ts, periodTs);
+    }
     SaDatalog("MOSDOp is in the queue. tid=%ld obj=%s vec_index=%ld",
         opReq->get_tid(), opReq->get_oid().name.c_str(), idx);
     sa->FtdsEndHigt(SA_FTDS_MOSDOP_ENQUEUE, "SA_FTDS_MOSDOP_ENQUEUE", enqueTs, 0);
 
     if (qosParam.limitWrite && ContainWriteOp(*opReq)) {
-        LimitWrite(*opReq);
+        LimitWrite(*opReq, !fast);
     }
     return ret;
 }
 
+int NetworkModule::OpLaneOf(const MOSDOp &op)
+{
+    // omap, xattr, stat and class calls are small, anything moving object data is bulk
+    for (auto &i : op.ops) {
+        switch (i.op.op) {
+            case CEPH_OSD_OP_READ:
+            case CEPH_OSD_OP_SPARSE_READ:
+            case CEPH_OSD_OP_SYNC_READ:
+            case CEPH_OSD_OP_WRITE:
+            case CEPH_OSD_OP_WRITEFULL:
+            case CEPH_OSD_OP_APPEND:
+            case CEPH_OSD_OP_WRITESAME:
+            case CEPH_OSD_OP_ZERO:
+            case CEPH_OSD_OP_TRUNCATE:
+                return OP_LANE_DATA;
+            default:
+                break;
+        }
+    }
+    return OP_LANE_META;
+}
+
+void NetworkModule::SetLanePolicy(const OpLanePolicy &p)
+{
+    lanePolicy = p;
+    Salog(LV_WARNING, LOG_TYPE, "op lanes meta weight %u, data weight %u, starve %u ms", p.metaWeight, p.dataWeight,
+        p.starveMs);
+}
+
+void NetworkModule::SetBatchPolicy(const OpBatchPolicy &p)
+{
+    batchPolicy = p;
+    Salog(LV_WARNING, LOG_TYPE, "op batch max %u ops, linger %u us, global cache batch entry %s", p.maxOps,
+        p.lingerUs, HasBatchOps() ? "found" : "missing");
+}
+
+/*
+ * Throttles are taken for the whole batch before it goes out, so no op of
+ * it is counted while the thread sleeps on a throttle with the batch held.
+ * A copyup op always closes its batch, a later batch waits for it only when
+ * one of its ops is for the same object.
+ */
+void NetworkModule::SubmitBatch(OpBatcher &batch)
+{
+    std::vector<SaOpReq *> &ops = batch.Ops();
+    unsigned int writes = 0;
+    unsigned int reads = 0;
+    unsigned long int writeBytes = 0;
+    unsigned long int readBytes = 0;
+    for (SaOpReq *opreq : ops) {
+        if (opreq->optionType == GCACHE_WRITE) {
+            writes++;
+            writeBytes += opreq->optionLength;
+        } else if (opreq->optionType == GCACHE_READ) {
+            reads++;
+            readBytes += opreq->optionLength;
+        }
+    }
+    GetlwtCas(ops.size());
+    if (writes != 0) {
+        GetWritelwtCas(writes);
+        GetWriteBWCas(writeBytes);
+    }
+    if (reads != 0) {
+        GetReadlwtCas(reads);
+        GetReadBWCas(readBytes);
+    }
+    CopyupExecutor &copyup = GetCopyupExecutor();
+    if (unlikely(copyup.AnyPending())) {
+        for (SaOpReq *opreq : ops) {
+            if (!opreq->vecOps.empty()) {
+                copyup.WaitIdle(CopyupKey(opreq->poolId, opreq->vecOps[0].objName));
+            }
+        }
+    }
+    SaOpReq *last = ops.back();
+    if (unlikely(last->exitsCopyUp == 1 && !last->vecOps.empty())) {
+        SaDatalog("exists copyup, tid=%ld", last->tid);
+        copyup.Expect(CopyupKey(last->poolId, last->vecOps[0].objName), last->ptrMosdop);
+    }
+    if (ops.size() > 1 && HasBatchOps()) {
+        SaExportDoBatchOps(sa, ops.data(), ops.size());
+    } else {
+        for (SaOpReq *opreq : ops) {
+            sa->DoOneOps(*opreq);
+        }
+    }
+    for (uint64_t &ts : batch.Ts()) {
+        sa->FtdsEndHigt(SA_FTDS_OP_LIFE, "SA_FTDS_OP_LIFE", ts, 0);
+    }
+    batch.Clear();
+}
+
 bool NetworkModule::ContainWriteOp(const MOSDOp &op)
 {
     for (auto &i : op.ops) {
@@ -728,7 +1081,35 @@ void NetworkModule::SetQosParam(const QosParam &p)
     qosParam = p;
 }
 
-void NetworkModule::LimitWrite(const MOSDOp &op)
+void NetworkModule::UpdateQosParam(const QosParam &p)
+{
+    // enableThrottle is bound to the messengers at start and stays as it is
+    qosParam.limitWrite = p.limitWrite.load();
+    qosParam.getQuotaCycle = p.getQuotaCycle.load();
+    qosParam.saOpThrottle = p.saOpThrottle.load();
+    Salog(LV_WARNING, LOG_TYPE, "SA QoS updated limitWrite=%u, time_cyc=%u ms, opThrottle=%lu",
+        qosParam.limitWrite.load(), qosParam.getQuotaCycle.load(), qosParam.saOpThrottle.load());
+}
+
+void NetworkModule::SetQueueMaxCapacity(uint32_t capacity)
+{
+    uint32_t old = queueMaxCapacity.exchange(capacity);
+    if (capacity > old) {
+        // enqueuers parked on the old limit may go on now
+        for (auto &q : opDispatcher) {
+            std::lock_guard<std::mutex> l(q->opQueueMutex);
+            q->cond.notify_all();
+        }
+    }
+    Salog(LV_WARNING, LOG_TYPE, "queue max capacity %u -> %u", old, capacity);
+}
+
+void NetworkModule::SetTraceParam(const OpTraceParam &p)
+{
+    traceParam = p;
+}
+
+void NetworkModule::LimitWrite(const MOSDOp &op, bool canWait)
 {
     std::unique_lock<std::mutex> lock = std::unique_lock<std::mutex>(limitWriteMtx);
     high_resolution_clock::time_point nowTime = std::chrono::high_resolution_clock::now();
@@ -747,12 +1128,17 @@ void NetworkModule::LimitWrite(const MOSDOp &op)
             wcacheBW = qosInfo.writeRatio * (qosParam.getQuotaCycle / SA_THOUSAND_DEC);
         }
         if (qosInfo.writeRatio == 0) {
-            Salog(LV_INFORMATION, LOG_TYPE, "writeRatio==0, stop, sleep %u ms", qosParam.getQuotaCycle);
+            writeLimited = true;
+            if (!canWait) {
+                return;
+            }
+            Salog(LV_INFORMATION, LOG_TYPE, "writeRatio==0, stop, sleep %u ms", qosParam.getQuotaCycle.load());
             usleep(qosParam.getQuotaCycle * SA_THOUSAND_DEC);
             Salog(LV_INFORMATION, LOG_TYPE, "writeRatio==0, stop, finish sleep");
             continue;
         } else {
             periodBW = 0;
+            writeLimited = false;
             cycleBegin = std::chrono::high_resolution_clock::now();
             Salog(LV_DEBUG, LOG_TYPE, "writeRatio=%ld, collect write op len", qosInfo.writeRatio);
             break;
@@ -765,6 +1151,10 @@ void NetworkModule::LimitWrite(const MOSDOp &op)
     }
     Salog(LV_DEBUG, LOG_TYPE, "periodBW=%lu,wcacheBW=%lu", periodBW, wcacheBW);
     if (periodBW >= wcacheBW) {
+        writeLimited = true;
+        if (!canWait) {
+            return;
+        }
         nowTime = std::chrono::high_resolution_clock::now();
         timeInterval = std::chrono::duration_cast<std::chrono::milliseconds>(nowTime - cycleBegin);
         Salog(LV_DEBUG, LOG_TYPE, "nowTime=%lu,cycleBegin=%lu,timeInterval=%lu", nowTime, cycleBegin, timeInterval.count());
@@ -790,7 +1180,7 @@ void NetworkModule::Getlwt(unsigned int c)
     }
     while (unlikely(lwtCount > qosParam.saOpThrottle)) {
         getlwtLock.lock();
-        SalogLimit(LV_INFORMATION, LOG_TYPE, "%lu > %lu, sleep 10ms", lwtCount, qosParam.saOpThrottle);
+        SalogLimit(LV_INFORMATION, LOG_TYPE, "%lu > %lu, sleep 10ms", lwtCount, qosParam.saOpThrottle.load());
         usleep(10 * SA_THOUSAND_DEC);
         getlwtLock.unlock();
     }
@@ -808,29 +1198,38 @@ void NetworkModule::Putlwt()
 }
 void NetworkModule::GetlwtCas(unsigned int c)
 {
-    if (qosParam.saOpThrottle == 0) {
-        return;
-    }
+    // ops are counted even with the throttle off, so it can be switched on live
     uint64_t oldCount = lwtCount;
     while (!__sync_bool_compare_and_swap(&lwtCount, oldCount, oldCount + c)) {
         oldCount = lwtCount;
     }
+    uint64_t opThrottle = qosParam.saOpThrottle;
+    if (opThrottle == 0) {
+        return;
+    }
     if (unlikely((lwtCount % 500 == 0) && (lwtCount > 0))) {
         SalogLimit(LV_INFORMATION, LOG_TYPE, "get lwtCount=%lu", oldCount);
     }
-    while (unlikely(oldCount > qosParam.saOpThrottle)) {
-        Salog(LV_INFORMATION, LOG_TYPE, "%lu > %lu, sleep 10ms", oldCount, qosParam.saOpThrottle);
+    while (unlikely(oldCount > opThrottle)) {
+        Salog(LV_INFORMATION, LOG_TYPE, "%lu > %lu, sleep 10ms", oldCount, opThrottle);
         usleep(10 * SA_THOUSAND_DEC);
         oldCount = lwtCount;
+        opThrottle = qosParam.saOpThrottle;
+        if (opThrottle == 0) {
+            return;
+        }
     }
 }
 void NetworkModule::PutlwtCas()
 {
-    if (qosParam.saOpThrottle == 0) {
+    if (lwtCount == 0) {
         return;
     }
     uint64_t oldCount = lwtCount;
     while (!__sync_bool_compare_and_swap(&lwtCount, oldCount, oldCount - 1)) {
+        if (lwtCount == 0) {
+            return;
+        }
         oldCount = lwtCount;
     }
     if (unlikely((lwtCount % 500 == 0) && (lwtCount > 0))) {
@@ -1121,6 +1520,13 @@ void FinishCacheOps(void *op, uint32_t optionType, uint64_t optionLength, int32_
         Salog(LV_ERROR, LOG_TYPE, " finish. but mosdop is null");
         return;
     }
+    uint32_t outBytes = 0;
+    OpTraceRecorder *trace = g_opTrace;
+    if (unlikely(trace != nullptr)) {
+        for (auto &i : ptr->ops) {
+            outBytes += i.outdata.length();
+        }
+    }
     MOSDOpReply *reply = new MOSDOpReply(ptr, 0, 0, 0, false);
     reply->claim_op_out_data(ptr->ops);
     reply->set_result(r);
@@ -1130,11 +1536,19 @@ void FinishCacheOps(void *op, uint32_t optionType, uint64_t optionLength, int32_
     ptr->osa_tick.SetSendStart(ptr);
 #endif
     con->send_message(reply);
+    if (unlikely(trace != nullptr)) {
+        trace->RecordReply(ptr, r, outBytes);
+    }
     string source;
 #ifdef SA_PERF
     g_msgPerf->set_send(ptr->osa_tick.SetSendEnd(ptr, source));
     g_msgPerf->set_Total(ptr->osa_tick.GetMsgLife(ptr));
 #endif
+    // ops of the object queued behind a copyup wait until it is answered, however it ended
+    CopyupExecutor &copyup = GetCopyupExecutor();
+    if (unlikely(copyup.AnyPending())) {
+        copyup.Release(ptr);
+    }
     ptr->put();
     if (likely(g_networkModule != nullptr)) {
         if (optionType == GCACHE_WRITE) {
@@ -1186,41 +1600,23 @@ void EncodeOmapGetkeys(const SaBatchKeys *batchKeys, int i, MOSDOp *mosdop)
 
 void EncodeOmapGetvals(const SaBatchKv *KVs, int i, MOSDOp *mosdop)
 {
-    bufferlist bl;
     if (mosdop == nullptr || KVs == nullptr) {
         Salog(LV_ERROR, LOG_TYPE, " mosdop %p or KVs %p is null, skip", mosdop, KVs);
         return;
     }
     Salog(LV_DEBUG, LOG_TYPE, "CEPH_OSD_OP_OMAPGETVALS get key num=%d", KVs->kvNum);
-    for (uint32_t j = 0; j < KVs->kvNum; j++) {
-        if (KVs->keys[j].buf && KVs->keys[j].len) {
-            Salog(LV_DEBUG, LOG_TYPE, "CEPH_OSD_OP_OMAPGETVALS get key KVs->keys[j].buf=%s", KVs->keys[j].buf);
-            encode(std::string_view(KVs->keys[j].buf, KVs->keys[j].len), bl);
-        }
-        if (KVs->values[j].buf && KVs->values[j].len) {
-            Salog(LV_DEBUG, LOG_TYPE, "CEPH_OSD_OP_OMAPGETVALS get key KVs->keys[j].buf=%s", KVs->values[j].buf);
-            encode(std::string_view(KVs->values[j].buf, KVs->values[j].len), bl);
-        }
-    }
-    encode(KVs->kvNum, mosdop->ops[i].outdata);
-    mosdop->ops[i].outdata.claim_append(bl);
+    // empty values are encoded too, skipping them left the count out of step with the entries
+    EncodeKvMap(KVs, mosdop->ops[i].outdata);
     encode(false, mosdop->ops[i].outdata);
 }
 
 void EncodeOmapGetvalsbykeys(const SaBatchKv *keyValue, int i, MOSDOp *mosdop)
 {
-    map<string, bufferlist> out;
     if (mosdop == nullptr || keyValue == nullptr) {
         Salog(LV_ERROR, LOG_TYPE, " mosdop %p or keyValue %p is null, skip", mosdop, keyValue);
         return;
     }
-    for (uint32_t j = 0; j < keyValue->kvNum; j++) {
-        bufferlist value;
-        string keys(keyValue->keys[j].buf, keyValue->keys[j].len);
-        value.append(keyValue->values[j].buf, keyValue->values[j].len);
-        out.insert(make_pair(keys, value));
-    }
-    encode(out, mosdop->ops[i].outdata);
+    EncodeKvMap(keyValue, mosdop->ops[i].outdata);
 }
 
 void EncodeRead(uint64_t opType, unsigned int offset, unsigned int len, const char *buf, unsigned int bufLen, int i,
@@ -1240,6 +1636,24 @@ void EncodeRead(uint64_t opType, unsigned int offset, unsigned int len, const ch
     }
 }
 
+void EncodeReadZeroCopy(uint64_t opType, unsigned int offset, unsigned int len, char *buf, unsigned int bufLen,
+    RELEASE_FUNC release, void *releaseArg, int i, MOSDOp *mosdop)
+{
+    // the raw owns the lent memory from here, so even a bad call hands it back
+    bufferptr data(new CacheLentRaw(buf, bufLen, release, releaseArg));
+    if (mosdop == nullptr) {
+        Salog(LV_ERROR, LOG_TYPE, " mosdop %p is null, skip", mosdop);
+        return;
+    }
+    if (unlikely(opType == CEPH_OSD_OP_SPARSE_READ)) {
+        std::map<uint64_t, uint64_t> extents;
+        extents[offset] = len;
+        encode(extents, mosdop->ops[i].outdata);
+        encode(bufLen, mosdop->ops[i].outdata);
+    }
+    mosdop->ops[i].outdata.push_back(std::move(data));
+}
+
 void EncodeXattrGetXattr(const SaBatchKv *keyValue, int i, MOSDOp *mosdop)
 {
     if (mosdop == nullptr || keyValue == nullptr) {
@@ -1259,16 +1673,7 @@ void EncodeXattrGetXattrs(const SaBatchKv *keyValue, int i, MOSDOp *mosdop)
         Salog(LV_ERROR, LOG_TYPE, " mosdop %p or keyValue %p is null, skip", mosdop, keyValue);
         return;
     }
-    map<string, bufferlist> out;
-    bufferlist bl;
-    for (uint32_t j = 0; j < keyValue->kvNum; j++) {
-        bufferlist value;
-        string keys(keyValue->keys[j].buf, keyValue->keys[j].len);
-        value.append(keyValue->values[j].buf, keyValue->values[j].len);
-        out.insert(make_pair(keys, value));
-    }
-    encode(out, bl);
-    mosdop->ops[i].outdata.claim_append(bl);
+    EncodeKvMap(keyValue, mosdop->ops[i].outdata);
 }
 
 void EncodeGetOpstat(uint64_t psize, time_t ptime, int i, MOSDOp *mosdop)
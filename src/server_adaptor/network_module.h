@@ -7,10 +7,14 @@
 #ifndef NETWORK_MODULE_H
 #define NETWORK_MODULE_H
 
+#include <atomic>
+#include <deque>
 #include <queue>
 #include <pthread.h>
+#include <shared_mutex>
 #include <thread>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <chrono>
 #include <messages/MOSDOp.h>
@@ -19,14 +23,32 @@
 #include "sa_server_dispatcher.h"
 #include "sa_def.h"
 #include "client_op_queue.h" 
+#include "op_batch.h"
 #include "msg_perf_record.h"
+#include "op_trace.h"
+#include "thread_placement.h"
 #include "sa_export.h"
 
+// limitWrite, getQuotaCycle and saOpThrottle can be changed live by OsaConfigReload
 struct QosParam {
-    uint32_t limitWrite { 0 };
-    uint32_t getQuotaCycle { 200 };
+    std::atomic<uint32_t> limitWrite { 0 };
+    std::atomic<uint32_t> getQuotaCycle { 200 };
     uint32_t enableThrottle { 0 };
-    uint64_t saOpThrottle { 5000 };
+    std::atomic<uint64_t> saOpThrottle { 5000 };
+
+    QosParam() {}
+    QosParam(const QosParam &p)
+    {
+        *this = p;
+    }
+    QosParam &operator=(const QosParam &p)
+    {
+        limitWrite = p.limitWrite.load();
+        getQuotaCycle = p.getQuotaCycle.load();
+        enableThrottle = p.enableThrottle;
+        saOpThrottle = p.saOpThrottle.load();
+        return *this;
+    }
 };
 
 typedef struct CloneInfo {
@@ -74,16 +96,37 @@ class NetworkModule {
     bool testMosdop { false };
 
     uint64_t queueNum { 0 };
-    uint32_t queueMaxCapacity { 0 };
+    std::atomic<uint32_t> queueMaxCapacity { 0 };
     std::vector<std::thread> doOpThread {};
     std::vector<ClientOpQueue *> opDispatcher {};
     std::vector<bool> finishThread {};
+    // queue affinity: ops a worker could not enqueue without waiting, per shard in arrival order
+    struct DeferredOps {
+        std::mutex mtx;
+        std::condition_variable cond;
+        std::deque<MOSDOp *> ops;
+    };
+    std::vector<DeferredOps *> deferred {};
+    std::vector<std::thread> deferThread {};
+    std::atomic<bool> deferStop { false };
+    // shard of each connection, taken from the worker its first op arrived on
+    std::shared_mutex connShardMtx;
+    std::unordered_map<const Connection *, size_t> connShard;
     std::vector<int> coreId;
     uint32_t msgrNum { 5 };
     uint32_t bindMsgrCore { 0 };
     uint32_t bindSaCore { 0 };
+    std::string placementIf;
+    bool autoPlacement { false };
+    ThreadPlacement *placement { nullptr };
+    bool queueAffinity { false };
+    OpLanePolicy lanePolicy;
+    OpBatchPolicy batchPolicy;
+    bool legacyOpArgs { true };
 
     MsgPerfRecord *msgPerf { nullptr};
+    OpTraceParam traceParam;
+    OpTraceRecorder *opTrace { nullptr };
 
     std::vector<Throttle *> vecMsgThrottler;
     std::vector<Throttle *> vecByteThrottler;
@@ -101,6 +144,8 @@ class NetworkModule {
     SaWcacheQosInfo qosInfo { 0 };
     std::mutex limitWriteMtx;
     std::condition_variable limitWriteCond {};
+    // write quota of the cycle used up, fast dispatch defers writes until it renews
+    std::atomic<bool> writeLimited { false };
 
     volatile uint64_t lwtCount { 0 };
     std::mutex lwtCountMtx;
@@ -125,6 +170,12 @@ class NetworkModule {
 
     bool ContainWriteOp(const MOSDOp &op);
 
+    size_t ShardOf(const Connection *con);
+    bool DeferFast(MOSDOp *opReq, size_t shard, size_t idx);
+    void DeferThread(size_t shard);
+    size_t SelectQueue(const MOSDOp &op, size_t objHash);
+    int OpLaneOf(const MOSDOp &op);
+
 public:
     NetworkModule() = delete;
 
@@ -159,11 +210,19 @@ public:
         if (msgPerf) {
             delete msgPerf;
         }
+        if (opTrace) {
+            delete opTrace;
+        }
+        if (placement) {
+            delete placement;
+        }
     }
 
     int InitNetworkModule(const std::string &rAddr, const std::vector<std::string> &rPort, const std::string &sAddr,
         const std::string &sPort, int *bind);
 
+    void SubmitBatch(OpBatcher &batch);
+
     int FinishNetworkModule();
 
     int ThreadFuncBodyServer();
@@ -175,10 +234,50 @@ public:
     {
         return ptrMsgModule;
     }
-    uint32_t EnqueueClientop(MOSDOp *opReq);
+    // fast is set on the messenger worker, which must not wait for queue room or write quota:
+    // such an op and the ones after it of the same shard are enqueued by the shard's defer thread
+    uint32_t EnqueueClientop(MOSDOp *opReq, bool fast = false);
+    void ForgetConnection(const Connection *con);
 
     void SetQosParam(const QosParam &p);
-    void LimitWrite(const MOSDOp &op);
+    void UpdateQosParam(const QosParam &p);
+    const QosParam &GetQosParam()
+    {
+        return qosParam;
+    }
+    void SetQueueMaxCapacity(uint32_t capacity);
+    uint32_t GetQueueMaxCapacity()
+    {
+        return queueMaxCapacity;
+    }
+    void SetTraceParam(const OpTraceParam &p);
+    // before CreateWorkThread
+    void SetLanePolicy(const OpLanePolicy &p);
+    // before CreateWorkThread
+    void SetBatchPolicy(const OpBatchPolicy &p);
+    // before InitNetworkModule, off leaves ops with typed args out of keys/values
+    void SetLegacyOpArgs(bool on)
+    {
+        legacyOpArgs = on;
+    }
+    // before CreateWorkThread, replaces bind_core/bind_queue_core
+    void SetAutoPlacement(const std::string &ifName);
+    bool IsAutoPlacement()
+    {
+        return placement != nullptr;
+    }
+    // called on messenger threads, pins the caller once
+    void PlaceMsgrThread();
+    // run to completion: ops are enqueued on the messenger worker into the queues it owns
+    void SetQueueAffinity(bool on)
+    {
+        queueAffinity = on;
+    }
+    bool IsQueueAffinity()
+    {
+        return queueAffinity;
+    }
+    void LimitWrite(const MOSDOp &op, bool canWait = true);
     void Getlwt(unsigned int c = 1);
     void Putlwt();
     void GetlwtCas(unsigned int c = 1);
@@ -209,6 +308,8 @@ void EncodeOmapGetvals(const SaBatchKv *KVs, int i, MOSDOp *mosdop);
 void EncodeOmapGetvalsbykeys(const SaBatchKv *keyValue, int i, MOSDOp *mosdop);
 void EncodeRead(uint64_t opType, unsigned int offset, unsigned int len, const char *buf, unsigned int bufLen, int i,
     MOSDOp *mosdop);
+void EncodeReadZeroCopy(uint64_t opType, unsigned int offset, unsigned int len, char *buf, unsigned int bufLen,
+    RELEASE_FUNC release, void *releaseArg, int i, MOSDOp *mosdop);
 void SetOpResult(int i, int32_t ret, MOSDOp *op);
 void EncodeXattrGetXattr(const SaBatchKv *keyValue, int i, MOSDOp *mosdop);
 void EncodeXattrGetXattrs(const SaBatchKv *keyValue, int i, MOSDOp *mosdop);
@@ -0,0 +1,103 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef OP_BATCH_H
+#define OP_BATCH_H
+#include <vector>
+#include <algorithm>
+
+#include "common/ceph_time.h"
+#include "sa_def.h"
+
+/* maxOps 1 keeps one DoOneOps call per op */
+struct OpBatchPolicy {
+    uint32_t maxOps { 1 };
+    uint32_t lingerUs { 0 };
+};
+
+/*
+ * Ops of one queue thread waiting to be handed to the global cache in a
+ * single call, in dequeue order. The target size follows the average round
+ * the thread drains, so a shallow queue submits at once and a deep one waits
+ * up to lingerUs for the batch to fill.
+ */
+class OpBatcher {
+    static const uint32_t DEPTH_SHIFT = 3;
+
+    OpBatchPolicy policy;
+    std::vector<SaOpReq *> ops;
+    std::vector<uint64_t> ts;
+    ceph::mono_time first;
+    // moving average of the drained round size, fixed point
+    uint32_t depthAvg { 1 << DEPTH_SHIFT };
+
+public:
+    void SetPolicy(const OpBatchPolicy &p)
+    {
+        policy = p;
+        ops.reserve(p.maxOps);
+        ts.reserve(p.maxOps);
+    }
+
+    void Observe(size_t depth)
+    {
+        uint32_t d = std::min<size_t>(depth, policy.maxOps);
+        depthAvg = depthAvg - (depthAvg >> DEPTH_SHIFT) + d;
+    }
+
+    uint32_t Target() const
+    {
+        return std::max<uint32_t>(1, std::min(depthAvg >> DEPTH_SHIFT, policy.maxOps));
+    }
+
+    void Add(SaOpReq *op, uint64_t t)
+    {
+        if (ops.empty()) {
+            first = ceph::mono_clock::now();
+        }
+        ops.push_back(op);
+        ts.push_back(t);
+    }
+
+    bool Full() const
+    {
+        return ops.size() >= policy.maxOps;
+    }
+
+    bool Pending() const
+    {
+        return !ops.empty();
+    }
+
+    ceph::mono_time Deadline() const
+    {
+        return first + std::chrono::microseconds(policy.lingerUs);
+    }
+
+    // worth waiting for more ops before submitting
+    bool Linger() const
+    {
+        return !ops.empty() && policy.lingerUs != 0 && ops.size() < Target() &&
+            ceph::mono_clock::now() < Deadline();
+    }
+
+    std::vector<SaOpReq *> &Ops()
+    {
+        return ops;
+    }
+
+    std::vector<uint64_t> &Ts()
+    {
+        return ts;
+    }
+
+    void Clear()
+    {
+        ops.clear();
+        ts.clear();
+    }
+};
+#endif
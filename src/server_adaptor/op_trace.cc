@@ -0,0 +1,368 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "op_trace.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include "include/encoding.h"
+#include "messages/MOSDOp.h"
+#include "salog.h"
+
+using namespace std;
+
+namespace {
+const string LOG_TYPE = "OP_TRACE";
+const uint32_t OP_TRACE_MAGIC_LEN = 8;
+const uint32_t OP_TRACE_HEADER_LEN = OP_TRACE_MAGIC_LEN + sizeof(uint32_t) * 2 + sizeof(uint64_t);
+const uint32_t OP_TRACE_RECORD_HEADER_LEN = sizeof(uint8_t) + sizeof(uint32_t);
+const uint64_t OP_TRACE_FLUSH_BYTES = 1ULL << 20;
+// records are dropped instead of blocking the dispatcher when the disk falls behind
+const uint64_t OP_TRACE_MAX_PENDING = 64ULL << 20;
+const uint32_t OP_TRACE_FLUSH_MS = 100;
+const uint32_t OP_TRACE_MAX_RECORD = 64U << 20;
+
+bool IsDataWrite(uint16_t op)
+{
+    return op == CEPH_OSD_OP_WRITE || op == CEPH_OSD_OP_WRITEFULL || op == CEPH_OSD_OP_APPEND ||
+        op == CEPH_OSD_OP_WRITESAME;
+}
+}
+
+OpTraceRecorder *g_opTrace = nullptr;
+
+void OpTraceOp::Encode(bufferlist &bl, uint32_t traceFlags) const
+{
+    using ceph::encode;
+    encode(tsNs, bl);
+    encode(connId, bl);
+    encode(tid, bl);
+    encode(pool, bl);
+    encode(hash, bl);
+    encode(pgSeed, bl);
+    encode(flags, bl);
+    encode(nspace, bl);
+    encode(oid, bl);
+    encode(static_cast<uint16_t>(ops.size()), bl);
+    for (auto &sub : ops) {
+        bl.append(reinterpret_cast<const char *>(&sub.op), sizeof(sub.op));
+        encode(sub.indataLen, bl);
+        encode(static_cast<uint8_t>(sub.hasIndata), bl);
+        encode(sub.indata, bl);
+        if (traceFlags & OP_TRACE_FLAG_PAYLOAD_HASH) {
+            encode(sub.crc, bl);
+        }
+    }
+}
+
+void OpTraceOp::Decode(bufferlist::const_iterator &p, uint32_t traceFlags)
+{
+    using ceph::decode;
+    decode(tsNs, p);
+    decode(connId, p);
+    decode(tid, p);
+    decode(pool, p);
+    decode(hash, p);
+    decode(pgSeed, p);
+    decode(flags, p);
+    decode(nspace, p);
+    decode(oid, p);
+    uint16_t num = 0;
+    decode(num, p);
+    ops.resize(num);
+    for (auto &sub : ops) {
+        p.copy(sizeof(sub.op), reinterpret_cast<char *>(&sub.op));
+        decode(sub.indataLen, p);
+        uint8_t has = 0;
+        decode(has, p);
+        sub.hasIndata = has != 0;
+        sub.indata.clear();
+        decode(sub.indata, p);
+        if (traceFlags & OP_TRACE_FLAG_PAYLOAD_HASH) {
+            decode(sub.crc, p);
+        }
+    }
+}
+
+void OpTraceReply::Encode(bufferlist &bl) const
+{
+    using ceph::encode;
+    encode(tsNs, bl);
+    encode(connId, bl);
+    encode(tid, bl);
+    encode(result, bl);
+    encode(outBytes, bl);
+}
+
+void OpTraceReply::Decode(bufferlist::const_iterator &p)
+{
+    using ceph::decode;
+    decode(tsNs, p);
+    decode(connId, p);
+    decode(tid, p);
+    decode(result, p);
+    decode(outBytes, p);
+}
+
+OpTraceRecorder::~OpTraceRecorder()
+{
+    Stop();
+}
+
+int OpTraceRecorder::Start()
+{
+    fd = ::open(param.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        int ret = -errno;
+        Salog(LV_ERROR, LOG_TYPE, "open op trace %s failed %d", param.path.c_str(), ret);
+        return ret;
+    }
+    uint32_t flags = param.payloadHash ? OP_TRACE_FLAG_PAYLOAD_HASH : 0;
+    char magic[OP_TRACE_MAGIC_LEN] = OP_TRACE_MAGIC;
+    bufferlist header;
+    header.append(magic, sizeof(magic));
+    encode(static_cast<uint32_t>(OP_TRACE_VERSION), header);
+    encode(flags, header);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    encode(static_cast<uint64_t>(ts.tv_sec * 1000000000ULL + ts.tv_nsec), header);
+    int ret = header.write_fd(fd);
+    if (ret < 0) {
+        Salog(LV_ERROR, LOG_TYPE, "write op trace header failed %d", ret);
+        ::close(fd);
+        fd = -1;
+        return ret;
+    }
+    written = header.length();
+    start = ceph::mono_clock::now();
+    writer = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "sa_op_trace");
+        WriterThread();
+    });
+    Salog(LV_WARNING, LOG_TYPE, "op trace to %s, max %lu bytes, payload hash %u", param.path.c_str(),
+        param.maxBytes, param.payloadHash);
+    return 0;
+}
+
+void OpTraceRecorder::Stop()
+{
+    {
+        std::lock_guard<std::mutex> l(lock);
+        if (stop) {
+            return;
+        }
+        stop = true;
+        cond.notify_one();
+    }
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+        fd = -1;
+    }
+    Salog(LV_WARNING, LOG_TYPE, "op trace stopped, %lu records %lu bytes, %lu dropped", records.load(), written,
+        dropped.load());
+}
+
+void OpTraceRecorder::WriterThread()
+{
+    std::unique_lock<std::mutex> l(lock);
+    while (true) {
+        if (pending.length() == 0) {
+            if (stop) {
+                break;
+            }
+            cond.wait_for(l, std::chrono::milliseconds(OP_TRACE_FLUSH_MS));
+            continue;
+        }
+        bufferlist bl;
+        bl.swap(pending);
+        l.unlock();
+        int ret = bl.write_fd(fd);
+        l.lock();
+        if (ret < 0) {
+            Salog(LV_ERROR, LOG_TYPE, "write op trace failed %d, tracing stops", ret);
+            full = true;
+            continue;
+        }
+        written += bl.length();
+    }
+}
+
+uint32_t OpTraceRecorder::GetConnId(const Connection *con, bool create)
+{
+    std::lock_guard<std::mutex> l(lock);
+    auto it = connIds.find(con);
+    if (it != connIds.end()) {
+        return it->second;
+    }
+    if (!create) {
+        return UINT32_MAX;
+    }
+    connIds[con] = nextConnId;
+    return nextConnId++;
+}
+
+void OpTraceRecorder::ResetConnection(const Connection *con)
+{
+    std::lock_guard<std::mutex> l(lock);
+    connIds.erase(con);
+}
+
+void OpTraceRecorder::Append(uint8_t type, bufferlist &body)
+{
+    bufferlist bl;
+    encode(type, bl);
+    encode(static_cast<uint32_t>(body.length()), bl);
+    bl.claim_append(body);
+
+    std::lock_guard<std::mutex> l(lock);
+    if (stop || full || pending.length() + bl.length() > OP_TRACE_MAX_PENDING) {
+        dropped++;
+        return;
+    }
+    if (written + pending.length() + bl.length() > param.maxBytes) {
+        full = true;
+        dropped++;
+        Salog(LV_WARNING, LOG_TYPE, "op trace reached %lu bytes, tracing stops", param.maxBytes);
+        return;
+    }
+    pending.claim_append(bl);
+    records++;
+    if (pending.length() >= OP_TRACE_FLUSH_BYTES) {
+        cond.notify_one();
+    }
+}
+
+void OpTraceRecorder::RecordOp(MOSDOp *m)
+{
+    OpTraceOp rec;
+    rec.tsNs = std::chrono::duration_cast<std::chrono::nanoseconds>(ceph::mono_clock::now() - start).count();
+    rec.connId = GetConnId(m->get_connection().get(), true);
+    rec.tid = m->get_tid();
+    const hobject_t &hobj = m->get_hobj();
+    rec.pool = hobj.pool;
+    rec.hash = hobj.get_hash();
+    rec.pgSeed = m->get_pg().ps();
+    rec.flags = m->get_flags();
+    rec.nspace = hobj.nspace;
+    rec.oid = hobj.oid.name;
+    rec.ops.resize(m->ops.size());
+    for (size_t i = 0; i < m->ops.size(); i++) {
+        OSDOp &osdop = m->ops[i];
+        OpTraceSubOp &sub = rec.ops[i];
+        sub.op = osdop.op;
+        sub.indataLen = osdop.indata.length();
+        sub.hasIndata = !IsDataWrite(osdop.op.op) && sub.indataLen <= param.maxIndata;
+        if (sub.hasIndata) {
+            sub.indata = osdop.indata;
+        } else if (osdop.op.op == CEPH_OSD_OP_CALL) {
+            uint32_t names = osdop.op.cls.class_len + osdop.op.cls.method_len;
+            sub.indata.substr_of(osdop.indata, 0, std::min(names, sub.indataLen));
+        }
+        if (param.payloadHash) {
+            sub.crc = osdop.indata.crc32c(0);
+        }
+    }
+    bufferlist body;
+    rec.Encode(body, param.payloadHash ? OP_TRACE_FLAG_PAYLOAD_HASH : 0);
+    Append(OP_TRACE_RECORD_OP, body);
+}
+
+void OpTraceRecorder::RecordReply(MOSDOp *m, int32_t result, uint32_t outBytes)
+{
+    OpTraceReply rec;
+    rec.tsNs = std::chrono::duration_cast<std::chrono::nanoseconds>(ceph::mono_clock::now() - start).count();
+    rec.connId = GetConnId(m->get_connection().get(), false);
+    if (rec.connId == UINT32_MAX) {
+        return;
+    }
+    rec.tid = m->get_tid();
+    rec.result = result;
+    rec.outBytes = outBytes;
+    bufferlist body;
+    rec.Encode(body);
+    Append(OP_TRACE_RECORD_REPLY, body);
+}
+
+OpTraceReader::~OpTraceReader()
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+int OpTraceReader::Open(const string &path)
+{
+    file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return -errno;
+    }
+    char buf[OP_TRACE_HEADER_LEN];
+    if (fread(buf, 1, sizeof(buf), file) != sizeof(buf) || memcmp(buf, OP_TRACE_MAGIC, OP_TRACE_MAGIC_LEN) != 0) {
+        return -EINVAL;
+    }
+    bufferlist bl;
+    bl.append(buf + OP_TRACE_MAGIC_LEN, sizeof(buf) - OP_TRACE_MAGIC_LEN);
+    auto p = bl.cbegin();
+    uint32_t version = 0;
+    decode(version, p);
+    decode(flags, p);
+    decode(startNs, p);
+    if (version > OP_TRACE_VERSION) {
+        return -EOPNOTSUPP;
+    }
+    return 0;
+}
+
+int OpTraceReader::Next(uint8_t &type, OpTraceOp &op, OpTraceReply &reply)
+{
+    while (true) {
+        char head[OP_TRACE_RECORD_HEADER_LEN];
+        size_t n = fread(head, 1, sizeof(head), file);
+        if (n == 0 && feof(file)) {
+            return 0;
+        }
+        if (n != sizeof(head)) {
+            return -EIO;
+        }
+        bufferlist hbl;
+        hbl.append(head, sizeof(head));
+        auto hp = hbl.cbegin();
+        uint32_t len = 0;
+        decode(type, hp);
+        decode(len, hp);
+        if (len > OP_TRACE_MAX_RECORD) {
+            return -EINVAL;
+        }
+        bufferptr body(len);
+        if (len != 0 && fread(body.c_str(), 1, len, file) != len) {
+            return -EIO;
+        }
+        bufferlist bl;
+        bl.append(std::move(body));
+        auto p = bl.cbegin();
+        try {
+            if (type == OP_TRACE_RECORD_OP) {
+                op.Decode(p, flags);
+                return 1;
+            }
+            if (type == OP_TRACE_RECORD_REPLY) {
+                reply.Decode(p);
+                return 1;
+            }
+        } catch (const buffer::error &e) {
+            return -EINVAL;
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef OP_TRACE_H
+#define OP_TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <cstdio>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_time.h"
+#include "include/buffer.h"
+#include "include/rados.h"
+
+class MOSDOp;
+class Connection;
+
+/*
+ * Trace file layout, little endian:
+ *   header  "SAOPTRC\0", u32 version, u32 flags, u64 start realtime ns
+ *   records u8 type, u32 body length, body
+ * Unknown record types are skipped by length, so newer writers stay readable.
+ */
+#define OP_TRACE_MAGIC "SAOPTRC"
+#define OP_TRACE_VERSION 1
+#define OP_TRACE_FLAG_PAYLOAD_HASH 0x1
+
+enum OpTraceRecordType {
+    OP_TRACE_RECORD_OP = 1,
+    OP_TRACE_RECORD_REPLY = 2,
+};
+
+struct OpTraceParam {
+    std::string path {};
+    uint64_t maxBytes { 1ULL << 30 };
+    uint32_t maxIndata { 4096 };
+    uint32_t payloadHash { 0 };
+};
+
+struct OpTraceSubOp {
+    ceph_osd_op op {};
+    uint32_t indataLen { 0 };
+    // small metadata payloads are kept whole so the op can be rebuilt, large ones
+    // keep only their class/method prefix and are padded back to indataLen on replay
+    bool hasIndata { false };
+    ceph::bufferlist indata;
+    uint32_t crc { 0 };
+};
+
+struct OpTraceOp {
+    uint64_t tsNs { 0 };
+    uint32_t connId { 0 };
+    uint64_t tid { 0 };
+    int64_t pool { 0 };
+    uint32_t hash { 0 };
+    uint32_t pgSeed { 0 };
+    uint32_t flags { 0 };
+    std::string nspace;
+    std::string oid;
+    std::vector<OpTraceSubOp> ops;
+
+    void Encode(ceph::bufferlist &bl, uint32_t traceFlags) const;
+    void Decode(ceph::bufferlist::const_iterator &p, uint32_t traceFlags);
+};
+
+struct OpTraceReply {
+    uint64_t tsNs { 0 };
+    uint32_t connId { 0 };
+    uint64_t tid { 0 };
+    int32_t result { 0 };
+    uint32_t outBytes { 0 };
+
+    void Encode(ceph::bufferlist &bl) const;
+    void Decode(ceph::bufferlist::const_iterator &p);
+};
+
+class OpTraceRecorder {
+    OpTraceParam param;
+    int fd { -1 };
+    ceph::mono_time start;
+    std::thread writer;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    ceph::bufferlist pending;
+    bool stop { false };
+    bool full { false };
+    uint64_t written { 0 };
+    std::map<const Connection *, uint32_t> connIds;
+    uint32_t nextConnId { 0 };
+
+    std::atomic<uint64_t> records { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+
+    uint32_t GetConnId(const Connection *con, bool create);
+    void Append(uint8_t type, ceph::bufferlist &body);
+    void WriterThread();
+
+public:
+    explicit OpTraceRecorder(const OpTraceParam &p) : param(p) {}
+    ~OpTraceRecorder();
+
+    int Start();
+    void Stop();
+    void RecordOp(MOSDOp *m);
+    void RecordReply(MOSDOp *m, int32_t result, uint32_t outBytes);
+    void ResetConnection(const Connection *con);
+};
+
+extern OpTraceRecorder *g_opTrace;
+
+class OpTraceReader {
+    FILE *file { nullptr };
+    uint32_t flags { 0 };
+    uint64_t startNs { 0 };
+
+public:
+    OpTraceReader() {}
+    ~OpTraceReader();
+
+    int Open(const std::string &path);
+    uint64_t GetStartNs()
+    {
+        return startNs;
+    }
+    // returns 1 with a record, 0 at the end of the trace, negative on a damaged file
+    int Next(uint8_t &type, OpTraceOp &op, OpTraceReply &reply);
+};
+
+#endif
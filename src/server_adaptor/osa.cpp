@@ -13,23 +13,28 @@
 #include <global/global_init.h>
 
 #include "network_module.h"
+#include "copyup_executor.h"
 #include "config_read.h"
+#include "config_reload.h"
 #include "salog.h" 
 #include "osa.h"
 
 using namespace std;
 
 NetworkModule *g_ptrNetwork = nullptr;
+OsaConfigReload *g_ptrConfReload = nullptr;
 namespace {
 const string LOG_TYPE = "SAO_INTERFACE";
 const int ERROR_PORT = 101;
 const int ERROR_BIND = 102;
 const uint32_t SA_QUEUE_MAX_NUM = 5000;
 const uint32_t SA_QUEUE_MIN_NUM = 4;
-const uint32_t SA_QUEUE_MAX_CAPACITY = 1024;
-const uint32_t SA_QUEUE_MIN_CAPACITY = 1;
 const uint32_t SA_MSGR_MAX_NUM = 16;
 const uint32_t SA_MSGR_MIN_NUM = 3;
+const uint32_t SA_LANE_MAX_WEIGHT = 1024;
+const uint32_t SA_BATCH_MAX_OPS = 256;
+const uint32_t SA_BATCH_MAX_LINGER_US = 10000;
+const string SA_CONF_PATH = "/opt/gcache/conf/gcache.conf";
 }
 
 ClassHandler *rpc_handler = nullptr;
@@ -194,9 +199,7 @@ int OSA_Init(SaExport &sa)
     }
    
     uint32_t queueMaxCapacity = readConfig.GetQueueMaxCapacity();
-    if (queueMaxCapacity > SA_QUEUE_MAX_CAPACITY || queueMaxCapacity < SA_QUEUE_MIN_CAPACITY) {
-	Salog(LV_CRITICAL, LOG_TYPE, "error : queueMaxCapacity number is %d should between %d~%d", queueMaxCapacity,
-			SA_QUEUE_MIN_CAPACITY, SA_QUEUE_MAX_CAPACITY);
+    if (!OsaCheckQueueMaxCapacity(queueMaxCapacity)) {
 	return ERROR_PORT;
     }
 
@@ -209,7 +212,8 @@ int OSA_Init(SaExport &sa)
 
     uint32_t bindCore = readConfig.GetBindCore();
     uint32_t bindSaCore = readConfig.GetBindQueueCore();
-    Salog(LV_WARNING, LOG_TYPE, "core binding is %d, %d", bindCore, bindSaCore);
+    uint32_t autoPlacement = readConfig.GetAutoPlacement();
+    Salog(LV_WARNING, LOG_TYPE, "core binding is %d, %d, auto placement %u", bindCore, bindSaCore, autoPlacement);
     if((msgrAmount + vecPort.size()) > vecCoreId.size() && bindCore) {
         Salog(LV_CRITICAL, LOG_TYPE, "error : SA needs more than %d cores !", (msgrAmount+vecPort.size()));
         return ERROR_PORT;
@@ -221,23 +225,42 @@ int OSA_Init(SaExport &sa)
     qos.enableThrottle = readConfig.GetMessengerThrottle();
     qos.saOpThrottle = readConfig.GetSaOpThrottle();
     Salog(LV_WARNING, LOG_TYPE, "SA QoS limitWrite=%d, time_cyc=%d ms, enableThrottle=%d, opThrottle=%lu",
-        qos.limitWrite, qos.getQuotaCycle, qos.enableThrottle, qos.saOpThrottle);
+        qos.limitWrite.load(), qos.getQuotaCycle.load(), qos.enableThrottle, qos.saOpThrottle.load());
+    if (!OsaCheckQosParam(qos)) {
+        return ERROR_PORT;
+    }
 
-    if (qos.getQuotaCycle < 1) {
-        Salog(LV_CRITICAL, LOG_TYPE, "error : get quota cycle is %d", qos.getQuotaCycle);
+    OpLanePolicy lanes;
+    lanes.metaWeight = readConfig.GetLaneMetaWeight();
+    lanes.dataWeight = readConfig.GetLaneDataWeight();
+    lanes.starveMs = readConfig.GetLaneStarveMs();
+    if (lanes.metaWeight > SA_LANE_MAX_WEIGHT || lanes.dataWeight > SA_LANE_MAX_WEIGHT ||
+        (lanes.metaWeight != 0 && (lanes.dataWeight == 0 || lanes.starveMs == 0))) {
+        Salog(LV_CRITICAL, LOG_TYPE, "error : op lane weights %u:%u starve %u ms, weights should be 1~%u",
+            lanes.metaWeight, lanes.dataWeight, lanes.starveMs, SA_LANE_MAX_WEIGHT);
         return ERROR_PORT;
     }
-    if ((qos.saOpThrottle != 0) && (qos.saOpThrottle < 2000 || qos.saOpThrottle > 30000)) {
-        Salog(LV_CRITICAL, LOG_TYPE, "error : get quota cycle is %d, should in {0, [2000~30000]}", qos.saOpThrottle);
+
+    OpBatchPolicy batch;
+    batch.maxOps = readConfig.GetBatchMaxOps();
+    batch.lingerUs = readConfig.GetBatchLingerUs();
+    if (batch.maxOps == 0 || batch.maxOps > SA_BATCH_MAX_OPS || batch.lingerUs > SA_BATCH_MAX_LINGER_US) {
+        Salog(LV_CRITICAL, LOG_TYPE, "error : op batch %u ops linger %u us, should be 1~%u ops and 0~%u us",
+            batch.maxOps, batch.lingerUs, SA_BATCH_MAX_OPS, SA_BATCH_MAX_LINGER_US);
         return ERROR_PORT;
     }
 
+    OpTraceParam trace;
+    trace.path = readConfig.GetOpTracePath();
+    trace.maxBytes = readConfig.GetOpTraceMaxMb() << 20;
+    trace.payloadHash = readConfig.GetOpTracePayloadHash();
+
     char szMsgrAmount[4] = {0};
     sprintf(szMsgrAmount, "%d", msgrAmount);
     Salog(LV_INFORMATION, LOG_TYPE, "Server adaptor init queueAmount=%d szMsgrAmount=%s bindCore=%d bindSaCore=%d",
 		    queueAmount, szMsgrAmount, bindCore, bindSaCore);
 
-    vector<const char *> args = { "--conf", "/opt/gcache/conf/gcache.conf" };
+    vector<const char *> args = { "--conf", SA_CONF_PATH.c_str() };
     map<string, string> defaults = { { "ms_async_op_threads", szMsgrAmount } };
     static auto cct = global_init(&defaults, args, 0xFF /* 0xFF CEPH_ENTITY_TYPE_ANY */,
 	    CODE_ENVIRONMENT_LIBRARY /*CODE_ENVIRONMENT_LIBRARY CODE_ENVIRONMENT_DAEMON */,
@@ -246,6 +269,13 @@ int OSA_Init(SaExport &sa)
     int ret = 0;
     if (g_ptrNetwork == nullptr) {
         g_ptrNetwork = new NetworkModule(sa, vecCoreId, msgrAmount, bindCore, bindSaCore);
+	if (autoPlacement) {
+	    g_ptrNetwork->SetAutoPlacement(GetIfNameByAddr(rAddr));
+	}
+	g_ptrNetwork->SetQueueAffinity(readConfig.GetQueueAffinity() != 0);
+	g_ptrNetwork->SetLanePolicy(lanes);
+	g_ptrNetwork->SetBatchPolicy(batch);
+	g_ptrNetwork->SetLegacyOpArgs(readConfig.GetOpArgsLegacy() != 0);
 	g_ptrNetwork->CreateWorkThread(queueAmount, vecPort.size(),queueMaxCapacity);
 	string sAddr = rAddr;
         string sPort = vecPort[0];
@@ -256,6 +286,7 @@ int OSA_Init(SaExport &sa)
 	    return 1;
 	}
     g_ptrNetwork->SetQosParam(qos);
+    g_ptrNetwork->SetTraceParam(trace);
 	int bindSuccess = -1;
 	ret = g_ptrNetwork->InitNetworkModule(rAddr, vecPort, sAddr, sPort, &bindSuccess);
 
@@ -275,6 +306,14 @@ int OSA_Init(SaExport &sa)
 	if (bindSuccess == 0) {
 	    ret=ERROR_BIND;
 	}
+	if (ret == 0) {
+	    // QoS and queue limits can change without restart, a failed watcher only loses that
+	    g_ptrConfReload = new OsaConfigReload(g_ptrNetwork, SA_CONF_PATH);
+	    if (g_ptrConfReload->Start() != 0) {
+		delete g_ptrConfReload;
+		g_ptrConfReload = nullptr;
+	    }
+	}
     }
     return ret;
 }
@@ -286,6 +325,11 @@ int OSA_Finish()
     if( g_ptrNetwork == nullptr) {
 	return 1;
     }
+    if (g_ptrConfReload) {
+        g_ptrConfReload->Stop();
+        delete g_ptrConfReload;
+        g_ptrConfReload = nullptr;
+    }
     ret = g_ptrNetwork->FinishNetworkModule();
     g_ptrNetwork->StopThread();
     delete g_ptrNetwork;
@@ -334,6 +378,13 @@ void OSA_EncodeRead(uint64_t opType, unsigned int offset, unsigned int len, char
     EncodeRead(opType, offset, len, buf, bufLen, i, ptr);
 }
 
+void OSA_EncodeReadZeroCopy(uint64_t opType, unsigned int offset, unsigned int len, char *buf, unsigned int bufLen,
+    RELEASE_FUNC release, void *releaseArg, int i, void *p)
+{
+    MOSDOp *ptr = (MOSDOp *)(p);
+    EncodeReadZeroCopy(opType, offset, len, buf, bufLen, release, releaseArg, i, ptr);
+}
+
 void OSA_SetOpResult(int i, int32_t ret, void *p)
 {
     MOSDOp *ptr = (MOSDOp *)(p);
@@ -401,14 +452,9 @@ int OSA_ExecClass(SaOpContext *pctx, PREFETCH_FUNC prefetch)
         osdop.objLength = len;
         return prefetch(*pOpReq, osdop);
     } else if (cname.compare("rbd") == 0 && mname.compare("copyup") == 0) {
-        if (cls_cxx_stat2(pctx, NULL, NULL) == 0) {
-            Salog(LV_DEBUG, LOG_TYPE, "finish state, tid=%ld", pOpReq->tid);
-            *pOpReq->copyupFlag = 0;
-            return 0;
-        }
-        int ret = cls_cxx_write(pctx, 0, indata.length(), &indata);
-        Salog(LV_DEBUG, LOG_TYPE, "finish write, tid=%ld", pOpReq->tid);
-        *pOpReq->copyupFlag = 0;
+        string key = CopyupKey(pOpReq->poolId, pOpReq->vecOps[pctx->opId].objName);
+        int ret = GetCopyupExecutor().Run(key, [pctx, &indata]() { return CopyupWrite(pctx, indata); });
+        Salog(LV_DEBUG, LOG_TYPE, "finish copyup, tid=%ld ret=%d", pOpReq->tid, ret);
         return ret;
     }
 
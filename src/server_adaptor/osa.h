@@ -30,6 +30,9 @@ OSA_API_PUBLIC void OSA_EncodeOmapGetvals(const SaBatchKv *KVs, int i,void *p);
 OSA_API_PUBLIC void OSA_EncodeOmapGetvalsbykeys(const SaBatchKv *keyValue, int i, void *p);
 OSA_API_PUBLIC void OSA_EncodeRead(uint64_t opType, unsigned int offset, unsigned int len, char *buf,
 	unsigned int bufLen, int i, void *p);
+/* buf stays owned by the cache and is referenced by the reply until release(releaseArg) */
+OSA_API_PUBLIC void OSA_EncodeReadZeroCopy(uint64_t opType, unsigned int offset, unsigned int len, char *buf,
+	unsigned int bufLen, RELEASE_FUNC release, void *releaseArg, int i, void *p);
 OSA_API_PUBLIC void OSA_SetOpResult(int i, int32_t ret, void *p);
 OSA_API_PUBLIC void OSA_EncodeXattrGetxattr(const SaBatchKv *keyValue, int i, void *p);
 OSA_API_PUBLIC void OSA_EncodeXattrGetxattrs(const SaBatchKv *keyValue, int i, void *p);
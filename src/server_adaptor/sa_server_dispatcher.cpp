@@ -7,6 +7,7 @@
 #include "sa_server_dispatcher.h"
 #include "salog.h"
 #include "network_module.h"
+#include "op_trace.h"
 
 #include "messages/MPing.h"
 #include "messages/MDataPing.h"
@@ -29,8 +30,47 @@ SaServerDispatcher::SaServerDispatcher( Messenger *msgr, MsgModule *msgModule, N
 
 SaServerDispatcher::~SaServerDispatcher() {}
 
+bool SaServerDispatcher::ms_can_fast_dispatch_any() const
+{
+   return ptrNetworkModule->IsAutoPlacement() || ptrNetworkModule->IsQueueAffinity();
+}
+
+bool SaServerDispatcher::ms_can_fast_dispatch(const Message *m) const
+{
+   // all ops of a connection take one path, one that would wait is deferred by NetworkModule
+   return ptrNetworkModule->IsQueueAffinity() && m->get_type() == CEPH_MSG_OSD_OP;
+}
+
+void SaServerDispatcher::ms_fast_preprocess(Message *m)
+{
+   ptrNetworkModule->PlaceMsgrThread();
+}
+
+void SaServerDispatcher::ms_fast_dispatch(Message *m)
+{
+   dcount++;
+   HandleOsdOp(m, true);
+}
+
+void SaServerDispatcher::HandleOsdOp(Message *m, bool fast)
+{
+   MOSDOp *osdOp = dynamic_cast<MOSDOp *>(m);
+   if (osdOp == nullptr) {
+      Salog(LV_ERROR, LOG_TYPE, "Critical error, Message from client is not MOSDOp!");
+      return;
+   }
+   osdOp->finish_decode();
+   if (unlikely(g_opTrace != nullptr)) {
+      g_opTrace->RecordOp(osdOp);
+   }
+   SaDatalog("Recive MOSDOp tid=%ld obj=%s, prepare to enqueue.",
+      osdOp->get_tid(), osdOp->get_oid().name.c_str());
+   ptrNetworkModule->EnqueueClientop(osdOp, fast);
+}
+
 bool SaServerDispatcher::ms_dispatch(Message *m) 
 {
+   ptrNetworkModule->PlaceMsgrThread();
    uint64_t dc = dcount++;
 
    ConnectionRef con = m->get_connection();
@@ -44,15 +84,7 @@ bool SaServerDispatcher::ms_dispatch(Message *m)
          con->send_message(m);
       } break;
       case CEPH_MSG_OSD_OP: {
-	      MOSDOp *osdOp = dynamic_cast<MOSDOp *>(m);
-	      if (osdOp == nullptr) {
-            Salog(LV_ERROR, LOG_TYPE, "Critical error, Message from client is not MOSDOp!");
-		      return true;
-	      }
-         osdOp->finish_decode();
-	      SaDatalog("Recive MOSDOp tid=%ld obj=%s, prepare to enqueue.",
-            osdOp->get_tid(), osdOp->get_oid().name.c_str());
-	      ptrNetworkModule->EnqueueClientop(osdOp);
+         HandleOsdOp(m);
 	   } break;
       default: {
 	      Salog(LV_DEBUG, LOG_TYPE, "Server dispatch unknown message type %d", m->get_type());
@@ -63,6 +95,10 @@ bool SaServerDispatcher::ms_dispatch(Message *m)
 
 bool SaServerDispatcher::ms_handle_reset(Connection *con) 
 {
+   if (g_opTrace != nullptr) {
+      g_opTrace->ResetConnection(con);
+   }
+   ptrNetworkModule->ForgetConnection(con);
    return true;
 }
  
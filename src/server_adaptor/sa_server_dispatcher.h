@@ -20,6 +20,8 @@ class SaServerDispatcher : public Dispatcher {
     MsgModule *ptrMsgModule { nullptr };
     NetworkModule *ptrNetworkModule { nullptr };
 
+    void HandleOsdOp(Message *m, bool fast = false);
+
 public:
    SaServerDispatcher() = delete;
    explicit SaServerDispatcher( Messenger *msgr, MsgModule *msgModule, NetworkModule *networkModule);
@@ -34,6 +36,12 @@ public:
 	active = true;
    }
 
+   // with auto placement the fast hooks run on the messenger workers so they can pin themselves;
+   // ops are fast dispatched only with queue affinity, otherwise they go through ms_dispatch
+   bool ms_can_fast_dispatch_any() const override;
+   bool ms_can_fast_dispatch(const Message *m) const override;
+   void ms_fast_preprocess(Message *m) override;
+   void ms_fast_dispatch(Message *m) override;
    bool ms_dispatch(Message *m) override;
    void ms_handle_connect(Connection *con) override {};
    void ms_handle_accept(Connection *con) override {};
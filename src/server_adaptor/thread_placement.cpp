@@ -0,0 +1,260 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#include "thread_placement.h"
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+#include "salog.h"
+
+using namespace std;
+
+namespace {
+const string LOG_TYPE = "PLACEMENT";
+
+bool ReadSysLine(const string &path, string &line)
+{
+    ifstream in(path);
+    if (!in || !getline(in, line)) {
+        return false;
+    }
+    return true;
+}
+
+int ReadSysInt(const string &path, int def)
+{
+    string line;
+    if (!ReadSysLine(path, line) || line.empty()) {
+        return def;
+    }
+    return atoi(line.c_str());
+}
+}
+
+int ParseCpuList(const string &list, vector<int> &out)
+{
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (item.empty() || item == "\n") {
+            continue;
+        }
+        size_t dash = item.find('-');
+        char *end = nullptr;
+        long first = strtol(item.c_str(), &end, 10);
+        if (end == item.c_str() || first < 0) {
+            return -EINVAL;
+        }
+        long last = first;
+        if (dash != string::npos) {
+            last = strtol(item.c_str() + dash + 1, &end, 10);
+            if (last < first) {
+                return -EINVAL;
+            }
+        }
+        for (long c = first; c <= last; c++) {
+            out.push_back(c);
+        }
+    }
+    return 0;
+}
+
+string GetIfNameByAddr(const string &addr)
+{
+    struct in_addr target;
+    if (inet_pton(AF_INET, addr.c_str(), &target) != 1) {
+        return "";
+    }
+    struct ifaddrs *ifaddr = nullptr;
+    if (getifaddrs(&ifaddr) == -1) {
+        Salog(LV_ERROR, LOG_TYPE, "getifaddrs error %d", -errno);
+        return "";
+    }
+    string name;
+    for (struct ifaddrs *ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET) {
+            continue;
+        }
+        if (reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr)->sin_addr.s_addr == target.s_addr) {
+            name = ifa->ifa_name;
+            break;
+        }
+    }
+    freeifaddrs(ifaddr);
+    return name;
+}
+
+int CpuTopology::Load(const string &sysRoot)
+{
+    root = sysRoot;
+    cpus.clear();
+    string line;
+    vector<int> online;
+    if (!ReadSysLine(root + "/devices/system/cpu/online", line) || ParseCpuList(line, online) != 0 ||
+        online.empty()) {
+        Salog(LV_ERROR, LOG_TYPE, "no online cpus under %s", root.c_str());
+        return -ENOENT;
+    }
+    map<int, int> cpuNode;
+    vector<int> nodes;
+    // kernels without NUMA have no node directory, everything is node 0 then
+    if (ReadSysLine(root + "/devices/system/node/online", line) && ParseCpuList(line, nodes) == 0) {
+        for (int n : nodes) {
+            vector<int> nodeCpus;
+            if (ReadSysLine(root + "/devices/system/node/node" + to_string(n) + "/cpulist", line)) {
+                ParseCpuList(line, nodeCpus);
+            }
+            for (int c : nodeCpus) {
+                cpuNode[c] = n;
+            }
+        }
+    }
+    nodeNum = nodes.empty() ? 1 : nodes.size();
+    for (int c : online) {
+        CpuInfo info;
+        string dir = root + "/devices/system/cpu/cpu" + to_string(c) + "/topology/";
+        info.cpu = c;
+        info.node = cpuNode.count(c) ? cpuNode[c] : 0;
+        info.package = ReadSysInt(dir + "physical_package_id", 0);
+        info.core = ReadSysInt(dir + "core_id", c);
+        cpus.push_back(info);
+    }
+    return 0;
+}
+
+int CpuTopology::GetNicNode(const string &ifName) const
+{
+    if (ifName.empty() || nodeNum <= 1) {
+        return -1;
+    }
+    return ReadSysInt(root + "/class/net/" + ifName + "/device/numa_node", -1);
+}
+
+int ThreadPlacement::Init(const PlacementParam &param)
+{
+    if (param.msgrNum == 0) {
+        return -EINVAL;
+    }
+    int ret = topo.Load(param.sysRoot);
+    if (ret != 0) {
+        return ret;
+    }
+    nicNode = topo.GetNicNode(param.ifName);
+
+    vector<CpuInfo> candidates;
+    for (auto &c : topo.GetCpus()) {
+        if (param.allowed.empty() || find(param.allowed.begin(), param.allowed.end(), c.cpu) != param.allowed.end()) {
+            candidates.push_back(c);
+        }
+    }
+    uint32_t local = count_if(candidates.begin(), candidates.end(), [this](const CpuInfo &c) {
+        return c.node == nicNode;
+    });
+    if (nicNode >= 0 && local >= param.msgrNum) {
+        candidates.erase(remove_if(candidates.begin(), candidates.end(), [this](const CpuInfo &c) {
+            return c.node != nicNode;
+        }), candidates.end());
+    } else if (nicNode >= 0) {
+        Salog(LV_WARNING, LOG_TYPE, "only %u allowed cpus on NIC node %d, spilling to other nodes", local, nicNode);
+    }
+    if (candidates.empty()) {
+        Salog(LV_ERROR, LOG_TYPE, "no cpu left to place threads on");
+        return -EINVAL;
+    }
+    // NIC node first, then siblings of one physical core next to each other
+    sort(candidates.begin(), candidates.end(), [this](const CpuInfo &a, const CpuInfo &b) {
+        return make_tuple(a.node != nicNode, a.node, a.package, a.core, a.cpu) <
+            make_tuple(b.node != nicNode, b.node, b.package, b.core, b.cpu);
+    });
+
+    uint32_t n = candidates.size();
+    workerCpu.assign(param.msgrNum, 0);
+    queueCpu.assign(param.queueNum, 0);
+    dispatchCpus.clear();
+    for (auto &c : candidates) {
+        dispatchCpus.push_back(c.cpu);
+    }
+    if (n >= param.msgrNum + param.queueNum) {
+        // a cpu for every thread, each worker followed by its own queues
+        uint32_t pos = 0;
+        for (uint32_t w = 0; w < param.msgrNum; w++) {
+            workerCpu[w] = candidates[pos++].cpu;
+            for (uint32_t q = w; q < param.queueNum; q += param.msgrNum) {
+                queueCpu[q] = candidates[pos++].cpu;
+            }
+        }
+    } else {
+        // each worker gets an even slice and its queues share the rest of it
+        for (uint32_t w = 0; w < param.msgrNum; w++) {
+            uint32_t base = (n >= param.msgrNum) ? w * n / param.msgrNum : w % n;
+            uint32_t size = (n >= param.msgrNum) ? (w + 1) * n / param.msgrNum - base : 1;
+            workerCpu[w] = candidates[base].cpu;
+            uint32_t k = 0;
+            for (uint32_t q = w; q < param.queueNum; q += param.msgrNum, k++) {
+                queueCpu[q] = (size > 1) ? candidates[base + 1 + k % (size - 1)].cpu : candidates[base].cpu;
+            }
+        }
+    }
+    Salog(LV_WARNING, LOG_TYPE, "thread placement on NIC node %d (%s), %u cpus: %s", nicNode,
+        param.ifName.c_str(), n, Dump().c_str());
+    return 0;
+}
+
+vector<int> ThreadPlacement::GetCpus(PlacementRole role, uint32_t index) const
+{
+    if (role == PLACEMENT_MSGR_WORKER && !workerCpu.empty()) {
+        return { workerCpu[index % workerCpu.size()] };
+    }
+    if (role == PLACEMENT_QUEUE && !queueCpu.empty()) {
+        return { queueCpu[index % queueCpu.size()] };
+    }
+    return dispatchCpus;
+}
+
+int ThreadPlacement::Register(PlacementRole role, uint32_t index, pthread_t thread)
+{
+    vector<int> cpus = GetCpus(role, index);
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int c : cpus) {
+        CPU_SET(c, &mask);
+    }
+    int ret = pthread_setaffinity_np(thread, sizeof(mask), &mask);
+    if (ret != 0) {
+        Salog(LV_ERROR, LOG_TYPE, "setaffinity role %d index %u failed %d", role, index, ret);
+        return -ret;
+    }
+    Salog(LV_INFORMATION, LOG_TYPE, "role %d index %u placed on cpu %d%s", role, index, cpus[0],
+        cpus.size() > 1 ? " and its node" : "");
+    return 0;
+}
+
+string ThreadPlacement::Dump() const
+{
+    ostringstream out;
+    for (uint32_t w = 0; w < workerCpu.size(); w++) {
+        out << "worker" << w << ":" << workerCpu[w] << " [";
+        for (uint32_t q = w; q < queueCpu.size(); q += workerCpu.size()) {
+            out << (q == w ? "" : " ") << "q" << q << ":" << queueCpu[q];
+        }
+        out << "] ";
+    }
+    out << "dispatch:";
+    for (uint32_t i = 0; i < dispatchCpus.size(); i++) {
+        out << (i == 0 ? "" : ",") << dispatchCpus[i];
+    }
+    return out.str();
+}
@@ -0,0 +1,86 @@
+/* License:LGPL-2.1
+ *
+ * Copyright (c) 2021 Huawei Technologies Co., Ltd All rights reserved.
+ *
+ */
+
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct CpuInfo {
+    int cpu { 0 };
+    int node { 0 };
+    int package { 0 };
+    int core { 0 };
+};
+
+/* CPU and NUMA layout read from sysfs; the root is a parameter so tests can use synthetic trees */
+class CpuTopology {
+    std::string root;
+    std::vector<CpuInfo> cpus;
+    int nodeNum { 1 };
+
+public:
+    int Load(const std::string &sysRoot);
+    // NUMA node of the NIC behind ifName, -1 when unknown (virtual or single node)
+    int GetNicNode(const std::string &ifName) const;
+    const std::vector<CpuInfo> &GetCpus() const
+    {
+        return cpus;
+    }
+    int GetNodeNum() const
+    {
+        return nodeNum;
+    }
+};
+
+int ParseCpuList(const std::string &list, std::vector<int> &out);
+std::string GetIfNameByAddr(const std::string &addr);
+
+enum PlacementRole {
+    PLACEMENT_MSGR_WORKER = 0,
+    PLACEMENT_DISPATCH,
+    PLACEMENT_QUEUE,
+};
+
+struct PlacementParam {
+    std::string sysRoot { "/sys" };
+    std::string ifName;
+    // cpus the adaptor may use, empty for all online cpus
+    std::vector<int> allowed;
+    uint32_t msgrNum { 3 };
+    uint32_t dispatchNum { 1 };
+    uint32_t queueNum { 4 };
+};
+
+/*
+ * Plans cpus for the adaptor threads on the NUMA node of the NIC. Queue q is fed
+ * by messenger worker q % msgrNum, and each worker sits next to its queues so
+ * that SMT siblings and shared caches serve one group. Threads register their
+ * own handle when they start instead of being looked up by name.
+ */
+class ThreadPlacement {
+    CpuTopology topo;
+    int nicNode { -1 };
+    std::vector<int> workerCpu;
+    std::vector<int> queueCpu;
+    std::vector<int> dispatchCpus;
+
+public:
+    int Init(const PlacementParam &param);
+    int GetNicNode() const
+    {
+        return nicNode;
+    }
+    // the planned cpus of a thread, all of them for dispatch threads
+    std::vector<int> GetCpus(PlacementRole role, uint32_t index) const;
+    int Register(PlacementRole role, uint32_t index, pthread_t thread);
+    std::string Dump() const;
+};
+
+#endif